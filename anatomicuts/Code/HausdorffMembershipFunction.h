@@ -31,6 +31,8 @@ class HausdorffMembershipFunction :  public LabelPerPointMembershipFunction< TVe
 		 * Method to get probability of an instance. The return value is the
 		 * value of the density function, not probability. */
 		double Evaluate(const MeasurementVectorType *m1,const MeasurementVectorType *m2)const ;
+		/** Stops as soon as the distance is large enough for the value to be below minValue */
+		double EvaluateBounded(const MeasurementVectorType *m1,const MeasurementVectorType *m2, double minValue)const ;
 		//double Evaluate(const MeasurementVectorType &measurement) const{ std::cout << "not implemented " << std::endl;return -1;};
 
 	protected:
@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include <fstream>
+#include <limits>
 #include "HausdorffMembershipFunction.h"
 
 
@@ -16,11 +17,20 @@ template < class TVector >
 double 
 HausdorffMembershipFunction< TVector >
 ::Evaluate(const MeasurementVectorType *m1, const MeasurementVectorType *m2 ) const
+{
+	return this->EvaluateBounded(m1, m2, 0);
+}
+template < class TVector >
+double 
+HausdorffMembershipFunction< TVector >
+::EvaluateBounded(const MeasurementVectorType *m1, const MeasurementVectorType *m2, double minValue ) const
 {
 //	std::cout << " hausdorff " << std::endl;
 	typedef typename MeasurementVectorType::CellType CellType;
 	const std::vector<CellType>* labels1 =m1->GetLabels();
 	//const std::vector<CellType>* labels2 =m2->GetLabels();
+	// 1/(dist+1) < minValue as soon as dist > 1/minValue-1
+	const double maxDist = (minValue > 0) ? 1/minValue - 1 : std::numeric_limits<double>::max();
 	double max1=0.0, max2=0.0;	
 	int numPoints =  labels1->size()-1;
 	for(int i=0;i<numPoints;i++)
@@ -41,6 +51,8 @@ HausdorffMembershipFunction< TVector >
 		}	
 		max1= std::max(max1,min1);
 		max2= std::max(max2,min2);
+		if(std::max(max1, max2) > maxDist)
+			return 0;
 	}
 
 	return 1/(std::max(max1, max2)+1);
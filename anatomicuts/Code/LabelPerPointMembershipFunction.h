@@ -50,6 +50,9 @@ class LabelPerPointMembershipFunction :
 		 * value of the density function, not probability. */
 		double Evaluate(const MeasurementVectorType *measurement) const{return this->Evaluate(this->GetCentroid(), measurement);}
 		virtual double Evaluate(const MeasurementVectorType *m1,const MeasurementVectorType *m2)const = 0; /*{std::cout << "que cagada " << std::endl;}*/
+		/** Same as Evaluate(m1,m2), except that it may stop early and return any value
+		 * below minValue once it knows the result is below it. Used to prune kNN searches. */
+		virtual double EvaluateBounded(const MeasurementVectorType *m1,const MeasurementVectorType *m2, double minValue)const {return this->Evaluate(m1,m2);}
 		double EvaluateNO2(const MeasurementVectorType *m1,const MeasurementVectorType *m2)const ;
 		double Evaluate(const MeasurementVectorType &measurement) const{ std::cout << "not implemented " << std::endl;return -1;}
 		void WithEuclid(bool on)
@@ -15,6 +15,7 @@
 #include "itkWeightedCentroidKdTreeGenerator.h"
 #include "itkMeshToMeshFilter.h"
 #include "ThreadedMembershipFunction.h"
+#include "ThreadedKNNAffinity.h"
 #if ITK_VERSION_MAJOR < 4
 #include "itkMaximumDecisionRule2.h"
 #else
@@ -67,6 +68,7 @@ class NormalizedCutsFilter :
 		typedef typename MembershipFunctionType::MeasurementVectorType MeasurementVectorType;
 
 		typedef ThreadedMembershipFunction<MembershipFunctionType> ThreadedMembershipFunctionType;
+		typedef ThreadedKNNAffinity<MembershipFunctionType> ThreadedKNNAffinityType;
 	
 
 		typedef ListSample< MeasurementVectorType > SampleType;
@@ -109,6 +111,16 @@ class NormalizedCutsFilter :
 		{
 			return m_numberOfFibersForEigenDecomposition;
 		}
+		/** If > 0, cut all fibers using a sparse affinity to this many nearest neighbours
+		 * instead of the dense affinity of a subsample */
+		void SetNumberOfNeighbors(int k)
+		{
+			this->m_numberOfNeighbors = k;
+		}
+		int GetNumberOfNeighbors()
+		{
+			return m_numberOfNeighbors;
+		}
 
 		std::vector<std::string> GetLabels()
 		{ return this->labels;}
@@ -147,11 +159,12 @@ class NormalizedCutsFilter :
 
 		std::vector<std::pair<int,int>> SelectCentroids(typename SampleType::Pointer samples, const typename MembershipFunctionType::Pointer);
 		std::vector<std::pair<int,int>> SelectCentroidsParallel(typename SampleType::Pointer samples, const typename MembershipFunctionType::Pointer);
+		std::vector<std::pair<int,int>> SelectCentroidsKNN(typename SampleType::Pointer samples, const typename MembershipFunctionType::Pointer);
 		MeshPointerType input;
 		std::vector<std::string> labels;
 		ListOfOutputMeshTypePointer m_Output;
 		int numberOfClusters;
-		NormalizedCutsFilter() {}
+		NormalizedCutsFilter() : m_numberOfNeighbors(0) {}
 		~NormalizedCutsFilter() {}
 
 		//    virtual void GenerateData (void);
@@ -162,6 +175,7 @@ class NormalizedCutsFilter :
 		void operator=(const Self&);    
 		int m_SigmaCurrents;
 		int m_numberOfFibersForEigenDecomposition;
+		int m_numberOfNeighbors;
 //		void SaveClustersInMeshes(MembershipFunctionVectorType mfv);
 		MembershipFunctionVectorType *m_membershipFunctions; 
 };  
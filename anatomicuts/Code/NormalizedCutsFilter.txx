@@ -74,7 +74,7 @@ NormalizedCutsFilter < TMesh,TMembershipFunctionType >::Update()
 		typename SampleType::Pointer samplePositives = SampleType::New();
 		typename SampleType::Pointer sampleNegatives = SampleType::New();
 		
-		if(sample->Size() > this->GetNumberOfFibersForEigenDecomposition())
+		if(centroidIndeces.size() < sample->Size())
 		{
 			//Multi-thread
 			std::vector<std::pair<int, int>> inIndeces;
@@ -164,6 +164,9 @@ template< class TMesh,class  TMembershipFunctionType>
 NormalizedCutsFilter < TMesh ,TMembershipFunctionType>::SelectCentroidsParallel(typename SampleType::Pointer samples, const typename MembershipFunctionType::Pointer membershipFunction )
 {
 
+	if(this->GetNumberOfNeighbors() > 0)
+		return this->SelectCentroidsKNN(samples, membershipFunction);
+
 	std::vector<std::pair<int,int>> indices;
 	std::vector<int> selected;
 
@@ -243,6 +246,104 @@ NormalizedCutsFilter < TMesh ,TMembershipFunctionType>::SelectCentroidsParallel(
 	delete ms;
 	return indices;
 }
+template< class TMesh,class  TMembershipFunctionType>
+	std::vector<std::pair<int,int>>	
+NormalizedCutsFilter < TMesh ,TMembershipFunctionType>::SelectCentroidsKNN(typename SampleType::Pointer samples, const typename MembershipFunctionType::Pointer membershipFunction )
+{
+	// Cut all the fibers of the sample with a sparse affinity matrix: each fiber is
+	// compared to the fibers with the closest centroids only, and keeps the
+	// GetNumberOfNeighbors() largest affinities.
+	typedef itk::Vector<double,3> CentroidType;
+	typedef ListSample< CentroidType > CentroidSampleType;
+	typedef KdTreeGenerator< CentroidSampleType > CentroidTreeGeneratorType;
+	typedef typename CentroidTreeGeneratorType::KdTreeType CentroidTreeType;
+
+	std::vector<std::pair<int,int>> indices;
+	const unsigned int n = samples->Size();
+	// a fiber is not its own neighbour
+	const unsigned int k = std::min((unsigned int)this->GetNumberOfNeighbors(), n-1);
+	// candidates examined per fiber, most of them rejected early by the bound;
+	// one more is searched since the fiber itself is among the nearest centroids
+	const unsigned int nc = std::min(3*k+1, n);
+
+	typename CentroidSampleType::Pointer centroids = CentroidSampleType::New();
+	centroids->SetMeasurementVectorSize(3);
+	for (unsigned i=0; i<n; i++) 
+	{
+		const MeasurementVectorType &mv = samples->GetMeasurementVector(i);
+		const int numPoints = mv.Size()/3;
+		CentroidType c;
+		c.Fill(0);
+		for(int p=0;p<numPoints;p++)
+			for(int d=0;d<3;d++)
+				c[d] += mv[p*3+d]/numPoints;
+		centroids->PushBack(c);
+	}
+
+	typename CentroidTreeGeneratorType::Pointer treeGenerator = CentroidTreeGeneratorType::New();
+	treeGenerator->SetSample(centroids);
+	treeGenerator->SetBucketSize(16);
+	treeGenerator->Update();
+	typename CentroidTreeType::ConstPointer tree = treeGenerator->GetOutput();
+
+	// kd-tree searches are not thread safe, so gather the candidates first, nearest first
+	std::vector<std::vector<int>> candidates(n);
+	for (unsigned i=0; i<n; i++) 
+	{
+		typename CentroidTreeType::InstanceIdentifierVectorType neighbors;
+		tree->Search(centroids->GetMeasurementVector(i), nc, neighbors);
+		candidates[i].reserve(neighbors.size());
+		for(size_t c=0; c<neighbors.size(); c++)
+			if(neighbors[c] != i)
+				candidates[i].push_back(neighbors[c]);
+	}
+
+	typename ThreadedKNNAffinityType::Pointer threadedAffinity = ThreadedKNNAffinityType::New();
+	typename ThreadedKNNAffinityType::DomainType domain;
+	domain[0]=0;
+	domain[1]= n-1;
+	typename MembershipFunctionType::Pointer hola = (*this->GetMembershipFunctionVector())[0];
+	threadedAffinity->SetStuff(samples, &candidates, hola, k);
+	threadedAffinity->Execute(hola ,domain);
+	vnl_sparse_matrix<double>* ms= threadedAffinity->GetResults();
+
+	vnl_sparse_matrix<double> diagonal(n,n);
+	for (unsigned i=0; i<n; i++) 
+		diagonal(i,i) =ms->sum_row(i);	
+
+	vnl_sparse_matrix<double> prod(n,n);
+	diagonal.subtract(*ms,prod);
+
+	// only the two smallest generalized eigenpairs are needed for the cut
+	vnl_sparse_symmetric_eigensystem es;
+	int res = es.CalculateNPairs(prod, diagonal, std::min(2u, n-1), 0.0000001,0,true, true,1000000,-1);
+	if(res<0)
+		std::cout << " ERROR " <<std::endl;
+
+	vnl_vector< double > vector ;
+	std::cout <<"e0 " <<  es.get_eigenvalue(0) << "e1 " << es.get_eigenvalue(1) <<std::endl;
+	if(es.get_eigenvalue(0)>0.1e-10)
+		vector  = es.get_eigenvector(0);
+	else
+		vector  = es.get_eigenvector(1);
+	int positivos=0, negativos=0;
+	for(unsigned i=0;i<n;i++)
+	{
+		if(vector(i)> 0)
+		{
+			positivos++;
+			indices.push_back(  std::pair<int, int>(0,i));
+		}
+		else
+		{
+			negativos++;
+			indices.push_back(  std::pair<int, int >(1, i));
+		}	
+	}
+	std::cout << " positivos " << positivos << " negativos " << negativos << std::endl;
+	delete ms;
+	return indices;
+}
 template< class TMesh,class  TMembershipFunctionType>
 	std::vector<std::pair<int,int>>	
 NormalizedCutsFilter < TMesh ,TMembershipFunctionType>::SelectCentroids(typename SampleType::Pointer samples, const typename MembershipFunctionType::Pointer membershipFunction )
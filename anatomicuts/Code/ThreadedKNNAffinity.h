@@ -0,0 +1,54 @@
+#ifndef _ThreadedKNNAffinity_h
+#define _ThreadedKNNAffinity_h
+
+#include "itkDomainThreader.h"
+#include "vnl/vnl_sparse_matrix.h"
+#include "itkThreadedIndexedContainerPartitioner.h"
+
+/** Sparse k-nearest-neighbour affinity matrix of a sample.
+ * The domain is the rows of the matrix. For each row i, the membership function is evaluated
+ * against the candidate neighbours of i (e.g. the closest streamline centroids), in order, and
+ * the k largest values are kept. i itself is skipped if it is among its candidates. Once k values are found, the smallest of them is passed to
+ * EvaluateBounded so that far candidates can be rejected early. */
+template<class TMembershipFunctionType> 
+class ThreadedKNNAffinity :  public itk::DomainThreader<itk::ThreadedIndexedContainerPartitioner, TMembershipFunctionType>
+{
+	public :
+		using Self = ThreadedKNNAffinity;
+		using Superclass =  itk::DomainThreader<itk::ThreadedIndexedContainerPartitioner,TMembershipFunctionType>;
+		using Pointer =  itk::SmartPointer<Self>;
+		using ConstPointer = itk::SmartPointer<const Self>;
+
+		using DomainType = typename Superclass::DomainType;
+		itkNewMacro(Self);
+		typedef TMembershipFunctionType MembershipFunctionType;
+		typedef typename TMembershipFunctionType::MeasurementVectorType MeasurementVectorType; 
+		typedef itk::Statistics::ListSample< MeasurementVectorType > SampleType;
+
+		void SetStuff(typename SampleType::Pointer samples, const std::vector<std::vector<int>> *candidates, typename MembershipFunctionType::Pointer msf, int k) 
+		{
+			m_samples = samples;
+			m_candidates = candidates;
+			m_membershipFunction =  msf;
+			m_numberOfNeighbors = k;
+		}
+		/** Symmetric matrix: an entry is kept if either fiber is among the neighbours of the other */
+		vnl_sparse_matrix<double>* GetResults();
+
+	protected:
+		ThreadedKNNAffinity(){}
+		~ThreadedKNNAffinity(){}
+
+	private:
+		int m_numberOfNeighbors;
+		typename SampleType::Pointer  m_samples;
+		const std::vector<std::vector<int>> *m_candidates; 
+		std::vector<std::vector<std::pair<double,int>>> m_neighbors;
+		typename MembershipFunctionType::Pointer m_membershipFunction;
+		void BeforeThreadedExecution();
+		void ThreadedExecution(const DomainType&, const itk::ThreadIdType);
+		void AfterThreadedExecution();
+
+};
+#include "ThreadedKNNAffinity.txx"
+#endif
@@ -0,0 +1,72 @@
+#ifndef _ThreadedKNNAffinity_txx
+#define _ThreadedKNNAffinity_txx
+
+
+#include "ThreadedKNNAffinity.h"
+#include <algorithm>
+#include <functional>
+
+template< class  TMembershipFunctionType> void
+ThreadedKNNAffinity< TMembershipFunctionType >::BeforeThreadedExecution() 
+{
+	this->m_neighbors.clear();
+	this->m_neighbors.resize(this->m_candidates->size());
+}
+template< class  TMembershipFunctionType> void
+ThreadedKNNAffinity< TMembershipFunctionType >::ThreadedExecution(const DomainType& subDomain, const itk::ThreadIdType threadId) 
+{
+	const size_t k = this->m_numberOfNeighbors;
+	for( itk::IndexValueType ii = subDomain[0]; ii <= subDomain[1]; ++ii )
+	{	
+		const MeasurementVectorType *mi = &m_samples->GetMeasurementVector(ii);
+		// min-heap of the k largest (value, column) found so far
+		std::vector<std::pair<double,int>> &best = this->m_neighbors[ii];
+		best.reserve(k+1);
+		for(size_t c=0; c< (*m_candidates)[ii].size();c++)
+		{
+			int j = (*m_candidates)[ii][c];
+			// the self affinity is the largest one and would take one of the k slots
+			if(j == ii)
+				continue;
+			double bound = (best.size() < k) ? 0 : best.front().first;
+			double val = m_membershipFunction->EvaluateBounded(mi, &m_samples->GetMeasurementVector(j), bound);
+			if(best.size() < k)
+			{
+				best.push_back(std::pair<double,int>(val,j));
+				std::push_heap(best.begin(), best.end(), std::greater<std::pair<double,int>>());
+			}
+			else if( val > best.front().first)
+			{
+				std::pop_heap(best.begin(), best.end(), std::greater<std::pair<double,int>>());
+				best.back() = std::pair<double,int>(val,j);
+				std::push_heap(best.begin(), best.end(), std::greater<std::pair<double,int>>());
+			}
+		}
+	}
+}
+
+template< class  TMembershipFunctionType> void
+ThreadedKNNAffinity< TMembershipFunctionType >::AfterThreadedExecution() 
+{
+
+}
+template< class  TMembershipFunctionType> 
+vnl_sparse_matrix<double>* ThreadedKNNAffinity< TMembershipFunctionType >::GetResults()
+{
+	const int n = this->m_neighbors.size();
+	vnl_sparse_matrix<double>*res = new vnl_sparse_matrix<double>(n,n);
+
+	for(int i=0;i<n;i++)
+	{
+		for(size_t c=0;c<this->m_neighbors[i].size();c++)
+		{
+			int j= this->m_neighbors[i][c].second;
+			double val = this->m_neighbors[i][c].first;
+			if(val > (*res)(i,j))
+				(*res)(i,j)=(*res)(j,i)=val;
+		}
+	}
+	return res;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+source "$(dirname $0)/../test.sh"
+
+# The inputs are synthesized here rather than shipped in a testdata tarball:
+# a 32^3 segmentation with label 10 on the left half and 20 on the right
+# half, and two bundles of 15 straight streamlines along y, one per half.
+rm -rf $FSTEST_TESTDATA_DIR && mkdir -p $FSTEST_TESTDATA_DIR && cd $FSTEST_TESTDATA_DIR
+python3 - << 'EOF'
+import struct
+
+n = 32
+hdr = bytearray(348)
+struct.pack_into('<i', hdr, 0, 348)
+struct.pack_into('<8h', hdr, 40, 3, n, n, n, 1, 1, 1, 1)
+struct.pack_into('<2h', hdr, 70, 8, 32)
+struct.pack_into('<8f', hdr, 76, 1, 1, 1, 1, 1, 1, 1, 1)
+struct.pack_into('<f', hdr, 108, 352)
+struct.pack_into('<2h', hdr, 252, 0, 1)
+struct.pack_into('<12f', hdr, 280, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0)
+hdr[344:348] = b'n+1\0'
+with open('seg.nii', 'wb') as f:
+    f.write(hdr + bytes(4))
+    for s in range(n):
+        for r in range(n):
+            f.write(struct.pack('<%di' % n, *[10 if c < n // 2 else 20 for c in range(n)]))
+
+fibers = []
+for x0 in (6.0, 24.0):
+    for k in range(15):
+        x, z = x0 + 0.2 * (k % 5), 12.0 + 0.5 * (k // 5)
+        fibers.append([(x, 2.0 + y, z) for y in range(28)])
+hdr = bytearray(1000)
+hdr[0:6] = b'TRACK\0'
+struct.pack_into('<3h3f3f', hdr, 6, n, n, n, 1, 1, 1, 0, 0, 0)
+struct.pack_into('<16f', hdr, 440, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1)
+hdr[948:951] = b'LAS'
+struct.pack_into('<3i', hdr, 988, len(fibers), 2, 1000)
+with open('fibers.trk', 'wb') as f:
+    f.write(hdr)
+    for fiber in fibers:
+        f.write(struct.pack('<i', len(fiber)))
+        for p in fiber:
+            f.write(struct.pack('<3f', *p))
+EOF
+
+# sparse k-nearest-neighbour cut: the two bundles end up in separate clusters
+FSTEST_NO_DATA_RESET=1
+test_command dmri_AnatomiCuts -s seg.nii -f fibers.trk -c 2 -n 10 -knn 5 -o knn -d a
+[ $(ls knn/*.trk | wc -l) -eq 2 ]
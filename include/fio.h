@@ -39,6 +39,13 @@ int freadFloatEx(float *pf, FILE *fp) ;
 int freadIntEx(int *pi, FILE *fp) ;
 int freadShortEx(short *ps, FILE *fp) ;
 
+/* n big-endian values in one fread/fwrite, byte swapped in place (reading)
+   or through a small buffer (writing); return the number of values done */
+long  freadFloatArray(float *v, long n, FILE *fp) ;
+long  freadIntArray(int *v, long n, FILE *fp) ;
+long  fwriteFloatArray(const float *v, long n, FILE *fp) ;
+long  fwriteIntArray(const int *v, long n, FILE *fp) ;
+
 int   fwriteDouble(double d, FILE *fp) ;
 int   fwriteFloat(float f, FILE *fp) ;
 int   fwriteShort(short s, FILE *fp) ;
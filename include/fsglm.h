@@ -71,6 +71,7 @@ typedef struct {
   MATRIX *gCVM[GLMMAT_NCONTRASTS_MAX];
   MATRIX *igCVM[GLMMAT_NCONTRASTS_MAX];
   MATRIX *gtigCVM[GLMMAT_NCONTRASTS_MAX];
+  MATRIX *Fmat; // 1x1 F of the contrast in hand, kept with the GLM
 
   // These are elements used to compute pcc
   int DoPCC;
@@ -92,6 +93,7 @@ GLMMAT;
 
 GLMMAT *GLMalloc(void);
 int GLMfree(GLMMAT **pgm);
+GLMMAT *GLMcopy(GLMMAT *src);
 int GLMallocX(GLMMAT *glm, int nrows, int ncols);
 int GLMallocY(GLMMAT *glm);
 int GLMallocYFFxVar(GLMMAT *glm);
@@ -179,6 +179,8 @@ typedef struct
 }
 GCA_TISSUE_PARMS ;
 
+typedef struct GCA_PACK GCA_PACK ;
+
 typedef struct
 {
   float     node_spacing ;    /* inter-node spacing */
@@ -222,6 +224,7 @@ typedef struct
   int          total_training ;
   int          max_label ;
   COLOR_TABLE  *ct ;
+  GCA_PACK     *pack ;   // non-NULL if GCApack() has flattened nodes and priors
 }
 GAUSSIAN_CLASSIFIER_ARRAY, GCA ;
 
@@ -542,6 +545,13 @@ int GCAmaxLikelihoodLabel( const GCA_NODE *gcan,
 			   float *vals, int ninputs, float *plikelihood );
 int GCAfreeRegionalGCAN(GCA_NODE **pgcan) ;
 GCA *GCAcompactify(GCA *gca);
+int GCApack(GCA *gca) ;
+int GCAunpack(GCA *gca) ;
+void GCAfreePack(GCA *gca) ;
+size_t GCAmemoryUsage(const GCA *gca, size_t *pnallocs) ;
+int GCAisPackedFile(const char *fname) ;
+int GCAwritePacked(GCA *gca, const char *fname) ;
+GCA *GCAreadPacked(const char *fname) ;
 MRI *GCAreplaceImpossibleLabels(MRI *mri_inputs, GCA *gca, MRI *mri_in_labels, MRI *mri_out_labels, TRANSFORM *transform) ;
 int  GCAremoveHemi(GCA *gca, int lh) ; 
 int  GCAremoveLabel(GCA *gca, int label) ; 
@@ -85,6 +85,12 @@
   extern double gcamComputeMetricProperties_tsec;
 #endif
 
+// The per-node state is split in two: GCA_MORPH_NODE holds everything the
+// gradient, metric and line search loops touch on every iteration, and
+// GCA_MORPH_NODE_COLD holds scratch copies and terms that only a few optional
+// code paths use. Both are stored as one contiguous block per morph
+// (see GCAMalloc), so a sweep over the nodes streams through memory and the
+// cold fields no longer dilute the cache lines of the hot ones.
 typedef struct
 {
   // gcamorph uses these fields in its hottest function so put them together to reduce cache misses
@@ -96,49 +102,54 @@ typedef struct
   double origx ;      //  mri original src voxel position (using lta)
   double origy ;
   double origz ;
-  //
-  double saved_origx ;      //  mri original src voxel position (using lta)
-  double saved_origy ;
-  double saved_origz ;
   double xs ;         //  not saved
   double ys ;
   double zs ;
-  double xs2 ;         //  more tmp storage
-  double ys2 ;
-  double zs2 ;
+  GC1D   *gc ;
   int    xn ;         /* node coordinates */
   int    yn ;         //  prior voxel position
   int    zn ;
   int    n ;          /* index in gcan structure */
+  int    status ;       /* ignore likelihood term */
   float  prior ;
-  GC1D   *gc ;
   float  log_p ;         /* current log probability of this sample */
   float  dx, dy, dz;     /* current gradient */
   float  odx, ody, odz ; /* previous gradient */
-  float  jx, jy, jz ;    /* jacobian gradient */
   float  area ;
   float  area1 ;      // right handed coordinate system
   float  area2 ;      // left-handed coordinate system
   float  orig_area ;
   float  orig_area1 ;
   float  orig_area2 ;
-  int    status ;       /* ignore likelihood term */
   float  label_dist ;   /* for computing label dist */
+}
+GCA_MORPH_NODE, GMN ;
+
+typedef struct
+{
+  double saved_origx ;      //  mri original src voxel position (using lta)
+  double saved_origy ;
+  double saved_origz ;
+  double xs2 ;         //  more tmp storage
+  double ys2 ;
+  double zs2 ;
+  double sum_ci_vi_ui ;
+  double sum_ci_vi ;
+  float  jx, jy, jz ;    /* jacobian gradient */
   float  last_se ;
   float  predicted_val ; /* weighted average of all class 
                             means in a ball around this node */
-  double sum_ci_vi_ui ;
-  double sum_ci_vi ;
   float  target_dist ;   /* target distance to move towards for 
                             label matching with distance xform */
 }
-GCA_MORPH_NODE, GMN ;
+GCA_MORPH_NODE_COLD, GMN_COLD ;
 
 struct GCA_MORPH
 {
   int  width, height ,depth ;
   GCA  *gca ;          // using a separate GCA data (not saved)
   GMN  ***nodes ;
+  GMN_COLD *cold_nodes ; // width*height*depth, same order as nodes
   int  neg ;
   double exp_k ;
   int  spacing ; // poor choice to make this an int
@@ -157,6 +168,12 @@ struct GCA_MORPH
 
 typedef GCA_MORPH GCAM;
 
+// the cold half of a node: nodes[0][0] is the start of the contiguous block
+static inline GMN_COLD *GCAMcold(const GCA_MORPH *gcam, const GMN *gcamn)
+{
+  return gcam->cold_nodes + (gcamn - gcam->nodes[0][0]);
+}
+
 typedef struct
 {
   GCAM   *gcam ;
@@ -154,6 +154,15 @@ GCSA  *GCSAread(char *fname) ;
 MRI   *GCSAlabel(GCSA *gcsa, MRI_SURFACE *mris) ;
 int   GCSAdump(GCSA *gcsa, int vno, MRI_SURFACE *mris, FILE *fp) ;
 int   GCSAreclassifyUsingGibbsPriors(GCSA *gcsa, MRI_SURFACE *mris) ;
+
+// GCSAreclassifyUsingGibbsPriors: write an annotation snapshot every
+// gcsa_write_iterations iterations to gcsa_write_fname, and relabel colors
+// of vertices in parallel instead of serially in random order if
+// gcsa_parallel_icm is set
+extern int   gcsa_write_iterations ;
+extern char *gcsa_write_fname ;
+extern int   gcsa_parallel_icm ;
+
 int   GCSAreclassifyLabel(GCSA *gcsa, MRI_SURFACE *mris, LABEL *area) ;
 int   GCSAputInputType(GCSA *gcsa, int type, const char *fname, int navgs, int ino,
                        int flags) ;
@@ -0,0 +1,69 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+// mgzblock.h - block-gzip (BGZF-style) storage of mgz voxel data
+
+#ifndef MGZBLOCK_H
+#define MGZBLOCK_H
+
+#include <stddef.h>
+#include <vector>
+
+/*
+  A block-gzip mgz is a plain concatenation of gzip members, so gunzip and
+  the regular znz reader still read it as an ordinary .mgz:
+
+    member 0      mgh header (written through znz as before)
+    member 1..n   voxel data, at most blocksize uncompressed bytes each,
+                  tagged with an 'FS' gzip extra subfield holding the
+                  compressed size of the member
+    member n+1    scan parameters and TAGs (znz, append mode)
+
+  The sidecar <fname>.gzi follows the bgzip index layout: a little-endian
+  uint64 count followed by (compressed offset, uncompressed offset) uint64
+  pairs, one for every member after the first. It ends with a record that
+  bgzip readers ignore: 'FSGZ', the uint64 size of the mgz and the gzip
+  trailer (CRC32 and ISIZE) of its last member, so an index left next to a
+  rewritten mgz is recognized as stale. With the sidecar each voxel member
+  can be inflated independently, so (de)compression runs on all threads and
+  mghRead() can seek straight to a frame.
+
+  Writing is enabled by setting FS_MGZIO_BLOCKGZIP; FS_MGZIO_BLOCKSIZE
+  overrides the uncompressed block size (bytes).
+*/
+
+#define MGZBLOCK_DEFAULT_BLOCKSIZE (1 << 20)
+#define MGZBLOCK_MAX_BLOCKSIZE     (1 << 26)
+
+struct MGZBLOCK_INDEX
+{
+  std::vector<unsigned long long> coffset;  // compressed offset of member i+1
+  std::vector<unsigned long long> uoffset;  // uncompressed offset of member i+1
+};
+
+int    MGZBLOCKenabled(void);
+size_t MGZBLOCKblockSize(void);
+char  *MGZBLOCKindexName(const char *fname, char *indexname);
+void   MGZBLOCKremoveIndex(const char *fname);
+
+int MGZBLOCKwriteData(const char *fname, const void *data, size_t nbytes, int swapsize,
+                      unsigned long long uoffset, MGZBLOCK_INDEX *index);
+int MGZBLOCKwriteIndex(const char *fname, const MGZBLOCK_INDEX *index);
+
+int MGZBLOCKreadIndex(const char *fname, unsigned long long uoffset, unsigned long long nbytes,
+                      MGZBLOCK_INDEX *index);
+int MGZBLOCKreadData(const char *fname, const MGZBLOCK_INDEX *index, unsigned long long uoffset,
+                     size_t nbytes, void *data, int swapsize);
+
+#endif
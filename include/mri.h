@@ -483,6 +483,7 @@ public:
   
   void initIndices();
   void initSlices();
+  int  mapChunk(const char *filename, size_t offset);
   void write(const std::string& filename);
   FnvHash hash();
 
@@ -599,6 +600,8 @@ public:
   bool owndata = true;          // indicates ownership of the chunked buffer data
   BUFTYPE ***slices = nullptr;  // fallback non-contiguous storage for 3D-indexed image data
   void *chunk = nullptr;        // default contiguous storage for image data
+  void *mapping = nullptr;      // file mapping backing the chunk (see mapChunk)
+  size_t mapping_len = 0;       // length of the file mapping
 };
 
 
@@ -1175,6 +1178,12 @@ int   MRIsampleVolumeFrameType( const MRI *mri,
 				const int frame,
 				int interp_type,
 				double *pval );
+int   MRIsampleVolumeFrameTypeBatch( const MRI *mri,
+                                     const int npoints,
+                                     const double *xs, const double *ys, const double *zs,
+                                     const int frame,
+                                     const int interp_type,
+                                     double *vals );
 #ifdef FASTER_MRI_EM_REGISTER
 int   MRIsampleVolumeFrameType_xyzInt_nRange_SAMPLE_NEAREST_floats(const MRI *mri,
                             int x, int y, int z, 
@@ -1802,12 +1811,14 @@ int mghWrite(MRI *mri, const char *fname, int frame=-1);
 int N_Zero_Pad_Input  = -1;
 int N_Zero_Pad_Output = -1;
 int MRIIO_Strip_Pound = 1;
+int MRIIO_UseMmap = 0;  // map uncompressed native byte order nii (and uchar mgh) voxel data instead of reading it (or set FS_MRIIO_MMAP)
 // Mixture model components for MRIgaussianSmoothNI()
 float smni_cw1=1, smni_cstd2=0, smni_rw1=1, smni_rstd2=0, smni_sw1=1, smni_sstd2=0;
 #else
 extern int N_Zero_Pad_Input;
 extern int N_Zero_Pad_Output;
 extern int MRIIO_Strip_Pound;
+extern int MRIIO_UseMmap;
 extern float smni_cw1, smni_cstd2, smni_rw1, smni_rstd2, smni_sw1, smni_sstd2;
 #endif
 
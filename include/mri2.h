@@ -131,6 +131,14 @@ int MRIsegStats(MRI *seg, int segid, MRI *mri,int frame,
 int MRIsegStatsRobust(MRI *seg, int segid, MRI *mri,int frame,
 		      float *min, float *max, float *range,
 		      float *mean, float *std, float Pct);
+int MRIsegCountAll(MRI *seg, int nsegs, const int *segids, int *nhits);
+int MRIsegStatsAll(MRI *seg, int nsegs, const int *segids, MRI *mri, int frame,
+                   int *nvox, float *min, float *max, float *range,
+                   float *mean, float *std);
+int MRIsegStatsRobustAll(MRI *seg, int nsegs, const int *segids, MRI *mri, int frame,
+                         int *nvox, float *min, float *max, float *range,
+                         float *mean, float *std, float Pct);
+int MRIsegFrameAvgAll(MRI *seg, int nsegs, const int *segids, MRI *mri, double **favg, int *nvox);
 
 MRI *MRImask_with_T2_and_aparc_aseg(MRI *mri_src, MRI *mri_dst, MRI *mri_T2, MRI *mri_aparc_aseg, float T2_thresh, int mm_from_exterior) ;
 int *MRIsegmentationList(MRI *seg, int *pListLength);
@@ -0,0 +1,115 @@
+/**
+ * @brief Bounding volume hierarchy over the faces of a surface
+ *
+ * Ray/segment, point inclusion and closest face queries in time logarithmic
+ * in the number of faces.
+ */
+/*
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#ifndef MRISBVH_H
+#define MRISBVH_H
+
+#include <vector>
+
+#include "mrisurf.h"
+
+//! Axis aligned bounding volume hierarchy over all faces of a MRIS.
+/** The tree is built with the surface area heuristic from the current
+ * (x,y,z) vertex positions, which must not change while it is in use; it
+ * holds its own copy of the triangles and does not take ownership of the
+ * surface. Leaves hold up to MRISBVH::MAX_LEAF triangles stored as arrays,
+ * which are tested against a segment together in one vectorizable loop.
+ *
+ * All queries are const and may be called from any number of threads; the
+ * batched versions spread their points over the OpenMP threads themselves.
+ */
+class MRISBVH
+{
+  public:
+    enum { MAX_LEAF = 8 };
+
+    MRISBVH(MRIS const *mris);
+
+    int GetNodesCount() const { return (int)nodes.size(); }
+    int GetDeepestLevel() const { return deepest; }
+
+    //! Point inclusion test, with the answers of MRISOBBTree::PointInclusionTest()
+    /*!
+     \param x, y and z - the test point
+     \return 1 if the point lies inside the surface
+     \return -1 if the point lies outside the surface
+     \return 0 if no intersection is found
+     */
+    int PointInclusionTest(double x, double y, double z) const;
+
+    //! PointInclusionTest() on npoints points xyz[3*i..3*i+2], results in res[i]
+    void PointInclusionTests(int npoints, const double *xyz, int *res) const;
+
+    //! Nearest crossing of the segment p0-p1 with a face
+    /*!
+     \param t - parametric coordinate of the crossing along p0-p1, in [0,1]
+     \param sense - 1 if the segment runs against the face normal, -1 if along it
+     \return the face number, or -1 if the segment crosses no face
+     */
+    int IntersectSegment(const double p0[3], const double p1[3], double *t, int *sense) const;
+
+    //! IntersectSegment() on nsegments segments p0[3*i..]-p1[3*i..]; t and sense may be NULL
+    void IntersectSegments(int nsegments, const double *p0, const double *p1, int *fno, double *t, int *sense) const;
+
+    //! Face closest to point p, searching no further than max_dist
+    /*!
+     \param dist - the distance from p to the closest point of that face
+     \return the face number, or -1 if no face is within max_dist
+     */
+    int ClosestFace(const double p[3], double max_dist, double *dist) const;
+
+    //! ClosestFace() on npoints points xyz[3*i..]; fno may be NULL
+    void ClosestFaces(int npoints, const double *xyz, double max_dist, double *dist, int *fno) const;
+
+  private:
+    struct Node {
+      double bmin[3], bmax[3];
+      int start;  // leaf: first triangle; interior: index of the right child (the left one follows the node)
+      int count;  // number of triangles, 0 for interior nodes
+    };
+
+    std::vector<Node> nodes;
+    int deepest;
+
+    // bounding box of all the vertices, used to reject points trivially
+    double aabb_min[3], aabb_max[3];
+
+    // per triangle, in leaf order
+    std::vector<int> fnos;
+    std::vector<double> p0x, p0y, p0z;  // first vertex
+    std::vector<double> e1x, e1y, e1z;  // v1 - v0
+    std::vector<double> e2x, e2y, e2z;  // v2 - v0
+    std::vector<double> nx, ny, nz;     // unit normal, (v1-v0) x (v2-v0)
+    // the segment test projects on the two coordinates (yi,zi) in which the
+    // triangle is largest; a and b are v0 in them, (u1,v1) and (u2,v2) the edges
+    std::vector<double> pa, pb, pu1, pv1, pu2, pv2, parea;
+    std::vector<int> pyi, pzi;
+
+    // centroid of face 0 etc., what PointInclusionTest aims its segments at
+    std::vector<double> centroid;
+    std::vector<double> fnormal;
+
+    int build(std::vector<int> &order, std::vector<double> const &bounds, std::vector<double> const &centers,
+              int first, int count, int level);
+    void storeTriangle(MRIS const *mris, int fno);
+    int leafSegment(Node const &node, const double p0[3], const double v01[3], double *t, int *sense) const;
+    double leafClosest(Node const &node, const double p[3], double best_d2, int *fno) const;
+};
+
+#endif
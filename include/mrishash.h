@@ -95,6 +95,23 @@ protected:
 
 
 // Construction, use either delete or MHTfree to destroy
+// The tables are built in parallel (OpenMP) without locks; the result is the
+// same as a serial build, bucket contents included.
+//
+// Concurrency contract
+//   - Queries (MHTfindClosestVertex*, MHTfindClosestSetVertexNo, MHTfindClosestFace*,
+//     MHTfindVnoOfClosestVertexInTable, MHTdoesFaceIntersect, MHTisVectorFilled) do not
+//     modify the table and may be called from any number of threads at once, with no
+//     locking, as long as no thread modifies the table or moves the surface vertices it
+//     was built from meanwhile.
+//   - MHTaddAllFaces/MHTremoveAllFaces/MHTupdateAllFaces modify the table.  They may only run concurrently
+//     with other calls on the same table inside MHT_maybeParallel_begin/end, which turns
+//     on the per-bucket locks; otherwise they must run on thread 0.
+//   - MHTfindReportCounts reports the counts of the calling thread's last query.
+//
+// A face table that follows a deforming surface should be kept current with
+// MHTupdateAllFaces rather than freed and recreated every step; it gives the
+// same table as a rebuild at the same resolution.
 //
 MRIS_HASH_TABLE* MHTcreateFaceTable             (MRIS* mris);
 MRIS_HASH_TABLE* MHTcreateFaceTable_Resolution  (MRIS* mris, int which, float res);
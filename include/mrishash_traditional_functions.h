@@ -11,6 +11,11 @@
 MHT_VIRTUAL int  MHT_FUNCTION(addAllFaces)                  (MHT_THIS_PARAMETER MHT_MRIS_PARAMETER  int vno) MHT_ABSTRACT;
 MHT_VIRTUAL int  MHT_FUNCTION(removeAllFaces)               (MHT_THIS_PARAMETER MHT_MRIS_PARAMETER  int vno) MHT_ABSTRACT;
 
+// Re-bucket the faces that moved (or were ripped or unripped) since they were hashed,
+// instead of freeing and recreating the table.  Returns the number of faces resampled.
+//
+MHT_VIRTUAL int  MHT_FUNCTION(updateAllFaces)               (MHT_THIS_PARAMETER MHT_MRIS_PARAMETER_NOCOMMA ) MHT_ABSTRACT;
+
 // Surface self-intersection (Uses MHT initialized with FACES)
 //
 MHT_VIRTUAL int MHT_FUNCTION(doesFaceIntersect)             (MHT_THIS_PARAMETER MHT_MRIS_PARAMETER  int fno                                 )                MHT_ABSTRACT;
@@ -1408,6 +1408,7 @@ typedef struct
   int correct_defect; /* correct only one single defect */
   int check_surface_intersection; /* check if self-intersection happens */
   int optimal_mapping; /* find optmal mapping by genrating sevral mappings */
+  int seed_per_defect; /* reseed the random numbers before each defect (seed+defect number) */
 }
 TOPOLOGY_PARMS ;
 
@@ -1645,6 +1646,13 @@ MRI *MRISsmoothMRIFastD(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask,  M
 int MRISsmoothMRIFastCheck(int nSmoothSteps);
 int MRISsmoothMRIFastFrame(MRIS *Surf, MRI *Src, int frame, int nSmoothSteps, MRI *IncMask);
 
+// One step of the MRISsmoothMRIFast() nearest neighbor averaging as a sparse
+// operator, built once and applied to all frames of an input at a time
+typedef struct MRIS_SMOOTH_OPERATOR MRIS_SMOOTH_OPERATOR;
+MRIS_SMOOTH_OPERATOR *MRISsmoothOperator(MRIS *Surf, MRI *IncMask);
+int  MRISsmoothOperatorApply(MRIS_SMOOTH_OPERATOR *op, MRI *Src, int nSmoothSteps);
+void MRISsmoothOperatorFree(MRIS_SMOOTH_OPERATOR **pop);
+
 
 int  MRISclearFlags(MRI_SURFACE *mris, int flags) ;
 int  MRISsetCurvature(MRI_SURFACE *mris, float val) ;
@@ -16,6 +16,8 @@
 #ifndef RESAMPLE_H_INC
 #define RESAMPLE_H_INC
 
+#include <vector>
+
 #include "MRIio_old.h"
 #include "mrisurf.h"
 #include "label.h"
@@ -105,6 +107,34 @@ MRI *vol2surf_linear(MRI *SrcVol,
 MRI *MRISapplyRegBCI(MRIS *reg1, MRIS *reg2, MRI *in); // barycentric interp
 MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
 		  int ReverseMapFlag, int DoJac, int UseHash);
+
+/* Vertex correspondence of MRISapplyReg() as a sparse map: target vertex t
+   gets (sum_k Src[srcvtx[k]] / srcdiv[k]) / trgdiv[t] over the entries
+   k = rowstart[t] .. rowstart[t+1]-1. The forward and reverse map hits
+   and the jacobian correction are in the divisors, which are kept rather
+   than their inverses so that the map gives the values MRISapplyReg()
+   always has, bit for bit. checksum is MRISapplyRegChecksum() of the
+   surfaces and options the map was computed from. */
+typedef struct
+{
+  int nsrc, ntrg;
+  int ReverseMapFlag, DoJac, UseHash;
+  unsigned long checksum;
+  int nSrcLost;
+  std::vector<int> rowstart, srcvtx;
+  std::vector<float> srcdiv, trgdiv;
+} MRIS_APPLYREG_MAP;
+
+unsigned long MRISapplyRegChecksum(MRI_SURFACE **SurfReg, int nsurfs,
+                                   int ReverseMapFlag, int DoJac, int UseHash);
+MRIS_APPLYREG_MAP *MRISapplyRegMap(MRI_SURFACE **SurfReg, int nsurfs,
+                                   int ReverseMapFlag, int DoJac, int UseHash);
+MRIS_APPLYREG_MAP *MRISapplyRegMapCached(const char *fname, MRI_SURFACE **SurfReg, int nsurfs,
+                                         int ReverseMapFlag, int DoJac, int UseHash);
+MRI *MRISapplyRegMapApply(MRIS_APPLYREG_MAP *map, MRI *SrcSurfVals);
+int MRISapplyRegMapWrite(MRIS_APPLYREG_MAP *map, const char *fname);
+MRIS_APPLYREG_MAP *MRISapplyRegMapRead(const char *fname);
+void MRISapplyRegMapFree(MRIS_APPLYREG_MAP **pmap);
 MRI *surf2surf_nnfr(MRI *SrcSurfVals, MRI_SURFACE *SrcSurfReg,
                     MRI_SURFACE *TrgSurfReg, MRI **SrcHits,
                     MRI **SrcDist, MRI **TrgHits, MRI **TrgDist,
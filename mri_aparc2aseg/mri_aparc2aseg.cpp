@@ -540,7 +540,6 @@ int main(int argc, char **argv)
   // Go through each voxel in the aseg
   printf("\nLabeling Slice (%d)\n",ASeg->width);
   
-  MHT_maybeParallel_begin();
   #ifdef HAVE_OPENMP
   #pragma omp parallel for reduction(+ : nbrute, nctx)
   #endif
@@ -924,7 +923,6 @@ int main(int argc, char **argv)
       } // slice
     } // row
   } // col
-  MHT_maybeParallel_end();
   printf("nctx = %d\n",nctx);
   printf("Used brute-force search on %d voxels\n",nbrute);
 
@@ -450,7 +450,6 @@ MRI *Surf2VolSeg::RelabelSegVol(void)
 {
   int c,nrelabled=0,ndotchecktot=0;
 
-  MHT_maybeParallel_begin();
   #ifdef HAVE_OPENMP
   #pragma omp parallel for reduction(+ : nrelabled, ndotchecktot)
   #endif
@@ -469,7 +468,6 @@ MRI *Surf2VolSeg::RelabelSegVol(void)
       }
     }
   }
-  MHT_maybeParallel_end();
   printf("\n");
   printf("nrelabeled = %d\n",nrelabled);
   printf("ndotcheck = %d\n",ndotchecktot);
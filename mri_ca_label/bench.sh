@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+source "$(dirname $0)/../test.sh"
+
+# Benchmark for the packed atlas layout (not part of the test suite, run by
+# hand from the build directory):
+#
+#     bench.sh [gca]
+#
+# Labels the test subject with the regular (-nopack) and the packed layout of
+# the RB atlas (default: the one test.sh uses), prints the wall time and the
+# peak resident memory (ru_maxrss, kB) of each run and fails if the two
+# segmentations differ. When quoting the numbers, give the CPU model, core
+# count, memory and OMP_NUM_THREADS along with both lines of output.
+
+gca=${1:-${FREESURFER_HOME}/average/RB_all_2016-05-10.vc700.gca}
+
+init_testdata
+FSTEST_NO_DATA_RESET=1
+
+for layout in nopack pack; do
+    opt=""
+    if [ "$layout" == "nopack" ]; then
+        opt="-nopack"
+    fi
+    start=$(date +%s.%N)
+    test_command mri_ca_label $opt -rusage rusage.$layout.dat \
+        -relabel_unlikely 9 .3 -prior 0.5 -align norm.mgz talairach.m3z \
+        $gca aseg.$layout.mgz
+    end=$(date +%s.%N)
+    echo "$layout: $(echo "$end - $start" | bc) s, peak $(awk '$1 == "ru_maxrss" {print $2}' rusage.$layout.dat) kB"
+done
+
+# the layout only changes where the atlas lives in memory, not the labels
+test_command mri_diff aseg.pack.mgz aseg.nopack.mgz
@@ -98,6 +98,7 @@ static float unlikely_mah_dist_thresh = 4 ;
 
 static int wmsa = 0 ;   // apply wmsa postprocessing (using T2/PD data)
 static int nowmsa = 0 ; // remove all wmsa labels from the atlas
+static int pack_gca = 1 ; // flatten the atlas into contiguous arrays before labeling
 static int fcd = 0 ;  // don't check for focal cortical dysplasias
 
 static int handle_expanded_ventricles = 0;
@@ -614,6 +615,11 @@ int main(int argc, char *argv[])
     GCAhistoScaleImageIntensities(gca, mri_inputs, 1) ;
   }
 
+  if (pack_gca)
+  {
+    GCApack(gca) ;
+  }
+
 
   if (gca->flags & GCA_GRAD)
   {
@@ -1554,6 +1560,11 @@ get_option(int argc, char *argv[])
     nowmsa = 1 ;
     printf("disabling WMSA labels\n") ;
   }
+  else if (!stricmp(option, "nopack"))
+  {
+    pack_gca = 0 ;
+    printf("keeping the atlas in its per-node heap layout\n") ;
+  }
   else if(!stricmp(option, "insert-from-seg") || !stricmp(option, "sa-insert-from-seg"))
   {
     // -insert-from-seg    InserFromSeg.mgz index1 <index2 ...>
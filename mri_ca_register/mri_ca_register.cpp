@@ -71,6 +71,7 @@ extern int gcam_write_grad ; // defined in gcamorph.c for diags
 static int remove_cerebellum = 0 ;
 static int remove_lh = 0 ;
 static int remove_rh = 0 ;
+static int pack_gca = 1 ; // flatten the atlas into contiguous arrays before registering
 
 static int remove_bright =0 ;
 static int map_to_flash = 0 ;
@@ -812,6 +813,9 @@ main(int argc, char *argv[])
                     insert_coords,
                     insert_whalf) ;
 
+  if (pack_gca)
+    GCApack(gca) ;
+
   //////////////////////////////////////////////////////////
   // -TL temporal_lobe.gca option
   if (tl_fname)
@@ -1877,6 +1881,11 @@ get_option(int argc, char *argv[])
     nargs = 1 ;
     printf("writing vector field to %s...\n", vf_fname) ;
   }
+  else if (!stricmp(option, "NOPACK"))
+  {
+    pack_gca = 0 ;
+    printf("keeping the atlas in its per-node heap layout\n") ;
+  }
   else if (!stricmp(option, "INSERT"))
   {
     if (ninsertions >= MAX_INSERTIONS)
@@ -19,9 +19,22 @@ fi
 
 if [[ "$TESTDATA_SUFFIX" != "" ]] && [[ "$host_os" == "macos10" ]] || [[ "$host_os" == "macos12" ]] ; then
    # Currently cannot get 0.00 diff output on MacOS
-   compare_vol talairach.m3z talairach.ref${TESTDATA_SUFFIX}.m3z
+   refm3z=talairach.ref${TESTDATA_SUFFIX}.m3z
+   compare_vol talairach.m3z $refm3z
    # compare_vol talairach.m3z talairach.ref${TESTDATA_SUFFIX}.m3z --thresh 2.14
 else
-   compare_vol talairach.m3z talairach.ref.m3z
+   refm3z=talairach.ref.m3z
+   compare_vol talairach.m3z $refm3z
+fi
+
+# read both morphs back and resample norm.mgz with them: this goes through
+# GCAMread and the node positions the morph is applied with, not only the
+# fields that were written out
+if [ "$FSTEST_REGENERATE" != true ]; then
+   FSTEST_NO_DATA_RESET=1
+   mri_convert=$(find_path $FSTEST_CWD mri_convert/mri_convert)
+   test_command $mri_convert -at talairach.m3z norm.mgz norm.morphed.mgz
+   test_command $mri_convert -at $refm3z norm.mgz norm.ref.morphed.mgz
+   test_command mri_diff norm.morphed.mgz norm.ref.morphed.mgz --debug
 fi
 
@@ -31,6 +31,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <ctype.h>
+#include <vector>
 
 #include "macros.h"
 #include "utils.h"
@@ -115,6 +116,7 @@ typedef struct {
   char *InitRegSave=NULL;
   int InitRegSaveOnly = 0;
   int ltatype =  LINEAR_VOX_TO_VOX;
+  int nPowellStarts;
 } CMDARGS;
 CMDARGS *cmdargs;
 
@@ -147,6 +149,8 @@ typedef struct {
   double mparams[12]; // params to create the matrix, always=12
   double H01d[256*256];
   double **H0;
+  double *HH; // partial histograms of COREGhist, one per chunk
+  int serialhist; // COREGhist keeps a single chunk histogram (clones)
   double cost;
   int nCostEvaluations;
   double tLastEval;
@@ -168,11 +172,15 @@ typedef struct {
   int optschema;
   int debug;
   int seed;
+  int quiet; // no progress output from COREGMinPowell (concurrent starts)
 } COREG;
 
 double COREGcost(COREG *coreg);
 float COREGcostPowell(float *pPowel) ;
-int COREGMinPowell();
+int COREGMinPowell(COREG *coreg);
+int COREGMinPowellMultiStart(COREG *coreg, int nstarts, double delta);
+COREG *COREGclone(COREG *coreg);
+int COREGfreeClone(COREG **pcoreg);
 float MRIgetPercentile(MRI *mri, double Pct, int frame);
 int COREGfwhm(MRI *mri, double sep, double fwhm[3]);
 int COREGpreproc(COREG *coreg);
@@ -227,6 +235,7 @@ int main(int argc, char *argv[]) {
   cmdargs->optschema = 1;
   cmdargs->seed = 53;
   cmdargs->rusagefile = "";
+  cmdargs->nPowellStarts = 1;
 
   nargs = handleVersionOption(argc, argv, "mri_coreg");
   if (nargs && argc - nargs == 1) exit (0);
@@ -495,7 +504,10 @@ int main(int argc, char *argv[]) {
     printf("sep = %d -----------------------------------\n",coreg->sep);
     if(n==0 && cmdargs->DoBF) COREGoptBruteForce(coreg, cmdargs->BFLim, 1, cmdargs->BFNSamp);
     coreg->startmin = 1;
-    COREGMinPowell();
+    if(n==0 && cmdargs->nPowellStarts > 1)
+      COREGMinPowellMultiStart(coreg, cmdargs->nPowellStarts, cmdargs->BFLim/cmdargs->BFNSamp);
+    else
+      COREGMinPowell(coreg);
   }
   if(coreg->fplogcost) fclose(coreg->fplogcost);
 
@@ -717,6 +729,11 @@ static int parse_commandline(int argc, char **argv) {
       sscanf(pargv[0],"%d",&cmdargs->BFNSamp);
       nargsused = 1;
     } 
+    else if (!strcasecmp(option, "--powell-starts")) {
+      if(nargc < 1) CMDargNErr(option,1);
+      sscanf(pargv[0],"%d",&cmdargs->nPowellStarts);
+      nargsused = 1;
+    } 
     else if (!strcasecmp(option, "--6")) cmdargs->dof = 6;
     else if (!strcasecmp(option, "--9")) cmdargs->dof = 9;
     else if (!strcasecmp(option, "--12")) cmdargs->dof = 12;
@@ -1048,6 +1065,8 @@ static void print_usage(void) {
   printf("   --no-bf : do not do brute force search\n");
   printf("   --bf-lim lim : constrain brute force search to +/-lim\n");
   printf("   --bf-nsamp nsamples : number of samples in brute force search\n");
+  printf("   --powell-starts nstarts : run nstarts Powell searches concurrently at the first\n");
+  printf("       separation, started around the brute force result, and keep the best\n");
   printf("   --no-smooth : do not apply smoothing to either ref or mov\n");
   printf("   --ref-fwhm fwhm : apply smoothing to ref\n");
   printf("   --mov-oob : count mov voxels that are out-of-bounds as 0\n");
@@ -1141,6 +1160,7 @@ static void dump_options(FILE *fp) {
   fprintf(fp,"bf       %d\n",cmdargs->DoBF);
   fprintf(fp,"bflim    %lf\n",cmdargs->BFLim);
   fprintf(fp,"bfnsamp    %d\n",cmdargs->BFNSamp);
+  fprintf(fp,"powellstarts %d\n",cmdargs->nPowellStarts);
   fprintf(fp,"SmoothRef %d\n",cmdargs->SmoothRef);
   fprintf(fp,"SatPct    %lf\n",cmdargs->SatPct);
   fprintf(fp,"MovOOB %d\n",cmdargs->MovOOBFlag);
@@ -1196,6 +1216,75 @@ double COREGsamp(unsigned char *f, const double c, const double r, const double
 }
 
 
+/*!
+  \fn static long COREGhistChunk(COREG *coreg, const double *V2V, int chunk, int chunkSize, double *H)
+  \brief Joint histogram of the ref columns of one chunk, H is cleared
+  first. Returns the number of in-bounds samples.
+ */
+static long COREGhistChunk(COREG *coreg, const double *V2V, int chunk, int chunkSize, double *H)
+{
+  long nhits = 0;
+  int const crefBegin = (chunk+0)*chunkSize*coreg->sep;
+  int       crefEnd   = (chunk+1)*chunkSize*coreg->sep;
+  if (crefEnd > coreg->ref->width) crefEnd = coreg->ref->width;
+
+  memset(H, 0, sizeof(double)*256*256);
+
+  int cref;
+  for(cref=crefBegin; cref < crefEnd; cref += coreg->sep){
+
+    int rref,sref;
+    for(rref=0; rref < coreg->ref->height; rref += coreg->sep){
+      for(sref=0; sref < coreg->ref->depth; sref += coreg->sep){
+
+        double dcref = cref, drref = rref, dsref = sref;
+
+        if(coreg->DoCoordDither){
+          // dither is uniform(0,1), scale by separation to sample entire vol
+          dcref += coreg->sep*MRIgetVoxVal(coreg->cdither,cref,rref,sref,0);
+          drref += coreg->sep*MRIgetVoxVal(coreg->cdither,cref,rref,sref,1);
+          dsref += coreg->sep*MRIgetVoxVal(coreg->cdither,cref,rref,sref,2);
+          if(dcref > coreg->ref->width-1)  dcref = coreg->ref->width-1;
+          if(drref > coreg->ref->height-1) drref = coreg->ref->height-1;
+          if(dsref > coreg->ref->depth-1)  dsref = coreg->ref->depth-1;
+        }
+
+        double dcmov  = V2V[0]*dcref + V2V[4]*drref + V2V[ 8]*dsref +  V2V[12];
+        double drmov  = V2V[1]*dcref + V2V[5]*drref + V2V[ 9]*dsref +  V2V[13];
+
+        int oob = 0;
+        if(dcmov < 0 || dcmov > coreg->mov->width-1)  oob = 1;
+        if(drmov < 0 || drmov > coreg->mov->height-1) oob = 1;
+
+        double dsmov = 0;
+        if(coreg->optschema != 2 && coreg->optschema != 4 && coreg->optschema != 5){
+          // not z-only
+          dsmov  = V2V[2]*dcref + V2V[6]*drref + V2V[10]*dsref +  V2V[14];
+          if(dsmov < 0 || dsmov > coreg->mov->depth-1)  oob = 1;
+        }
+
+        double vf;
+        if(!oob) {
+          vf = COREGsamp(coreg->f, dcmov, drmov, dsmov, coreg->mov->width,coreg->mov->height,coreg->mov->depth);
+          nhits ++;
+        } else {
+          if(coreg->MovOOBFlag) vf = 0;
+          else continue;
+        }
+
+
+        double vg = COREGsamp(coreg->g, dcref, drref, dsref, coreg->ref->width,coreg->ref->height,coreg->ref->depth);
+
+        int const ivf = floor(vf);
+        int const ivg = floor(vg+0.5);
+        H[ivf+ivg*256] += (1-(vf-ivf));
+        if(ivf<255) H[ivf+1+ivg*256] += (vf-ivf);
+      }
+    }
+  }
+  return(nhits);
+}
+
 /*!
   \fn int COREGhist(COREG *coreg)
   \brief Compute joint histogram. Somewhat based on spm_hist2.c
@@ -1225,12 +1314,6 @@ int COREGhist(COREG *coreg)
   V2V[14] = coreg->V2V->rptr[3][4];
   V2V[15] = 0;
 
-  double **HH  = (double **)calloc(sizeof(double*),nchunks);
-  { int n;
-    for(n=0; n < nchunks; n++) 
-      HH[n] = (double *)calloc(sizeof(double),256*256);
-  }
-  
   long nhits = 0;
 
   // Calculate the number of iterations the original loop did
@@ -1238,91 +1321,60 @@ int COREGhist(COREG *coreg)
   //
   int const niters    = (coreg->ref->width + coreg->sep - 1) / coreg->sep;
   int const chunkSize = (niters            + nchunks    - 1) / nchunks;
-  
   int chunk;
-  ROMP_PF_begin
-  #ifdef HAVE_OPENMP
-  #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+:nhits)
-  #endif
-  for (chunk = 0; chunk < nchunks; chunk++) {
-    ROMP_PFLB_begin
-    
-    int const crefBegin = (chunk+0)*chunkSize*coreg->sep;
-    int       crefEnd   = (chunk+1)*chunkSize*coreg->sep;
-    if (crefEnd > coreg->ref->width) crefEnd = coreg->ref->width;
-    
-    int cref;
-    for(cref=crefBegin; cref < crefEnd; cref += coreg->sep){
-  
-      double * const H = HH[chunk];
-
-      int rref,sref;
-      for(rref=0; rref < coreg->ref->height; rref += coreg->sep){
-	for(sref=0; sref < coreg->ref->depth; sref += coreg->sep){
-
-          double dcref = cref, drref = rref, dsref = sref;
-
-	  if(coreg->DoCoordDither){
-	    // dither is uniform(0,1), scale by separation to sample entire vol
-	    dcref += coreg->sep*MRIgetVoxVal(coreg->cdither,cref,rref,sref,0);
-	    drref += coreg->sep*MRIgetVoxVal(coreg->cdither,cref,rref,sref,1);
-	    dsref += coreg->sep*MRIgetVoxVal(coreg->cdither,cref,rref,sref,2);
-	    if(dcref > coreg->ref->width-1)  dcref = coreg->ref->width-1;
-	    if(drref > coreg->ref->height-1) drref = coreg->ref->height-1;
-	    if(dsref > coreg->ref->depth-1)  dsref = coreg->ref->depth-1;
-	  }
-
-	  double dcmov  = V2V[0]*dcref + V2V[4]*drref + V2V[ 8]*dsref +  V2V[12];
-	  double drmov  = V2V[1]*dcref + V2V[5]*drref + V2V[ 9]*dsref +  V2V[13];
-
-	  int oob = 0;
-	  if(dcmov < 0 || dcmov > coreg->mov->width-1)  oob = 1;
-	  if(drmov < 0 || drmov > coreg->mov->height-1) oob = 1;
-
-          double dsmov = 0;
-	  if(coreg->optschema != 2 && coreg->optschema != 4 && coreg->optschema != 5){
-            // not z-only
-	    dsmov  = V2V[2]*dcref + V2V[6]*drref + V2V[10]*dsref +  V2V[14];
-	    if(dsmov < 0 || dsmov > coreg->mov->depth-1)  oob = 1;
-	  }
-
-          double vf;
-	  if(!oob) {
-	    vf = COREGsamp(coreg->f, dcmov, drmov, dsmov, coreg->mov->width,coreg->mov->height,coreg->mov->depth);
-	    nhits ++;
-	  } else {
-	    if(coreg->MovOOBFlag) vf = 0;
-	    else continue;
-	  }
-
-
-	  double vg = COREGsamp(coreg->g, dcref, drref, dsref, coreg->ref->width,coreg->ref->height,coreg->ref->depth);
-
-	  int const ivf = floor(vf);
-	  int const ivg = floor(vg+0.5);
-	  H[ivf+ivg*256] += (1-(vf-ivf));
-	  if(ivf<255) H[ivf+1+ivg*256] += (vf-ivf);
-	}
-      }
+
+  if(coreg->serialhist){
+    // Clones evaluate the cost inside a loop that is already parallel
+    // (brute force, multi-start powell), so keep only one chunk
+    // histogram and add each chunk into H01d as soon as it is done.
+    // The additions happen in the same order as the collection below,
+    // so the cost is bitwise the same as with the full set of chunks.
+    if(!coreg->HH) coreg->HH = (double *)calloc(sizeof(double),256*256);
+    memset(coreg->H01d, 0, sizeof(coreg->H01d));
+    for (chunk = 0; chunk < nchunks; chunk++) {
+      nhits += COREGhistChunk(coreg, V2V, chunk, chunkSize, coreg->HH);
+      int k;
+      for(k=0; k < 256*256; k++) coreg->H01d[k] += coreg->HH[k];
     }
-    ROMP_PFLB_end
   }
-  ROMP_PF_end
-
-  // Collect the chunks
-  { int k;
-    for(k=0; k < 256*256; k++){
-      coreg->H01d[k] = 0;
+  else {
+    // The chunk histograms are kept with the coreg, allocating and
+    // clearing 32 of them at every cost evaluation was a good part of it
+    if(!coreg->HH) coreg->HH = (double *)calloc(sizeof(double),nchunks*256*256);
+    double * const HH = coreg->HH;
+
+    ROMP_PF_begin
+    #ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+:nhits)
+    #endif
+    for (chunk = 0; chunk < nchunks; chunk++) {
+      ROMP_PFLB_begin
+      nhits += COREGhistChunk(coreg, V2V, chunk, chunkSize, &HH[(long)chunk*256*256]);
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    // Collect the chunks, always summing them in the same order
+    int row;
+    ROMP_PF_begin
+    #ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible)
+    #endif
+    for(row=0; row < 256; row++){
+      ROMP_PFLB_begin
+      double * const H01d = &coreg->H01d[row*256];
+      int k;
+      for(k=0; k < 256; k++) H01d[k] = 0;
       int n;
-      for(n=0; n < nchunks; n++) coreg->H01d[k] += HH[n][k];
+      for(n=0; n < nchunks; n++){
+        const double * const H = &HH[(long)n*256*256 + row*256];
+        for(k=0; k < 256; k++) H01d[k] += H[k];
+      }
+      ROMP_PFLB_end
     }
+    ROMP_PF_end
   }
-  
-  { int n;
-    for(n=0; n < nchunks; n++) free(HH[n]);
-    free(HH); HH=NULL;
-  }
-  
+
   // Repackage Histogram into a 2D array
   if(!coreg->H0) coreg->H0 = AllocDoubleMatrix(256,256);
   
@@ -1824,13 +1876,17 @@ double COREGcost(COREG *coreg)
 }
 
 
+// The COREG that COREGMinPowell() is optimizing in this thread; Powell
+// only passes the parameters to the cost function
+static thread_local COREG *powellcoreg = NULL;
+
 /*--------------------------------------------------------------------------*/
 float COREGcostPowell(float *pPowel) 
 {
-  extern COREG *coreg;
+  COREG *coreg = powellcoreg;
   int n,newmin;
   float curcost;
-  static float initcost=-1,mincost=-1,ppmin[100];
+  static thread_local float initcost=-1,mincost=-1,ppmin[100];
   FILE *fp;
 
   for(n=0; n < coreg->nparams; n++) coreg->params[n] = pPowel[n+1];
@@ -1844,7 +1900,7 @@ float COREGcostPowell(float *pPowel)
     initcost = curcost;
     mincost = curcost;
     for(n=0; n<coreg->nparams; n++) ppmin[n] = coreg->params[n];
-    printf("InitialCost %20.10lf \n",initcost);
+    if(!coreg->quiet) printf("InitialCost %20.10lf \n",initcost);
     coreg->startmin = 0;
   }
 
@@ -1862,7 +1918,7 @@ float COREGcostPowell(float *pPowel)
     fflush(fp);
   }
 
-  if(newmin){
+  if(newmin && !coreg->quiet){
     printf("#@# %2d %4d  ",coreg->sep,coreg->nCostEvaluations);
     for(n=0; n<coreg->nparams; n++) printf("%7.5f ",ppmin[n]);
     printf("  %9.7f\n",mincost);
@@ -1873,21 +1929,23 @@ float COREGcostPowell(float *pPowel)
 }
 
 /*---------------------------------------------------------*/
-int COREGMinPowell()
+int COREGMinPowell(COREG *coreg)
 {
-  extern COREG *coreg;
   float *pPowel, **xi;
   int    r, c, n,dof;
   Timer timer;
+  FILE *fp = coreg->quiet ? NULL : stdout;
 
   timer.reset();
   dof = coreg->nparams;
 
-  printf("\n\n---------------------------------\n");
-  printf("Init Powel Params dof = %d: ",dof);
+  if(fp){
+    printf("\n\n---------------------------------\n");
+    printf("Init Powel Params dof = %d: ",dof);
+    for(n=0; n < dof; n++) printf("%f ",coreg->params[n]);
+    printf("\n");
+  }
   pPowel = vector(1, dof) ;
-  for(n=0; n < dof; n++) printf("%f ",coreg->params[n]);
-  printf("\n");
   for(n=0; n < dof; n++) pPowel[n+1] = coreg->params[n];
 
   xi = matrix(1, dof, 1, dof) ;
@@ -1896,35 +1954,146 @@ int COREGMinPowell()
       xi[r][c] = r == c ? 1 : 0 ;
     }
   }
-  printf("Starting OpenPowel2(), sep = %d\n",coreg->sep);
+  if(fp) printf("Starting OpenPowel2(), sep = %d\n",coreg->sep);
+  powellcoreg = coreg;
   OpenPowell2(pPowel, xi, dof, coreg->ftol, coreg->linmintol, coreg->nitersmax, 
 	      &coreg->niters, &coreg->fret, COREGcostPowell);
-  printf("Powell done niters total = %d\n",coreg->niters);
+  powellcoreg = NULL;
+  for(n=0; n < coreg->nparams; n++) coreg->params[n] = pPowel[n+1];
+  COREGcost(coreg);
+
+  if(fp){
+    printf("Powell done niters total = %d\n",coreg->niters);
+    printf("OptTimeSec %4.1f sec\n",timer.seconds());
+    printf("OptTimeMin %5.2f min\n", timer.minutes());
+    printf("nEvals %d\n",coreg->nCostEvaluations);
+    //printf("EvalTimeSec %4.1f sec\n",(timer.seconds())/coreg->nCostEvaluations);
+    fflush(stdout);
+
+    printf("Final optimized parameters ");
+    for(n=0; n < coreg->nparams; n++) printf("%12.8f ",coreg->params[n]);
+    printf("\n");
+    printf("Final matrix parameters ");
+    for(n=0; n < 12; n++) printf("%7.4lf ",coreg->mparams[n]);
+    printf("\n");
+    printf("Final cost %20.15lf\n ",coreg->cost);
+    printf("\n\n---------------------------------\n");
+  }
+
+  free_matrix(xi, 1, dof, 1, dof);
+  free_vector(pPowel, 1, dof);
+  return(NO_ERROR) ;
+}
+
+/*!
+  \fn int COREGMinPowellMultiStart(COREG *coreg, int nstarts, double delta)
+  \brief Runs nstarts Powell searches concurrently, one per thread, and
+  keeps the one that ends with the lowest cost. The first one starts at the
+  current parameters, the others at the corners of a cube around them that
+  is delta (mm and deg) wide in the translations and rotations, so that a
+  start that is one brute force step off can still find the better basin.
+  The result does not depend on the number of threads.
+ */
+int COREGMinPowellMultiStart(COREG *coreg, int nstarts, double delta)
+{
+  int k,n,best;
+  Timer timer;
+
+  printf("\n\n---------------------------------\n");
+  printf("Running %d Powell searches, delta %g, sep = %d\n",nstarts,delta,coreg->sep);
+  fflush(stdout);
+
+  int nrigid = coreg->nparams < 6 ? coreg->nparams : 6;
+  std::vector<COREG*> starts(nstarts);
+  std::vector<double> initcost(nstarts);
+  for(k=0; k < nstarts; k++){
+    starts[k] = COREGclone(coreg);
+    starts[k]->quiet = 1;
+    starts[k]->startmin = 1;
+    if(k == 0) continue;
+    // corners of the cube first, farther out once they are used up
+    double scale = delta*(1 + (k-1)/(1<<nrigid));
+    for(n=0; n < nrigid; n++)
+      starts[k]->params[n] += (((k-1)>>n) & 1) ? scale : -scale;
+  }
+
+  // the histogram of each cost evaluation is then computed by one thread
+  ROMP_PF_begin
+  #ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic,1)
+  #endif
+  for(k=0; k < nstarts; k++){
+    ROMP_PFLB_begin
+    initcost[k] = COREGcost(starts[k]);
+    COREGMinPowell(starts[k]);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  best = 0;
+  for(k=0; k < nstarts; k++){
+    printf("#@# start %2d  ",k);
+    for(n=0; n<coreg->nparams; n++) printf("%7.5f ",starts[k]->params[n]);
+    printf("  %9.7f %9.7f %4d\n",initcost[k],starts[k]->cost,starts[k]->nCostEvaluations);
+    if(starts[k]->cost < starts[best]->cost) best = k;
+    coreg->nCostEvaluations += starts[k]->nCostEvaluations;
+  }
+  printf("Best start %d\n",best);
+
+  for(n=0; n < coreg->nparams; n++) coreg->params[n] = starts[best]->params[n];
+  coreg->niters = starts[best]->niters;
+  coreg->fret = starts[best]->fret;
+  coreg->startmin = 0;
+  COREGcost(coreg);
+  for(k=0; k < nstarts; k++) COREGfreeClone(&starts[k]);
+
   printf("OptTimeSec %4.1f sec\n",timer.seconds());
   printf("OptTimeMin %5.2f min\n", timer.minutes());
   printf("nEvals %d\n",coreg->nCostEvaluations);
-  //printf("EvalTimeSec %4.1f sec\n",(timer.seconds())/coreg->nCostEvaluations);
-  fflush(stdout);
-
   printf("Final optimized parameters ");
-  for(n=0; n < coreg->nparams; n++){
-    coreg->params[n] = pPowel[n+1];
-    printf("%12.8f ",coreg->params[n]);
-  }
+  for(n=0; n < coreg->nparams; n++) printf("%12.8f ",coreg->params[n]);
   printf("\n");
   printf("Final matrix parameters ");
   for(n=0; n < 12; n++) printf("%7.4lf ",coreg->mparams[n]);
   printf("\n");
-
-  COREGcost(coreg);
   printf("Final cost %20.15lf\n ",coreg->cost);
-
-  free_matrix(xi, 1, dof, 1, dof);
-  free_vector(pPowel, 1, dof);
   printf("\n\n---------------------------------\n");
+  fflush(stdout);
   return(NO_ERROR) ;
 }
 
+/*!
+  \fn COREG *COREGclone(COREG *coreg)
+  \brief Copy of coreg for evaluating the cost at other parameters in
+  another thread. It shares the (read-only) volumes, dither and sample
+  vectors with coreg and has its own matrices, histograms and no cost log.
+ */
+COREG *COREGclone(COREG *coreg)
+{
+  COREG *clone = (COREG *) calloc(sizeof(COREG),1);
+  *clone = *coreg;
+  clone->M = NULL;
+  clone->V2V = NULL;
+  clone->H0 = NULL;
+  clone->HH = NULL;
+  clone->serialhist = 1;
+  clone->fplogcost = NULL;
+  clone->nCostEvaluations = 0;
+  return(clone);
+}
+
+int COREGfreeClone(COREG **pcoreg)
+{
+  COREG *clone = *pcoreg;
+  if(clone->M) MatrixFree(&clone->M);
+  if(clone->V2V) MatrixFree(&clone->V2V);
+  if(clone->H0) FreeDoubleMatrix(clone->H0,256,256);
+  if(clone->HH) free(clone->HH);
+  free(clone);
+  *pcoreg = NULL;
+  return(0);
+}
+
 int COREGpreproc(COREG *coreg)
 {
   int n, DoSmooth;
@@ -2074,9 +2243,15 @@ MRI *MRIconformNoScale(MRI *mri, MRI *mric)
   return(mric);
 }
 
+/*!
+  \fn int COREGoptBruteForce(COREG *coreg, double lim0, int niters, int n1d)
+  \brief Line search through each of the (first 6) parameters in turn. The
+  samples of a line are evaluated concurrently on per-thread copies of coreg
+  and then taken in order, so the result is the same as a serial search.
+ */
 int COREGoptBruteForce(COREG *coreg, double lim0, int niters, int n1d)
 {
-  int iter,nthp,nth1d,n,newmin;
+  int iter,nthp,nth1d,n,newmin,k;
   double curcost,mincost;
   double p,pmin,pmax,pdelta=0,popt;
   double lim;
@@ -2094,6 +2269,14 @@ int COREGoptBruteForce(COREG *coreg, double lim0, int niters, int n1d)
     printf("Turning on MovOOB for BruteForce Search\n");
   }
 
+  int nthreads = 1;
+#ifdef HAVE_OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  std::vector<COREG*> clones(nthreads);
+  for(n=0; n < nthreads; n++) clones[n] = COREGclone(coreg);
+  std::vector<double> plist, costlist;
+
   mincost = 10e10;
   lim = lim0;
   for(iter = 0; iter < niters; iter++){
@@ -2102,24 +2285,52 @@ int COREGoptBruteForce(COREG *coreg, double lim0, int niters, int n1d)
       pmax = coreg->params[nthp] + lim;
       pdelta = (pmax-pmin)/n1d;
 
-      nth1d = 0;
+      plist.clear();
+      for(p=pmin; p<=pmax; p+=pdelta) plist.push_back(p);
+      costlist.resize(plist.size());
+
+      ROMP_PF_begin
+      #ifdef HAVE_OPENMP
+      #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic,1)
+      #endif
+      for(k=0; k < (int)plist.size(); k++){
+        ROMP_PFLB_begin
+        int tid = 0;
+#ifdef HAVE_OPENMP
+        tid = omp_get_thread_num();
+#endif
+        COREG *clone = clones[tid];
+        for(int m=0; m < coreg->nparams; m++) clone->params[m] = coreg->params[m];
+        clone->params[nthp] = plist[k];
+        costlist[k] = COREGcost(clone);
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+
       popt = coreg->params[nthp];
       newmin = 0;
-      for(p=pmin; p<=pmax; p+=pdelta){
-	coreg->params[nthp] = p;
-	curcost = COREGcost(coreg);
+      for(nth1d = 0; nth1d < (int)plist.size(); nth1d++){
+	coreg->params[nthp] = plist[nth1d];
+	curcost = costlist[nth1d];
 	if(mincost > curcost){
 	  mincost = curcost;
-	  popt = p;
+	  popt = plist[nth1d];
 	  newmin = 1;
 	}
+	if(coreg->fplogcost){
+	  fp = coreg->fplogcost;
+	  fprintf(fp,"%2d %4d  ",coreg->sep,coreg->nCostEvaluations);
+	  for(n=0; n<coreg->nparams; n++) fprintf(fp,"%7.5f ",coreg->params[n]);
+	  fprintf(fp,"  %9.7f\n",curcost);
+	  fflush(fp);
+	}
+	coreg->nCostEvaluations++;
 	if(coreg->debug){
 	  printf("%2d %2d %3d",iter,nthp,nth1d);
 	  for(n=0; n<coreg->nparams; n++) printf("%9.5f ",coreg->params[n]);
 	  printf("  %9.7f %9.7f\n",curcost,mincost);
 	  fflush(stdout);
 	}
-	nth1d++;
       } // 1d min
       coreg->params[nthp] = popt;
 
@@ -2134,11 +2345,10 @@ int COREGoptBruteForce(COREG *coreg, double lim0, int niters, int n1d)
     lim = lim/n1d;
   } // iteration
 
+  for(n=0; n < nthreads; n++) COREGfreeClone(&clones[n]);
+
   if(BakMovOOBFlag == 0) printf("Turning  MovOOB back off after brute force search\n");
   coreg->MovOOBFlag = BakMovOOBFlag;
 
   return(0);
 }
-
-
-
@@ -0,0 +1,134 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+// mri_gca_pack - convert a .gca atlas to the mmap-able .gcp format (or back)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "macros.h"
+#include "error.h"
+#include "diag.h"
+#include "proto.h"
+#include "timer.h"
+#include "version.h"
+#include "gca.h"
+
+
+int main(int argc, char *argv[]) ;
+
+static int  get_option(int argc, char *argv[]) ;
+static void print_usage(void) ;
+static void print_help(void) ;
+static void print_version(void) ;
+
+const char *Progname ;
+
+int
+main(int argc, char *argv[]) {
+  char   *in_fname, *out_fname ;
+  int    nargs ;
+  GCA    *gca ;
+  Timer  start ;
+
+  nargs = handleVersionOption(argc, argv, "mri_gca_pack");
+  if (nargs && argc - nargs == 1)
+    exit (0);
+  argc -= nargs;
+
+  Progname = argv[0] ;
+  ErrorInit(NULL, NULL, NULL) ;
+  DiagInit(NULL, NULL, NULL) ;
+
+  for ( ; argc > 1 && ISOPTION(*argv[1]) ; argc--, argv++) {
+    nargs = get_option(argc, argv) ;
+    argc -= nargs ;
+    argv += nargs ;
+  }
+
+  if (argc != 3)
+    print_help() ;
+
+  in_fname = argv[1] ;
+  out_fname = argv[2] ;
+
+  printf("reading gca from %s...\n", in_fname) ;
+  gca = GCAread(in_fname) ;
+  if (!gca)
+    ErrorExit(ERROR_NOFILE, "%s: could not read gca file %s", Progname, in_fname) ;
+  printf("read in %2.1f sec\n", start.seconds()) ;
+
+  printf("writing %s gca to %s...\n",
+         strstr(out_fname, ".gcp") ? "packed" : "regular", out_fname) ;
+  if (GCAwrite(gca, out_fname) != NO_ERROR)
+    ErrorExit(Gerror, "%s: could not write gca file %s", Progname, out_fname) ;
+
+  GCAfree(&gca) ;
+  exit(0) ;
+  return(0) ;
+}
+
+static int
+get_option(int argc, char *argv[]) {
+  int  nargs = 0 ;
+  char *option ;
+
+  option = argv[1] + 1 ;            /* past '-' */
+  if (!stricmp(option, "-help"))
+    print_help() ;
+  else if (!stricmp(option, "-version"))
+    print_version() ;
+  else switch (toupper(*option)) {
+    case '?':
+    case 'U':
+      print_usage() ;
+      exit(1) ;
+      break ;
+    default:
+      fprintf(stderr, "unknown option %s\n", argv[1]) ;
+      exit(1) ;
+      break ;
+    }
+
+  return(nargs) ;
+}
+
+static void
+print_usage(void) {
+  fprintf(stderr,
+          "usage: %s [options] <input gca> <output gca>\n",
+          Progname) ;
+}
+
+static void
+print_help(void) {
+  print_usage() ;
+  fprintf(stderr,
+          "\nThis program converts a gca atlas between the regular (.gca/.gcz) format and\n"
+          "the packed .gcp format, which is read by mapping it into memory instead of\n"
+          "parsing it, so it loads in a fraction of the time and is shared between\n"
+          "processes using the same atlas. The format is chosen by the output\n"
+          "extension. .gcp files are in native byte order and must be regenerated\n"
+          "on machines of the other endianness.\n") ;
+  exit(1) ;
+}
+
+static void
+print_version(void) {
+  fprintf(stderr, "%s\n", getVersion().c_str()) ;
+  exit(1) ;
+}
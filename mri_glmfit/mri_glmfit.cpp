@@ -115,6 +115,7 @@ USAGE: ./mri_glmfit
    --allow-zero-dof : mostly for very special purposes
    --illcond : allow ill-conditioned design matrices
    --sim-done SimDoneFile : create DoneFile when simulation finished 
+   --sim-nworkers N : split the sim iterations over N worker processes
    --no-sig-double : compute sig = -log10(p) from a float precision p rather than double
 
 ENDUSAGE --------------------------------------------------------------
@@ -497,6 +498,15 @@ only have one row.
 For mc-full, synthesize input as a uniform distribution between min
 and max. 
 
+--sim-nworkers N
+
+Run the sim iterations in N forked worker processes (eg, the number of
+cores), each running single-threaded. Each iteration gets its own random
+sequence derived from the seed and the iteration number, and each
+permutation is applied to the original design matrix, so the CSD files
+are the same for any N (but differ from a run without --sim-nworkers).
+The CSD files are written once all the iterations are done.
+
 ENDHELP --------------------------------------------------------------
 
 */
@@ -524,6 +534,9 @@ double round(double x);
 #include <unistd.h>
 #include <float.h>
 #include <errno.h>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "macros.h"
 #include "utils.h"
@@ -552,6 +565,7 @@ double round(double x);
 #include "image.h"
 #include "stats.h"
 #include "evschutils.h"
+#include "romp_support.h"
 
 int MRISmaskByLabel(MRI *y, MRIS *surf, LABEL *lb, int invflag);
 int RandPermMatrixAndPVR(MATRIX *X, MRI **pvrs, int npvrs);
@@ -564,6 +578,8 @@ static void print_help(void) ;
 static void print_version(void) ;
 static void dump_options(FILE *fp);
 static int SmoothSurfOrVol(MRIS *surf, MRI *mri, MRI *mask, double SmthLevel);
+static int SimIterationSeed(int seed, int nthsim);
+static int SimCSDwrite(CSD *csd, int n, int msecFitTime);
 
 int main(int argc, char *argv[]) ;
 
@@ -721,6 +737,7 @@ STAT_TABLE *StatTable=NULL, *OutStatTable=NULL, *GammaStatTable=NULL;
 int  UseCortexLabel = 1;
 
 char *SimDoneFile = NULL;
+int SimNWorkers = 0; // >0 to split the sim iterations over forked workers
 int tSimSign = 0;
 int FWHMSet = 0;
 int DoKurtosis = 0;
@@ -782,7 +799,6 @@ int main(int argc, char **argv) {
   MATRIX *Ct, *CCt;
   FILE *fp;
   double Ccond, dtmp, threshadj, eff;
-  const char *tmpstr2=NULL;
 
   setenv("FS_MRIMASK_ALLOW_DIFF_GEOM","0",1);
   eresfwhm = -1;
@@ -1775,9 +1791,101 @@ int main(int argc, char **argv) {
       }
     }
 
+    // With --sim-nworkers, iteration nthsim is run by worker nthsim%SimNWorkers
+    // from its own random sequence, and each permutation starts from the
+    // original design, so the results do not depend on the number of workers.
+    // The workers put the per-iteration cluster stats in a shared table, from
+    // which the CSD files are written once all of them are done.
+    int SimWorker = -1, nSimTable = 0, w;
+    double *SimTable = NULL;
+    MATRIX *Xg0 = NULL;
+    MRI *pvr0[50];
+    if(SimNWorkers > 0){
+      mytimer.reset() ;
+      if (!strcmp(csd->simtype,"perm")){
+	Xg0 = MatrixCopy(mriglm->Xg,NULL);
+	for (n=0; n < mriglm->npvr; n++) pvr0[n] = MRIcopy(mriglm->pvr[n],NULL);
+      }
+      nSimTable = nThreshList*nSignList*mriglm->glm->ncontrasts*nsim*4;
+      SimTable = (double *) mmap(NULL, nSimTable*sizeof(double), PROT_READ|PROT_WRITE,
+				 MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+      if(SimTable == MAP_FAILED){
+	printf("ERROR: could not map table for %d sim workers\n",SimNWorkers);
+	exit(1);
+      }
+      printf("Running sim over %d workers\n",SimNWorkers);
+      fflush(stdout);
+      std::vector<pid_t> pids(SimNWorkers);
+      for(w=0; w < SimNWorkers; w++){
+	pids[w] = fork();
+	if(pids[w] < 0){
+	  printf("ERROR: could not fork sim worker %d\n",w);
+	  exit(1);
+	}
+	if(pids[w] == 0){
+	  SimWorker = w;
+	  break;
+	}
+      }
+      if(SimWorker < 0){
+	// Parent: wait for all the workers, then write the CSD files
+	int err = 0;
+	for(w=0; w < SimNWorkers; w++){
+	  int status;
+	  waitpid(pids[w],&status,0);
+	  if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+	    printf("ERROR: sim worker %d failed\n",w);
+	    err = 1;
+	  }
+	}
+	if(err) exit(1);
+	msecFitTime = mytimer.milliseconds();
+	for(nthThresh = 0; nthThresh < nThreshList; nthThresh++){
+	  for(nthSign = 0; nthSign < nSignList; nthSign++){
+	    for (n=0; n < mriglm->glm->ncontrasts; n++) {
+	      csd = csdList[nthThresh][nthSign][n];
+	      csd->threshsign = SignList[nthSign];
+	      if(mriglm->glm->C[n]->rows > 1) csd->threshsign = 0;
+	      strcpy(csd->contrast,mriglm->glm->Cname[n]);
+	      csd->nreps = nsim;
+	      double *row = &SimTable[(((nthThresh*nSignList)+nthSign)*mriglm->glm->ncontrasts + n)*nsim*4];
+	      for (nthsim=0; nthsim < nsim; nthsim++) {
+		csd->nClusters[nthsim]      = row[4*nthsim];
+		csd->MaxClusterSize[nthsim] = row[4*nthsim+1];
+		csd->MaxSig[nthsim]         = row[4*nthsim+2];
+		csd->MaxStat[nthsim]        = row[4*nthsim+3];
+	      }
+	      SimCSDwrite(csd,n,msecFitTime);
+	    }
+	  }
+	}
+	munmap(SimTable, nSimTable*sizeof(double));
+	if(SimDoneFile){
+	  fp = fopen(SimDoneFile,"w");
+	  fclose(fp);
+	}
+	printf("mri_glmfit simulation done %g\n\n\n",msecFitTime/(1000*60.0));
+	exit(0);
+      }
+      // Workers share the cores, so each one runs single-threaded
+#ifdef HAVE_OPENMP
+      omp_set_num_threads(1);
+#endif
+    }
+
     printf("\n\nStarting simulation sim over %d trials\n",nsim);
     mytimer.reset() ;
     for (nthsim=0; nthsim < nsim; nthsim++) {
+      if(SimWorker >= 0){
+	if(nthsim % SimNWorkers != SimWorker) continue;
+	int seed = SimIterationSeed(SynthSeed,nthsim);
+	srand48(seed);
+	if(rfs) RFspecSetSeed(rfs,seed);
+	if(Xg0){
+	  MatrixCopy(Xg0,mriglm->Xg);
+	  for (n=0; n < mriglm->npvr; n++) MRIcopy(pvr0[n],mriglm->pvr[n]);
+	}
+      }
       msecFitTime = mytimer.milliseconds();
       if(debug) printf("%d/%d t=%g ---------------------------------\n",
              nthsim+1,nsim,msecFitTime/(1000*60.0));
@@ -1932,47 +2040,26 @@ int main(int argc, char **argv) {
 	    if(debug) printf("%s %d nc=%d  maxcsize=%g  sigmax=%g  Fmax=%g\n",
 			     mriglm->glm->Cname[n],nthsim,nClusters,csize,sigmax,Fmax);
 
-	    // Re-write the full CSD file each time. Should not take that
-	    // long and assures output can be used immediately regardless
-	    // of whether the job terminated properly or not
-	    strcpy(csd->contrast,mriglm->glm->Cname[n]);
-	    if(DoSimThreshLoop && (nThreshList > 1 || nSignList > 1) ){
-	      if(round(csd->threshsign) ==  0) tmpstr2 = "abs"; 
-	      if(round(csd->threshsign) == +1) tmpstr2 = "pos"; 
-	      if(round(csd->threshsign) == -1) tmpstr2 = "neg"; 
-	      //sprintf(tmpstr,"%s-%s.th%04d.%s.csd",simbase,mriglm->glm->Cname[n],
-	      //      (int)round(csd->thresh*100),tmpstr2);
-	      sprintf(tmpstr,"%s.th%02d.%s.j001-%s.csd",simbase,
-		      (int)round(csd->thresh*10),tmpstr2,mriglm->glm->Cname[n]);
+	    if(SimWorker >= 0){
+	      double *row = &SimTable[((((nthThresh*nSignList)+nthSign)*mriglm->glm->ncontrasts + n)*nsim + nthsim)*4];
+	      row[0] = nClusters;
+	      row[1] = csize;
+	      row[2] = sigmax;
+	      row[3] = Fmax;
 	    }
-	    else
-	      sprintf(tmpstr,"%s-%s.csd",simbase,mriglm->glm->Cname[n]);
-	    if(debug) printf("csd %s \n",tmpstr);
-	    fflush(stdout);
-	    fp = fopen(tmpstr,"w");
-	    if (fp == NULL) {
-	      printf("ERROR: opening %s\n",tmpstr);
-	      exit(1);
+	    else {
+	      // Re-write the full CSD file each time. Should not take that
+	      // long and assures output can be used immediately regardless
+	      // of whether the job terminated properly or not
+	      strcpy(csd->contrast,mriglm->glm->Cname[n]);
+	      csd->nreps = nthsim+1;
+	      csd->nClusters[nthsim] = nClusters;
+	      csd->MaxClusterSize[nthsim] = csize;
+	      csd->MaxSig[nthsim] = sigmax;
+	      csd->MaxStat[nthsim] = Fmax;
+	      SimCSDwrite(csd,n,msecFitTime);
+	      if(debug) CSDprint(stdout, csd);
 	    }
-	    fprintf(fp,"# ClusterSimulationData 2\n");
-	    fprintf(fp,"# mri_glmfit simulation sim\n");
-	    fprintf(fp,"# hostname %s\n",uts.nodename);
-	    fprintf(fp,"# machine  %s\n",uts.machine);
-	    fprintf(fp,"# runtime_min %g\n",msecFitTime/(1000*60.0));
-	    fprintf(fp,"# FixVertexAreaFlag %d\n",MRISgetFixVertexAreaValue());
-	    if (mriglm->mask) fprintf(fp,"# masking 1\n");
-	    else             fprintf(fp,"# masking 0\n");
-	    fprintf(fp,"# num_dof %d\n",mriglm->glm->C[n]->rows);
-	    fprintf(fp,"# den_dof %g\n",mriglm->glm->dof);
-	    fprintf(fp,"# SmoothLevel %g\n",SmoothLevel);
-	    csd->nreps = nthsim+1;
-	    csd->nClusters[nthsim] = nClusters;
-	    csd->MaxClusterSize[nthsim] = csize;
-	    csd->MaxSig[nthsim] = sigmax;
-	    csd->MaxStat[nthsim] = Fmax;
-	    CSDprint(fp, csd);
-	    fclose(fp);
-	    if(debug) CSDprint(stdout, csd);
 
 	    if(DiagCluster) {
 	      sprintf(tmpstr,"./%s-sig.%s",mriglm->glm->Cname[n],format);
@@ -1987,6 +2074,10 @@ int main(int argc, char **argv) {
       //MRIfree(&sig);
 
     }// simulation loop
+    if(SimWorker >= 0){
+      fflush(stdout);
+      _exit(0);
+    }
     if(SimDoneFile){
       fp = fopen(SimDoneFile,"w");
       fclose(fp);
@@ -3203,6 +3294,11 @@ static int parse_commandline(int argc, char **argv) {
       SimDoneFile = pargv[0];
       nargsused = 1;
     } 
+    else if (!strcmp(option, "--sim-nworkers")) {
+      if(nargc < 1) CMDargNErr(option,1);
+      sscanf(pargv[0],"%d",&SimNWorkers);
+      nargsused = 1;
+    } 
     else {
       fprintf(stderr,"ERROR: Option %s unknown\n",option);
       if (CMDsingleDash(option))
@@ -3315,6 +3411,7 @@ printf("                  before --fsgd)\n");
 printf("   --allow-zero-dof : mostly for very special purposes\n");
 printf("   --illcond : allow ill-conditioned design matrices\n");
 printf("   --sim-done SimDoneFile : create DoneFile when simulation finished \n");
+printf("   --sim-nworkers N : split the sim iterations over N worker processes\n");
 printf("   --no-sig-double : compute sig = -log10(p) from a float precision p rather than double \n");
 printf("\n");
 printf("\n");
@@ -3704,6 +3801,15 @@ printf("--uniform min max\n");
 printf("\n");
 printf("For mc-full, synthesize input as a uniform distribution between min\n");
 printf("and max. \n");
+printf("\n");
+printf("--sim-nworkers N\n");
+printf("\n");
+printf("Run the sim iterations in N forked worker processes (eg, the number of\n");
+printf("cores), each running single-threaded. Each iteration gets its own random\n");
+printf("sequence derived from the seed and the iteration number, and each\n");
+printf("permutation is applied to the original design matrix, so the CSD files\n");
+printf("are the same for any N (but differ from a run without --sim-nworkers).\n");
+printf("The CSD files are written once all the iterations are done.\n");
 printf("\n");
   exit(1) ;
 }
@@ -4373,6 +4479,67 @@ int MRIloganize(MATRIX **X, MRI **Ct, MRI **intCt, const MATRIX *t, const double
   return(0);
 }
 
+/*!
+  \fn static int SimCSDwrite(CSD *csd, int n, int msecFitTime)
+  \brief Writes the simulation CSD of contrast n to the file named from
+  simbase, the contrast name, and (with a threshold/sign loop) csd's
+  threshold and sign.
+*/
+static int SimCSDwrite(CSD *csd, int n, int msecFitTime)
+{
+  const char *tmpstr2=NULL;
+  FILE *fp;
+
+  if(DoSimThreshLoop && (nThreshList > 1 || nSignList > 1) ){
+    if(round(csd->threshsign) ==  0) tmpstr2 = "abs"; 
+    if(round(csd->threshsign) == +1) tmpstr2 = "pos"; 
+    if(round(csd->threshsign) == -1) tmpstr2 = "neg"; 
+    //sprintf(tmpstr,"%s-%s.th%04d.%s.csd",simbase,mriglm->glm->Cname[n],
+    //      (int)round(csd->thresh*100),tmpstr2);
+    sprintf(tmpstr,"%s.th%02d.%s.j001-%s.csd",simbase,
+	    (int)round(csd->thresh*10),tmpstr2,mriglm->glm->Cname[n]);
+  }
+  else
+    sprintf(tmpstr,"%s-%s.csd",simbase,mriglm->glm->Cname[n]);
+  if(debug) printf("csd %s \n",tmpstr);
+  fflush(stdout);
+  fp = fopen(tmpstr,"w");
+  if (fp == NULL) {
+    printf("ERROR: opening %s\n",tmpstr);
+    exit(1);
+  }
+  fprintf(fp,"# ClusterSimulationData 2\n");
+  fprintf(fp,"# mri_glmfit simulation sim\n");
+  fprintf(fp,"# hostname %s\n",uts.nodename);
+  fprintf(fp,"# machine  %s\n",uts.machine);
+  fprintf(fp,"# runtime_min %g\n",msecFitTime/(1000*60.0));
+  fprintf(fp,"# FixVertexAreaFlag %d\n",MRISgetFixVertexAreaValue());
+  if (mriglm->mask) fprintf(fp,"# masking 1\n");
+  else             fprintf(fp,"# masking 0\n");
+  fprintf(fp,"# num_dof %d\n",mriglm->glm->C[n]->rows);
+  fprintf(fp,"# den_dof %g\n",mriglm->glm->dof);
+  fprintf(fp,"# SmoothLevel %g\n",SmoothLevel);
+  CSDprint(fp, csd);
+  fclose(fp);
+  return(0);
+}
+
+/*!
+  \fn static int SimIterationSeed(int seed, int nthsim)
+  \brief Seed of the random sequence of sim iteration nthsim with
+  --sim-nworkers. The bits of seed and nthsim are mixed (splitmix64)
+  so that the sequences of neighboring iterations are unrelated.
+*/
+static int SimIterationSeed(int seed, int nthsim)
+{
+  unsigned long long x = ((unsigned long long)(unsigned int)seed << 32) + (unsigned int)nthsim;
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  x = x ^ (x >> 31);
+  return((int)(x & 0x7fffffff));
+}
+
 /*!
   \fn int RandPermMatrixAndPVR(MATRIX *X, MRI **pvrs, int npvrs)
   \brief Permutes both the design matrix and any PVRs
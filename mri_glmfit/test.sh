@@ -23,3 +23,27 @@ done
 for f in F.mgh gamma.mgh sig.mgh; do
     compare_vol ${actual}/age/${f} ${expected}/age/${f} --thresh 0.008
 done
+
+# the shared design above is fit with the batched matrix-matrix products;
+# the voxel loop (FS_GLM_NO_BATCH) must give the same maps
+FSTEST_NO_DATA_RESET=1
+export FS_GLM_NO_BATCH=1
+test_command mri_glmfit \
+    --seed 1234 \
+    --y lh.gender_age.thickness.10.mgh \
+    --fsgd gender_age.txt doss \
+    --no-cortex \
+    --glmdir lh.gender_age.voxloop.glmdir \
+    --surf average lh \
+    --C age.mat
+unset FS_GLM_NO_BATCH
+
+voxloop="${FSTEST_TESTDATA_DIR}/lh.gender_age.voxloop.glmdir"
+
+for f in beta.mgh rvar.mgh rstd.mgh; do
+    compare_vol ${actual}/${f} ${voxloop}/${f} --thresh 0.00007
+done
+
+for f in F.mgh gamma.mgh sig.mgh; do
+    compare_vol ${actual}/age/${f} ${voxloop}/age/${f} --thresh 0.008
+done
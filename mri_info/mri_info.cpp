@@ -134,6 +134,7 @@ int main(int argc, char *argv[])
   argv++;
   ErrorInit(NULL, NULL, NULL) ;
   DiagInit(NULL, NULL, NULL) ;
+  MRIIO_UseMmap = 1; // inputs are only read, so map uncompressed volumes
   if (argc == 0)
   {
     usage_exit();
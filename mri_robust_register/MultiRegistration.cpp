@@ -350,7 +350,7 @@ int MultiRegistration::loadIntensities(const std::vector<std::string> nintens)
 }
 
 /*!
- \brief Initializes a Registration with Parameters (rigid, iscale, transonly, robust, sat and doubleprec)
+ \brief Initializes a Registration with Parameters (rigid, iscale, transonly, robust, sat, doubleprec and streamab)
  \param R  Registration to be initialized
  */
 void MultiRegistration::initRegistration(RegRobust & R)
@@ -373,6 +373,7 @@ void MultiRegistration::initRegistration(RegRobust & R)
   R.setCost(Registration::ROB);
   R.setSaturation(sat);
   R.setDoublePrec(doubleprec);
+  R.setStreamAb(streamab);
   //R.setDebug(debug);
 
   if (subsamplesize > 0)
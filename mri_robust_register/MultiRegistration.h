@@ -49,7 +49,7 @@ public:
       outdir("./"), transonly(false), rigid(true), robust(true), sat(4.685),
           satit(false), debug(0), iscale(false), iscaleonly(false),
           nomulti(false), subsamplesize(-1), highit(-1), fixvoxel(false),
-          keeptype(false), average(1), doubleprec(false), backupweights(false),
+          keeptype(false), average(1), doubleprec(false), streamab(false), backupweights(false),
 	sampletype(SAMPLE_CUBIC_BSPLINE), crascenter(false), resthresh(0.01), frobnormthresh(0.0001), mri_mean(NULL)
   {
   }
@@ -58,7 +58,7 @@ public:
       outdir("./"), transonly(false), rigid(true), robust(true), sat(4.685),
           satit(false), debug(0), iscale(false), iscaleonly(false),
           nomulti(false), subsamplesize(-1), highit(-1), fixvoxel(false),
-          keeptype(false), average(1), doubleprec(false), backupweights(false),
+          keeptype(false), average(1), doubleprec(false), streamab(false), backupweights(false),
           sampletype(SAMPLE_CUBIC_BSPLINE), crascenter(false), resthresh(0.01), frobnormthresh(0.0001), mri_mean(NULL)
   {
     loadMovables(mov);
@@ -91,6 +91,7 @@ public:
     std::cout << " KeepType:      " << keeptype << std::endl;
     std::cout << " Average:       " << average << std::endl;
     std::cout << " DoublePrec:    " << doubleprec << std::endl;
+    std::cout << " StreamAb:      " << streamab << std::endl;
     std::cout << " BackupWeights: " << backupweights << std::endl;
     std::cout << " SampleType:    " << sampletype<< std::endl;
     std::cout << " CRASCenter:    " << crascenter<< std::endl;
@@ -235,6 +236,12 @@ public:
     doubleprec = b;
   }
 
+  //! Specify if the robust steps stream the rows of A instead of storing them
+  void setStreamAb(bool b)
+  {
+    streamab = b;
+  }
+
   //! Specify if weights are keept
   void setBackupWeights(bool b)
   {
@@ -327,6 +334,7 @@ private:
   bool keeptype;
   int average;
   bool doubleprec;
+  bool streamab;
   bool backupweights;
   int sampletype;
   bool crascenter;
@@ -67,7 +67,7 @@ public:
           affine(false), trans(NULL), subsamplesize(-1), minsize(-1), maxsize(-1),
           debug(0), verbose(1),initorient(false), inittransform(true), initscaling(false),
           highit(-1), mri_source(NULL), mri_target(NULL), iscaleinit(1.0),
-          iscalefinal(1.0), doubleprec(false), symmetry(true),
+          iscalefinal(1.0), doubleprec(false), streamab(false), normaleq(false), symmetry(true),
           sampletype(SAMPLE_TRILINEAR), resample(false), costfun(ROB), converged(false)
   {
   }
@@ -238,6 +238,18 @@ public:
     doubleprec = b;
   }
 
+  //! Specify if the robust step streams the rows of A instead of storing them
+  void setStreamAb(bool b)
+  {
+    streamab = b;
+  }
+
+  //! Specify if the robust step solves the normal equations instead of QR
+  void setNormalEq(bool b)
+  {
+    normaleq = b;
+  }
+
   // void setWLimit( double d)      {wlimit = d;};
   //! Specify whether registration is symmetric or at target space
   void setSymmetry(bool b)
@@ -426,6 +438,8 @@ protected:
   double iscaleinit;
   double iscalefinal;
   bool doubleprec;
+  bool streamab;
+  bool normaleq;
 //  double wlimit;
   bool symmetry;
   int sampletype;
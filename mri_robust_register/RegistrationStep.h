@@ -51,7 +51,8 @@ public:
       sat(R.sat), iscale(R.iscale), transonly(R.transonly), rigid(R.rigid), isoscale(
           R.isoscale), trans(R.trans), costfun(R.costfun), rtype(1), subsamplesize(
           R.subsamplesize), debug(R.debug), verbose(R.verbose), floatsvd(false), iscalefinal(
-          R.iscalefinal), mri_weights(NULL), mri_indexing(NULL)
+          R.iscalefinal), streamab(R.streamab), normaleq(R.normaleq), mri_weights(NULL), mri_indexing(NULL),
+          streaming(false), mri_fx(NULL), mri_fy(NULL), mri_fz(NULL), mri_ft(NULL)
   {
   }
 
@@ -62,6 +63,7 @@ public:
       MRIfree(&mri_indexing);
     if (mri_weights)
       MRIfree(&mri_weights);
+    freePartials();
   }
 
   //! Compute a single registration step
@@ -115,6 +117,46 @@ protected:
 
   vnl_matrix<T> constructR(const vnl_vector<T> & p);
 
+  //! Row of A for a voxel of the (subsampled) partials
+  void constructRow(int x, float fxval, int y, float fyval, int z, float fzval,
+      float ftval, T * row) const;
+  //! Rows of A for line ib = z * width + x of the partials (streaming)
+  void constructRows(long int ib, T * a) const;
+  //! Voxel in the images that subsampled voxel (x,y,z) was taken from
+  void getSampleVoxel(int x, int y, int z, int & randpos, int & xp1, int & yp1,
+      int & zp1) const;
+  //! Position in the getRand table at the start of line ib (lines of length h)
+  int getRandPos(long int ib, int h) const;
+  void freePartials();
+
+  //! The rows of A, block-wise from the partials kept by constructAb
+  class StepRows: public RegressionRows<T>
+  {
+  public:
+    StepRows(const RegistrationStep<T> & s) :
+        step(s)
+    {
+    }
+    unsigned int getCols() const
+    {
+      return step.pnum;
+    }
+    int getBlockCount() const
+    {
+      return step.linerows.size() - 1;
+    }
+    long int getBlockStart(int i) const
+    {
+      return step.linerows[i];
+    }
+    void getBlock(int i, T * a) const
+    {
+      step.constructRows(i, a);
+    }
+  private:
+    const RegistrationStep<T> & step;
+  };
+
 private:
 // in:
 
@@ -131,6 +173,8 @@ private:
   int verbose;
   bool floatsvd; // should be removed
   double iscalefinal; // from the last step, used in constructAB
+  bool streamab; // generate the rows of A block-wise instead of storing A
+  bool normaleq; // solve the robust steps from the normal equations
 
 // out:
 
@@ -145,6 +189,17 @@ private:
   MRI * mri_indexing;
   vnl_vector<T> pvec;
 
+  // set by constructAb
+  bool streaming; // A is not stored, the partials are kept instead
+  bool is2d;
+  bool dosubsample;
+  int pnum; // columns of A
+  std::vector<long int> linerows; // first row of each (z,x) line of the partials
+  MRI * mri_fx;
+  MRI * mri_fy;
+  MRI * mri_fz;
+  MRI * mri_ft;
+
 };
 
 /** Computes Registration Single Step
@@ -174,6 +229,7 @@ std::pair<vnl_matrix_fixed<double, 4, 4>, double> RegistrationStep<T>::computeRe
 
     // compute non rigid A
     rigid = false;
+    streaming = false; // A is needed for the restriction
     constructAb(mriS, mriT, A, b);
     rigid = true;
     // now restrict A  (= A R(lastp) )
@@ -197,6 +253,8 @@ std::pair<vnl_matrix_fixed<double, 4, 4>, double> RegistrationStep<T>::computeRe
   {
     //std::cout << "Rtype  " << rtype << std::endl;
 
+    // only the robust solver can work with generated rows
+    streaming = streamab && costfun == Registration::ROB;
     constructAb(mriS, mriT, A, b);
   }
 
@@ -211,9 +269,11 @@ std::pair<vnl_matrix_fixed<double, 4, 4>, double> RegistrationStep<T>::computeRe
   if (verbose > 1)
     std::cout << "  DONE" << std::endl;
 
-  Regression<T> R(A, b);
+  StepRows Arows(*this);
+  Regression<T> R = streaming ? Regression<T>(Arows, b) : Regression<T>(A, b);
   R.setVerbose(verbose);
   R.setFloatSvd(floatsvd);
+  R.setNormalEquations(normaleq);
   if (costfun == Registration::ROB)
   {
     vnl_vector<T> w;
@@ -227,6 +287,7 @@ std::pair<vnl_matrix_fixed<double, 4, 4>, double> RegistrationStep<T>::computeRe
 
     A.clear();
     b.clear();
+    freePartials();
 
     if (verbose > 1)
       std::cout << "  DONE" << std::endl;
@@ -383,7 +444,7 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
   assert(mriS->nframes == mriT->nframes);
   assert(mriS->type == mriT->type);
 
-  bool is2d = false;
+  is2d = false;
   //cout << "Sd: " << mriS->depth << " Td: " << mriT->depth << endl;
   if (mriS->depth == 1 || mriT->depth == 1)
   {
@@ -396,7 +457,6 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
   }
 
   // Allocate and initialize indexing volume
-  int z, y, x, f;
   long int ss = mriS->width * mriS->height * mriS->depth * mriS->nframes;
   if (mri_indexing)
     MRIfree(&mri_indexing);
@@ -431,17 +491,20 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
   if (verbose > 1)
     std::cout << " done!" << std::endl;
   // initialize with -10
-  for (z = 0; z < mriS->depth; z++)
-    for (x = 0; x < mriS->width; x++)
-      for (y = 0; y < mriS->height; y++)
-        for (f = 0; f < mriS->nframes; f++)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int z = 0; z < mriS->depth; z++)
+    for (int x = 0; x < mriS->width; x++)
+      for (int y = 0; y < mriS->height; y++)
+        for (int f = 0; f < mriS->nframes; f++)
           if (itype == MRI_LONG)
             MRILseq_vox(mri_indexing,x,y,z,f) = -10;
           else
             MRIIseq_vox(mri_indexing,x,y,z,f) = -10;
 
   // determine if we will subsample below:
-  bool dosubsample = false;
+  dosubsample = false;
   if (subsamplesize > 0)
     dosubsample = (mriS->width > subsamplesize && mriS->height > subsamplesize
         && (mriS->depth > subsamplesize || mriS->depth == 1));
@@ -512,7 +575,6 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
   if (verbose > 1)
     std::cout << "     -- size " << fx->width << " x " << fx->height << " x "
         << fx->depth << " x " << fx->nframes << " = " << n << std::flush;
-  long int counti = 0;
   double eps = 0.00001;
   double oepss = eps+mriS->outside_val/255.0;
   double oepst = eps+mriT->outside_val/255.0;
@@ -520,53 +582,42 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
   int fxw = fx->width;
   int fxh = fx->height;
   int fxf = fx->nframes;
-  int fxstart = 0;
-  int xp1, yp1, zp1;
   int ocount = 0, ncount = 0, zcount = 0;
-  float fzval = eps/2.0;
-  int dx, dy, dz;
-  int randpos = 0;
-  for (z = fxstart; z < fxd; z++)
-    for (x = fxstart; x < fxw; x++)
-      for (y = fxstart; y < fxh; y++)
+  // The rows are counted per (z,x) line, so that both passes below can run
+  // over the slices in parallel: each line then knows its first row and A
+  // and b come out in the same order as with a single thread. The lines are
+  // also the blocks in which constructRows generates A again when streaming.
+  // When subsampling, every voxel draws 2 (2D) or 3 random offsets from the
+  // cyclic table of MyMRI::getRand, so the position in the table at the
+  // start of a line is known as well (see getRandPos).
+  linerows.assign((long int) fxd * fxw + 1, 0);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) reduction(+:ocount,ncount,zcount)
+#endif
+  for (int z = 0; z < fxd; z++)
+  {
+    int randpos = getRandPos((long int) z * fxw, fxh);
+    int xp1, yp1, zp1;
+    float fzval = eps/2.0;
+    for (int x = 0; x < fxw; x++)
+    {
+      long int rows = 0;
+      for (int y = 0; y < fxh; y++)
       {
         // check if position is outside either source or target:
-        if (dosubsample)
-        {
-          // dx,dy and dz need to agree with the subsampling above
-          dx = (int)(2.0*MyMRI::getRand(randpos));
-          randpos++;
-          dy = (int)(2.0*MyMRI::getRand(randpos));
-          randpos++;
-          xp1 = 2*x+dx;
-          yp1 = 2*y+dy;
-          if (is2d) zp1 = z;
-          else
-          {
-            dz = (int)(2.0*MyMRI::getRand(randpos));
-            randpos++;
-            zp1 = 2*z+dz;
-          }
-        }
-        else 
-        {
-          xp1 = x;
-          yp1 = y;
-          zp1 = z; 
-        }
+        getSampleVoxel(x, y, z, randpos, xp1, yp1, zp1);
         assert(xp1 < mriS->width);
         assert(yp1 < mriS->height);
         assert(zp1 < mriS->depth);
 //        if ( MRIgetVoxVal(mriS,xp1,yp1,zp1,0) == mriS->outside_val || MRIgetVoxVal(mriT,xp1,yp1,zp1,0) == mriT->outside_val )
         if ( fabs(MRIgetVoxVal(mriS,xp1,yp1,zp1,0)- mriS->outside_val) <= oepss || fabs(MRIgetVoxVal(mriT,xp1,yp1,zp1,0)- mriT->outside_val)<=oepst )
         {
-          //std::cout << "voxel outside (" << xp1 << " " << yp1 << " " << zp1 << " )  mriS: " <<MRIFvox(mriS,xp1,yp1,zp1) << "  mriT: " << MRIFvox(mriT,xp1,yp1,zp1)  << "  ovalS: " << mriS->outside_val << "  ovalT: " << mriT->outside_val<< std::endl;
           ocount+=fxf; // will be outside in all frames then
           continue;
         }
 
         // nan and zero values will also be skipped 
-        for (f=0;f<fxf;f++)
+        for (int f=0;f<fxf;f++)
         {
           const float & ftval = MRIFseq_vox(ft, x, y, z, f);
           const float & fxval = MRIFseq_vox(fx, x, y, z, f);
@@ -576,19 +627,24 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
                 
           if (isnan(fxval) || isnan(fyval) || isnan(fzval) || isnan(ftval) )
           {
-            //if (verbose > 0) std::cout << " found a nan value!!!" << std::endl;
             ncount++;
             continue;
           }
           if (fabs(fxval) < eps  && fabs(fyval) < eps && fabs(fzval) < eps )
           {
-            //if (verbose > 0) std::cout << " found a zero element !!!" << std::endl;
             zcount++;
             continue;
           }
-          counti++; // found another good voxel
+          rows++; // found another good voxel
          }
        }
+      linerows[(long int) z * fxw + x + 1] = rows;
+    }
+  }
+  // first row of each line
+  for (long int l = 0; l < (long int) fxd * fxw; l++)
+    linerows[l + 1] += linerows[l];
+  long int counti = linerows[(long int) fxd * fxw];
       
   if (verbose > 1 && n > counti)
     std::cout << "  need only: " << counti << std::endl;
@@ -627,16 +683,20 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
         << ocount << endl;
 
   // allocate the space for A and B
-  int pnum = trans->getDOF();
+  pnum = trans->getDOF();
   if (iscale)
     pnum++;
   //cout << " pnum: " << pnum << "  counti: " << counti<<  endl;
   double amu = ((double) counti * (pnum + 1)) * sizeof(T) / (1024.0 * 1024.0); // +1 =  rowpointer vector
   double bmu = (double) counti * sizeof(T) / (1024.0 * 1024.0);
+  if (streaming)
+    amu = 0.0; // A is never stored
   if (verbose > 1)
     std::cout << "     -- allocating " << amu + bmu << "Mb mem for A and b ... "
         << std::flush;
-  bool OK = A.set_size(counti, pnum);
+  bool OK = true;
+  if (!streaming)
+    OK = A.set_size(counti, pnum);
   OK = OK && b.set_size(counti);
   if (!OK)
   {
@@ -648,7 +708,19 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
     std::cout << " done! " << std::endl;
   double maxmu = 5 * amu + 7 * bmu;
   string fstr = "";
-  if (floatsvd)
+  if (streaming)
+  {
+    // the normal equations need b and four more vectors (residuals, weights)
+    maxmu = 5 * bmu;
+    fstr = "-stream";
+  }
+  else if (normaleq)
+  {
+    // A, b and the same vectors, no weighted copy of A
+    maxmu = amu + 5 * bmu;
+    fstr = "-normal";
+  }
+  else if (floatsvd)
   {
     maxmu = amu + 3 * bmu + 2 * (amu + bmu);
     fstr = "-float";
@@ -662,7 +734,7 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
         << "Mb mem + 6 MRI" << std::endl;
     //string fsvd;
     //if (doubleprec) fsvd = "remove --doubleprec and/or ";
-    std::cout << "          Maybe use --subsample <int> " << std::endl;
+    std::cout << "          Maybe use --subsample <int> or --streamab " << std::endl;
   }
 
 //        char ch;
@@ -670,39 +742,20 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
 //        std::cin  >> ch;
 
   // Loop and construct A and b
-  long int count = 0;
-  ocount = 0;
-  randpos = 0;
-  fzval = eps/2.0;
-
-  for (z = fxstart; z < fxd; z++)
-    for (x = fxstart; x < fxw; x++)
-      for (y = fxstart; y < fxh; y++)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int z = 0; z < fxd; z++)
+  {
+    int randpos = getRandPos((long int) z * fxw, fxh);
+    int xp1, yp1, zp1;
+    long int count = linerows[(long int) z * fxw];
+    float fzval = eps/2.0;
+    for (int x = 0; x < fxw; x++)
+      for (int y = 0; y < fxh; y++)
       {
         // check if position is outside either source or target:
-        if (dosubsample)
-        {
-          // dx,dy and dz need to agree with the subsampling above
-          dx = (int)(2.0*MyMRI::getRand(randpos));
-          randpos++;
-          dy = (int)(2.0*MyMRI::getRand(randpos));
-          randpos++;
-          xp1 = 2*x+dx;
-          yp1 = 2*y+dy;
-          if (is2d) zp1 = z;
-          else
-          {
-            dz = (int)(2.0*MyMRI::getRand(randpos));
-            randpos++;
-            zp1 = 2*z+dz;
-          }
-        }
-        else // if not subsampled
-        {
-          xp1 = x;
-          yp1 = y;
-          zp1 = z;
-        }
+        getSampleVoxel(x, y, z, randpos, xp1, yp1, zp1);
         assert(xp1 < mriS->width);
         assert(yp1 < mriS->height);
         assert(zp1 < mriS->depth);
@@ -716,15 +769,13 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
           int outval = -4;
           if (fabs(mriSval - mriS->outside_val)<=oepss && fabs(mriTval- mriT->outside_val) <= oepst )
             outval = -5;
-          for (f=0;f<fxf;f++)
+          for (int f=0;f<fxf;f++)
             MRILseq_vox(mri_indexing, xp1, yp1, zp1,f) = outval;
-          ocount+=fxf;
-          //cout << " " << ocount << flush;
           continue;
         }
         
         // loop through all frames
-        for (f=0; f<fxf; f++)
+        for (int f=0; f<fxf; f++)
         {
           const float & ftval = MRIFseq_vox(ft, x, y, z, f);
           const float & fxval = MRIFseq_vox(fx, x, y, z, f);
@@ -745,20 +796,65 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
             continue;
           }
 
-          assert(counti > count);
+          assert(linerows[(long int) (z + 1) * fxw] > count);
 
           MRILseq_vox(mri_indexing, xp1, yp1, zp1, f) = count;
 
           //cout << "x: " << x << " y: " << y << " z: " << z << " count: "<< count << std::endl;
           //cout << " " << count << " mrifx: " << MRIFvox(mri_fx, x, y, z) << " mrifx int: " << (int)MRIvox(mri_fx,x,y,z) <<endl;
 
-          // new: now use transformation model to get the gradient vector
-          vnl_vector < double > grad = trans->getGradient(x,fxval,y,fyval,z,fzval);
-          int dof = grad.size();
-          for (int pno = 0; pno < dof; pno++)
-          {
-            A[count][pno] = grad[pno];
-          }
+          // when streaming, the rows of A are generated again by constructRows
+          if (!streaming)
+            constructRow(x, fxval, y, fyval, z, fzval, ftval, A[count]);
+
+          // A p = b = IS - IT
+          b[count] = MRIFseq_vox(SmT, x, y, z, f);
+
+          count++;// start with the first row of the slice above
+
+        }
+      }
+    assert(linerows[(long int) (z + 1) * fxw] == count);
+  }
+
+//   vnl_matlab_print(vcl_cerr,A,"A",vnl_matlab_print_format_long);std::cerr << std::endl;    
+//   vnl_matlab_print(vcl_cerr,b,"b",vnl_matlab_print_format_long);std::cerr << std::endl;    
+
+  // free remaining MRI    
+  MRIfree(&SmT);
+  if (streaming)
+  {
+    // keep the partials to generate the rows of A from
+    mri_fx = fx;
+    mri_fy = fy;
+    mri_fz = fz;
+    mri_ft = ft;
+    return;
+  }
+  MRIfree(&fx);
+  MRIfree(&fy);
+  if (fz)
+    MRIfree(&fz);
+  MRIfree(&ft);
+//MRIwrite(mri_indexing,"mriindexing2.mgz");
+//exit(1);
+  return;
+}
+
+/** Writes the row of A for the voxel (x,y,z) of the partials with
+ values fxval, fyval, fzval (eps/2 in 2D) and ftval.
+ */
+template<class T>
+void RegistrationStep<T>::constructRow(int x, float fxval, int y, float fyval,
+    int z, float fzval, float ftval, T * row) const
+{
+  // new: now use transformation model to get the gradient vector
+  vnl_vector < double > grad = trans->getGradient(x,fxval,y,fyval,z,fzval);
+  int dof = grad.size();
+  for (int pno = 0; pno < dof; pno++)
+  {
+    row[pno] = grad[pno];
+  }
 
 //         if (transonly)
 //         {
@@ -876,36 +972,98 @@ void RegistrationStep<T>::constructAb(MRI *mriS, MRI *mriT, vnl_matrix<T>& A,
 //           }
 //         }
 
-          // ISCALE
-          // intensity model: R(s,IS,IT) = exp(-0.5 s) IT - exp(0.5 s) IS
-          //                  R'  = -0.5 ( exp(-0.5 s) IT + exp(0.5 s) IS)
-          //   ft = 0.5 ( exp(-0.5s) IT + exp(0.5s) IS)  (average of intensity adjusted images)
-          if (iscale) A[count][dof] = ftval;
-
-          // A p = b = IS - IT
-          b[count] = MRIFseq_vox(SmT, x, y, z, f);
+  // ISCALE
+  // intensity model: R(s,IS,IT) = exp(-0.5 s) IT - exp(0.5 s) IS
+  //                  R'  = -0.5 ( exp(-0.5 s) IT + exp(0.5 s) IS)
+  //   ft = 0.5 ( exp(-0.5s) IT + exp(0.5s) IS)  (average of intensity adjusted images)
+  if (iscale) row[dof] = ftval;
+}
 
-          count++;// start with 0 above
+/** Generates the rows of A for the (z,x) line ib of the partials, the same
+ rows constructAb would have stored at linerows[ib], ... , linerows[ib+1]-1.
+ The rows are found through the index image.
+ */
+template<class T>
+void RegistrationStep<T>::constructRows(long int ib, T * a) const
+{
+  int fxw = mri_fx->width;
+  int fxh = mri_fx->height;
+  int fxf = mri_fx->nframes;
+  int z = ib / fxw;
+  int x = ib % fxw;
+  int randpos = getRandPos(ib, fxh);
+  int xp1, yp1, zp1;
+  long int first = linerows[ib];
+  float fzval = 0.00001/2.0; // eps/2 as in constructAb
+  for (int y = 0; y < fxh; y++)
+  {
+    getSampleVoxel(x, y, z, randpos, xp1, yp1, zp1);
+    for (int f = 0; f < fxf; f++)
+    {
+      long int count = MRILseq_vox(mri_indexing, xp1, yp1, zp1, f);
+      if (count < 0)
+        continue; // outside, nan or zero
+      if (!is2d)
+        fzval = MRIFseq_vox(mri_fz, x, y, z, f);
+      constructRow(x, MRIFseq_vox(mri_fx, x, y, z, f), y,
+          MRIFseq_vox(mri_fy, x, y, z, f), z, fzval,
+          MRIFseq_vox(mri_ft, x, y, z, f), a + (count - first) * pnum);
+    }
+  }
+}
 
-        }
-      }
-        //cout << " ocount : " << ocount << endl;    
-        //cout << " counti: " << counti << " count : " << count<< endl;    
-  assert(counti == count);
+/** Without subsampling this is (x,y,z) itself, else a random voxel of the
+ 2x2x2 (2x2 in 2D) box, drawn as in MyMRI::subSample.
+ */
+template<class T>
+inline void RegistrationStep<T>::getSampleVoxel(int x, int y, int z,
+    int & randpos, int & xp1, int & yp1, int & zp1) const
+{
+  if (dosubsample)
+  {
+    // dx,dy and dz need to agree with the subsampling
+    int dx = (int)(2.0*MyMRI::getRand(randpos));
+    randpos++;
+    int dy = (int)(2.0*MyMRI::getRand(randpos));
+    randpos++;
+    xp1 = 2*x+dx;
+    yp1 = 2*y+dy;
+    if (is2d) zp1 = z;
+    else
+    {
+      int dz = (int)(2.0*MyMRI::getRand(randpos));
+      randpos++;
+      zp1 = 2*z+dz;
+    }
+  }
+  else // if not subsampled
+  {
+    xp1 = x;
+    yp1 = y;
+    zp1 = z;
+  }
+}
 
-//   vnl_matlab_print(vcl_cerr,A,"A",vnl_matlab_print_format_long);std::cerr << std::endl;    
-//   vnl_matlab_print(vcl_cerr,b,"b",vnl_matlab_print_format_long);std::cerr << std::endl;    
+/** getSampleVoxel draws 2 (2D) or 3 numbers per voxel from the table of
+ 101 values in MyMRI::getRand, starting with the first one at voxel 0.
+ */
+template<class T>
+inline int RegistrationStep<T>::getRandPos(long int ib, int h) const
+{
+  return (int) ((ib * h * (is2d ? 2 : 3)) % 101);
+}
 
-  // free remaining MRI    
-  MRIfree(&fx);
-  MRIfree(&fy);
-  if (fz)
-    MRIfree(&fz);
-  MRIfree(&ft);
-  MRIfree(&SmT);
-//MRIwrite(mri_indexing,"mriindexing2.mgz");
-//exit(1);
-  return;
+template<class T>
+void RegistrationStep<T>::freePartials()
+{
+  if (mri_fx)
+    MRIfree(&mri_fx);
+  if (mri_fy)
+    MRIfree(&mri_fy);
+  if (mri_fz)
+    MRIfree(&mri_fz);
+  if (mri_ft)
+    MRIfree(&mri_ft);
 }
 
 // template <class T>
@@ -38,10 +38,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include "error.h"
 
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
+// rows per block when accumulating the normal equations and the error sums;
+// blocks are summed in their fixed order, so the results do not depend on
+// the number of threads
+#define REGRESSION_BLOCK 4096
+
 template<class T>
 vnl_vector<T> Regression<T>::getRobustEst(double sat, double sig)
 {
@@ -79,7 +89,7 @@ template<class T>
 vnl_vector<T> Regression<T>::getRobustEstW(vnl_vector<T>& w, double sat,
     double sig)
 {
-  if (A)
+  if (A || rows)
     return getRobustEstWAB(w, sat, sig);
   else
     return vnl_vector<T>(1, getRobustEstWB(w, sat, sig));
@@ -197,7 +207,8 @@ vnl_vector<T> Regression<T>::getRobustEstWAB(vnl_vector<T>& wfinal, double sat,
   if (verbose > 1)
   {
     cout << "  Regression<T>::getRobustEstWAB( "<<sat<<" , "<<sig<<" ) " ;
-    if (floatsvd) cout << "  FLOAT version " ;
+    if (rows || normaleq) cout << "  NORMAL EQUATIONS version " ;
+    else if (floatsvd) cout << "  FLOAT version " ;
     else cout << "  DOUBLE version " ;
     cout << endl;
   }
@@ -213,8 +224,8 @@ vnl_vector<T> Regression<T>::getRobustEstWAB(vnl_vector<T>& wfinal, double sat,
   err[1] = 1e20;
   double sigma;
 
-  int arows = A->rows(); // large (voxels)
-  int acols = A->cols(); // small (parameters)
+  int arows = b->size(); // large (voxels)
+  int acols = getCols(); // small (parameters)
 
   //pre-alocate vectors
   // init residuals (based on zero p, so r := b )
@@ -271,26 +282,59 @@ vnl_vector<T> Regression<T>::getRobustEstWAB(vnl_vector<T>& wfinal, double sat,
     r->clear();
 
     // compute weighted least squares
-    if (floatsvd)
+    // (generated rows can only be summed into the normal equations)
+    if (rows || normaleq)
+      *p = getWeightedLSEstNormal(*w);
+    else if (floatsvd)
       *p = getWeightedLSEstFloat(*w);
     else
       *p = getWeightedLSEst(*w);
 
-    // compute new residuals
-    *r = *b - (*A * *p);
-
+    // compute new residuals r = b - A p
     // and total errors (using new r)
     // err = sum (w r^2) / sum (w)
+    r->set_size(arows);
+    int nblocks = getBlockCount();
+    std::vector<T> bsw(nblocks), bswr(nblocks);
+#ifdef HAVE_OPENMP
+#pragma omp parallel
+#endif
+    {
+      std::vector<T> buf;
+#ifdef HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (int ib = 0; ib < nblocks; ib++)
+      {
+        T swr = 0;
+        T sw = 0;
+        long int rstart = getBlockStart(ib);
+        long int rend = getBlockStart(ib + 1);
+        const T * row = getBlockRows(ib, buf);
+        for (long int rr = rstart; rr < rend; rr++, row += acols)
+        {
+          T ap = 0;
+          for (int cc = 0; cc < acols; cc++)
+            ap += row[cc] * (*p)[cc];
+          (*r)[rr] = (*b)[rr] - ap;
+
+          T t1 = w->operator[](rr);
+          T t2 = r->operator[](rr);
+          t1 *= t1; // remember w is the sqrt of the weights
+          t2 *= t2;
+          sw += t1;
+          swr += t1 * t2;
+        }
+        bsw[ib] = sw;
+        bswr[ib] = swr;
+      }
+    }
     T swr = 0;
     T sw = 0;
-    for (unsigned int rr = 0; rr < r->size(); rr++)
+    for (int ib = 0; ib < nblocks; ib++)
     {
-      T t1 = w->operator[](rr);
-      T t2 = r->operator[](rr);
-      t1 *= t1; // remember w is the sqrt of the weights
-      t2 *= t2;
-      sw += t1;
-      swr += t1 * t2;
+      sw += bsw[ib];
+      swr += bswr[ib];
     }
     err[count] = swr / sw;
     //cout << "err [ " << count << " ] = " << err[count] << endl;
@@ -356,6 +400,137 @@ vnl_vector<T> Regression<T>::getRobustEstWAB(vnl_vector<T>& wfinal, double sat,
 }
 
 
+template<class T>
+unsigned int Regression<T>::getCols() const
+{
+  if (rows)
+    return rows->getCols();
+  return A->cols();
+}
+
+/** Blocks of rows for the normal equations and the residuals, either
+ given by the RegressionRows or REGRESSION_BLOCK rows of A each.
+ */
+template<class T>
+int Regression<T>::getBlockCount() const
+{
+  if (rows)
+    return rows->getBlockCount();
+  return (A->rows() + REGRESSION_BLOCK - 1) / REGRESSION_BLOCK;
+}
+
+template<class T>
+long int Regression<T>::getBlockStart(int ib) const
+{
+  if (rows)
+    return rows->getBlockStart(ib);
+  return std::min((long int) A->rows(), (long int) ib * REGRESSION_BLOCK);
+}
+
+/** Returns the rows of block ib (row major), pointing into A or
+ generated into buf.
+ */
+template<class T>
+const T * Regression<T>::getBlockRows(int ib, std::vector<T> & buf) const
+{
+  long int rstart = getBlockStart(ib);
+  if (!rows)
+    return A->data_block() + rstart * A->cols();
+
+  buf.resize((getBlockStart(ib + 1) - rstart) * rows->getCols());
+  rows->getBlock(ib, buf.data());
+  return buf.data();
+}
+
+/** Solving \f$ p = [A^T W A]^{-1} A^T W b\f$     (with \f$ W = diag(w_i^2) \f$ )
+ via the normal equations. \f$ A^T W A \f$ and \f$ A^T W b \f$ are accumulated in double
+ over blocks of REGRESSION_BLOCK rows in parallel and the blocks are added in order,
+ so the result is the same for any number of threads (with a RegressionRows
+ its blocks are used instead). The small system is scaled
+ by its diagonal (the columns of A differ by orders of magnitude) and solved with QR.
+ Unlike getWeightedLSEst this needs no weighted copy of A.
+ \param w vector representing a diagnoal matrix with the sqrt of the weights as elements
+ */
+template<class T>
+vnl_vector<T> Regression<T>::getWeightedLSEstNormal(const vnl_vector<T> & w)
+{
+  assert(w.size() == b->size());
+
+  int acols = getCols();
+  int nsum = acols * (acols + 1); // upper triangle of A^T W A (stored full) and A^T W b
+  int nblocks = getBlockCount();
+  std::vector<double> partial((size_t) nblocks * nsum, 0.0);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<T> buf;
+#ifdef HAVE_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int ib = 0; ib < nblocks; ib++)
+    {
+      double * AtA = &partial[(size_t) ib * nsum];
+      double * Atb = AtA + acols * acols;
+      long int rstart = getBlockStart(ib);
+      long int rend = getBlockStart(ib + 1);
+      const T * row = getBlockRows(ib, buf);
+      for (long int rr = rstart; rr < rend; rr++, row += acols)
+      {
+        double ww = (double) w[rr] * (double) w[rr];
+        if (ww == 0.0)
+          continue; // Tukey zero weight (outlier)
+        double wb = ww * (double) (*b)[rr];
+        for (int i = 0; i < acols; i++)
+        {
+          double wai = ww * (double) row[i];
+          for (int j = i; j < acols; j++)
+            AtA[i * acols + j] += wai * (double) row[j];
+          Atb[i] += (double) row[i] * wb;
+        }
+      }
+    }
+  }
+
+  vnl_matrix<double> M(acols, acols, 0.0);
+  vnl_vector<double> v(acols, 0.0);
+  for (int ib = 0; ib < nblocks; ib++)
+  {
+    const double * AtA = &partial[(size_t) ib * nsum];
+    const double * Atb = AtA + acols * acols;
+    for (int i = 0; i < acols; i++)
+    {
+      for (int j = i; j < acols; j++)
+        M(i, j) += AtA[i * acols + j];
+      v[i] += Atb[i];
+    }
+  }
+
+  // symmetric, equilibrate with the diagonal
+  vnl_vector<double> d(acols);
+  for (int i = 0; i < acols; i++)
+    d[i] = M(i, i) > 0.0 ? 1.0 / sqrt(M(i, i)) : 1.0;
+  for (int i = 0; i < acols; i++)
+  {
+    for (int j = i; j < acols; j++)
+    {
+      M(i, j) *= d[i] * d[j];
+      M(j, i) = M(i, j);
+    }
+    v[i] *= d[i];
+  }
+
+  vnl_qr<double> QR(M);
+  vnl_vector<double> y = QR.solve(v);
+
+  vnl_vector<T> p(acols);
+  for (int i = 0; i < acols; i++)
+    p[i] = (T) (d[i] * y[i]);
+
+  return p;
+}
+
 /** Solving \f$ p = [A^T W A]^{-1} A^T W b\f$     (with \f$ W = diag(w_i^2) \f$ )
  done by computing \f$ M := \sqrt{W} A\f$ and  \f$ v := \sqrt{W} b\f$
  then we have \f$ p = [ M^T M ]^{-1} M^T v  \f$
@@ -634,15 +809,17 @@ void Regression<T>::getSqrtTukeyDiaWeights(const vnl_vector<T>& r,
 {
   //cout << " getTukeyDiaWeights  r size: " << r->rows << " , " << r->cols << endl;
 
-  unsigned int n = r.size();
-  assert(n == w.size());
+  int n = r.size();
+  assert(n == (int)w.size());
 
-  double t1;
-  //double t2;
-  unsigned int rr;
   //int ocount = 0;
-  for (rr = 0; rr < n; rr++)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int rr = 0; rr < n; rr++)
   {
+    double t1;
+    //double t2;
     // cout << " fabs: " << fabs(r->rptr[rr][cc]) << " sat: " << sat << endl;
     if (fabs(r[rr]) >= sat)
     {
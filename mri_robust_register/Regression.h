@@ -34,10 +34,33 @@
 #define SATr 4.685  // this is suggested for gaussian noise
 #include <utility>
 #include <string>
+#include <vector>
 #include <cassert>
 #include <vnl/vnl_vector.h>
 #include <vnl/vnl_matrix.h>
 
+/** \class RegressionRows
+ * \brief Rows of the matrix A in blocks, generated when Regression needs them
+ *
+ * Lets the robust solver run without A being stored. Block i holds the rows
+ * getBlockStart(i) ... getBlockStart(i+1)-1 and getBlockStart(getBlockCount())
+ * is the number of rows.
+ */
+template<class T>
+class RegressionRows
+{
+public:
+  virtual ~RegressionRows()
+  {
+  }
+
+  virtual unsigned int getCols() const = 0;
+  virtual int getBlockCount() const = 0;
+  virtual long int getBlockStart(int i) const = 0;
+  //! Writes the rows of block i to a (row major)
+  virtual void getBlock(int i, T * a) const = 0;
+};
+
 /** \class Transform3dTranslate
  * \brief Templated class for iteratively reweighted least squares
  */
@@ -48,12 +71,17 @@ public:
 
   //! Constructor initializing A and b
   Regression(vnl_matrix<T> & Ap, vnl_vector<T> & bp) :
-      A(&Ap), b(&bp), lasterror(-1), lastweight(-1), lastzero(-1), verbose(1), floatsvd(false)
+      A(&Ap), rows(NULL), b(&bp), lasterror(-1), lastweight(-1), lastzero(-1), verbose(1), floatsvd(false), normaleq(false)
   {}
 
   //! Constructor initializing b (for simple case where x is single variable and A is (...1...)^T
   Regression(vnl_vector<T> & bp) :
-      A(NULL), b(&bp), lasterror(-1), lastweight(-1), lastzero(-1), verbose(1), floatsvd(false)
+      A(NULL), rows(NULL), b(&bp), lasterror(-1), lastweight(-1), lastzero(-1), verbose(1), floatsvd(false), normaleq(false)
+  {}
+
+  //! Constructor with the rows of A generated block-wise (robust solver only)
+  Regression(const RegressionRows<T> & Arows, vnl_vector<T> & bp) :
+      A(NULL), rows(&Arows), b(&bp), lasterror(-1), lastweight(-1), lastzero(-1), verbose(1), floatsvd(false), normaleq(false)
   {}
 
   //! Robust solver
@@ -67,6 +95,8 @@ public:
   vnl_vector<T> getWeightedLSEst(const vnl_vector<T> & sqrtweights);
   //! Weighted least squares in float (only for the T=double version)
   vnl_vector<T> getWeightedLSEstFloat(const vnl_vector<T> & sqrtweights);
+  //! Weighted least squares from the normal equations (parallel, deterministic; generated rows or setNormalEquations)
+  vnl_vector<T> getWeightedLSEstNormal(const vnl_vector<T> & sqrtweights);
 
   double getLastError()
   {
@@ -93,12 +123,18 @@ public:
       verbose = 2;
   }
   
-  //! Specify if SVD is float (also in double case)
+  //! Specify if SVD is float (also in double case), not used with generated rows
   void setFloatSvd(bool b)
   {
     floatsvd = b;
   }
 
+  //! Solve the robust steps from the (parallel) normal equations instead of QR
+  void setNormalEquations(bool b)
+  {
+    normaleq = b;
+  }
+
   void plotPartialSat(const std::string& fname);
 
 protected:
@@ -114,11 +150,18 @@ protected:
   double getTukeyPartialSat(const vnl_vector<T>& r, double sat = SATr);
 
 private:
+  unsigned int getCols() const;
+  int getBlockCount() const;
+  long int getBlockStart(int ib) const;
+  const T * getBlockRows(int ib, std::vector<T> & buf) const;
+
   vnl_matrix<T> * A;
+  const RegressionRows<T> * rows;
   vnl_vector<T> * b;
   double lasterror, lastweight, lastzero;
   int verbose;
   bool floatsvd;
+  bool normaleq;
 };
 
 #include "Regression.cpp"
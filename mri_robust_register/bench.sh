@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+source "$(dirname $0)/../test.sh"
+
+# Benchmark for the multithreaded robust registration (not part of the test
+# suite, run by hand from the build directory):
+#
+#     bench.sh [nthreads]
+#
+# Moves the test image by a random rigid transform, registers it back and
+# builds a two timepoint template, once with one thread and once with
+# nthreads (default: all cores), prints the timings and fails if the threaded
+# runs do not give the same transforms.
+
+nthreads=${1:-$(getconf _NPROCESSORS_ONLN)}
+
+init_testdata
+FSTEST_NO_DATA_RESET=1
+
+test_command mri_create_tests \
+    --in 001.mgz \
+    --outs src.mgz \
+    --outt trg.mgz \
+    --lta-out truth.lta \
+    --translation --transdist 10 \
+    --rotation --maxdeg 10
+
+for n in 1 $nthreads; do
+    export OMP_NUM_THREADS=$n
+    start=$(date +%s.%N)
+    test_command mri_robust_register \
+        --mov src.mgz \
+        --dst trg.mgz \
+        --lta reg.$n.lta \
+        --satit \
+        --iscale
+    mid=$(date +%s.%N)
+    test_command mri_robust_template \
+        --mov src.mgz trg.mgz \
+        --template template.$n.mgz \
+        --lta tp1.$n.lta tp2.$n.lta \
+        --satit \
+        --iscale
+    end=$(date +%s.%N)
+    echo "threads $n: mri_robust_register $(echo "$mid - $start" | bc) s, mri_robust_template $(echo "$end - $mid" | bc) s"
+done
+
+# the reductions are done in a fixed order, the results must not depend on the thread count
+compare_lta reg.$nthreads.lta reg.1.lta
+compare_lta tp1.$nthreads.lta tp1.1.lta
+compare_lta tp2.$nthreads.lta tp2.1.lta
+
+test_command lta_diff reg.1.lta truth.lta
@@ -132,6 +132,8 @@ struct Parameters
   bool whitebgmov;
   bool whitebgdst;
   bool uchartype;
+  bool streamab;
+  bool normaleq;
 };
 static struct Parameters P =
 { "", "", "", "", "", "", "", "", "", "", "", false, false, false, false, false, false,
@@ -139,7 +141,7 @@ static struct Parameters P =
     NULL, NULL, false, false, true, false, 1, -1, false, 0.16, true, true, "",
     "", -1, -1, Registration::ROB,
 //  256,
-    SAMPLE_CUBIC_BSPLINE, false, ERADIUS, "", "", false, false, false, 1e-5, false, false,false};
+    SAMPLE_CUBIC_BSPLINE, false, ERADIUS, "", "", false, false, false, 1e-5, false, false,false,false,false};
 
 static void printUsage(void);
 static bool parseCommandLine(int argc, char *argv[], Parameters & P);
@@ -1455,6 +1457,8 @@ static void initRegistration(Registration & R, Parameters & P)
   R.setInitOrient(P.initorient);
   R.setInitScaling(P.initscaling);
   R.setDoublePrec(P.doubleprec);
+  R.setStreamAb(P.streamab);
+  R.setNormalEq(P.normaleq);
   //R.setWLimit(P.wlimit);
   R.setSymmetry(P.symmetry);
   R.setCost(P.cost);
@@ -2118,6 +2122,22 @@ static int parseNextCommand(int argc, char *argv[], Parameters & P)
         << "--doubleprec: Will perform algorithm with double precision (higher mem usage)!"
         << endl;
   }
+  else if (!strcmp(option, "STREAMAB"))
+  {
+    P.streamab = true;
+    nargs = 0;
+    cout
+        << "--streamab: Will not store the design matrix (lower mem usage, robust cost only)!"
+        << endl;
+  }
+  else if (!strcmp(option, "NORMALEQ"))
+  {
+    P.normaleq = true;
+    nargs = 0;
+    cout
+        << "--normaleq: Will solve the robust steps from the normal equations (multithreaded)!"
+        << endl;
+  }
   else if (!strcmp(option, "DEBUG"))
   {
     P.debug = 1;
@@ -13,3 +13,18 @@ test_command mri_robust_template \
     --subsample 200 \
 
 compare_vol rawavg.mgz 001.mgz --notallow-acq
+
+# register a rotated and shifted copy of 001.mgz back to it, once with the
+# default QR solver and once with the normal equations (--normaleq), which
+# should agree to within 0.05mm RMS
+FSTEST_NO_DATA_RESET=1
+test_command mri_vol2vol --mov 001.mgz --targ 001.mgz --regheader --rot 2 -1 1 --trans 2 1 -1 --o moved.mgz
+test_command mri_robust_register --mov moved.mgz --dst 001.mgz --lta qr.lta --satit --subsample 200
+test_command mri_robust_register --mov moved.mgz --dst 001.mgz --lta normaleq.lta --satit --subsample 200 --normaleq
+lta_diff normaleq.lta qr.lta | awk 'END {print $0; exit !($0<0.05)}'
+
+# the same registration with the rows of A generated block-wise (--streamab),
+# which also solves the normal equations
+test_command mri_robust_register --mov moved.mgz --dst 001.mgz --lta streamab.lta --satit --subsample 200 --streamab
+lta_diff streamab.lta qr.lta | awk 'END {print $0; exit !($0<0.05)}'
+lta_diff streamab.lta normaleq.lta | awk 'END {print $0; exit !($0<1e-4)}'
@@ -232,6 +232,7 @@ int main(int argc, char **argv)
   argv++;
   ErrorInit(NULL, NULL, NULL) ;
   DiagInit(NULL, NULL, NULL) ;
+  MRIIO_UseMmap = 1; // inputs are only read, so map uncompressed volumes
 
   if (argc == 0)
   {
@@ -819,6 +820,37 @@ int main(int argc, char **argv)
   printf("Computing statistics for each segmentation\n");
   fflush(stdout);
 
+  /* Count the voxels and compute the intensity stats of all the segs in
+     one pass over the volumes rather than one pass per seg. For a
+     surface seg the "volume" is nvertices x 1 x 1, the counts and
+     areas are still done per seg below. */
+  int *segidAll = NULL, *nhitsAll = NULL;
+  float *minAll = NULL, *maxAll = NULL, *rangeAll = NULL, *meanAll = NULL, *stdAll = NULL;
+  if (!dontrun)
+  {
+    segidAll = (int *) calloc(nsegid, sizeof(int));
+    for (n=0; n < nsegid; n++) segidAll[n] = StatSumTable[n].id;
+    if (!mris)
+    {
+      nhitsAll = (int *) calloc(nsegid, sizeof(int));
+      MRIsegCountAll(seg, nsegid, segidAll, nhitsAll);
+    }
+    if (InVolFile != NULL)
+    {
+      minAll   = (float *) calloc(nsegid, sizeof(float));
+      maxAll   = (float *) calloc(nsegid, sizeof(float));
+      rangeAll = (float *) calloc(nsegid, sizeof(float));
+      meanAll  = (float *) calloc(nsegid, sizeof(float));
+      stdAll   = (float *) calloc(nsegid, sizeof(float));
+      if(UseRobust == 0)
+        MRIsegStatsAll(seg, nsegid, segidAll, invol, frame, NULL,
+                       minAll, maxAll, rangeAll, meanAll, stdAll);
+      else
+        MRIsegStatsRobustAll(seg, nsegid, segidAll, invol, frame, NULL,
+                             minAll, maxAll, rangeAll, meanAll, stdAll, RobustPct);
+    }
+  }
+
   DoContinue=0;nx=0;skip=0;n0=0;vol=0;nhits=0;c=0;min=0.0;max=0.0;range=0.0;mean=0.0;std=0.0;snr=0.0;
 
   ROMP_PF_begin
@@ -861,15 +893,15 @@ int main(int argc, char **argv)
     {
       if (!mris)
       {
+        nhits = nhitsAll[n];
         if (pvvol == NULL)
         {
-          nhits = MRIsegCount(seg, StatSumTable[n].id, 0);
           vol = nhits*voxelvolume;
         }
         else
         {
+          // the PV correction looks at each label's border, so stays per seg
           vol = MRIvoxelsInLabelWithPartialVolumeEffects(seg, pvvol, StatSumTable[n].id, NULL, NULL);
-          nhits = MRIsegCount(seg, StatSumTable[n].id, 0);
 //          nhits = nint(vol/voxelvolume);
         }
       }  // if (!mris)
@@ -906,13 +938,11 @@ int main(int argc, char **argv)
     {
       if (nhits > 0)
       {
-        if(UseRobust == 0)
-          MRIsegStats(seg, StatSumTable[n].id, invol, frame,
-            &min, &max, &range, &mean, &std);
-        else
-          MRIsegStatsRobust(seg, StatSumTable[n].id, invol, frame,
-            &min, &max, &range, &mean, &std, RobustPct);
-
+        min   = minAll[n];
+        max   = maxAll[n];
+        range = rangeAll[n];
+        mean  = meanAll[n];
+        std   = stdAll[n];
         snr = mean/std;
       }
       else
@@ -935,6 +965,13 @@ int main(int argc, char **argv)
     ROMP_PFLB_end
   } // for (n=0; n < nsegid; n++)
   ROMP_PF_end
+  free(segidAll);
+  free(nhitsAll);
+  free(minAll);
+  free(maxAll);
+  free(rangeAll);
+  free(meanAll);
+  free(stdAll);
   
   /* print results ordered */
   for (n=0; n < nsegid; n++)
@@ -1422,13 +1459,18 @@ int main(int argc, char **argv)
     for (n=0; n < nsegid; n++)
       favg[n] = (double *) calloc(sizeof(double),invol->nframes);
     favgmn = (double *) calloc(sizeof(double *),nsegid);
+    // All segs and frames in one go
+    int *segidAll = (int *) calloc(nsegid, sizeof(int));
+    int *nvoxAll = (int *) calloc(nsegid, sizeof(int));
+    for (n=0; n < nsegid; n++) segidAll[n] = StatSumTable[n].id;
+    MRIsegFrameAvgAll(seg, nsegid, segidAll, invol, favg, nvoxAll);
     for (n=0; n < nsegid; n++) {
       if(debug){
 	printf("%3d",n);
 	if (n%20 == 19) printf("\n");
 	fflush(stdout);
       }
-      nvox = MRIsegFrameAvg(seg, StatSumTable[n].id, invol, favg[n]);
+      nvox = nvoxAll[n];
       favgmn[n] = 0.0;
       for(f=0; f < invol->nframes; f++) {
 	if(DoFrameSum) favg[n][f] *= nvox; // Undo spatial average
@@ -1438,6 +1480,8 @@ int main(int argc, char **argv)
       if(RmFrameAvgMn) for(f=0; f < invol->nframes; f++) favg[n][f] -= favgmn[n];
       if(NormFrameAvgMn != 0) for(f=0; f < invol->nframes; f++) favg[n][f] *= (NormFrameAvgMn/favgmn[n]);
     }
+    free(segidAll);
+    free(nvoxAll);
     printf("\n");
 
     // Save mean over space and frames in simple text file
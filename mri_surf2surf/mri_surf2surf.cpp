@@ -148,6 +148,14 @@ OPTIONS
     target vertex. If a target vertex has multiple source vertices, then the
     source values are averaged together. It does not seem to make much difference.
 
+  --map-cache mapfile
+
+    Save the source-to-target vertex correspondence found by the mapping in
+    mapfile, or reuse it if mapfile already holds one computed from the same
+    registration surfaces and mapping options (checked with a checksum of the
+    surfaces). When many measures of a subject are mapped to the same target,
+    the surfaces are then only searched once. Not used with --old.
+
   --fwhm-src fwhmsrc
   --fwhm-trg fwhmtrg (can also use --fwhm)
 
@@ -423,6 +431,7 @@ int  reshapefactor;
 int  reshape3d=0;
 
 const char *mapmethod = "nnfr";
+char *RegMapFile = NULL;
 
 int UseHash = 1;
 int framesave = 0;
@@ -1034,7 +1043,14 @@ int main(int argc, char **argv)
       MRIS *SurfRegList[2];
       SurfRegList[0] = SrcSurfReg;
       SurfRegList[1] = TrgSurfReg;
-      TrgVals = MRISapplyReg(SrcVals, SurfRegList, 2, ReverseMapFlag,jac,UseHash);
+      if (RegMapFile) {
+        MRIS_APPLYREG_MAP *RegMap = MRISapplyRegMapCached(RegMapFile, SurfRegList, 2, ReverseMapFlag,jac,UseHash);
+        if (RegMap == NULL) exit(1);
+        TrgVals = MRISapplyRegMapApply(RegMap, SrcVals);
+        MRISapplyRegMapFree(&RegMap);
+      }
+      else TrgVals = MRISapplyReg(SrcVals, SurfRegList, 2, ReverseMapFlag,jac,UseHash);
+      if (TrgVals == NULL) exit(1);
     }
 
   } else {
@@ -1712,6 +1728,12 @@ static int parse_commandline(int argc, char **argv)
       }
       trgsurfregfile = pargv[0];
       nargsused = 1;
+    } else if (!strcmp(option, "--map-cache")) {
+      if (nargc < 1) {
+        argnerr(option,1);
+      }
+      RegMapFile = pargv[0];
+      nargsused = 1;
     } else if (!strcmp(option, "--mapmethod")) {
       if (nargc < 1) {
         argnerr(option,1);
@@ -1863,6 +1885,7 @@ static void print_usage(void)
   printf("   --srcsurfreg source surface registration (sphere.reg)  \n");
   printf("   --trgsurfreg target surface registration (sphere.reg)  \n");
   printf("   --mapmethod  nnfr or nnf\n");
+  printf("   --map-cache mapfile : reuse/save the vertex correspondence in mapfile\n");
   printf("   --frame      save only nth frame (with --trg_type paint)\n");
   printf("   --fwhm-src fwhmsrc: smooth the source to fwhmsrc\n");
   printf("   --fwhm-trg fwhmtrg: smooth the target to fwhmtrg\n");
@@ -2024,6 +2047,14 @@ printf("    'holes'). If nnfr is chosen, then each hole is assigned to the close
 printf("    target vertex. If a target vertex has multiple source vertices, then the\n");
 printf("    source values are averaged together. It does not seem to make much difference.\n");
 printf("\n");
+printf("  --map-cache mapfile\n");
+printf("\n");
+printf("    Save the source-to-target vertex correspondence found by the mapping in\n");
+printf("    mapfile, or reuse it if mapfile already holds one computed from the same\n");
+printf("    registration surfaces and mapping options (checked with a checksum of the\n");
+printf("    surfaces). When many measures of a subject are mapped to the same target,\n");
+printf("    the surfaces are then only searched once. Not used with --old.\n");
+printf("\n");
 printf("  --fwhm-src fwhmsrc\n");
 printf("  --fwhm-trg fwhmtrg (can also use --fwhm)\n");
 printf("\n");
@@ -12,3 +12,18 @@ test_command mri_surf2surf \
 
 compare_vol bert/surf/lh.thickness bert/surf/lh.ref_thickness
 
+
+# the same mapping through a saved correspondence map: the first run computes
+# and saves it, the second one reuses it
+for run in save reuse; do
+    test_command mri_surf2surf \
+        --hemi lh \
+        --srcsubject bert \
+        --srcsurfval thickness \
+        --src_type curv \
+        --trgsubject fsaverage \
+        --trg_type curv \
+        --map-cache lh.bert.fsaverage.map \
+        --trgsurfval bert/surf/lh.thickness.$run
+    compare_vol bert/surf/lh.thickness.$run bert/surf/lh.ref_thickness
+done
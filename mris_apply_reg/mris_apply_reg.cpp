@@ -92,6 +92,7 @@ int LabelKeepStat=1;
 int ReverseMapFlag = 1;
 int DoJac = 0;
 int UseHash = 1;
+char *RegMapFile = NULL;
 int nsurfs = 0;
 int npatches = 0;
 int DoSynthRand = 0;
@@ -241,13 +242,18 @@ int main(int argc, char *argv[]) {
   }
   else LabelSurf = SurfReg[nsurfs-1];
 
-  // Apply registration to source
-  TrgVal = MRISapplyReg(SrcVal, SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+  // Apply registration to source, searching the correspondence only once
+  MRIS_APPLYREG_MAP *RegMap;
+  if(RegMapFile) RegMap = MRISapplyRegMapCached(RegMapFile, SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+  else           RegMap = MRISapplyRegMap(SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+  if(RegMap == NULL) exit(1);
+  TrgVal = MRISapplyRegMapApply(RegMap, SrcVal);
   if(TrgVal == NULL) exit(1);
   if(SrcLabelStat) {
-    TrgLabelStat = MRISapplyReg(SrcLabelStat, SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+    TrgLabelStat = MRISapplyRegMapApply(RegMap, SrcLabelStat);
     if(TrgLabelStat == NULL) exit(1);
   }
+  MRISapplyRegMapFree(&RegMap);
 
   // Save output
   if(AnnotFile){
@@ -432,6 +438,11 @@ static int parse_commandline(int argc, char **argv) {
       npatches++;
       nargsused = 2;
     } 
+    else if (!strcasecmp(option, "--map-cache")) {
+      if (nargc < 1) CMDargNErr(option,1);
+      RegMapFile = pargv[0];
+      nargsused = 1;
+    } 
     else if (!strcasecmp(option, "--stvpair")) {
       if (nargc < 1) CMDargNErr(option,1);
       setenv("FS_MRISAPPLYREG_STVPAIR",pargv[0],1);
@@ -657,6 +668,8 @@ static void print_usage(void) {
   printf("\n");
   printf("   --jac : use jacobian correction\n");
   printf("   --no-rev : do not do reverse mapping  (put after --src-label to enforce)\n");
+  printf("   --map-cache mapfile : reuse the vertex correspondence saved in mapfile if it was\n");
+  printf("        computed from the same surfaces and options, otherwise compute and save it\n");
   printf("   --rev : perform reverse mapping (this is done by default)\n");
   printf("   --randn : replace input with WGN\n");
   printf("   --ones  : replace input with ones\n");
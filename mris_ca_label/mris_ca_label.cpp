@@ -75,8 +75,6 @@ static const char *sulc_name = "sulc" ;
 #endif
 
 static char subjects_dir[STRLEN] ;
-extern char *gcsa_write_fname ;
-extern int gcsa_write_iterations ;
 
 static int novar = 0 ;
 static int refine = 0;
@@ -430,6 +428,11 @@ get_option(int argc, char *argv[])
     nargs = 1 ;
     fprintf(stderr, "using neighborhood size=%d\n", nbrs) ;
   }
+  else if (!stricmp(option, "parallel-icm"))
+  {
+    gcsa_parallel_icm = 1 ;
+    fprintf(stderr, "relabeling with the Gibbs priors in parallel\n") ;
+  }
   else if (!stricmp(option, "seed"))
   {
     setRandomSeed(atol(argv[2])) ;
@@ -149,6 +149,8 @@ main(int argc, char *argv[])
   parms.check_surface_intersection=0;
   // use initial mapping only
   parms.optimal_mapping=0;
+  // one random sequence for all the defects
+  parms.seed_per_defect=0;
 
   //Gdiag |= DIAG_WRITE ;
   Progname = argv[0] ;
@@ -760,6 +762,11 @@ get_option(int argc, char *argv[])
     fprintf(stderr,"using '%s' instead of surf subdirectory\n",surf_dir);
     nargs = 1 ;
   }
+  else if (!stricmp(option, "seed_per_defect"))
+  {
+    parms.seed_per_defect = 1;
+    fprintf(stderr,"reseeding the random number generator for each defect\n");
+  }
   else if (!stricmp(option, "seed"))
   {
     setRandomSeed(atol(argv[2])) ;
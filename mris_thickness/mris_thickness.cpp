@@ -39,6 +39,7 @@
 #include "version.h"
 #include "icosahedron.h"
 #include "label.h"
+#include "romp_support.h"
 
 
 int main(int argc, char *argv[]) ;
@@ -345,7 +346,6 @@ main(int argc, char *argv[]) {
         tmp[STRLEN], out_fname_only[STRLEN] ;
       int  vno ;
       FILE *fp ;
-      VERTEX *v ;
       MHT   *mht ;
 
       MRIScopyCurvatureToImagValues(mris) ; // save base thickness 
@@ -384,24 +384,32 @@ main(int argc, char *argv[]) {
         }
         if (MRISreadPialCoordinates(mris, fname) != NO_ERROR)
           ErrorExit(ERROR_NOFILE, "%s: could not read surface file %s", Progname, fname) ;
+        // each vertex only writes its own curv and t[xyz], the face table is only read
+        ROMP_PF_begin
+#ifdef HAVE_OPENMP
+        #pragma omp parallel for if_ROMP(assume_reproducible) schedule(guided)
+#endif
         for (vno = 0 ; vno < mris->nvertices ; vno++)
         {
+          ROMP_PFLB_begin
           float   xw, yw, zw, xp, yp, zp, thick ;
           
-          v = &mris->vertices[vno] ;
+          VERTEX * const v = &mris->vertices[vno] ;
           if (vno == Gdiag_no)
             DiagBreak() ;
           if (v->ripflag)
           {
             v->tx = v->whitex ; v->ty = v->whitey ; v->tz = v->whitez ;
-            continue ;
+            ROMP_PFLB_continue ;
           }
           MRISvertexCoord2XYZ_float(v, WHITE_VERTICES, &xw, &yw, &zw) ;
           MRISsampleFaceCoordsCanonical(mht, mris, v->x, v->y, v->z, 
                                         PIAL_VERTICES, &xp, &yp, &zp);
           thick = sqrt(SQR(xp-xw) + SQR(yp-yw) + SQR(zp-zw)) ;
           v->curv = thick ; v->tx = xp ; v->ty = yp ; v->tz = zp ;
+          ROMP_PFLB_end
         }
+        ROMP_PF_end
         FileNameOnly(out_fname, out_fname_only) ;
         req = snprintf(fname, STRLEN, "%s/%s.long.%s/surf/%s", sdir, subject, base_name, out_fname_only);
         if (req >= STRLEN) {
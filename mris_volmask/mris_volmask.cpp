@@ -4,7 +4,8 @@
  * Uses the 4 surfaces of a scan to construct a mask volume showing the
  * position of each voxel with respect to the surfaces - GM, WM, LH or RH.
  *
- * Uses the MRISOBBTree algorithm
+ * Uses a bounding volume hierarchy over the faces (MRISBVH) for the
+ * inside/outside tests
  */
 /*
  * Original Author: Krish Subramaniam
@@ -28,8 +29,8 @@
 #include <cstdio>
 #include <vector>
 
-#include "MRISOBBTree.h"
 #include "MRISdistancefield.h"
+#include "mrisbvh.h"
 #include "fastmarching.h"
 #include "cmd_line_interface.h"
 
@@ -676,9 +677,8 @@ ComputeSurfaceDistanceFunction(MRIS* mris,
   distfield->SetMaxDistance(thickness);
   distfield->Generate(); //mri_dist now has the distancefield
 
-  // Construct the OBB Tree
-  MRISOBBTree* OBBTree = new MRISOBBTree(mris);
-  OBBTree->ConstructTree();
+  // Construct the face hierarchy used for the inside/outside tests
+  MRISBVH* bvh = new MRISBVH(mris);
 
   std::queue<Pointd* > ptsqueue;
   // iterate through all the volume points
@@ -694,7 +694,7 @@ ComputeSurfaceDistanceFunction(MRIS* mris,
         {
           continue;
         }
-        res = OBBTree->PointInclusionTest(i, j, k);
+        res = bvh->PointInclusionTest(i, j, k);
         Pointd *pt = new Pointd;
         pt->v[0] = i;
         pt->v[1] = j;
@@ -795,7 +795,7 @@ ComputeSurfaceDistanceFunction(MRIS* mris,
 
   MRIfree(&mri_visited);
   MRIfree(&_mridist);
-  delete OBBTree;
+  delete bvh;
   delete distfield;
   return(mri_distfield);
 }
@@ -25,25 +25,45 @@ using namespace std;
 int Bite::mNumDir, Bite::mNumB0, Bite::mNumTract, Bite::mNumBedpost;
 float Bite::mFminPath;
 vector<unsigned int> Bite::mBaselineImages;
-vector<float> Bite::mGradients, Bite::mBvalues;
+vector<float> Bite::mGradients, Bite::mGradX, Bite::mGradY, Bite::mGradZ,
+              Bite::mBvalues;
+
+//
+// Allocate storage for the data of NumVox voxels
+// (after Bite::SetStatic has been called)
+//
+void BiteStore::Resize(int NumVox) {
+  const int ndir = Bite::GetNumDir(), ntract = Bite::GetNumTract(),
+            nsamp = Bite::GetNumBedpost() * ntract;
+
+  mDwi.assign((size_t) NumVox * ndir, 0);
+  mPhiSamples.assign((size_t) NumVox * nsamp, 0);
+  mThetaSamples.assign((size_t) NumVox * nsamp, 0);
+  mFSamples.assign((size_t) NumVox * nsamp, 0);
+  mPhi.assign((size_t) NumVox * ntract, 0);
+  mTheta.assign((size_t) NumVox * ntract, 0);
+  mF.assign((size_t) NumVox * ntract, 0);
+}
 
 Bite::Bite(MRI *Dwi, MRI **Phi, MRI **Theta, MRI **F,
            MRI **V0, MRI **F0, MRI *D0,
-           int CoordX, int CoordY, int CoordZ) :
-           mCoordX(CoordX), mCoordY(CoordY), mCoordZ(CoordZ) {
+           int CoordX, int CoordY, int CoordZ,
+           BiteStore &Store, int Index) :
+           mCoordX(CoordX), mCoordY(CoordY), mCoordZ(CoordZ), mPathTract(0) {
   float fsum, vx, vy, vz;
+  const size_t nsamp = (size_t) mNumBedpost * mNumTract;
 
-  mDwi.clear();
-  mPhiSamples.clear();
-  mThetaSamples.clear();
-  mFSamples.clear();
-  mPhi.clear();
-  mTheta.clear();
-  mF.clear();
+  mDwi = &Store.mDwi[(size_t) Index * mNumDir];
+  mPhiSamples = &Store.mPhiSamples[Index * nsamp];
+  mThetaSamples = &Store.mThetaSamples[Index * nsamp];
+  mFSamples = &Store.mFSamples[Index * nsamp];
+  mPhi = &Store.mPhi[(size_t) Index * mNumTract];
+  mTheta = &Store.mTheta[(size_t) Index * mNumTract];
+  mF = &Store.mF[(size_t) Index * mNumTract];
 
   // DWI intensity values
   for (int idir = 0; idir < mNumDir; idir++)
-    mDwi.push_back(MRIgetVoxVal(Dwi, mCoordX, mCoordY, mCoordZ, idir));
+    mDwi[idir] = MRIgetVoxVal(Dwi, mCoordX, mCoordY, mCoordZ, idir);
 
   // Initialize s0
   mS0 = 0;
@@ -56,12 +76,13 @@ Bite::Bite(MRI *Dwi, MRI **Phi, MRI **Theta, MRI **F,
   // Samples of phi, theta, f
   for (int isamp = 0; isamp < mNumBedpost; isamp++)
     for (int itract = 0; itract < mNumTract; itract++) {
-      mPhiSamples.push_back(MRIgetVoxVal(Phi[itract],
-                                         mCoordX, mCoordY, mCoordZ, isamp));
-      mThetaSamples.push_back(MRIgetVoxVal(Theta[itract],
-                                         mCoordX, mCoordY, mCoordZ, isamp));
-      mFSamples.push_back(MRIgetVoxVal(F[itract],
-                                         mCoordX, mCoordY, mCoordZ, isamp));
+      const int k = isamp * mNumTract + itract;
+      mPhiSamples[k] = MRIgetVoxVal(Phi[itract],
+                                    mCoordX, mCoordY, mCoordZ, isamp);
+      mThetaSamples[k] = MRIgetVoxVal(Theta[itract],
+                                    mCoordX, mCoordY, mCoordZ, isamp);
+      mFSamples[k] = MRIgetVoxVal(F[itract],
+                                    mCoordX, mCoordY, mCoordZ, isamp);
     }
 
   fsum = 0;
@@ -70,11 +91,11 @@ Bite::Bite(MRI *Dwi, MRI **Phi, MRI **Theta, MRI **F,
     vx = MRIgetVoxVal(V0[itract], mCoordX, mCoordY, mCoordZ, 0),
     vy = MRIgetVoxVal(V0[itract], mCoordX, mCoordY, mCoordZ, 1),
     vz = MRIgetVoxVal(V0[itract], mCoordX, mCoordY, mCoordZ, 2);
-    mPhi.push_back(atan2(vy, vx));
-    mTheta.push_back(acos(vz / sqrt(vx*vx + vy*vy + vz*vz)));
+    mPhi[itract] = atan2(vy, vx);
+    mTheta[itract] = acos(vz / sqrt(vx*vx + vy*vy + vz*vz));
 
     // Initialize f
-    mF.push_back(MRIgetVoxVal(F0[itract], mCoordX, mCoordY, mCoordZ, 0));
+    mF[itract] = MRIgetVoxVal(F0[itract], mCoordX, mCoordY, mCoordZ, 0);
     fsum += MRIgetVoxVal(F0[itract], mCoordX, mCoordY, mCoordZ, 0);
   }
 
@@ -134,6 +155,16 @@ void Bite::SetStatic(const string GradientFile, const string BvalueFile,
       mGradients.at(ii + 3*idir) = val;
     }
 
+  // Same gradients, one array per component for the likelihood kernels
+  mGradX.resize(mNumDir);
+  mGradY.resize(mNumDir);
+  mGradZ.resize(mNumDir);
+  for (int idir = 0; idir < mNumDir; idir++) {
+    mGradX[idir] = mGradients[3*idir];
+    mGradY[idir] = mGradients[3*idir + 1];
+    mGradZ[idir] = mGradients[3*idir + 2];
+  }
+
   if (gfile >> val) {
     cout << "ERROR: Dimensions of " << BvalueFile << " and " << GradientFile
          << " do not match" << endl;
@@ -161,106 +192,164 @@ float Bite::GetLowBvalue() { return mBvalues[mBaselineImages[0]]; }
 void Bite::SampleParameters() {
   const int isamp = (int) round(drand48() * (mNumBedpost-1))
                                             * mNumTract;
-  vector<float>::const_iterator samples;
- 
-  samples = mPhiSamples.begin() + isamp;
-  copy(samples, samples + mNumTract, mPhi.begin());
- 
-  samples = mThetaSamples.begin() + isamp;
-  copy(samples, samples + mNumTract, mTheta.begin());
- 
-  samples = mFSamples.begin() + isamp;
-  copy(samples, samples + mNumTract, mF.begin());
+
+  copy(mPhiSamples + isamp, mPhiSamples + isamp + mNumTract, mPhi);
+  copy(mThetaSamples + isamp, mThetaSamples + isamp + mNumTract, mTheta);
+  copy(mFSamples + isamp, mFSamples + isamp + mNumTract, mF);
 }
 
 //
-// Compute likelihood given that voxel is off path
+// Scratch space for the likelihood kernels, [(mNumTract+2) x mNumDir]:
+// the signal of each stick, the signal of the path stick, and the
+// isotropic signal, plus the table of signals that ComputeSquaredError
+// sums. One per thread, so no allocation per evaluation.
 //
-void Bite::ComputeLikelihoodOffPath() {
-  double like = 0;
-  vector<float>::const_iterator ri = mGradients.begin();
-  vector<float>::const_iterator bi = mBvalues.begin();
-  vector<float>::const_iterator sij = mDwi.begin();
+double *Bite::GetWorkspace(const double **&Signal) {
+  static thread_local vector<double> work;
+  static thread_local vector<const double *> signal;
+
+  work.resize((size_t) (mNumTract+2) * mNumDir);
+  signal.resize(mNumTract+1);
+  Signal = &signal[0];
+  return &work[0];
+}
 
-  for (int idir = mNumDir; idir > 0; idir--) {
-    double sbar = 0, fsum = 0;
-    const double bidj = (*bi) * mD;
-    vector<float>::const_iterator fjl = mF.begin();
-    vector<float>::const_iterator phijl = mPhi.begin();
-    vector<float>::const_iterator thetajl = mTheta.begin();
+//
+// Signal attenuation exp(-b_i d (r_i . v)^2) of a stick along (Phi, Theta)
+// for all gradient directions r_i
+//
+void Bite::ComputeStickSignal(float Phi, float Theta, double *Signal) {
+  const float cphi = cos(Phi), sphi = sin(Phi),
+              ctheta = cos(Theta), stheta = sin(Theta);
+  const float *rx = &mGradX[0], *ry = &mGradY[0], *rz = &mGradZ[0],
+              *bi = &mBvalues[0];
+  const float d = mD;
+
+#ifdef HAVE_OPENMP
+  #pragma omp simd
+#endif
+  for (int idir = 0; idir < mNumDir; idir++) {
+    const double bidj = bi[idir] * d;
+    const double iprod = (rx[idir] * cphi + ry[idir] * sphi) * stheta
+                       + rz[idir] * ctheta;
+
+    Signal[idir] = exp(-bidj * iprod * iprod);
+  }
+}
 
-    for (int itract = mNumTract; itract > 0; itract--) {
-      const double iprod =
-        (ri[0] * cos(*phijl) + ri[1] * sin(*phijl)) * sin(*thetajl)
-        + ri[2] * cos(*thetajl);
+//
+// Signal attenuation exp(-b_i d) of the isotropic compartment
+//
+void Bite::ComputeIsoSignal(double *Signal) {
+  const float *bi = &mBvalues[0];
+  const float d = mD;
+
+#ifdef HAVE_OPENMP
+  #pragma omp simd
+#endif
+  for (int idir = 0; idir < mNumDir; idir++) {
+    const double bidj = bi[idir] * d;
+
+    Signal[idir] = exp(-bidj);
+  }
+}
+
+//
+// Sum of squared differences between the DWI values and the signal
+// predicted from the stick signals Signal[itract] and the isotropic
+// signal Signal[mNumTract]
+//
+double Bite::ComputeSquaredError(const double * const *Signal) {
+  double like = 0;
+  const double *iso = Signal[mNumTract];
 
-      sbar += *fjl * exp(-bidj * iprod * iprod);
-      fsum += *fjl;
+  for (int idir = 0; idir < mNumDir; idir++) {
+    double sbar = 0, fsum = 0;
 
-      fjl++;
-      phijl++;
-      thetajl++;
+    for (int itract = 0; itract < mNumTract; itract++) {
+      sbar += mF[itract] * Signal[itract][idir];
+      fsum += mF[itract];
     }
 
-    sbar += (1-fsum) * exp(-bidj);
+    sbar += (1-fsum) * iso[idir];
     sbar *= mS0;
-    like += pow(*sij - sbar, 2);
+    like += pow(mDwi[idir] - sbar, 2);
+  }
+
+  return like;
+}
 
-    ri+=3;
-    bi++;
-    sij++;
+//
+// Compute likelihood given that voxel is off path
+//
+void Bite::ComputeLikelihoodOffPath() {
+  const double **signal;
+  double *work = GetWorkspace(signal);
+
+  for (int itract = 0; itract < mNumTract; itract++) {
+    signal[itract] = work + itract * mNumDir;
+    ComputeStickSignal(mPhi[itract], mTheta[itract], work + itract * mNumDir);
   }
 
-  mLikelihood0 = (float) log(like/2) * mNumDir/2;
+  signal[mNumTract] = work + (mNumTract+1) * mNumDir;
+  ComputeIsoSignal(work + (mNumTract+1) * mNumDir);
+
+  mLikelihood0 = (float) log(ComputeSquaredError(signal)/2) * mNumDir/2;
 }
 
 //
 // Compute likelihood given that voxel is on path
 //
 void Bite::ComputeLikelihoodOnPath(float PathPhi, float PathTheta) {
-  double like = 0;
-  vector<float>::const_iterator ri = mGradients.begin();
-  vector<float>::const_iterator bi = mBvalues.begin();
-  vector<float>::const_iterator sij = mDwi.begin();
+  const double **signal;
+  double *work = GetWorkspace(signal);
 
   // Choose which anisotropic compartment in voxel corresponds to path
   ChoosePathTractAngle(PathPhi, PathTheta);
 
   // Calculate likelihood by replacing the chosen tract orientation from path
-  for (int idir = mNumDir; idir > 0; idir--) {
-    double sbar = 0, fsum = 0;
-    const double bidj = (*bi) * mD;
-    vector<float>::const_iterator fjl = mF.begin();
-    vector<float>::const_iterator phijl = mPhi.begin();
-    vector<float>::const_iterator thetajl = mTheta.begin();
-
-    for (int itract = 0; itract < mNumTract; itract++) {
-      double iprod;
-      if (itract == mPathTract)
-        iprod = (ri[0] * cos(PathPhi) + ri[1] * sin(PathPhi)) * sin(PathTheta)
-              + ri[2] * cos(PathTheta);
-      else
-        iprod = (ri[0] * cos(*phijl) + ri[1] * sin(*phijl)) * sin(*thetajl)
-              + ri[2] * cos(*thetajl);
-
-      sbar += *fjl * exp(-bidj * iprod * iprod);
-      fsum += *fjl;
-
-      fjl++;
-      phijl++;
-      thetajl++;
+  for (int itract = 0; itract < mNumTract; itract++)
+    if (itract != mPathTract) {
+      signal[itract] = work + itract * mNumDir;
+      ComputeStickSignal(mPhi[itract], mTheta[itract], work + itract*mNumDir);
     }
 
-    sbar += (1-fsum) * exp(-bidj);
-    sbar *= mS0;
-    like += pow(*sij - sbar, 2);
+  signal[mPathTract] = work + mNumTract * mNumDir;
+  ComputeStickSignal(PathPhi, PathTheta, work + mNumTract * mNumDir);
 
-    ri+=3;
-    bi++;
-    sij++;
+  signal[mNumTract] = work + (mNumTract+1) * mNumDir;
+  ComputeIsoSignal(work + (mNumTract+1) * mNumDir);
+
+  mLikelihood1 = (float) log(ComputeSquaredError(signal)/2) * mNumDir/2;
+}
+
+//
+// Compute likelihoods given that voxel is off path and on path, in one go:
+// the two differ only in the path tract, so the signals of the other tracts
+// and of the isotropic compartment are computed once for both
+//
+void Bite::ComputeLikelihoodOffOnPath(float PathPhi, float PathTheta) {
+  const double **signal;
+  double *work = GetWorkspace(signal);
+
+  for (int itract = 0; itract < mNumTract; itract++) {
+    signal[itract] = work + itract * mNumDir;
+    ComputeStickSignal(mPhi[itract], mTheta[itract], work + itract * mNumDir);
   }
 
-  mLikelihood1 = (float) log(like/2) * mNumDir/2;
+  signal[mNumTract] = work + (mNumTract+1) * mNumDir;
+  ComputeIsoSignal(work + (mNumTract+1) * mNumDir);
+
+  mLikelihood0 = (float) log(ComputeSquaredError(signal)/2) * mNumDir/2;
+
+  // Choose which anisotropic compartment in voxel corresponds to path
+  ChoosePathTractAngle(PathPhi, PathTheta);
+
+  // Replace the chosen tract orientation from path
+  signal[mPathTract] = work + mNumTract * mNumDir;
+  ComputeStickSignal(PathPhi, PathTheta, work + mNumTract * mNumDir);
+
+  mLikelihood1 = (float) log(ComputeSquaredError(signal)/2) * mNumDir/2;
 }
 
 //
@@ -268,9 +357,9 @@ void Bite::ComputeLikelihoodOnPath(float PathPhi, float PathTheta) {
 //
 void Bite::ChoosePathTractAngle(float PathPhi, float PathTheta) {
   double maxprod = 0;
-  vector<float>::const_iterator fjl = mF.begin();
-  vector<float>::const_iterator phijl = mPhi.begin();
-  vector<float>::const_iterator thetajl = mTheta.begin();
+  const float *fjl = mF;
+  const float *phijl = mPhi;
+  const float *thetajl = mTheta;
 
   for (int itract = 0; itract < mNumTract; itract++) {
     if (*fjl > mFminPath) {
@@ -298,47 +387,27 @@ void Bite::ChoosePathTractAngle(float PathPhi, float PathTheta) {
 //
 void Bite::ChoosePathTractLike(float PathPhi, float PathTheta) {
   double mindlike = numeric_limits<double>::max();
+  const double **signal;
+  double *work = GetWorkspace(signal);
+
+  for (int itract = 0; itract < mNumTract; itract++) {
+    signal[itract] = work + itract * mNumDir;
+    ComputeStickSignal(mPhi[itract], mTheta[itract], work + itract * mNumDir);
+  }
+
+  signal[mNumTract] = work + (mNumTract+1) * mNumDir;
+  ComputeIsoSignal(work + (mNumTract+1) * mNumDir);
+
+  ComputeStickSignal(PathPhi, PathTheta, work + mNumTract * mNumDir);
 
   for (int jtract = 0; jtract < mNumTract; jtract++)
     if (mF[jtract] > mFminPath) {
-      double dlike, like = 0;
-      vector<float>::const_iterator ri = mGradients.begin();
-      vector<float>::const_iterator bi = mBvalues.begin();
-      vector<float>::const_iterator sij = mDwi.begin();
+      double dlike, like;
 
       // Calculate likelihood by replacing the chosen tract orientation from path
-      for (int idir = mNumDir; idir > 0; idir--) {
-        double sbar = 0, fsum = 0;
-        const double bidj = (*bi) * mD;
-        vector<float>::const_iterator fjl = mF.begin();
-        vector<float>::const_iterator phijl = mPhi.begin();
-        vector<float>::const_iterator thetajl = mTheta.begin();
-
-        for (int itract = 0; itract < mNumTract; itract++) {
-          double iprod;
-          if (itract == jtract)
-            iprod = (ri[0] * cos(PathPhi) + ri[1] * sin(PathPhi)) * sin(PathTheta)
-                  + ri[2] * cos(PathTheta);
-          else
-            iprod = (ri[0] * cos(*phijl) + ri[1] * sin(*phijl)) * sin(*thetajl)
-                  + ri[2] * cos(*thetajl);
-
-          sbar += *fjl * exp(-bidj * iprod * iprod);
-          fsum += *fjl;
-
-          fjl++;
-          phijl++;
-          thetajl++;
-        }
-
-        sbar += (1-fsum) * exp(-bidj);
-        sbar *= mS0;
-        like += pow(*sij - sbar, 2);
-
-        ri+=3;
-        bi++;
-        sij++;
-      }
+      signal[jtract] = work + mNumTract * mNumDir;
+      like = ComputeSquaredError(signal);
+      signal[jtract] = work + jtract * mNumDir;
 
       like = log(like/2) * mNumDir/2;
       dlike = fabs(like - (double) mLikelihood0);
@@ -360,8 +429,8 @@ void Bite::ChoosePathTractLike(float PathPhi, float PathTheta) {
 // Compute prior given that voxel is off path
 //
 void Bite::ComputePriorOffPath() {
-  vector<float>::const_iterator fjl = mF.begin() + mPathTract;
-  vector<float>::const_iterator thetajl = mTheta.begin() + mPathTract;
+  const float *fjl = mF + mPathTract;
+  const float *thetajl = mTheta + mPathTract;
 
 //cout << (*fjl) << " " << log((*fjl - 1) * log(1 - *fjl)) << " "
 //     << log(((double)*fjl - 1) * log(1 - (double)*fjl)) << endl;
@@ -380,7 +449,7 @@ void Bite::ComputePriorOnPath() {
 }
 
 bool Bite::IsAllFZero() {
-  return (*max_element(mF.begin(), mF.end()) < mFminPath);
+  return (*max_element(mF, mF + mNumTract) < mFminPath);
 }
 
 bool Bite::IsFZero() { return (mF[mPathTract] < mFminPath); }
@@ -30,11 +30,28 @@
 #include <math.h>
 #include "mri.h"
 
+//
+// Contiguous storage of the diffusion data of all voxels in a mask.
+// Each field is one array over all voxels, which the Bite of each voxel
+// points into, so that walking a path does not chase per-voxel allocations.
+//
+class BiteStore {
+  public:
+    void Resize(int NumVox);
+
+    std::vector<float> mDwi;			// [NumVox x mNumDir]
+    std::vector<float> mPhiSamples,		// [NumVox x mNumBedpost x mNumTract]
+                       mThetaSamples,
+                       mFSamples;
+    std::vector<float> mPhi, mTheta, mF;	// [NumVox x mNumTract]
+};
+
 class Bite {
   public:
     Bite(MRI *Dwi, MRI **Phi, MRI **Theta, MRI **F,
          MRI **V0, MRI **F0, MRI *D0,
-         int CoordX, int CoordY, int CoordZ);
+         int CoordX, int CoordY, int CoordZ,
+         BiteStore &Store, int Index);
     ~Bite();
 
   private:
@@ -42,17 +59,23 @@ class Bite {
     static float mFminPath;
     static std::vector<unsigned int> mBaselineImages;
     static std::vector<float> mGradients,	// [3 x mNumDir]
+                              mGradX, mGradY, mGradZ,	// [mNumDir]
                               mBvalues;		// [mNumDir]
 
     int mCoordX, mCoordY, mCoordZ, mPathTract;
     float mS0, mD, mLikelihood0, mLikelihood1, mPrior0, mPrior1;
-    std::vector<float> mDwi;			// [mNumDir]
-    std::vector<float> mPhiSamples;		// [mNumTract x mNumBedpost]
-    std::vector<float> mThetaSamples;		// [mNumTract x mNumBedpost]
-    std::vector<float> mFSamples;		// [mNumTract x mNumBedpost]
-    std::vector<float> mPhi;			// [mNumTract]
-    std::vector<float> mTheta;			// [mNumTract]
-    std::vector<float> mF;			// [mNumTract]
+    float *mDwi;				// [mNumDir]
+    float *mPhiSamples;				// [mNumTract x mNumBedpost]
+    float *mThetaSamples;			// [mNumTract x mNumBedpost]
+    float *mFSamples;				// [mNumTract x mNumBedpost]
+    float *mPhi;				// [mNumTract]
+    float *mTheta;				// [mNumTract]
+    float *mF;					// [mNumTract]
+
+    double *GetWorkspace(const double **&Signal);
+    void ComputeStickSignal(float Phi, float Theta, double *Signal);
+    void ComputeIsoSignal(double *Signal);
+    double ComputeSquaredError(const double * const *Signal);
 
   public:
     static void SetStatic(const std::string GradientFile,
@@ -67,6 +90,7 @@ class Bite {
     void SampleParameters();
     void ComputeLikelihoodOffPath();
     void ComputeLikelihoodOnPath(float PathPhi, float PathTheta);
+    void ComputeLikelihoodOffOnPath(float PathPhi, float PathTheta);
     void ChoosePathTractAngle(float PathPhi, float PathTheta);
     void ChoosePathTractLike(float PathPhi, float PathTheta);
     void ComputePriorOffPath();
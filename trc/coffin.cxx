@@ -20,6 +20,10 @@
 
 #include <coffin.h>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 using namespace std;
 
 const unsigned int Aeon::mDiffStep = 3;
@@ -172,12 +176,22 @@ void Aeon::ReadData(const string RootDir, const string DwiFile,
        << Bite::GetLowBvalue() << ") out of a total of "
        << Bite::GetNumDir() << " frames" << endl;
 
+  mNumVox = 0;
+  for (int iz = 0; iz < mNz; iz++)
+    for (int iy = 0; iy < mNy; iy++)
+      for (int ix = 0; ix < mNx; ix++)
+        if (MRIgetVoxVal(mMask, ix, iy, iz, 0))
+          mNumVox++;
+
+  mDataStore.Resize(mNumVox);
   mData.clear();
+  mData.reserve(mNumVox);
   for (int iz = 0; iz < mNz; iz++)
     for (int iy = 0; iy < mNy; iy++)
       for (int ix = 0; ix < mNx; ix++)
         if (MRIgetVoxVal(mMask, ix, iy, iz, 0)) {
-          Bite data = Bite(dwi, phi, theta, f, v0, f0, d0, ix, iy, iz);
+          Bite data = Bite(dwi, phi, theta, f, v0, f0, d0, ix, iy, iz,
+                           mDataStore, mData.size());
           mData.push_back(data);
         }
 
@@ -292,6 +306,8 @@ void Aeon::ClearPath() {
   mPathThetaNew.clear();
 
   mDataFitSamples.clear();
+  mChainSampleStart.clear();
+  mChainFitStart.clear();
 
   mRejectF = false;
   mAcceptF = false;
@@ -520,8 +536,7 @@ bool Aeon::ComputePathDataFit() {
                              ipt < mPathPointsNew.end(); ipt += 3) {
     Bite *ivox = mDataMask[ipt[0] + ipt[1]*mNx + ipt[2]*mNxy];
 
-    ivox->ComputeLikelihoodOffPath();
-    ivox->ComputeLikelihoodOnPath(*iphi, *itheta);
+    ivox->ComputeLikelihoodOffOnPath(*iphi, *itheta);
     if (ivox->IsFZero()) {
       ostringstream msg;
       msg << "Reject due to f=0 at "
@@ -572,8 +587,7 @@ bool Aeon::ComputePathDataFit() {
                              ipt < mPathPoints.end(); ipt += 3) {
     Bite *ivox = mDataMask[ipt[0] + ipt[1]*mNx + ipt[2]*mNxy];
 
-    ivox->ComputeLikelihoodOffPath();
-    ivox->ComputeLikelihoodOnPath(*iphi, *itheta);
+    ivox->ComputeLikelihoodOffOnPath(*iphi, *itheta);
     if (ivox->IsFZero()) {
       ostringstream msg;
       msg << "Accept due to f=0 at "
@@ -705,6 +719,98 @@ void Aeon::SavePath() {
   mPathPointSamples.push_back(mPathPoints);
 }
 
+//
+// Write/read a vector to/from a binary file of MCMC samples
+//
+template <class T>
+static void WriteSampleVector(ofstream &OutFile, const vector<T> &Samples) {
+  const unsigned int nsamp = Samples.size();
+
+  OutFile.write((const char *) &nsamp, sizeof(nsamp));
+  if (nsamp > 0)
+    OutFile.write((const char *) &Samples[0], nsamp * sizeof(T));
+}
+
+template <class T>
+static void ReadSampleVector(ifstream &InFile, vector<T> &Samples) {
+  unsigned int nsamp = 0;
+
+  InFile.read((char *) &nsamp, sizeof(nsamp));
+  Samples.resize(nsamp);
+  if (nsamp > 0)
+    InFile.read((char *) &Samples[0], nsamp * sizeof(T));
+}
+
+//
+// Write the MCMC samples of this time point to a binary file, so that the
+// samples of a chain that ran in another process can be pooled with these
+//
+void Aeon::WriteSamples(ofstream &OutFile) const {
+  const unsigned int npath = mPathPointSamples.size();
+
+  OutFile.write((const char *) &npath, sizeof(npath));
+  for (vector< vector<int> >::const_iterator ipath = mPathPointSamples.begin();
+                                             ipath < mPathPointSamples.end();
+                                             ipath++)
+    WriteSampleVector(OutFile, *ipath);
+
+  WriteSampleVector(OutFile, mDataFitSamples);
+}
+
+//
+// Append the MCMC samples of another chain for this time point,
+// as written by WriteSamples, keeping track of where each chain starts
+//
+void Aeon::ReadSamples(ifstream &InFile) {
+  unsigned int npath = 0;
+  vector<float> datafit;
+
+  if (mChainSampleStart.empty()) {
+    mChainSampleStart.push_back(0);
+    mChainFitStart.push_back(0);
+  }
+  mChainSampleStart.push_back(mPathPointSamples.size());
+  mChainFitStart.push_back(mDataFitSamples.size());
+
+  InFile.read((char *) &npath, sizeof(npath));
+  for (unsigned int k = 0; k < npath; k++) {
+    mPathPointSamples.push_back(vector<int>());
+    ReadSampleVector(InFile, mPathPointSamples.back());
+  }
+
+  ReadSampleVector(InFile, datafit);
+  mDataFitSamples.insert(mDataFitSamples.end(), datafit.begin(), datafit.end());
+}
+
+//
+// Write/read the MCMC samples that are common among all time points
+//
+void Aeon::WriteCommonSamples(ofstream &OutFile) {
+  const unsigned int npath = mBasePathPointSamples.size();
+
+  WriteSampleVector(OutFile, mPriorSamples);
+
+  OutFile.write((const char *) &npath, sizeof(npath));
+  for (vector< vector<int> >::const_iterator
+                              ipath = mBasePathPointSamples.begin();
+                              ipath < mBasePathPointSamples.end(); ipath++)
+    WriteSampleVector(OutFile, *ipath);
+}
+
+void Aeon::ReadCommonSamples(ifstream &InFile) {
+  unsigned int npath = 0;
+  vector<float> priors;
+
+  ReadSampleVector(InFile, priors);
+  mPriorSamples.insert(mPriorSamples.end(), priors.begin(), priors.end());
+
+  InFile.read((char *) &npath, sizeof(npath));
+  for (unsigned int k = 0; k < npath; k++) {
+    mBasePathPointSamples.push_back(vector<int>());
+    ReadSampleVector(InFile, mBasePathPointSamples.back());
+  }
+}
+
 //
 // Write output files for this time point
 //
@@ -951,6 +1057,10 @@ if (0) {		// !OLD METHOD! Remove this eventually
   }
 
   MRIfree(&pdvol);
+
+  // Save convergence diagnostics, if samples were pooled from several chains
+  if (mChainSampleStart.size() > 1)
+    WriteConvergence();
 }
 
 //
@@ -1075,7 +1185,7 @@ Coffin::Coffin(const string OutDir, vector<string> InDirList,
                const int KeepSampleNth, const int UpdatePropNth,
                const string PropStdFile,
                const bool Debug) :
-               mDebug(Debug),
+               mDebug(Debug), mChain(0),
                mPriorSetLocal(LocalPriorSet), mPriorSetNear(NeighPriorSet),
                mMask(0), mRoi1(0), mRoi2(0),
                mXyzPrior0(0), mXyzPrior1(0) {
@@ -2077,7 +2187,7 @@ bool Coffin::RunMcmcSingle() {
   vector<int>::const_iterator icpt;
 
   // Open log file in first time point's output directory
-  sprintf(fname, "%s/log.txt", mOutDir.c_str());
+  sprintf(fname, "%s/%s", mOutDir.c_str(), GetLogName().c_str());
   mLog.open(fname, ios::out | ios::app);
   if (!mLog) {
     cout << "ERROR: Could not open " << fname << " for writing" << endl;
@@ -2216,7 +2326,7 @@ bool Coffin::RunMcmcSingle() {
 
   for (vector<Aeon>::const_iterator idwi = mDwi.begin() + 1; idwi < mDwi.end();
                                                              idwi++) {
-    cmdline = "cp -f " + mDwi[0].GetOutputDir() + "/log.txt " +
+    cmdline = "cp -f " + mDwi[0].GetOutputDir() + "/" + GetLogName() + " " +
               idwi->GetOutputDir();
 
     if (system(cmdline.c_str()) != 0) {
@@ -2229,6 +2339,106 @@ bool Coffin::RunMcmcSingle() {
   return true;
 }
 
+//
+// Run NumChain independent MCMC chains for the current pathway and pool
+// their samples. Chain 0 runs in this process and continues its random
+// number sequence, so a single chain gives the same result as
+// RunMcmcSingle(). Each other chain runs in a forked process with its
+// random number generators seeded from Seed + chain number, and writes
+// its samples to a temporary file that is pooled here.
+//
+bool Coffin::RunMcmcChains(int NumChain, long Seed) {
+  bool success;
+  char fname[PATH_MAX];
+  vector<pid_t> pids(NumChain, 0);
+
+  if (NumChain <= 1)
+    return RunMcmcSingle();
+
+  cout << "Running " << NumChain << " MCMC chains" << endl;
+  cout.flush();
+  fflush(stdout);
+
+  for (int ichain = 1; ichain < NumChain; ichain++) {
+    pids[ichain] = fork();
+
+    if (pids[ichain] < 0) {
+      cout << "ERROR: Could not start MCMC chain " << ichain << endl;
+      exit(1);
+    }
+
+    if (pids[ichain] == 0) {		// Child: run one chain and save it
+      mChain = ichain;
+      srand(Seed + ichain);
+      srand48(Seed + ichain);
+
+      if (!RunMcmcSingle())
+        _exit(1);
+
+      sprintf(fname, "%s/samples.chain%d.bin", mOutDir.c_str(), mChain);
+      ofstream outfile(fname, ios::out | ios::binary);
+      if (!outfile) {
+        cout << "ERROR: Could not open " << fname << " for writing" << endl;
+        _exit(1);
+      }
+
+      for (vector<Aeon>::const_iterator idwi = mDwi.begin(); idwi < mDwi.end();
+                                                             idwi++)
+        idwi->WriteSamples(outfile);
+      Aeon::WriteCommonSamples(outfile);
+
+      outfile.close();
+      _exit(outfile.fail() ? 1 : 0);
+    }
+  }
+
+  success = RunMcmcSingle();
+
+  // Pool the samples of the other chains with those of this one
+  for (int ichain = 1; ichain < NumChain; ichain++) {
+    int status = 0;
+
+    waitpid(pids[ichain], &status, 0);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      cout << "WARN: MCMC chain " << ichain << " failed" << endl;
+      continue;
+    }
+
+    sprintf(fname, "%s/samples.chain%d.bin", mOutDir.c_str(), ichain);
+    ifstream infile(fname, ios::in | ios::binary);
+    if (!infile) {
+      cout << "ERROR: Could not open " << fname << " for reading" << endl;
+      exit(1);
+    }
+
+    for (vector<Aeon>::iterator idwi = mDwi.begin(); idwi < mDwi.end(); idwi++)
+      idwi->ReadSamples(infile);
+    Aeon::ReadCommonSamples(infile);
+
+    if (infile.fail()) {
+      cout << "ERROR: Could not read samples from " << fname << endl;
+      exit(1);
+    }
+
+    infile.close();
+    remove(fname);
+    success = true;
+  }
+
+  return success && mDwi[0].GetNumSample() > 0;
+}
+
+//
+// Name of the log file of the chain run by this process
+//
+string Coffin::GetLogName() const {
+  if (mChain == 0)
+    return "log.txt";
+
+  return "log.chain" + to_string(mChain) + ".txt";
+}
+
 //
 // Initialize path and MCMC proposals
 //
@@ -3871,6 +4081,108 @@ int Aeon::FindMaxAPosterioriPath(vector< vector<int> > &PathSamples,
   return ipathmap - PathSamples.begin();
 }
 
+//
+// Gelman-Rubin potential scale reduction factor of a scalar trace that
+// consists of several chains, each starting at ChainStart[k].
+// The same number of samples, that of the shortest chain, is used from
+// the end of every chain.
+//
+static double ComputeRhat(const vector<double> &Trace,
+                          const vector<unsigned int> &ChainStart) {
+  unsigned int nchain = 0, nsamp = UINT_MAX;
+  double mean = 0, within = 0, between = 0;
+  vector<double> chainmean;
+
+  for (unsigned int k = 0; k < ChainStart.size(); k++) {
+    const unsigned int end = (k+1 < ChainStart.size()) ? ChainStart[k+1]
+                                                       : Trace.size();
+    if (end - ChainStart[k] > 1)
+      nsamp = min(nsamp, end - ChainStart[k]);
+  }
+
+  if (nsamp == UINT_MAX)
+    return numeric_limits<double>::quiet_NaN();
+
+  for (unsigned int k = 0; k < ChainStart.size(); k++) {
+    const unsigned int end = (k+1 < ChainStart.size()) ? ChainStart[k+1]
+                                                       : Trace.size();
+    double cmean = 0, cvar = 0;
+
+    if (end - ChainStart[k] < nsamp)
+      continue;
+
+    // Use the last nsamp samples of each chain
+    for (unsigned int i = end - nsamp; i < end; i++)
+      cmean += Trace[i];
+    cmean /= nsamp;
+
+    for (unsigned int i = end - nsamp; i < end; i++)
+      cvar += (Trace[i] - cmean) * (Trace[i] - cmean);
+    cvar /= (nsamp - 1);
+
+    chainmean.push_back(cmean);
+    within += cvar;
+    mean += cmean;
+    nchain++;
+  }
+
+  if (nchain < 2)
+    return numeric_limits<double>::quiet_NaN();
+
+  within /= nchain;
+  mean /= nchain;
+
+  for (vector<double>::const_iterator icm = chainmean.begin();
+                                      icm < chainmean.end(); icm++)
+    between += (*icm - mean) * (*icm - mean);
+  between *= nsamp / (nchain - 1.0);
+
+  if (within == 0)
+    return (between == 0) ? 1 : numeric_limits<double>::infinity();
+
+  return sqrt(((nsamp - 1.0) / nsamp * within + between / nsamp) / within);
+}
+
+//
+// Write R-hat convergence diagnostics of the pooled MCMC chains
+// for this time point
+//
+void Aeon::WriteConvergence() {
+  vector<double> lengths, datafit;
+  string fname = mOutDir + "/rhat.txt";
+  ofstream rhatfile(fname.c_str(), ios::out);
+
+  if (!rhatfile) {
+    cout << "ERROR: Could not open " << fname << " for writing" << endl;
+    exit(1);
+  }
+
+  // Path length of the kept samples
+  for (vector< vector<int> >::const_iterator ipath = mPathPointSamples.begin();
+                                             ipath < mPathPointSamples.end();
+                                             ipath++)
+    lengths.push_back(ipath->size() / 3);
+
+  // Data-fit term of the current path after each jump
+  for (vector<float>::const_iterator idf = mDataFitSamples.begin();
+                                     idf < mDataFitSamples.end(); idf += 2)
+    datafit.push_back(*idf);
+
+  vector<unsigned int> fitstart(mChainFitStart.size());
+  for (unsigned int k = 0; k < mChainFitStart.size(); k++)
+    fitstart[k] = mChainFitStart[k] / 2;
+
+  rhatfile << "NumChains " << mChainSampleStart.size() << endl
+           << "NumSamples";
+  for (unsigned int k = 0; k < mChainSampleStart.size(); k++)
+    rhatfile << " " << ((k+1 < mChainSampleStart.size() ?
+                         mChainSampleStart[k+1] : mPathPointSamples.size())
+                        - mChainSampleStart[k]);
+  rhatfile << endl
+           << "RhatLength " << ComputeRhat(lengths, mChainSampleStart) << endl
+           << "RhatDataFit " << ComputeRhat(datafit, fitstart) << endl;
+}
+
 //
 // Write output files for all time points
 //
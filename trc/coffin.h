@@ -72,6 +72,10 @@ class Aeon {		// One point in time
     void UpdatePath();
     void SavePathDataFit(bool IsPathAccepted);
     void SavePath();
+    void WriteSamples(std::ofstream &OutFile) const;
+    void ReadSamples(std::ifstream &InFile);
+    static void WriteCommonSamples(std::ofstream &OutFile);
+    static void ReadCommonSamples(std::ifstream &InFile);
     void WriteOutputs();
     unsigned int GetNumFZerosNew() const;
     unsigned int GetNumFZeros() const;
@@ -119,6 +123,9 @@ class Aeon {		// One point in time
                        mPathTheta, mPathThetaNew,
                        mDataFitSamples;
     std::vector< std::vector<int> > mPathPointSamples;
+    std::vector<unsigned int> mChainSampleStart,	// [number of chains]
+                              mChainFitStart;
+    BiteStore mDataStore;				// [mNumVox]
     std::vector<Bite> mData;				// [mNumVox]
     std::vector<Bite *>mDataMask;			// [mNx x mNy x mNz]
     AffineReg mBaseReg;
@@ -130,6 +137,7 @@ class Aeon {		// One point in time
                           std::vector< std::vector<int> > &PathSamples);
     int FindMaxAPosterioriPath(std::vector< std::vector<int> > &PathSamples,
                                std::vector<int> &PathLengths, MRI *PathHisto);
+    void WriteConvergence();
 };
 
 class Coffin {		// The main container
@@ -171,6 +179,7 @@ class Coffin {		// The main container
                            const string PropStdFile);
     bool RunMcmcFull();
     bool RunMcmcSingle();
+    bool RunMcmcChains(int NumChain, long Seed);
     void WriteOutputs();
 
   private:
@@ -179,6 +188,7 @@ class Coffin {		// The main container
     bool mRejectSpline, mRejectPosterior,
          mRejectF, mAcceptF, mRejectTheta, mAcceptTheta;
     const bool mDebug;
+    int mChain;
     int mNx, mNy, mNz, mNxy, mNumControl,
         mNxAtlas, mNyAtlas, mNzAtlas, mNumArc,
         mPriorSetLocal, mPriorSetNear,
@@ -217,6 +227,7 @@ class Coffin {		// The main container
     std::vector<MRI *> mAseg;
     std::vector<Aeon> mDwi;
 
+    string GetLogName() const;
     void ReadControlPoints(const string ControlPointFile);
     void ReadProposalStds(const string PropStdFile);
     bool InitializeMcmc();
@@ -66,6 +66,7 @@ const char *Progname = "dmri_paths";
 unsigned int nlab1 = 0, nlab2 = 0;
 unsigned int nTract = 1, 
              nBurnIn = 5000, nSample = 5000, nKeepSample = 10, nUpdateProp = 40,
+             nChain = 1,
              localPriorSet = 15, neighPriorSet = 14;
 float fminPath = 0;
 string dwiFile, gradFile, bvalFile, maskFile, bedpostDir,
@@ -114,8 +115,9 @@ int main(int argc, char **argv) {
 
   dump_options();
 
-  srand(6875);
-  srand48(6875);
+  const long seed = 6875;
+  srand(seed);
+  srand48(seed);
 
   if (xyzPriorFile0.empty())  doxyzprior = false;
   if (tangPriorFile.empty())  dotangprior = false;
@@ -189,7 +191,7 @@ int main(int argc, char **argv) {
     cputimer.reset();
 
     //if (mycoffin.RunMcmcFull())
-    if (mycoffin.RunMcmcSingle())
+    if (mycoffin.RunMcmcChains(nChain, seed + iout * nChain))
       mycoffin.WriteOutputs();
     else
       cout << "ERROR: Pathway reconstruction failed" << endl;
@@ -444,6 +446,11 @@ static int parse_commandline(int argc, char **argv) {
       sscanf(pargv[0],"%u",&nUpdateProp);
       nargsused = 1;
     }
+    else if (!strcmp(option, "--nchain")) {
+      if (nargc < 1) CMDargNErr(option,1);
+      sscanf(pargv[0],"%u",&nChain);
+      nargsused = 1;
+    }
     else {
       fprintf(stderr,"ERROR: Option %s unknown\n",option);
       if (CMDsingleDash(option))
@@ -542,6 +549,10 @@ static void print_usage(void) {
   << "     Keep every nk-th sample (default 10)" << endl
   << "   --nu <num>:" << endl
   << "     Update proposal every nu-th sample (default 40)" << endl
+  << "   --nchain <num>:" << endl
+  << "     Number of independent MCMC chains to run in parallel per path" << endl
+  << "     (default 1); each runs nb burn-in and ns post-burn-in samples," << endl
+  << "     the samples are pooled and R-hat is saved in rhat.txt" << endl
   << "   --sdp <file> [...]:" << endl
   << "     Text file with initial proposal standard deviations" << endl
   << "     for control point perturbations (one per path or" << endl
@@ -662,6 +673,10 @@ static void check_options(void) {
     cout << "ERROR: Must specify segmentation map file with aseg prior" << endl;
     exit(1);
   }
+  if (nChain < 1) {
+    cout << "ERROR: Number of MCMC chains must be at least 1" << endl;
+    exit(1);
+  }
   if (!stdPropFile.empty() && stdPropFile.size() != outDir.size()) {
     cout << "ERROR: Must specify as many control point proposal"
          << " standard deviation files as outputs" << endl;
@@ -798,6 +813,7 @@ static void dump_options() {
   cout << "Number of burn-in samples: " << nBurnIn << endl
        << "Number of post-burn-in samples: " << nSample << endl
        << "Keep every: " << nKeepSample << "-th sample" << endl
+       << "Number of MCMC chains: " << nChain << endl
        << "Update proposal every: " << nUpdateProp << "-th sample" << endl;
 
   if (!stdPropFile.empty()) {
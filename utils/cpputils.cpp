@@ -30,8 +30,8 @@
 #include <string>
 #include <vector>
 
-#include "MRISOBBTree.h"
 #include "MRISdistancefield.h"
+#include "mrisbvh.h"
 
 typedef Math::Point< int > Pointd;
 typedef Math::Point< float > Point_f;
@@ -55,9 +55,8 @@ MRI *MRISsignedFixedDistanceTransform(MRI_SURFACE *mris, MRI *mri_dist, double d
   distfield->SetMaxDistance(distance);
   distfield->Generate();  // mri_dist now has the distancefield
 
-  // Construct the OBB Tree
-  MRISOBBTree *OBBTree = new MRISOBBTree(mris);
-  OBBTree->ConstructTree();
+  // Construct the face hierarchy used for the inside/outside tests
+  MRISBVH *bvh = new MRISBVH(mris);
 
   std::queue< Pointd * > ptsqueue;
   // iterate through all the volume points
@@ -67,7 +66,7 @@ MRI *MRISsignedFixedDistanceTransform(MRI_SURFACE *mris, MRI *mri_dist, double d
     for (int j = 0; j < mri_dist->height; j++) {
       for (int k = 0; k < mri_dist->depth; k++) {
         if (MRIIvox(mri_visited, i, j, k)) continue;
-        int res = OBBTree->PointInclusionTest(i, j, k);
+        int res = bvh->PointInclusionTest(i, j, k);
         Pointd *pt = new Pointd;
         pt->v[0] = i;
         pt->v[1] = j;
@@ -147,14 +146,14 @@ MRI *MRISsignedFixedDistanceTransform(MRI_SURFACE *mris, MRI *mri_dist, double d
   
   MRISpopXYZ(mris,&savedXYZ);
 
-  delete OBBTree;
+  delete bvh;
   delete distfield;
   MRIfree(&mri_visited);
   return (mri_dist);
 }
 
 
-/* This uses the more accurate signed distance transform from a surface ( uses OBB Trees in turn ). It takes more time (
+/* This uses the more accurate signed distance transform from a surface ( uses MRISBVH in turn ). It takes more time (
  * around 4 to 5 minutes ) but it's very accurate. returned MRI structure (mri_out) is an MRI_INT MRI volume with voxels
  * inside having the value 1 and voxels outside with value 0.
  */
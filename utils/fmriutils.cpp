@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 double round(double x);
 #include "MRIio_old.h"
@@ -889,6 +890,293 @@ MRI *MRInormWeights(MRI *w, int sqrtFlag, int invFlag, MRI *mask, MRI *wn)
   return (wn);
 }
 
+/*---------------------------------------------------------------------
+  MRIglmThreadGLMs() - returns one GLM workspace per OpenMP thread for
+  the voxel loops of MRIglmFitAndTest(), MRIglmFit(), and MRIglmTest().
+  With one thread this is just mriglm->glm. Otherwise each thread gets
+  its own GLMcopy() of it with the contrast matrices computed. A voxel
+  is fit with the same arithmetic whichever workspace it lands in, so
+  the maps are identical to the serial ones. Free with
+  MRIglmFreeThreadGLMs(), passing for each thread the index of the last
+  voxel it loaded (-1 for none) when glm->dof is needed afterwards.
+  --------------------------------------------------------------------*/
+static GLMMAT **MRIglmThreadGLMs(MRIGLM *mriglm, int *pnthreads)
+{
+  int nthreads = 1, t;
+  GLMMAT **glms;
+
+#ifdef HAVE_OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  glms = (GLMMAT **)calloc(nthreads, sizeof(GLMMAT *));
+  if (nthreads == 1)
+    glms[0] = mriglm->glm;
+  else {
+    for (t = 0; t < nthreads; t++) {
+      glms[t] = GLMcopy(mriglm->glm);
+      GLMcMatrices(glms[t]);
+    }
+  }
+  *pnthreads = nthreads;
+  return (glms);
+}
+
+static void MRIglmFreeThreadGLMs(MRIGLM *mriglm, GLMMAT ***pglms, int nthreads, const long *lastvox)
+{
+  int t, tlast = -1;
+  GLMMAT **glms = *pglms;
+
+  // The serial loop leaves the dof of the last voxel loaded in
+  // mriglm->glm (callers read it after the fit). Take it from the copy
+  // that loaded the last voxel. It can vary by voxel with a frame mask.
+  if (lastvox != NULL) {
+    for (t = 0; t < nthreads; t++)
+      if (lastvox[t] >= 0 && (tlast < 0 || lastvox[t] > lastvox[tlast])) tlast = t;
+    if (tlast >= 0 && glms[tlast] != mriglm->glm) mriglm->glm->dof = glms[tlast]->dof;
+  }
+
+  for (t = 0; t < nthreads; t++)
+    if (glms[t] != mriglm->glm) GLMfree(&glms[t]);
+  free(glms);
+  *pglms = NULL;
+}
+
+/*---------------------------------------------------------------------
+  MRIglmBatchable() - returns 1 if every in-mask voxel of mriglm is fit
+  with the same design, so that MRIglmFitAndTestBatch() can be used: no
+  per-voxel regressors, weights, frame masks, or ffx variances, the
+  design is not ill-conditioned, and no contrast needs the per-voxel
+  partial correlation. GLMcMatrices() and GLMxMatrices() must already
+  have been run on mriglm->glm with X = Xg.
+  --------------------------------------------------------------------*/
+static int MRIglmBatchable(MRIGLM *mriglm)
+{
+  int n;
+  GLMMAT *glm = mriglm->glm;
+
+  if (mriglm->pervoxflag || mriglm->wg != NULL || mriglm->yffxvar != NULL) return (0);
+  if (glm->ill_cond_flag || glm->debug) return (0);
+  for (n = 0; n < glm->ncontrasts; n++)
+    if (glm->Dt[n] != NULL) return (0);
+  return (1);
+}
+
+// Number of voxels whose time courses are fit together
+#define GLM_BATCH_NVOX 256
+
+/*---------------------------------------------------------------------
+  MRIglmFitAndTestBatch() - the same as the voxel loop of
+  MRIglmFitAndTest() for designs shared by all voxels (see
+  MRIglmBatchable()). The in-mask voxels are gathered GLM_BATCH_NVOX at
+  a time into a frames-by-voxels matrix Y, and the fit is done with
+  matrix-matrix products against the precomputed P = inv(X'*X)*X':
+  beta = P*Y, yhat = X*beta, eres = Y - yhat, and for each contrast
+  gamma = C*beta and F = gamma'*inv(C*inv(X'*X)*C')*gamma/(J*rvar).
+  The products are accumulated in double over the voxels of a block so
+  that they vectorize, and the blocks are spread over the threads. The
+  maps agree with the voxel loop to float precision; set the environment
+  variable FS_GLM_NO_BATCH to use the voxel loop instead.
+  --------------------------------------------------------------------*/
+static int MRIglmFitAndTestBatch(MRIGLM *mriglm)
+{
+  GLMMAT *glm = mriglm->glm;
+  int nc, nr, ns, nf, nreg, ncon, n, k, f, j, jj, Jmax, c, r, s;
+  long nvox;
+  MATRIX *P, *W;
+  double *Pd, *Xd, Xcond = 0;
+  std::vector<double> Cd[GLMMAT_NCONTRASTS_MAX], Wd[GLMMAT_NCONTRASTS_MAX], g0d[GLMMAT_NCONTRASTS_MAX];
+  std::vector<double> Md[GLMMAT_NCONTRASTS_MAX];
+  int Wok[GLMMAT_NCONTRASTS_MAX];
+  std::vector<int> vc, vr, vs;
+
+  nc = mriglm->y->width;
+  nr = mriglm->y->height;
+  ns = mriglm->y->depth;
+  nf = mriglm->y->nframes;
+  nreg = glm->X->cols;
+  ncon = glm->ncontrasts;
+
+  // The in-mask voxels, in the order of the voxel loop
+  for (c = 0; c < nc; c++) {
+    for (r = 0; r < nr; r++) {
+      for (s = 0; s < ns; s++) {
+        if (mriglm->mask != NULL) {
+          int m = MRIgetVoxVal(mriglm->mask, c, r, s, 0);
+          if (m < 0.5) continue;
+        }
+        vc.push_back(c);
+        vr.push_back(r);
+        vs.push_back(s);
+      }
+    }
+  }
+  nvox = vc.size();
+
+  // Everything that does not depend on the data
+  P = MatrixMultiplyD(glm->iXtX, glm->Xt, NULL);
+  Pd = (double *)calloc(nreg * nf, sizeof(double));
+  Xd = (double *)calloc(nf * nreg, sizeof(double));
+  for (k = 0; k < nreg; k++)
+    for (f = 0; f < nf; f++) {
+      Pd[k * nf + f] = P->rptr[k + 1][f + 1];
+      Xd[f * nreg + k] = glm->X->rptr[f + 1][k + 1];
+    }
+  MatrixFree(&P);
+  if (mriglm->condsave) Xcond = MatrixConditionNumber(glm->XtX);
+
+  Jmax = 1;
+  for (n = 0; n < ncon; n++) {
+    int J = glm->C[n]->rows;
+    if (J > Jmax) Jmax = J;
+    Cd[n].resize(J * nreg);
+    for (j = 0; j < J; j++)
+      for (k = 0; k < nreg; k++) Cd[n][j * nreg + k] = glm->C[n]->rptr[j + 1][k + 1];
+    if (glm->UseGamma0[n]) {
+      g0d[n].resize(J);
+      for (j = 0; j < J; j++) g0d[n][j] = glm->gamma0[n]->rptr[j + 1][1];
+    }
+    W = MatrixInverse(glm->CiXtXCt[n], NULL);
+    Wok[n] = (W != NULL);
+    Wd[n].resize(J * J);
+    if (W) {
+      for (j = 0; j < J; j++)
+        for (jj = 0; jj < J; jj++) Wd[n][j * J + jj] = W->rptr[j + 1][jj + 1];
+      MatrixFree(&W);
+    }
+    if (glm->ypmfflag[n]) {
+      Md[n].resize(nf * nreg);
+      for (f = 0; f < nf; f++)
+        for (k = 0; k < nreg; k++) Md[n][f * nreg + k] = glm->Mpmf[n]->rptr[f + 1][k + 1];
+    }
+  }
+
+  long nblocks = (nvox + GLM_BATCH_NVOX - 1) / GLM_BATCH_NVOX;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (long b = 0; b < nblocks; b++) {
+    ROMP_PFLB_begin
+    const int B = GLM_BATCH_NVOX;
+    long v0 = b * B;
+    int nb = (int)MIN((long)B, nvox - v0), i, k, f, j, jj, n;
+    std::vector<double> Y(nf * B), beta(nreg * B, 0.0), yhat(nf * B, 0.0), rvar(B, 0.0);
+    std::vector<double> gamma(Jmax * B), pmf(nf * B);
+
+    // Gather Y, one row per frame
+    for (i = 0; i < nb; i++)
+      for (f = 0; f < nf; f++) Y[f * B + i] = MRIgetVoxVal(mriglm->y, vc[v0 + i], vr[v0 + i], vs[v0 + i], f);
+
+    // beta = P*Y
+    for (k = 0; k < nreg; k++) {
+      double *bk = &beta[k * B];
+      for (f = 0; f < nf; f++) {
+        const double pkf = Pd[k * nf + f], *yf = &Y[f * B];
+        for (i = 0; i < nb; i++) bk[i] += pkf * yf[i];
+      }
+    }
+    // yhat = X*beta; the residuals overwrite Y
+    for (f = 0; f < nf; f++) {
+      double *yh = &yhat[f * B], *yf = &Y[f * B];
+      for (k = 0; k < nreg; k++) {
+        const double xfk = Xd[f * nreg + k], *bk = &beta[k * B];
+        for (i = 0; i < nb; i++) yh[i] += xfk * bk[i];
+      }
+      for (i = 0; i < nb; i++) {
+        yf[i] -= yh[i];
+        rvar[i] += yf[i] * yf[i];
+      }
+    }
+    for (i = 0; i < nb; i++) {
+      rvar[i] /= glm->dof;
+      if (rvar[i] < FLT_MIN) rvar[i] = FLT_MIN;
+    }
+
+    // Pack the fit back into MRI
+    for (i = 0; i < nb; i++) {
+      int c = vc[v0 + i], r = vr[v0 + i], s = vs[v0 + i];
+      if (mriglm->condsave) MRIsetVoxVal(mriglm->cond, c, r, s, 0, Xcond);
+      MRIsetVoxVal(mriglm->rvar, c, r, s, 0, rvar[i]);
+      for (k = 0; k < nreg; k++) MRIsetVoxVal(mriglm->beta, c, r, s, k, beta[k * B + i]);
+      for (f = 0; f < nf; f++) MRIsetVoxVal(mriglm->eres, c, r, s, f, Y[f * B + i]);
+      if (mriglm->yhatsave)
+        for (f = 0; f < nf; f++) MRIsetVoxVal(mriglm->yhat, c, r, s, f, yhat[f * B + i]);
+    }
+
+    // Test each contrast, as in GLMtest()
+    for (n = 0; n < ncon; n++) {
+      int J = glm->C[n]->rows;
+      for (j = 0; j < J; j++) {
+        double *gj = &gamma[j * B];
+        for (i = 0; i < nb; i++) gj[i] = 0;
+        for (k = 0; k < nreg; k++) {
+          const double cjk = Cd[n][j * nreg + k], *bk = &beta[k * B];
+          for (i = 0; i < nb; i++) gj[i] += cjk * bk[i];
+        }
+        if (glm->UseGamma0[n])
+          for (i = 0; i < nb; i++) gj[i] -= g0d[n][j];
+      }
+      if (glm->ypmfflag[n]) {
+        for (f = 0; f < nf; f++) {
+          double *mf = &pmf[f * B];
+          for (i = 0; i < nb; i++) mf[i] = 0;
+          for (k = 0; k < nreg; k++) {
+            const double mfk = Md[n][f * nreg + k], *bk = &beta[k * B];
+            for (i = 0; i < nb; i++) mf[i] += mfk * bk[i];
+          }
+        }
+      }
+
+      for (i = 0; i < nb; i++) {
+        int c = vc[v0 + i], r = vr[v0 + i], s = vs[v0 + i];
+        double dtmp, F = 0, p = 1, z = 0, sig;
+        if (rvar[i] < 2 * FLT_MIN)
+          dtmp = 1e10 * J;
+        else
+          dtmp = rvar[i] * J;
+
+        if (Wok[n] && rvar[i] > FLT_MIN) {
+          for (j = 0; j < J; j++)
+            for (jj = 0; jj < J; jj++) F += gamma[j * B + i] * Wd[n][j * J + jj] * gamma[jj * B + i];
+          F /= dtmp;
+          if (F >= 0) {
+            p = sc_cdf_fdist_Q(F, J, glm->dof);
+            z = sc_cdf_gaussian_Qinv(p / 2.0, 1);
+          }
+          else {
+            F = 0;
+            p = 1;
+            z = 0;
+          }
+          if (J == 1 && gamma[i] < 0) z *= -1;
+        }
+
+        for (j = 0; j < J; j++) MRIsetVoxVal(mriglm->gamma[n], c, r, s, j, gamma[j * B + i]);
+        if (J == 1) MRIsetVoxVal(mriglm->gammaVar[n], c, r, s, 0, glm->CiXtXCt[n]->rptr[1][1] * dtmp);
+        MRIsetVoxVal(mriglm->F[n], c, r, s, 0, F);
+        MRIsetVoxVal(mriglm->z[n], c, r, s, 0, z);
+        MRIsetVoxVal(mriglm->p[n], c, r, s, 0, p);
+        if (J == 1 && glm->DoPCC) MRIsetVoxVal(mriglm->pcc[n], c, r, s, 0, 0);
+        if (p == 0)
+          MRIsetVoxVal(mriglm->sig[n], c, r, s, 0, 10e10);
+        else {
+          sig = -log10(p);
+          if (J == 1) sig *= SIGN(gamma[i]);
+          MRIsetVoxVal(mriglm->sig[n], c, r, s, 0, sig);
+        }
+        if (glm->ypmfflag[n])
+          for (f = 0; f < nf; f++) MRIsetVoxVal(mriglm->ypmf[n], c, r, s, f, pmf[f * B + i]);
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  free(Pd);
+  free(Xd);
+  return (0);
+}
+
 /*---------------------------------------------------------------------
   MRIglmFitAndTest() - fits and tests glm on a voxel-by-voxel basis.
   There are also two other related functions, MRIglmFit() and
@@ -981,13 +1269,28 @@ int MRIglmFitAndTest(MRIGLM *mriglm)
   mriglm->n_ill_cond = 0;
   long n_ill_cond = 0;
 
-  // Parallel does not work yet because need separate glm for each thread
-  //#ifdef HAVE_OPENMP
-  //#pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : n_ill_cond)
-  //#endif
+  // Same design at every voxel: fit all of them with matrix-matrix products.
+  // Setting FS_GLM_NO_BATCH forces the voxel loop below.
+  if (MRIglmBatchable(mriglm) && getenv("FS_GLM_NO_BATCH") == NULL) return (MRIglmFitAndTestBatch(mriglm));
+
+  // Each thread fits and tests its voxels in its own copy of the glm
+  int nthreads;
+  GLMMAT **glms = MRIglmThreadGLMs(mriglm, &nthreads);
+  std::vector<long> lastvox(nthreads, -1);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : n_ill_cond)
+#endif
   for (c = 0; c < nc; c++) {
+    ROMP_PFLB_begin
     int r,s,nthvox=0,m,n,pctdone=0;
     double Xcond;
+    int tid = 0;
+#ifdef HAVE_OPENMP
+    tid = omp_get_thread_num();
+#endif
+    GLMMAT *glm = glms[tid];
     for (r = 0; r < nr; r++) {
       for (s = 0; s < ns; s++) {
         nthvox++;
@@ -1009,11 +1312,12 @@ int MRIglmFitAndTest(MRIGLM *mriglm)
         }
 
         // Get data from mri and put in GLM
-        MRIglmLoadVox(mriglm, c, r, s, 0, NULL);
+        MRIglmLoadVox(mriglm, c, r, s, 0, glm);
 
         // Compute intermediate matrices
-	if(mriglm->pervoxflag) GLMcMatrices(mriglm->glm);
+	if(mriglm->pervoxflag) GLMcMatrices(glm);
         GLMxMatrices(glm); // why have to be done if not pervox?
+        lastvox[tid] = ((long)c * nr + r) * ns + s;
 
         // Compute condition
         if (mriglm->condsave) {
@@ -1058,7 +1362,11 @@ int MRIglmFitAndTest(MRIGLM *mriglm)
         }
       }
     }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
+  MRIglmFreeThreadGLMs(mriglm, &glms, nthreads, lastvox.data());
+
   if (Gdiag_no > 0) printf("\n");
   mriglm->n_ill_cond = n_ill_cond;
   // printf("n_ill_cond = %d\n",mriglm->n_ill_cond);
@@ -1071,9 +1379,8 @@ int MRIglmFitAndTest(MRIGLM *mriglm)
   --------------------------------------------------------------------*/
 int MRIglmFit(MRIGLM *mriglm)
 {
-  int c, r, s, nc, nr, ns, nf, pctdone;
-  float m, Xcond;
-  long nvoxtot, nthvox;
+  int c, nc, nr, ns, nf;
+  long nvoxtot;
 
   nc = mriglm->y->width;
   nr = mriglm->y->height;
@@ -1118,10 +1425,28 @@ int MRIglmFit(MRIGLM *mriglm)
   }
 
   //--------------------------------------------
-  pctdone = 0;
-  nthvox = 0;
   mriglm->n_ill_cond = 0;
+  long n_ill_cond = 0;
+
+  // Each thread fits its voxels in its own copy of the glm
+  int nthreads;
+  GLMMAT **glms = MRIglmThreadGLMs(mriglm, &nthreads);
+  std::vector<long> lastvox(nthreads, -1);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : n_ill_cond)
+#endif
   for (c = 0; c < nc; c++) {
+    ROMP_PFLB_begin
+    int r, s, pctdone = 0;
+    long nthvox = 0;
+    float m, Xcond;
+    int tid = 0;
+#ifdef HAVE_OPENMP
+    tid = omp_get_thread_num();
+#endif
+    GLMMAT *glm = glms[tid];
     for (r = 0; r < nr; r++) {
       for (s = 0; s < ns; s++) {
         nthvox++;
@@ -1139,34 +1464,39 @@ int MRIglmFit(MRIGLM *mriglm)
         }
 
         // Get data from mri and put in GLM
-        MRIglmLoadVox(mriglm, c, r, s, 0, NULL);
+        MRIglmLoadVox(mriglm, c, r, s, 0, glm);
 
         // Compute intermediate matrices
-	if(mriglm->pervoxflag) GLMcMatrices(mriglm->glm);
-        GLMxMatrices(mriglm->glm);
+	if(mriglm->pervoxflag) GLMcMatrices(glm);
+        GLMxMatrices(glm);
+        lastvox[tid] = ((long)c * nr + r) * ns + s;
 
         // Compute condition
         if (mriglm->condsave) {
-          Xcond = MatrixConditionNumber(mriglm->glm->XtX);
+          Xcond = MatrixConditionNumber(glm->XtX);
           MRIsetVoxVal(mriglm->cond, c, r, s, 0, Xcond);
         }
 
         // Test condition
-        if (mriglm->glm->ill_cond_flag) {
-          mriglm->n_ill_cond++;
+        if (glm->ill_cond_flag) {
+          n_ill_cond++;
           continue;
         }
 
-        GLMfit(mriglm->glm);
+        GLMfit(glm);
 
         // Pack data back into MRI
-        MRIsetVoxVal(mriglm->rvar, c, r, s, 0, mriglm->glm->rvar);
-        MRIfromMatrix(mriglm->beta, c, r, s, mriglm->glm->beta, NULL);
-        MRIfromMatrix(mriglm->eres, c, r, s, mriglm->glm->eres, mriglm->FrameMask);
-        if (mriglm->yhatsave) MRIfromMatrix(mriglm->yhat, c, r, s, mriglm->glm->yhat, mriglm->FrameMask);
+        MRIsetVoxVal(mriglm->rvar, c, r, s, 0, glm->rvar);
+        MRIfromMatrix(mriglm->beta, c, r, s, glm->beta, NULL);
+        MRIfromMatrix(mriglm->eres, c, r, s, glm->eres, mriglm->FrameMask);
+        if (mriglm->yhatsave) MRIfromMatrix(mriglm->yhat, c, r, s, glm->yhat, mriglm->FrameMask);
       }
     }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
+  MRIglmFreeThreadGLMs(mriglm, &glms, nthreads, lastvox.data());
+  mriglm->n_ill_cond = n_ill_cond;
   printf("\n");
 
   // printf("n_ill_cond = %d\n",mriglm->n_ill_cond);
@@ -1179,9 +1509,8 @@ int MRIglmFit(MRIGLM *mriglm)
   --------------------------------------------------------------------*/
 int MRIglmTest(MRIGLM *mriglm)
 {
-  int c, r, s, n, nc, nr, ns, nf, pctdone;
-  float m;
-  long nvoxtot, nthvox;
+  int c, n, nc, nr, ns, nf;
+  long nvoxtot;
 
   if (mriglm->glm->ncontrasts == 0) return (0);
 
@@ -1218,9 +1547,25 @@ int MRIglmTest(MRIGLM *mriglm)
   }
 
   //--------------------------------------------
-  pctdone = 0;
-  nthvox = 0;
+  // Each thread tests its voxels in its own copy of the glm, which
+  // carries the fitted beta and rvar of the voxel in hand
+  int nthreads;
+  GLMMAT **glms = MRIglmThreadGLMs(mriglm, &nthreads);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (c = 0; c < nc; c++) {
+    ROMP_PFLB_begin
+    int r, s, n, pctdone = 0;
+    long nthvox = 0;
+    float m;
+    int tid = 0;
+#ifdef HAVE_OPENMP
+    tid = omp_get_thread_num();
+#endif
+    GLMMAT *glm = glms[tid];
     for (r = 0; r < nr; r++) {
       for (s = 0; s < ns; s++) {
         nthvox++;
@@ -1238,33 +1583,36 @@ int MRIglmTest(MRIGLM *mriglm)
         }
 
         // Get data from mri and put in GLM
-        MRIglmLoadVox(mriglm, c, r, s, 1, NULL);
+        MRIglmLoadVox(mriglm, c, r, s, 1, glm);
 
         // Compute intermediate matrices
-        GLMxMatrices(mriglm->glm);
+        GLMxMatrices(glm);
 
         // Test
         if (mriglm->yffxvar == NULL)
-          GLMtest(mriglm->glm);
+          GLMtest(glm);
         else
-          GLMtestFFx(mriglm->glm);
+          GLMtestFFx(glm);
 
         // Pack data back into MRI
-        for (n = 0; n < mriglm->glm->ncontrasts; n++) {
-          MRIfromMatrix(mriglm->gamma[n], c, r, s, mriglm->glm->gamma[n], NULL);
-          if (mriglm->glm->C[n]->rows == 1) {
-            MRIsetVoxVal(mriglm->gammaVar[n], c, r, s, 0, mriglm->glm->gCVM[n]->rptr[1][1]);
-            if (mriglm->glm->DoPCC) MRIsetVoxVal(mriglm->pcc[n], c, r, s, 0, mriglm->glm->pcc[n]);
+        for (n = 0; n < glm->ncontrasts; n++) {
+          MRIfromMatrix(mriglm->gamma[n], c, r, s, glm->gamma[n], NULL);
+          if (glm->C[n]->rows == 1) {
+            MRIsetVoxVal(mriglm->gammaVar[n], c, r, s, 0, glm->gCVM[n]->rptr[1][1]);
+            if (glm->DoPCC) MRIsetVoxVal(mriglm->pcc[n], c, r, s, 0, glm->pcc[n]);
           }
-          MRIsetVoxVal(mriglm->F[n], c, r, s, 0, mriglm->glm->F[n]);
-          MRIsetVoxVal(mriglm->p[n], c, r, s, 0, mriglm->glm->p[n]);
-          MRIsetVoxVal(mriglm->z[n], c, r, s, 0, mriglm->glm->z[n]);
-          if (mriglm->glm->ypmfflag[n])
-            MRIfromMatrix(mriglm->ypmf[n], c, r, s, mriglm->glm->ypmf[n], mriglm->FrameMask);
+          MRIsetVoxVal(mriglm->F[n], c, r, s, 0, glm->F[n]);
+          MRIsetVoxVal(mriglm->p[n], c, r, s, 0, glm->p[n]);
+          MRIsetVoxVal(mriglm->z[n], c, r, s, 0, glm->z[n]);
+          if (glm->ypmfflag[n])
+            MRIfromMatrix(mriglm->ypmf[n], c, r, s, glm->ypmf[n], mriglm->FrameMask);
         }
       }
     }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
+  MRIglmFreeThreadGLMs(mriglm, &glms, nthreads, NULL);
   printf("\n");
 
   // printf("n_ill_cond = %d\n",mriglm->n_ill_cond);
@@ -1280,10 +1628,13 @@ int MRIglmTest(MRIGLM *mriglm)
    -------------------------------------------------------------------------*/
 int MRIglmLoadVox(MRIGLM *mriglm, int c, int r, int s, int LoadBeta, GLMMAT *glm)
 {
-  int f, n, nthreg, nthf, nf;
+  int f, n, nthreg, nthf, nf, XgLoaded;
   double v;
-  static int nfprev = -1;
   if(glm == NULL) glm = mriglm->glm;
+  // Only mriglm->glm keeps track of whether Xg is in its X. The per-thread
+  // copies used by the voxel loops reload it each time, so that they never
+  // write the shared flag.
+  XgLoaded = (glm == mriglm->glm && mriglm->XgLoaded);
 
   nf = mriglm->y->nframes;
   // Count the number of frames in frame mask
@@ -1293,15 +1644,14 @@ int MRIglmLoadVox(MRIGLM *mriglm, int c, int r, int s, int LoadBeta, GLMMAT *glm
       if (MRIgetVoxVal(mriglm->FrameMask, c, r, s, f - 1) > 0.5) nf++;
     if (nf == 0) printf("MRIglmLoadVox(): %d,%d,%d nf=0\n", c, r, s);
     // Free matrices if needed
-    if (glm->X != NULL && nfprev != nf) MatrixFree(&(glm->X));
-    if (glm->y != NULL && nfprev != nf) MatrixFree(&(glm->y));
-    nfprev = nf;
+    if (glm->X != NULL && glm->X->rows != nf) MatrixFree(&(glm->X));
+    if (glm->y != NULL && glm->y->rows != nf) MatrixFree(&(glm->y));
   }
 
   // Alloc matrices if needed
   if (glm->X == NULL) {
-    mriglm->nregtot = mriglm->Xg->cols + mriglm->npvr;
-    glm->X = MatrixAlloc(nf, mriglm->nregtot, MATRIX_REAL);
+    if (glm == mriglm->glm) mriglm->nregtot = mriglm->Xg->cols + mriglm->npvr;
+    glm->X = MatrixAlloc(nf, mriglm->Xg->cols + mriglm->npvr, MATRIX_REAL);
   }
   if (glm->y == NULL) glm->y = MatrixAlloc(nf, 1, MATRIX_REAL);
 
@@ -1318,7 +1668,7 @@ int MRIglmLoadVox(MRIGLM *mriglm, int c, int r, int s, int LoadBeta, GLMMAT *glm
     // For wg, this is a little bit of a hack. wg needs to be applied to Xg only once,
     // but it will get applied again and again. Including wg here forces Xg to be
     // freshly copied into X each time, then wg is applied.
-    if (mriglm->w != NULL || mriglm->wg != NULL || !mriglm->XgLoaded || mriglm->FrameMask) {
+    if (mriglm->w != NULL || mriglm->wg != NULL || !XgLoaded || mriglm->FrameMask) {
       nthreg = 1;
       for (n = 1; n <= mriglm->Xg->cols; n++) {
         glm->X->rptr[nthf][nthreg] = mriglm->Xg->rptr[f][n];  // X=Xg
@@ -1334,7 +1684,7 @@ int MRIglmLoadVox(MRIGLM *mriglm, int c, int r, int s, int LoadBeta, GLMMAT *glm
       nthreg++;
     }
   }
-  mriglm->XgLoaded = 1;  // Set flag that Xg has been loaded, can cause probs with pvr sim
+  if (glm == mriglm->glm) mriglm->XgLoaded = 1;  // Set flag that Xg has been loaded, can cause probs with pvr sim
 
   // Weight X and y, X = w.*X, y = w.*y
   if ((mriglm->w != NULL || mriglm->wg != NULL) && !mriglm->skipweight) {
@@ -1365,6 +1715,7 @@ int MRIglmLoadVox(MRIGLM *mriglm, int c, int r, int s, int LoadBeta, GLMMAT *glm
 
   // Beta
   if (LoadBeta) {
+    if (glm->beta == NULL) glm->beta = MatrixAlloc(glm->X->cols, 1, MATRIX_REAL);
     for (f = 1; f <= glm->X->cols; f++) {
       v = MRIgetVoxVal(mriglm->beta, c, r, s, f - 1);
       glm->beta->rptr[f][1] = v;
@@ -304,6 +304,7 @@ int GLMfree(GLMMAT **pglm)
   if (glm->Xty) MatrixFree(&glm->Xty);
 
   if (glm->yffxvar) MatrixFree(&glm->yffxvar);
+  if (glm->Fmat) MatrixFree(&glm->Fmat);
 
   for (n = 0; n < GLMMAT_NCONTRASTS_MAX; n++) {
     if (glm->C[n]) MatrixFree(&glm->C[n]);
@@ -337,6 +338,44 @@ int GLMfree(GLMMAT **pglm)
   return (0);
 }
 
+/*---------------------------------------------------------------------
+  GLMcopy() - allocates a new GLM with the same configuration as src
+  (contrasts, gamma0, PMF and PCC flags, X rescaling, DOF handling) and
+  copies of its X, y, yffxvar, and beta, so that it can be used as the
+  workspace of another thread. The intermediate matrices are not
+  copied; run GLMcMatrices() and GLMxMatrices() on it as on src. The
+  contrast names are not copied.
+  ------------------------------------------------------------------*/
+GLMMAT *GLMcopy(GLMMAT *src)
+{
+  int n;
+  GLMMAT *glm;
+
+  glm = GLMalloc();
+  glm->AllowZeroDOF = src->AllowZeroDOF;
+  glm->ReScaleX = src->ReScaleX;
+  glm->DoPCC = src->DoPCC;
+  glm->ffxdof = src->ffxdof;
+  glm->dof = src->dof;
+  glm->debug = src->debug;
+
+  if (src->X) glm->X = MatrixCopy(src->X, NULL);
+  if (src->y) glm->y = MatrixCopy(src->y, NULL);
+  if (src->yffxvar) glm->yffxvar = MatrixCopy(src->yffxvar, NULL);
+  if (src->beta) glm->beta = MatrixCopy(src->beta, NULL);
+  glm->rvar = src->rvar;
+
+  glm->ncontrasts = src->ncontrasts;
+  for (n = 0; n < src->ncontrasts; n++) {
+    glm->C[n] = MatrixCopy(src->C[n], NULL);
+    glm->UseGamma0[n] = src->UseGamma0[n];
+    if (src->gamma0[n]) glm->gamma0[n] = MatrixCopy(src->gamma0[n], NULL);
+    glm->ypmfflag[n] = src->ypmfflag[n];
+    if (src->Dt[n]) glm->Dt[n] = MatrixCopy(src->Dt[n], NULL);
+  }
+  return (glm);
+}
+
 /*-----------------------------------------------------------------
   GLMcMatrices() - given all the C's computes all the Ct's.  Also
   computes condition number of each C as well as it's PMF.  This
@@ -494,6 +533,16 @@ int GLMfit(GLMMAT *glm)
   return (0);
 }
 
+/*------------------------------------------------------------------------
+  GLMzRFS() - standard normal field used by GLMtest() to turn p into z
+  ------------------------------------------------------------------------*/
+static RFS *GLMzRFS(void)
+{
+  RFS *rfs = RFspecInit(0, NULL);
+  rfs->name = strcpyalloc("z");
+  return (rfs);
+}
+
 /*------------------------------------------------------------------------
   GLMtest() - tests all the contrasts for the given GLM. Must have already
   run GLMcMatrices(), GLMxMatrices(), and GLMfit(). See also GLMtestFFX().
@@ -502,13 +551,9 @@ int GLMtest(GLMMAT *glm)
 {
   int n;
   double dtmp;
-  static MATRIX *F = NULL, *mtmp = NULL;
-  static RFS *rfs = NULL;
-
-  if (rfs == NULL) {
-    rfs = RFspecInit(0, NULL);
-    rfs->name = strcpyalloc("z");
-  }
+  MATRIX *mtmp = NULL;
+  // Initialized once, even when GLMtest() is called from several threads
+  static RFS *rfs = GLMzRFS();
 
   if (glm->ill_cond_flag) {
     // If it's ill cond, just return F=0
@@ -547,7 +592,8 @@ int GLMtest(GLMMAT *glm)
     if (mtmp != NULL && glm->rvar > FLT_MIN) {
       glm->igCVM[n] = MatrixScalarMul(glm->igCVM[n], 1.0 / dtmp, glm->igCVM[n]);
       glm->gtigCVM[n] = MatrixMultiplyD(glm->gammat[n], glm->igCVM[n], glm->gtigCVM[n]);
-      F = MatrixMultiplyD(glm->gtigCVM[n], glm->gamma[n], F);
+      glm->Fmat = MatrixMultiplyD(glm->gtigCVM[n], glm->gamma[n], glm->Fmat);
+      MATRIX *F = glm->Fmat;
       if(glm->debug){
 	printf("g=%10.8f F=%6.4f  gtig %6.4f\n",glm->gamma[n]->rptr[1][1],F->rptr[1][1],glm->gtigCVM[n]->rptr[1][1]);
       }
@@ -601,7 +647,7 @@ int GLMtestFFx(GLMMAT *glm)
 {
   double val;
   int n, r, c;
-  static MATRIX *F = NULL, *mtmp = NULL;
+  MATRIX *mtmp = NULL;
   MATRIX *Xs = NULL, *Xst = NULL, *CiXtXXs = NULL, *CiXtXXst = NULL;
 
   if (glm->ill_cond_flag) {
@@ -633,8 +679,8 @@ int GLMtestFFx(GLMMAT *glm)
     mtmp = MatrixInverse(glm->gCVM[n], glm->igCVM[n]);
     if (mtmp != NULL) {
       glm->gtigCVM[n] = MatrixMultiplyD(glm->gammat[n], glm->igCVM[n], glm->gtigCVM[n]);
-      F = MatrixMultiplyD(glm->gtigCVM[n], glm->gamma[n], F);
-      glm->F[n] = F->rptr[1][1];
+      glm->Fmat = MatrixMultiplyD(glm->gtigCVM[n], glm->gamma[n], glm->Fmat);
+      glm->F[n] = glm->Fmat->rptr[1][1];
       glm->p[n] = sc_cdf_fdist_Q(glm->F[n], glm->C[n]->rows, glm->ffxdof);
       glm->igCVM[n] = mtmp;
     }
@@ -1609,6 +1609,13 @@ int GCAfree(GCA **pgca)
   gca = *pgca;
   *pgca = NULL;
 
+  if (gca->pack) {
+    GCAfreePack(gca);
+    GCAcleanup(gca);
+    free(gca);
+    return (NO_ERROR);
+  }
+
   for (x = 0; x < gca->node_width; x++) {
     for (y = 0; y < gca->node_height; y++) {
       for (z = 0; z < gca->node_depth; z++) {
@@ -2076,6 +2083,9 @@ int GCAwrite(GCA *gca, const char *fname)
   GC1D *gc;
   int gzipped = 0;
 
+  if (strstr(fname, ".gcp")) {
+    return (GCAwritePacked(gca, fname));
+  }
   if (strstr(fname, ".gcz")) {
     gzipped = 1;
   }
@@ -2230,6 +2240,9 @@ GCA *GCAread(const char *fname)
   int gzipped = 0;
   int tempZNZ;
 
+  if (GCAisPackedFile(fname)) {
+    return (GCAreadPacked(fname));
+  }
   if (strstr(fname, ".gcz")) {
     gzipped = 1;
   }
@@ -2667,6 +2680,7 @@ static int GCAupdatePrior(GCA *gca, MRI *mri, int xn, int yn, int zn, int label)
     DiagBreak();
   }
 
+  GCAunpack(gca);  // the prior arrays may have to grow
   gcap = &gca->priors[xn][yn][zn];
   if (gcap == NULL) {
     return -1;
@@ -2785,6 +2799,8 @@ static int GCAupdateNode(GCA *gca, MRI *mri, int xn, int yn, int zn, float *vals
     DiagBreak();
   }
 
+  GCAunpack(gca);  // the node arrays may have to grow
+
   // if non-zero label and gca_prune is there
   if (label > 0 && gca_prune != NULL && !noint) {
     GCA_NODE *gcan_prune;
@@ -5953,6 +5969,7 @@ static int GCAupdateNodeGibbsPriors(GCA *gca, MRI *mri, int xn, int yn, int zn,
   GCA_NODE *gcan;
   GC1D *gc;
 
+  GCAunpack(gca);  // the gibbs arrays may have to grow
   gcan = &gca->nodes[xn][yn][zn];
 
   // look for this label
@@ -12705,6 +12722,7 @@ int GCAfreeGibbs(GCA *gca)
   if (gca->flags & GCA_NO_MRF) {
     return (NO_ERROR); /* already done */
   }
+  GCAunpack(gca);
 
   for (x = 0; x < gca->node_width; x++) {
     for (y = 0; y < gca->node_height; y++) {
@@ -18465,6 +18483,10 @@ GCA *GCAcompactify(GCA *gca)
   int i, j, k;
   double byteSaved = 0.;
 
+  if (gca->pack) {
+    return gca;  // packed arrays are already exactly nlabels long
+  }
+
   width = gca->prior_width;
   height = gca->prior_height;
   depth = gca->prior_depth;
@@ -21957,6 +21979,7 @@ int GCAinsertLabels(GCA *gca,
   GCA_NODE *gcan;
   GCA_PRIOR *gcap;
 
+  GCAunpack(gca);
   for (l = 0; l < ninsertions; l++) {
     whalf = insert_whalf[l];
     label = insert_labels[l];
@@ -22923,6 +22946,7 @@ void GCAinitLabelsFromMRI(GCA *gca, MRI *mri_labels)
   if (gca->width != mri_labels->width || gca->height != mri_labels->height || gca->depth != mri_labels->depth)
     ErrorExit(ERROR_BADPARM, "GCAinitLabelsFromMRI: GCA and MRI must have same dimensions");
 
+  GCAunpack(gca);
   for (x = 0; x < gca->width; x++)
     for (y = 0; y < gca->height; y++)
       for (z = 0; z < gca->depth; z++) {
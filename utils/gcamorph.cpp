@@ -1330,6 +1330,19 @@ GCA_MORPH *GCAMalloc(const int width, const int height, const int depth)
   gcam->spacing = 1; // may be changed by the user later; must be an int
   gcam->type = GCAM_VOX;
 
+  // one block for all nodes (and one for their cold halves) so that the
+  // x/y/z sweeps stream through memory instead of hopping between rows
+  size_t nnodes = (size_t)width * height * depth;
+  GCA_MORPH_NODE *buf = (GCA_MORPH_NODE *)calloc(nnodes, sizeof(GCA_MORPH_NODE));
+  gcam->cold_nodes = (GMN_COLD *)calloc(nnodes, sizeof(GMN_COLD));
+  if (!buf || !gcam->cold_nodes)
+    ErrorExit(ERROR_NOMEMORY,
+              "GCAMalloc(%d, %d, %d): could not allocate %zu nodes",
+              width,
+              height,
+              depth,
+              nnodes);
+
   gcam->nodes = (GCA_MORPH_NODE ***)calloc(width, sizeof(GCA_MORPH_NODE **));
   if (!gcam->nodes) {
     ErrorExit(ERROR_NOMEMORY, "GCAMalloc: could not allocate nodes");
@@ -1341,29 +1354,8 @@ GCA_MORPH *GCAMalloc(const int width, const int height, const int depth)
       ErrorExit(ERROR_NOMEMORY, "GCAMalloc: could not allocate %dth **", x);
     }
 
-#define ELECTRIC_FENCE 0
-#if ELECTRIC_FENCE
-    {
-      GCA_MORPH_NODE *buf;
-
-      buf = (GCA_MORPH_NODE *)calloc(gcam->depth * gcam->height, sizeof(GCA_MORPH_NODE));
-      if (buf == NULL)
-        ErrorExit(ERROR_NO_MEMORY,
-                  "GCAMalloc(%d, %d, %d): could not allocate "
-                  "%d bytes for %dth bslice\n",
-                  height,
-                  width,
-                  depth,
-                  (gcam->depth * gcam->height * sizeof(GCA_MORPH_NODE)),
-                  x);
-      for (y = 0; y < gcam->height; y++) {
-        gcam->nodes[x][y] = buf + (y * gcam->depth);
-      }
-    }
-#else
     for (y = 0; y < gcam->height; y++) {
-      gcam->nodes[x][y] = (GCA_MORPH_NODE *)calloc(gcam->depth, sizeof(GCA_MORPH_NODE));
-      if (!gcam->nodes[x][y]) ErrorExit(ERROR_NOMEMORY, "GCAMalloc: could not allocate %d,%dth *", x, y);
+      gcam->nodes[x][y] = buf + ((size_t)x * gcam->height + y) * gcam->depth;
       for (z = 0; z < gcam->depth; z++) {
         gcam->nodes[x][y][z].origx = x;
         gcam->nodes[x][y][z].origy = y;
@@ -1373,7 +1365,6 @@ GCA_MORPH *GCAMalloc(const int width, const int height, const int depth)
         gcam->nodes[x][y][z].z = z;
       }
     }
-#endif
   }
   initVolGeom(&gcam->image);
   initVolGeom(&gcam->atlas);
@@ -1711,11 +1702,12 @@ int GCAMfreeContents(GCA_MORPH *gcam)
           free_gcs(gcamn->gc, 1, gcam->ninputs);
         }
       }
-      free(gcam->nodes[x][y]);
     }
-    free(gcam->nodes[x]);
   }
+  if (gcam->width > 0 && gcam->height > 0) free(gcam->nodes[0][0]);
+  for (x = 0; x < gcam->width; x++) free(gcam->nodes[x]);
   free(gcam->nodes);
+  free(gcam->cold_nodes);
   return (NO_ERROR);
 }
 
@@ -3037,6 +3029,7 @@ int gcamVolumeChangeTermAtNode(
     GCA_MORPH *gcam, MRI *mri, double l_area, int i, int j, int k, double *pdx, double *pdy, double *pdz)
 {
   GCA_MORPH_NODE *gcamn, *gcamni, *gcamnj, *gcamnk;
+  GMN_COLD *gcamnc;
   float delta, total_delta = 0;
   int n, width = 0, height = 0, depth = 0, num, invert;
   static VECTOR *v_i = NULL, *v_j, *v_k, *v_j_x_k, *v_i_x_j, *v_k_x_i, *v_grad, *v_tmp;
@@ -3152,9 +3145,10 @@ int gcamVolumeChangeTermAtNode(
     //
     if (gcamn->invalid == GCAM_POSITION_INVALID || gcamni->invalid == GCAM_POSITION_INVALID ||
         gcamnj->invalid == GCAM_POSITION_INVALID || gcamnk->invalid == GCAM_POSITION_INVALID || gcamn->gc == NULL ||
-        DZERO(gcamn->sum_ci_vi_ui)) {
+        DZERO(GCAMcold(gcam, gcamn)->sum_ci_vi_ui)) {
       continue;
     }
+    gcamnc = GCAMcold(gcam, gcamn);
 
     num++;
 
@@ -3165,9 +3159,9 @@ int gcamVolumeChangeTermAtNode(
   well, otherwise it dominates the gradient.
 */
     del_v_scale =
-        (uk * (gcamn->sum_ci_vi - gcamn->area) - gcamn->sum_ci_vi_ui) / (gcamn->sum_ci_vi_ui * gcamn->sum_ci_vi_ui);
+        (uk * (gcamnc->sum_ci_vi - gcamn->area) - gcamnc->sum_ci_vi_ui) / (gcamnc->sum_ci_vi_ui * gcamnc->sum_ci_vi_ui);
     MRIsampleVolumeFrameType(mri, gcamn->x, gcamn->y, gcamn->z, 0, SAMPLE_TRILINEAR, &image_val);
-    error = image_val - gcamn->predicted_val;
+    error = image_val - gcamnc->predicted_val;
     del_v_scale *= error;
 
     /* compute cross products and area delta */
@@ -5915,9 +5909,9 @@ int gcamLimitGradientMagnitude(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms, MRI *mri
         }
 
         // dt*length of gradient
-        dx = (gcamn->dx + gcamn->jx);
-        dy = (gcamn->dy + gcamn->jy);
-        dz = (gcamn->dz + gcamn->jz);
+        dx = (gcamn->dx + GCAMcold(gcam, gcamn)->jx);
+        dy = (gcamn->dy + GCAMcold(gcam, gcamn)->jy);
+        dz = (gcamn->dz + GCAMcold(gcam, gcamn)->jz);
         norm = sqrt(dx * dx + dy * dy + dz * dz);
         // get max norm and its position
         if (norm > max_norm) {
@@ -5973,7 +5967,7 @@ int gcamLimitGradientMagnitude(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms, MRI *mri
         if (frame >= 0)
           MRIsampleVolumeFrameType(parms->mri_dist_map, gcamn->x, gcamn->y, gcamn->z, frame, SAMPLE_TRILINEAR, &dist);
 
-        printf("dist:target = %2.2f:%2.2f ", dist, gcamn->target_dist);
+        printf("dist:target = %2.2f:%2.2f ", dist, GCAMcold(gcam, gcamn)->target_dist);
       }
       else {
         printf("vals(means) = ");
@@ -9362,6 +9356,7 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
 {
   int x, y, z;
   GCA_MORPH_NODE *gcamn;
+  GMN_COLD *gcamnc;
 
   for (x = 0; x < gcam->width; x++)
     for (y = 0; y < gcam->height; y++)
@@ -9370,6 +9365,7 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
           DiagBreak();
         }
         gcamn = &gcam->nodes[x][y][z];
+        gcamnc = GCAMcold(gcam, gcamn);
 
         switch (from) {
           default:
@@ -9379,9 +9375,9 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
               default:
                 ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "GCAMcopyNodePositions: unsupported to %d", to));
               case SAVED_ORIGINAL_POSITIONS:
-                gcamn->saved_origx = gcamn->origx;
-                gcamn->saved_origy = gcamn->origy;
-                gcamn->saved_origz = gcamn->origz;
+                gcamnc->saved_origx = gcamn->origx;
+                gcamnc->saved_origy = gcamn->origy;
+                gcamnc->saved_origz = gcamn->origz;
                 break;
               case SAVED_POSITIONS:
                 gcamn->xs = gcamn->origx;
@@ -9401,19 +9397,19 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
               default:
                 ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "GCAMcopyNodePositions: unsupported to %d", to));
               case SAVED_POSITIONS:
-                gcamn->xs = gcamn->saved_origx;
-                gcamn->ys = gcamn->saved_origy;
-                gcamn->zs = gcamn->saved_origz;
+                gcamn->xs = gcamnc->saved_origx;
+                gcamn->ys = gcamnc->saved_origy;
+                gcamn->zs = gcamnc->saved_origz;
                 break;
               case CURRENT_POSITIONS:
-                gcamn->x = gcamn->saved_origx;
-                gcamn->y = gcamn->saved_origy;
-                gcamn->z = gcamn->saved_origz;
+                gcamn->x = gcamnc->saved_origx;
+                gcamn->y = gcamnc->saved_origy;
+                gcamn->z = gcamnc->saved_origz;
                 break;
               case ORIGINAL_POSITIONS:
-                gcamn->origx = gcamn->saved_origx;
-                gcamn->origy = gcamn->saved_origy;
-                gcamn->origz = gcamn->saved_origz;
+                gcamn->origx = gcamnc->saved_origx;
+                gcamn->origy = gcamnc->saved_origy;
+                gcamn->origz = gcamnc->saved_origz;
                 break;
             }
             break;
@@ -9433,9 +9429,9 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
                 gcamn->z = gcamn->zs;
                 break;
               case SAVED_ORIGINAL_POSITIONS:
-                gcamn->saved_origx = gcamn->xs;
-                gcamn->saved_origy = gcamn->ys;
-                gcamn->saved_origz = gcamn->zs;
+                gcamnc->saved_origx = gcamn->xs;
+                gcamnc->saved_origy = gcamn->ys;
+                gcamnc->saved_origz = gcamn->zs;
                 break;
             }
             break;
@@ -9445,19 +9441,19 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
               default:
                 ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "GCAMcopyNodePositions: unsupported to %d", to));
               case ORIGINAL_POSITIONS:
-                gcamn->origx = gcamn->xs2;
-                gcamn->origy = gcamn->ys2;
-                gcamn->origz = gcamn->zs2;
+                gcamn->origx = gcamnc->xs2;
+                gcamn->origy = gcamnc->ys2;
+                gcamn->origz = gcamnc->zs2;
                 break;
               case CURRENT_POSITIONS:
-                gcamn->x = gcamn->xs2;
-                gcamn->y = gcamn->ys2;
-                gcamn->z = gcamn->zs2;
+                gcamn->x = gcamnc->xs2;
+                gcamn->y = gcamnc->ys2;
+                gcamn->z = gcamnc->zs2;
                 break;
               case SAVED_ORIGINAL_POSITIONS:
-                gcamn->saved_origx = gcamn->xs2;
-                gcamn->saved_origy = gcamn->ys2;
-                gcamn->saved_origz = gcamn->zs2;
+                gcamnc->saved_origx = gcamnc->xs2;
+                gcamnc->saved_origy = gcamnc->ys2;
+                gcamnc->saved_origz = gcamnc->zs2;
                 break;
             }
             break;
@@ -9477,14 +9473,14 @@ int GCAMcopyNodePositions(GCA_MORPH *gcam, int from, int to)
                 gcamn->zs = gcamn->z;
                 break;
               case SAVED2_POSITIONS:
-                gcamn->xs2 = gcamn->x;
-                gcamn->ys2 = gcamn->y;
-                gcamn->zs2 = gcamn->z;
+                gcamnc->xs2 = gcamn->x;
+                gcamnc->ys2 = gcamn->y;
+                gcamnc->zs2 = gcamn->z;
                 break;
               case SAVED_ORIGINAL_POSITIONS:
-                gcamn->saved_origx = gcamn->x;
-                gcamn->saved_origy = gcamn->y;
-                gcamn->saved_origz = gcamn->z;
+                gcamnc->saved_origx = gcamn->x;
+                gcamnc->saved_origy = gcamn->y;
+                gcamnc->saved_origz = gcamn->z;
                 break;
             }
 
@@ -10070,6 +10066,7 @@ double gcamAreaIntensityEnergy(GCA_MORPH *gcam, MRI *mri, NODE_LOOKUP_TABLE *nlt
   int x, y, z, xn, yn, zn, i, nbrs = 0, x1, y1, z1, xk, yk, zk, xi, yi, zi;
   // int debug = 0, xmax, ymax, zmax;
   GCA_MORPH_NODE *gcamn, *gcamn_nbr;
+  GMN_COLD *gcamnc;
   NODE_BUCKET *nb;
 
   sse = 0.0;
@@ -10079,6 +10076,7 @@ double gcamAreaIntensityEnergy(GCA_MORPH *gcam, MRI *mri, NODE_LOOKUP_TABLE *nlt
     for (y = 0; y < gcam->height; y++)
       for (z = 0; z < gcam->depth; z++) {
         gcamn = &gcam->nodes[x][y][z];
+        gcamnc = GCAMcold(gcam, gcamn);
         if (gcamn->label == 0 || gcamn->invalid) {
           continue;
         }
@@ -10097,7 +10095,7 @@ double gcamAreaIntensityEnergy(GCA_MORPH *gcam, MRI *mri, NODE_LOOKUP_TABLE *nlt
         sum_uv = sum_v = 0.0;
         // debug = 0; /* for diagnostics */
 
-        gcamn->sum_ci_vi_ui = gcamn->sum_ci_vi = 0;
+        gcamnc->sum_ci_vi_ui = gcamnc->sum_ci_vi = 0;
         for (nbrs = 0, xk = -AINT_NBHD_SIZE; xk <= AINT_NBHD_SIZE; xk++) {
           xi = xn + xk + NLT_PAD;
           if (xi < 0 || xi >= nlt->width) {
@@ -10133,8 +10131,8 @@ double gcamAreaIntensityEnergy(GCA_MORPH *gcam, MRI *mri, NODE_LOOKUP_TABLE *nlt
                   val = gcamn_nbr->gc->means[0];
                   sum_v += c * gcamn_nbr->area;
                   sum_uv += c * gcamn_nbr->area * val;
-                  gcamn->sum_ci_vi += gcamn_nbr->area;
-                  gcamn->sum_ci_vi_ui += gcamn_nbr->area * val;
+                  gcamnc->sum_ci_vi += gcamn_nbr->area;
+                  gcamnc->sum_ci_vi_ui += gcamn_nbr->area * val;
                 }
               }
             }
@@ -10172,14 +10170,14 @@ double gcamAreaIntensityEnergy(GCA_MORPH *gcam, MRI *mri, NODE_LOOKUP_TABLE *nlt
         if (fabs(error) > 1 && (y < 30 && y > 31)) {
           DiagBreak();
         }
-        if (error * error - gcamn->last_se > max_increase) {
-          max_increase = error * error - gcamn->last_se;
+        if (error * error - gcamnc->last_se > max_increase) {
+          max_increase = error * error - gcamnc->last_se;
           // xmax = x;
           // ymax = y;
           // zmax = z;
           DiagBreak();
         }
-        gcamn->last_se = error * error;
+        gcamnc->last_se = error * error;
         sse += (error * error);
         if (!finitep(sse)) {
           DiagBreak();
@@ -10232,10 +10230,10 @@ double gcamBinaryEnergy(GCA_MORPH *gcam, MRI *mri)
                  gcamn->label,
                  val);
 
-        if (error * error > gcamn->last_se) {
+        if (error * error > GCAMcold(gcam, gcamn)->last_se) {
           DiagBreak();
         }
-        gcamn->last_se = error * error;
+        GCAMcold(gcam, gcamn)->last_se = error * error;
       }
 
   return (sse * BIN_SCALE);
@@ -10249,6 +10247,7 @@ int gcamAreaIntensityTerm(
   double val, image_val, error, dx, dy, dz, sum_cv, Ix, Iy, Iz, c, distsq, sum_cuv, dxI, dyI, dzI, predicted_val, norm;
   int x, y, z, xn, yn, zn, i, x1, y1, z1, wsize, xi, yi, zi, xk, yk, zk, nbrs;
   GCA_MORPH_NODE *gcamn, *gcamn_nbr;
+  GMN_COLD *gcamnc;
   MRI *mri_dx, *mri_dy, *mri_dz, *mri_ctrl, *mri_kernel, *mri_nbhd;
   NODE_BUCKET *nb;
 
@@ -10273,6 +10272,7 @@ int gcamAreaIntensityTerm(
     for (y = 0; y < gcam->height; y++)
       for (z = 0; z < gcam->depth; z++) {
         gcamn = &gcam->nodes[x][y][z];
+        gcamnc = GCAMcold(gcam, gcamn);
         if (gcamn->label == 0 || gcamn->invalid) {
           continue;
         }
@@ -10332,17 +10332,18 @@ int gcamAreaIntensityTerm(
           error = image_val;
           DiagBreak();
         }
-        gcamn->sum_ci_vi = sum_cv;
-        gcamn->sum_ci_vi_ui = sum_cuv;
+        gcamnc->sum_ci_vi = sum_cv;
+        gcamnc->sum_ci_vi_ui = sum_cuv;
 
         predicted_val = sum_cuv / sum_cv;
-        gcamn->predicted_val = predicted_val;
+        gcamnc->predicted_val = predicted_val;
       }
 
   for (x = 0; x < gcam->width; x++)
     for (y = 0; y < gcam->height; y++)
       for (z = 0; z < gcam->depth; z++) {
         gcamn = &gcam->nodes[x][y][z];
+        gcamnc = GCAMcold(gcam, gcamn);
         if (gcamn->label == 0 || gcamn->invalid) {
           continue;
         }
@@ -10359,9 +10360,9 @@ int gcamAreaIntensityTerm(
           one that pushes the node towards the image location with the predicted intensity
           one that squeezes or expands the node if it is brighter than the predicted val.
         */
-        error = image_val - gcamn->predicted_val;
+        error = image_val - gcamnc->predicted_val;
         gcamComputeMostLikelyDirection(
-            gcam, mri, gcamn->x, gcamn->y, gcamn->z, gcamn->predicted_val, mri_kernel, mri_nbhd, &Ix, &Iy, &Iz);
+            gcam, mri, gcamn->x, gcamn->y, gcamn->z, gcamnc->predicted_val, mri_kernel, mri_nbhd, &Ix, &Iy, &Iz);
 
         norm = sqrt(Ix * Ix + Iy * Iy + Iz * Iz);
         if (!FZERO(norm)) /* don't worry about magnitude of gradient */
@@ -10415,7 +10416,7 @@ int gcamAreaIntensityTerm(
                  gcamn->gc->means[0],
                  gcamn->area);
           printf("            partial volume intensity = %2.1f (error = %2.1f), gradI(%2.3f, %2.3f, %2.3f)\n",
-                 gcamn->predicted_val,
+                 gcamnc->predicted_val,
                  error,
                  dxI,
                  dyI,
@@ -13688,7 +13689,7 @@ int gcamDistanceTransformTerm(GCA_MORPH *gcam, MRI *mri_source, MRI *mri, double
         {
           MRIsampleVolumeGradientFrame(mri, gcamn->x, gcamn->y, gcamn->z, &dx, &dy, &dz, frame);
           MRIsampleVolumeFrameType(mri, gcamn->x, gcamn->y, gcamn->z, frame, SAMPLE_TRILINEAR, &dist);
-          error = (dist - gcamn->target_dist);
+          error = (dist - GCAMcold(gcam, gcamn)->target_dist);
           if (x == Gx && y == Gy && z == Gz)
             printf("l_dtrans: node(%d,%d,%d, %s) -> (%2.1f,%2.1f,%2.1f), dist=%2.2f, T=%2.2f, D=(%2.1f,%2.1f,%2.1f)\n",
                    x,
@@ -13699,7 +13700,7 @@ int gcamDistanceTransformTerm(GCA_MORPH *gcam, MRI *mri_source, MRI *mri, double
                    gcamn->y,
                    gcamn->z,
                    dist,
-                   gcamn->target_dist,
+                   GCAMcold(gcam, gcamn)->target_dist,
                    -error * dx,
                    -error * dy,
                    -error * dz);
@@ -13775,10 +13776,10 @@ double gcamDistanceTransformEnergy(GCA_MORPH *gcam, MRI *mri_source, MRI *mri, G
                    gcamn->y,
                    gcamn->z,
                    dist,
-                   gcamn->target_dist);
+                   GCAMcold(gcam, gcamn)->target_dist);
 
           check_gcam(gcam);
-          dist -= (gcamn->target_dist);
+          dist -= (GCAMcold(gcam, gcamn)->target_dist);
           sse += (dist * dist);
           if (!finitep(sse)) DiagBreak();
         }
@@ -13839,7 +13840,7 @@ int GCAMsetTargetDistancesForLabel(GCA_MORPH *gcam, MRI *mri_labels, MRI *mri_di
         if (x == Gx && y == Gy && z == Gz) {
           DiagBreak();
         }
-        gcamn->target_dist = MRIgetVoxVal(mri_dist, xv, yv, zv, 0);
+        GCAMcold(gcam, gcamn)->target_dist = MRIgetVoxVal(mri_dist, xv, yv, zv, 0);
       }
     }
   }
@@ -16544,9 +16545,9 @@ GCA_MORPH *GCAMdownsample2(GCA_MORPH *gcam)
         node_dst->origy = node_src->origy;
         node_dst->origz = node_src->origz;
 
-        node_dst->xs2 = node_src->xs2;
-        node_dst->ys2 = node_src->ys2;
-        node_dst->zs2 = node_src->zs2;
+        GCAMcold(gcam_dst, node_dst)->xs2 = GCAMcold(gcam, node_src)->xs2;
+        GCAMcold(gcam_dst, node_dst)->ys2 = GCAMcold(gcam, node_src)->ys2;
+        GCAMcold(gcam_dst, node_dst)->zs2 = GCAMcold(gcam, node_src)->zs2;
 
         node_dst->xs = node_src->xs;
         node_dst->ys = node_src->ys;
@@ -16556,9 +16557,9 @@ GCA_MORPH *GCAMdownsample2(GCA_MORPH *gcam)
         node_dst->yn = node_src->yn;
         node_dst->zn = node_src->zn;
 
-        node_dst->saved_origx = node_src->saved_origx;
-        node_dst->saved_origy = node_src->saved_origy;
-        node_dst->saved_origz = node_src->saved_origz;
+        GCAMcold(gcam_dst, node_dst)->saved_origx = GCAMcold(gcam, node_src)->saved_origx;
+        GCAMcold(gcam_dst, node_dst)->saved_origy = GCAMcold(gcam, node_src)->saved_origy;
+        GCAMcold(gcam_dst, node_dst)->saved_origz = GCAMcold(gcam, node_src)->saved_origz;
 
         node_dst->prior = node_src->prior;
         node_dst->area = node_src->area;
@@ -17373,6 +17374,9 @@ GCA_MORPH *GCAMcopy(const GCA_MORPH *gcamsrc, GCA_MORPH *gcamdst)
       }
     }
   }
+  memcpy(gcamdst->cold_nodes,
+         gcamsrc->cold_nodes,
+         (size_t)gcamsrc->width * gcamsrc->height * gcamsrc->depth * sizeof(GMN_COLD));
   gcamdst->vgcam_ms = gcamsrc->vgcam_ms; // Not saved.
   return (gcamdst);
 }
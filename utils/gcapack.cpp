@@ -0,0 +1,1014 @@
+/**
+ * @brief flattened (CSR-style) storage of the nodes and priors of a GCA
+ *
+ */
+/*
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "colortab.h"
+#include "diag.h"
+#include "error.h"
+#include "gca.h"
+#include "znzlib.h"
+
+/*
+  A GCA read from disk holds every node and prior as a small heap struct
+  with its own heap arrays (labels, gcs, GC1D means/covars and the gibbs
+  label_priors/labels), i.e. a handful of allocations per node scattered
+  over the heap. GCApack() moves all of them into a few contiguous arrays,
+  laid out in the same x/y/z order that the nodes[x][y][z] and
+  priors[x][y][z] lookups walk:
+
+    nodes      GCA_NODE[node_width*node_height*node_depth], z fastest
+    labels     unsigned short[sum of nlabels], CSR by node
+    gcs        GC1D[sum of nlabels], CSR by node
+    means      float[ninputs per gc]
+    covars     float[ninputs*(ninputs+1)/2 per gc]
+    gibbs      nlabels/labels/label_priors of every gc, CSR by gc/direction
+
+  and the same for the priors. The GCA_NODE/GCA_PRIOR/GC1D pointers are
+  rewritten to point into these arrays, so getGCAN(), getGCAP(),
+  GCAfindGC(), GCAcomputePosteriorDensity() etc. work unchanged but walk
+  memory sequentially and the malloc overhead of ~10 allocations per node
+  goes away.
+
+  A packed GCA may have its values (means, covars, priors, labels)
+  modified in place, but the per-node arrays cannot be grown or freed
+  individually. Functions that do so call GCAunpack() first, which turns
+  the GCA back into the regular heap layout.
+
+  The same arrays, minus the pointers, are what a .gcp file holds (see
+  GCAwritePacked()), so GCAreadPacked() can mmap the file and point the
+  nodes and priors straight into the mapping.
+*/
+
+struct GCA_PACK
+{
+  GCA_NODE **node_rows;
+  GCA_NODE ***node_cols;
+  GCA_NODE *nodes;
+  unsigned short *node_labels;
+  GC1D *gcs;
+  float *means;
+  float *covars;
+  short *gibbs_nlabels;
+  unsigned short **gibbs_label_ptrs;
+  float **gibbs_prior_ptrs;
+  unsigned short *gibbs_labels;
+  float *gibbs_priors;
+
+  GCA_PRIOR **prior_rows;
+  GCA_PRIOR ***prior_cols;
+  GCA_PRIOR *priors;
+  unsigned short *prior_labels;
+  float *prior_priors;
+
+  void *mapping;  // the data arrays above point into a mapped .gcp file
+  size_t mapping_len;
+
+  size_t nbytes;
+  size_t nallocs;
+};
+
+static void *gcaPackAlloc(GCA_PACK *pack, size_t n, size_t size)
+{
+  void *ptr;
+
+  // calloc(0) may legitimately return NULL, so always ask for something
+  ptr = calloc(n > 0 ? n : 1, size);
+  if (ptr == NULL) ErrorExit(ERROR_NOMEMORY, "GCApack: could not allocate %zu x %zu bytes", n, size);
+  pack->nbytes += n * size;
+  pack->nallocs++;
+  return (ptr);
+}
+
+/* release the per-node and per-prior heap arrays of an unpacked GCA */
+static void gcaFreeHeapLayout(GCA *gca)
+{
+  int x, y, z;
+
+  for (x = 0; x < gca->node_width; x++) {
+    for (y = 0; y < gca->node_height; y++) {
+      for (z = 0; z < gca->node_depth; z++) {
+        GCANfree(&gca->nodes[x][y][z], gca->ninputs);
+      }
+      free(gca->nodes[x][y]);
+    }
+    free(gca->nodes[x]);
+  }
+  free(gca->nodes);
+
+  for (x = 0; x < gca->prior_width; x++) {
+    for (y = 0; y < gca->prior_height; y++) {
+      for (z = 0; z < gca->prior_depth; z++) {
+        free(gca->priors[x][y][z].labels);
+        free(gca->priors[x][y][z].priors);
+      }
+      free(gca->priors[x][y]);
+    }
+    free(gca->priors[x]);
+  }
+  free(gca->priors);
+}
+
+/*!
+  \fn int GCApack(GCA *gca)
+  \brief Move the nodes and priors of gca into contiguous CSR-style
+  arrays (see the comment at the top of gcapack.cpp). The query API is
+  unchanged. Does nothing if gca is already packed.
+*/
+int GCApack(GCA *gca)
+{
+  GCA_PACK *pack;
+  size_t nnodes, npriors, ngcs, ngibbs, nplabels, i, g, b, p;
+  int x, y, z, n, j, k, ncovars, have_gibbs;
+
+  if (gca->pack) {
+    return (NO_ERROR);
+  }
+
+  ncovars = (gca->ninputs * (gca->ninputs + 1)) / 2;
+  nnodes = (size_t)gca->node_width * gca->node_height * gca->node_depth;
+  npriors = (size_t)gca->prior_width * gca->prior_height * gca->prior_depth;
+
+  // count everything first so each array is a single allocation
+  have_gibbs = 0;
+  ngcs = ngibbs = nplabels = 0;
+  for (x = 0; x < gca->node_width; x++)
+    for (y = 0; y < gca->node_height; y++)
+      for (z = 0; z < gca->node_depth; z++) {
+        GCA_NODE *gcan = &gca->nodes[x][y][z];
+        ngcs += gcan->nlabels;
+        for (n = 0; n < gcan->nlabels; n++) {
+          GC1D *gc = &gcan->gcs[n];
+          if (gc->nlabels == NULL) {
+            continue;
+          }
+          have_gibbs = 1;
+          for (j = 0; j < GIBBS_NEIGHBORHOOD; j++) {
+            ngibbs += gc->nlabels[j];
+          }
+        }
+      }
+  for (x = 0; x < gca->prior_width; x++)
+    for (y = 0; y < gca->prior_height; y++)
+      for (z = 0; z < gca->prior_depth; z++) {
+        nplabels += gca->priors[x][y][z].nlabels;
+      }
+
+  pack = (GCA_PACK *)calloc(1, sizeof(GCA_PACK));
+  if (pack == NULL) ErrorExit(ERROR_NOMEMORY, "GCApack: could not allocate pack");
+
+  pack->node_cols = (GCA_NODE ***)gcaPackAlloc(pack, gca->node_width, sizeof(GCA_NODE **));
+  pack->node_rows = (GCA_NODE **)gcaPackAlloc(pack, (size_t)gca->node_width * gca->node_height, sizeof(GCA_NODE *));
+  pack->nodes = (GCA_NODE *)gcaPackAlloc(pack, nnodes, sizeof(GCA_NODE));
+  pack->node_labels = (unsigned short *)gcaPackAlloc(pack, ngcs, sizeof(unsigned short));
+  pack->gcs = (GC1D *)gcaPackAlloc(pack, ngcs, sizeof(GC1D));
+  pack->means = (float *)gcaPackAlloc(pack, ngcs * gca->ninputs, sizeof(float));
+  pack->covars = (float *)gcaPackAlloc(pack, ngcs * ncovars, sizeof(float));
+  if (have_gibbs) {
+    pack->gibbs_nlabels = (short *)gcaPackAlloc(pack, ngcs * GIBBS_NEIGHBORHOOD, sizeof(short));
+    pack->gibbs_label_ptrs =
+        (unsigned short **)gcaPackAlloc(pack, ngcs * GIBBS_NEIGHBORHOOD, sizeof(unsigned short *));
+    pack->gibbs_prior_ptrs = (float **)gcaPackAlloc(pack, ngcs * GIBBS_NEIGHBORHOOD, sizeof(float *));
+    pack->gibbs_labels = (unsigned short *)gcaPackAlloc(pack, ngibbs, sizeof(unsigned short));
+    pack->gibbs_priors = (float *)gcaPackAlloc(pack, ngibbs, sizeof(float));
+  }
+
+  pack->prior_cols = (GCA_PRIOR ***)gcaPackAlloc(pack, gca->prior_width, sizeof(GCA_PRIOR **));
+  pack->prior_rows =
+      (GCA_PRIOR **)gcaPackAlloc(pack, (size_t)gca->prior_width * gca->prior_height, sizeof(GCA_PRIOR *));
+  pack->priors = (GCA_PRIOR *)gcaPackAlloc(pack, npriors, sizeof(GCA_PRIOR));
+  pack->prior_labels = (unsigned short *)gcaPackAlloc(pack, nplabels, sizeof(unsigned short));
+  pack->prior_priors = (float *)gcaPackAlloc(pack, nplabels, sizeof(float));
+
+  // copy the nodes
+  for (i = g = b = 0, x = 0; x < gca->node_width; x++) {
+    pack->node_cols[x] = &pack->node_rows[(size_t)x * gca->node_height];
+    for (y = 0; y < gca->node_height; y++) {
+      pack->node_cols[x][y] = &pack->nodes[i];
+      for (z = 0; z < gca->node_depth; z++, i++) {
+        GCA_NODE *src = &gca->nodes[x][y][z];
+        GCA_NODE *dst = &pack->nodes[i];
+
+        dst->nlabels = src->nlabels;
+        dst->max_labels = src->nlabels;
+        dst->total_training = src->total_training;
+        if (src->nlabels == 0) {
+          dst->labels = NULL;
+          dst->gcs = NULL;
+          continue;
+        }
+        dst->labels = &pack->node_labels[g];
+        dst->gcs = &pack->gcs[g];
+        memcpy(dst->labels, src->labels, src->nlabels * sizeof(unsigned short));
+        for (n = 0; n < src->nlabels; n++, g++) {
+          GC1D *gc_src = &src->gcs[n];
+          GC1D *gc_dst = &pack->gcs[g];
+
+          gc_dst->means = &pack->means[g * gca->ninputs];
+          gc_dst->covars = &pack->covars[g * ncovars];
+          memcpy(gc_dst->means, gc_src->means, gca->ninputs * sizeof(float));
+          memcpy(gc_dst->covars, gc_src->covars, ncovars * sizeof(float));
+          gc_dst->n_just_priors = gc_src->n_just_priors;
+          gc_dst->ntraining = gc_src->ntraining;
+          gc_dst->regularized = gc_src->regularized;
+          if (gc_src->nlabels == NULL) {
+            continue;
+          }
+          gc_dst->nlabels = &pack->gibbs_nlabels[g * GIBBS_NEIGHBORHOOD];
+          gc_dst->labels = &pack->gibbs_label_ptrs[g * GIBBS_NEIGHBORHOOD];
+          gc_dst->label_priors = &pack->gibbs_prior_ptrs[g * GIBBS_NEIGHBORHOOD];
+          for (j = 0; j < GIBBS_NEIGHBORHOOD; j++) {
+            k = gc_src->nlabels[j];
+            gc_dst->nlabels[j] = k;
+            gc_dst->labels[j] = &pack->gibbs_labels[b];
+            gc_dst->label_priors[j] = &pack->gibbs_priors[b];
+            if (k > 0) {
+              memcpy(gc_dst->labels[j], gc_src->labels[j], k * sizeof(unsigned short));
+              memcpy(gc_dst->label_priors[j], gc_src->label_priors[j], k * sizeof(float));
+            }
+            b += k;
+          }
+        }
+      }
+    }
+  }
+
+  // copy the priors
+  for (i = p = 0, x = 0; x < gca->prior_width; x++) {
+    pack->prior_cols[x] = &pack->prior_rows[(size_t)x * gca->prior_height];
+    for (y = 0; y < gca->prior_height; y++) {
+      pack->prior_cols[x][y] = &pack->priors[i];
+      for (z = 0; z < gca->prior_depth; z++, i++) {
+        GCA_PRIOR *src = &gca->priors[x][y][z];
+        GCA_PRIOR *dst = &pack->priors[i];
+
+        dst->nlabels = src->nlabels;
+        dst->max_labels = src->nlabels;
+        dst->total_training = src->total_training;
+        dst->labels = &pack->prior_labels[p];
+        dst->priors = &pack->prior_priors[p];
+        if (src->nlabels > 0) {
+          memcpy(dst->labels, src->labels, src->nlabels * sizeof(unsigned short));
+          memcpy(dst->priors, src->priors, src->nlabels * sizeof(float));
+        }
+        p += src->nlabels;
+      }
+    }
+  }
+
+  gcaFreeHeapLayout(gca);
+  gca->nodes = pack->node_cols;
+  gca->priors = pack->prior_cols;
+  gca->pack = pack;
+
+  if (Gdiag & DIAG_SHOW)
+    printf("GCApack: %zu nodes, %zu gcs, %zu priors packed into %zu arrays (%.1f MB)\n",
+           nnodes,
+           ngcs,
+           npriors,
+           pack->nallocs,
+           pack->nbytes / (1024.0 * 1024.0));
+
+  return (NO_ERROR);
+}
+
+/*!
+  \fn int GCAunpack(GCA *gca)
+  \brief Undo GCApack(): give every node and prior its own heap arrays
+  again so that they can be reallocated or freed individually. Does
+  nothing if gca is not packed.
+*/
+int GCAunpack(GCA *gca)
+{
+  GCA_PACK *pack;
+  GCA_NODE ***nodes;
+  GCA_PRIOR ***priors;
+  int x, y, z, n, j, ncovars;
+
+  pack = gca->pack;
+  if (pack == NULL) {
+    return (NO_ERROR);
+  }
+
+  ncovars = (gca->ninputs * (gca->ninputs + 1)) / 2;
+
+  nodes = (GCA_NODE ***)calloc(gca->node_width, sizeof(GCA_NODE **));
+  if (!nodes) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate nodes");
+  for (x = 0; x < gca->node_width; x++) {
+    nodes[x] = (GCA_NODE **)calloc(gca->node_height, sizeof(GCA_NODE *));
+    if (!nodes[x]) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %dth **", x);
+    for (y = 0; y < gca->node_height; y++) {
+      nodes[x][y] = (GCA_NODE *)calloc(gca->node_depth, sizeof(GCA_NODE));
+      if (!nodes[x][y]) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %d,%dth *", x, y);
+      for (z = 0; z < gca->node_depth; z++) {
+        GCA_NODE *src = &gca->nodes[x][y][z];
+        GCA_NODE *dst = &nodes[x][y][z];
+
+        *dst = *src;
+        if (src->nlabels == 0) {
+          continue;
+        }
+        dst->labels = (unsigned short *)calloc(src->nlabels, sizeof(unsigned short));
+        if (!dst->labels) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %d labels", src->nlabels);
+        memcpy(dst->labels, src->labels, src->nlabels * sizeof(unsigned short));
+        dst->gcs = alloc_gcs(src->nlabels, GCA_NO_MRF, gca->ninputs);
+        for (n = 0; n < src->nlabels; n++) {
+          GC1D *gc_src = &src->gcs[n];
+          GC1D *gc_dst = &dst->gcs[n];
+
+          memcpy(gc_dst->means, gc_src->means, gca->ninputs * sizeof(float));
+          memcpy(gc_dst->covars, gc_src->covars, ncovars * sizeof(float));
+          gc_dst->n_just_priors = gc_src->n_just_priors;
+          gc_dst->ntraining = gc_src->ntraining;
+          gc_dst->regularized = gc_src->regularized;
+          if (gc_src->nlabels == NULL) {
+            continue;
+          }
+          gc_dst->nlabels = (short *)calloc(GIBBS_NEIGHBORHOOD, sizeof(short));
+          gc_dst->labels = (unsigned short **)calloc(GIBBS_NEIGHBORHOOD, sizeof(unsigned short *));
+          gc_dst->label_priors = (float **)calloc(GIBBS_NEIGHBORHOOD, sizeof(float *));
+          if (!gc_dst->nlabels || !gc_dst->labels || !gc_dst->label_priors)
+            ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate gibbs priors");
+          for (j = 0; j < GIBBS_NEIGHBORHOOD; j++) {
+            gc_dst->nlabels[j] = gc_src->nlabels[j];
+            gc_dst->labels[j] = (unsigned short *)calloc(gc_src->nlabels[j], sizeof(unsigned short));
+            gc_dst->label_priors[j] = (float *)calloc(gc_src->nlabels[j], sizeof(float));
+            if (!gc_dst->labels[j] || !gc_dst->label_priors[j])
+              ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %d gibbs labels", gc_src->nlabels[j]);
+            memcpy(gc_dst->labels[j], gc_src->labels[j], gc_src->nlabels[j] * sizeof(unsigned short));
+            memcpy(gc_dst->label_priors[j], gc_src->label_priors[j], gc_src->nlabels[j] * sizeof(float));
+          }
+        }
+      }
+    }
+  }
+
+  priors = (GCA_PRIOR ***)calloc(gca->prior_width, sizeof(GCA_PRIOR **));
+  if (!priors) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate priors");
+  for (x = 0; x < gca->prior_width; x++) {
+    priors[x] = (GCA_PRIOR **)calloc(gca->prior_height, sizeof(GCA_PRIOR *));
+    if (!priors[x]) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %dth **", x);
+    for (y = 0; y < gca->prior_height; y++) {
+      priors[x][y] = (GCA_PRIOR *)calloc(gca->prior_depth, sizeof(GCA_PRIOR));
+      if (!priors[x][y]) ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %d,%dth *", x, y);
+      for (z = 0; z < gca->prior_depth; z++) {
+        GCA_PRIOR *src = &gca->priors[x][y][z];
+        GCA_PRIOR *dst = &priors[x][y][z];
+
+        *dst = *src;
+        dst->labels = NULL;
+        dst->priors = NULL;
+        if (src->nlabels == 0) {
+          continue;
+        }
+        dst->labels = (unsigned short *)calloc(src->nlabels, sizeof(unsigned short));
+        dst->priors = (float *)calloc(src->nlabels, sizeof(float));
+        if (!dst->labels || !dst->priors)
+          ErrorExit(ERROR_NOMEMORY, "GCAunpack: could not allocate %d prior labels", src->nlabels);
+        memcpy(dst->labels, src->labels, src->nlabels * sizeof(unsigned short));
+        memcpy(dst->priors, src->priors, src->nlabels * sizeof(float));
+      }
+    }
+  }
+
+  GCAfreePack(gca);
+  gca->nodes = nodes;
+  gca->priors = priors;
+
+  return (NO_ERROR);
+}
+
+/*!
+  \fn void GCAfreePack(GCA *gca)
+  \brief Release the arrays of a packed GCA (called by GCAfree()). The
+  node and prior pointers of gca are left dangling.
+*/
+void GCAfreePack(GCA *gca)
+{
+  GCA_PACK *pack = gca->pack;
+
+  if (pack == NULL) {
+    return;
+  }
+  free(pack->node_cols);
+  free(pack->node_rows);
+  free(pack->nodes);
+  free(pack->gcs);
+  free(pack->gibbs_label_ptrs);
+  free(pack->gibbs_prior_ptrs);
+  free(pack->prior_cols);
+  free(pack->prior_rows);
+  free(pack->priors);
+  if (pack->mapping) {
+    munmap(pack->mapping, pack->mapping_len);
+  }
+  else {
+    free(pack->node_labels);
+    free(pack->means);
+    free(pack->covars);
+    free(pack->gibbs_nlabels);
+    free(pack->gibbs_labels);
+    free(pack->gibbs_priors);
+    free(pack->prior_labels);
+    free(pack->prior_priors);
+  }
+  free(pack);
+  gca->pack = NULL;
+}
+
+/*!
+  \fn size_t GCAmemoryUsage(const GCA *gca, size_t *pnallocs)
+  \brief Bytes used by the nodes and priors of gca (not counting malloc
+  bookkeeping). If pnallocs is non-NULL it receives the number of heap
+  blocks they occupy, which is what dominates for an unpacked atlas.
+*/
+size_t GCAmemoryUsage(const GCA *gca, size_t *pnallocs)
+{
+  size_t nbytes, nallocs;
+  int x, y, z, n, j, nlabels, ncovars;
+
+  if (gca->pack) {
+    if (pnallocs) {
+      *pnallocs = gca->pack->nallocs;
+    }
+    return (gca->pack->nbytes);
+  }
+
+  ncovars = (gca->ninputs * (gca->ninputs + 1)) / 2;
+  nbytes = nallocs = 0;
+  nbytes += gca->node_width * sizeof(GCA_NODE **) + (size_t)gca->node_width * gca->node_height * sizeof(GCA_NODE *);
+  nallocs += 1 + gca->node_width;
+  for (x = 0; x < gca->node_width; x++)
+    for (y = 0; y < gca->node_height; y++) {
+      nbytes += gca->node_depth * sizeof(GCA_NODE);
+      nallocs++;
+      for (z = 0; z < gca->node_depth; z++) {
+        const GCA_NODE *gcan = &gca->nodes[x][y][z];
+        nlabels = gcan->nlabels;
+        if (nlabels == 0) {
+          continue;
+        }
+        nbytes += nlabels * (sizeof(unsigned short) + sizeof(GC1D));
+        nallocs += 2;
+        for (n = 0; n < nlabels; n++) {
+          const GC1D *gc = &gcan->gcs[n];
+          nbytes += (gca->ninputs + ncovars) * sizeof(float);
+          nallocs += 2;
+          if (gc->nlabels == NULL) {
+            continue;
+          }
+          nbytes += GIBBS_NEIGHBORHOOD * (sizeof(short) + sizeof(unsigned short *) + sizeof(float *));
+          nallocs += 3;
+          for (j = 0; j < GIBBS_NEIGHBORHOOD; j++) {
+            nbytes += gc->nlabels[j] * (sizeof(unsigned short) + sizeof(float));
+            nallocs += 2;
+          }
+        }
+      }
+    }
+
+  nbytes +=
+      gca->prior_width * sizeof(GCA_PRIOR **) + (size_t)gca->prior_width * gca->prior_height * sizeof(GCA_PRIOR *);
+  nallocs += 1 + gca->prior_width;
+  for (x = 0; x < gca->prior_width; x++)
+    for (y = 0; y < gca->prior_height; y++) {
+      nbytes += gca->prior_depth * sizeof(GCA_PRIOR);
+      nallocs++;
+      for (z = 0; z < gca->prior_depth; z++) {
+        const GCA_PRIOR *gcap = &gca->priors[x][y][z];
+        nlabels = MAX(gcap->nlabels, gcap->max_labels);
+        if (nlabels == 0) {
+          continue;
+        }
+        nbytes += nlabels * (sizeof(unsigned short) + sizeof(float));
+        nallocs += 2;
+      }
+    }
+
+  if (pnallocs) {
+    *pnallocs = nallocs;
+  }
+  return (nbytes);
+}
+
+/*
+  .gcp file layout (native byte order, every section 64 byte aligned):
+
+    GCAP_HEADER
+    node nlabels        int32[nnodes]
+    node total_training int32[nnodes]
+    node labels         uint16[ngcs]
+    gc means            float[ngcs*ninputs]
+    gc covars           float[ngcs*ncovars]
+    gc ntraining        int32[ngcs]
+    gc n_just_priors    int16[ngcs]
+    gc regularized      int8[ngcs]
+    gibbs nlabels       int16[ngcs*GIBBS_NEIGHBORHOOD]   (empty if GCA_NO_MRF)
+    gibbs labels        uint16[ngibbs]
+    gibbs label_priors  float[ngibbs]
+    prior nlabels       int32[npriors]
+    prior total_train.  int32[npriors]
+    prior labels        uint16[nplabels]
+    prior priors        float[nplabels]
+    colortable          znzCTABwriteIntoBinary() format, if any
+*/
+
+#define GCAP_MAGIC "FSGCAPK"
+#define GCAP_VERSION 1
+#define GCAP_BYTEORDER 0x01020304
+#define GCAP_ALIGN 64
+
+enum {
+  GCAP_NODE_NLABELS,
+  GCAP_NODE_TRAINING,
+  GCAP_NODE_LABELS,
+  GCAP_GC_MEANS,
+  GCAP_GC_COVARS,
+  GCAP_GC_NTRAINING,
+  GCAP_GC_NJUSTPRIORS,
+  GCAP_GC_REGULARIZED,
+  GCAP_GIBBS_NLABELS,
+  GCAP_GIBBS_LABELS,
+  GCAP_GIBBS_PRIORS,
+  GCAP_PRIOR_NLABELS,
+  GCAP_PRIOR_TRAINING,
+  GCAP_PRIOR_LABELS,
+  GCAP_PRIOR_PRIORS,
+  GCAP_NSECTIONS
+};
+
+typedef struct
+{
+  char magic[8];
+  int32_t version;
+  int32_t byteorder;
+  float prior_spacing, node_spacing;
+  int32_t prior_width, prior_height, prior_depth;
+  int32_t node_width, node_height, node_depth;
+  int32_t ninputs, flags, type, max_label, have_gibbs, total_training;
+  double TRs[MAX_GCA_INPUTS], FAs[MAX_GCA_INPUTS], TEs[MAX_GCA_INPUTS];
+  float x_r, x_a, x_s, y_r, y_a, y_s, z_r, z_a, z_s, c_r, c_a, c_s;
+  int32_t width, height, depth;
+  float xsize, ysize, zsize;
+  uint64_t nnodes, ngcs, ngibbs, npriors, nplabels;
+  uint64_t offset[GCAP_NSECTIONS];
+  uint64_t ct_offset;  // 0 if there is no colortable
+  uint64_t file_size;
+} GCAP_HEADER;
+
+static int gcapWriteSection(FILE *fp, GCAP_HEADER *hdr, int section, const void *data, size_t nbytes)
+{
+  static const char zeros[GCAP_ALIGN] = {0};
+  long pos = ftell(fp);
+  size_t pad = (GCAP_ALIGN - pos % GCAP_ALIGN) % GCAP_ALIGN;
+
+  if (pad && fwrite(zeros, 1, pad, fp) != pad) return (ERROR_BADFILE);
+  hdr->offset[section] = pos + pad;
+  if (nbytes && fwrite(data, 1, nbytes, fp) != nbytes) return (ERROR_BADFILE);
+  return (NO_ERROR);
+}
+
+/* check that every section of hdr lies inside the file */
+static int gcapSectionsFit(const GCAP_HEADER *hdr)
+{
+  uint64_t nbytes[GCAP_NSECTIONS];
+  uint64_t ncovars = ((uint64_t)hdr->ninputs * (hdr->ninputs + 1)) / 2;
+  int i;
+
+  if (hdr->ninputs < 1 || hdr->ninputs > MAX_GCA_INPUTS || hdr->node_width < 1 || hdr->node_height < 1 ||
+      hdr->node_depth < 1 || hdr->prior_width < 1 || hdr->prior_height < 1 || hdr->prior_depth < 1 ||
+      hdr->nnodes != (uint64_t)hdr->node_width * hdr->node_height * hdr->node_depth ||
+      hdr->npriors != (uint64_t)hdr->prior_width * hdr->prior_height * hdr->prior_depth)
+    return (0);
+
+  nbytes[GCAP_NODE_NLABELS] = hdr->nnodes * sizeof(int32_t);
+  nbytes[GCAP_NODE_TRAINING] = hdr->nnodes * sizeof(int32_t);
+  nbytes[GCAP_NODE_LABELS] = hdr->ngcs * sizeof(unsigned short);
+  nbytes[GCAP_GC_MEANS] = hdr->ngcs * hdr->ninputs * sizeof(float);
+  nbytes[GCAP_GC_COVARS] = hdr->ngcs * ncovars * sizeof(float);
+  nbytes[GCAP_GC_NTRAINING] = hdr->ngcs * sizeof(int32_t);
+  nbytes[GCAP_GC_NJUSTPRIORS] = hdr->ngcs * sizeof(int16_t);
+  nbytes[GCAP_GC_REGULARIZED] = hdr->ngcs * sizeof(int8_t);
+  nbytes[GCAP_GIBBS_NLABELS] = hdr->have_gibbs ? hdr->ngcs * GIBBS_NEIGHBORHOOD * sizeof(short) : 0;
+  nbytes[GCAP_GIBBS_LABELS] = hdr->ngibbs * sizeof(unsigned short);
+  nbytes[GCAP_GIBBS_PRIORS] = hdr->ngibbs * sizeof(float);
+  nbytes[GCAP_PRIOR_NLABELS] = hdr->npriors * sizeof(int32_t);
+  nbytes[GCAP_PRIOR_TRAINING] = hdr->npriors * sizeof(int32_t);
+  nbytes[GCAP_PRIOR_LABELS] = hdr->nplabels * sizeof(unsigned short);
+  nbytes[GCAP_PRIOR_PRIORS] = hdr->nplabels * sizeof(float);
+
+  for (i = 0; i < GCAP_NSECTIONS; i++) {
+    if (hdr->offset[i] % GCAP_ALIGN || hdr->offset[i] > hdr->file_size ||
+        nbytes[i] > hdr->file_size - hdr->offset[i])
+      return (0);
+  }
+  return (1);
+}
+
+/*!
+  \fn int GCAisPackedFile(const char *fname)
+  \brief Returns 1 if fname is a .gcp file written by GCAwritePacked().
+*/
+int GCAisPackedFile(const char *fname)
+{
+  char magic[8];
+  FILE *fp;
+  int ok;
+
+  fp = fopen(fname, "rb");
+  if (fp == NULL) {
+    return (0);
+  }
+  ok = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && !memcmp(magic, GCAP_MAGIC, sizeof(GCAP_MAGIC));
+  fclose(fp);
+  return (ok);
+}
+
+/*!
+  \fn int GCAwritePacked(GCA *gca, const char *fname)
+  \brief Write gca in the mmap-able .gcp format read by GCAreadPacked().
+  The file is in native byte order. gca is packed for the duration of the
+  call and returned in the layout it came in.
+*/
+int GCAwritePacked(GCA *gca, const char *fname)
+{
+  GCAP_HEADER hdr;
+  GCA_PACK *pack;
+  FILE *fp;
+  size_t nnodes, ngcs, ngibbs, npriors, nplabels, i;
+  int32_t *ibuf;
+  int16_t *sbuf;
+  int8_t *cbuf;
+  int was_packed, ncovars, err;
+
+  was_packed = (gca->pack != NULL);
+  GCApack(gca);
+  pack = gca->pack;
+
+  ncovars = (gca->ninputs * (gca->ninputs + 1)) / 2;
+  nnodes = (size_t)gca->node_width * gca->node_height * gca->node_depth;
+  npriors = (size_t)gca->prior_width * gca->prior_height * gca->prior_depth;
+  for (ngcs = i = 0; i < nnodes; i++) ngcs += pack->nodes[i].nlabels;
+  for (nplabels = i = 0; i < npriors; i++) nplabels += pack->priors[i].nlabels;
+  ngibbs = 0;
+  if (pack->gibbs_nlabels)
+    for (i = 0; i < ngcs * GIBBS_NEIGHBORHOOD; i++) ngibbs += pack->gibbs_nlabels[i];
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, GCAP_MAGIC, sizeof(GCAP_MAGIC));
+  hdr.version = GCAP_VERSION;
+  hdr.byteorder = GCAP_BYTEORDER;
+  hdr.prior_spacing = gca->prior_spacing;
+  hdr.node_spacing = gca->node_spacing;
+  hdr.prior_width = gca->prior_width;
+  hdr.prior_height = gca->prior_height;
+  hdr.prior_depth = gca->prior_depth;
+  hdr.node_width = gca->node_width;
+  hdr.node_height = gca->node_height;
+  hdr.node_depth = gca->node_depth;
+  hdr.ninputs = gca->ninputs;
+  hdr.flags = gca->flags;
+  hdr.type = gca->type;
+  hdr.max_label = gca->max_label;
+  hdr.have_gibbs = (pack->gibbs_nlabels != NULL);
+  hdr.total_training = gca->total_training;
+  memcpy(hdr.TRs, gca->TRs, sizeof(hdr.TRs));
+  memcpy(hdr.FAs, gca->FAs, sizeof(hdr.FAs));
+  memcpy(hdr.TEs, gca->TEs, sizeof(hdr.TEs));
+  hdr.x_r = gca->x_r;
+  hdr.x_a = gca->x_a;
+  hdr.x_s = gca->x_s;
+  hdr.y_r = gca->y_r;
+  hdr.y_a = gca->y_a;
+  hdr.y_s = gca->y_s;
+  hdr.z_r = gca->z_r;
+  hdr.z_a = gca->z_a;
+  hdr.z_s = gca->z_s;
+  hdr.c_r = gca->c_r;
+  hdr.c_a = gca->c_a;
+  hdr.c_s = gca->c_s;
+  hdr.width = gca->width;
+  hdr.height = gca->height;
+  hdr.depth = gca->depth;
+  hdr.xsize = gca->xsize;
+  hdr.ysize = gca->ysize;
+  hdr.zsize = gca->zsize;
+  hdr.nnodes = nnodes;
+  hdr.ngcs = ngcs;
+  hdr.ngibbs = ngibbs;
+  hdr.npriors = npriors;
+  hdr.nplabels = nplabels;
+
+  fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    if (!was_packed) GCAunpack(gca);
+    ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "GCAwritePacked(%s): could not open file", fname));
+  }
+
+  // header goes in last, once the offsets are known
+  err = fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ? ERROR_BADFILE : NO_ERROR;
+
+  ibuf = (int32_t *)calloc(MAX(MAX(nnodes, npriors), ngcs) + 1, sizeof(int32_t));
+  sbuf = (int16_t *)calloc(ngcs + 1, sizeof(int16_t));
+  cbuf = (int8_t *)calloc(ngcs + 1, sizeof(int8_t));
+  if (!ibuf || !sbuf || !cbuf) ErrorExit(ERROR_NOMEMORY, "GCAwritePacked: could not allocate buffers");
+
+  for (i = 0; i < nnodes; i++) ibuf[i] = pack->nodes[i].nlabels;
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_NODE_NLABELS, ibuf, nnodes * sizeof(int32_t));
+  for (i = 0; i < nnodes; i++) ibuf[i] = pack->nodes[i].total_training;
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_NODE_TRAINING, ibuf, nnodes * sizeof(int32_t));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_NODE_LABELS, pack->node_labels, ngcs * sizeof(unsigned short));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GC_MEANS, pack->means, ngcs * gca->ninputs * sizeof(float));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GC_COVARS, pack->covars, ngcs * ncovars * sizeof(float));
+  for (i = 0; i < ngcs; i++) {
+    ibuf[i] = pack->gcs[i].ntraining;
+    sbuf[i] = pack->gcs[i].n_just_priors;
+    cbuf[i] = pack->gcs[i].regularized;
+  }
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GC_NTRAINING, ibuf, ngcs * sizeof(int32_t));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GC_NJUSTPRIORS, sbuf, ngcs * sizeof(int16_t));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GC_REGULARIZED, cbuf, ngcs * sizeof(int8_t));
+  if (!err)
+    err = gcapWriteSection(
+        fp, &hdr, GCAP_GIBBS_NLABELS, pack->gibbs_nlabels, hdr.have_gibbs ? ngcs * GIBBS_NEIGHBORHOOD * sizeof(short) : 0);
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GIBBS_LABELS, pack->gibbs_labels, ngibbs * sizeof(unsigned short));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_GIBBS_PRIORS, pack->gibbs_priors, ngibbs * sizeof(float));
+  for (i = 0; i < npriors; i++) ibuf[i] = pack->priors[i].nlabels;
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_PRIOR_NLABELS, ibuf, npriors * sizeof(int32_t));
+  for (i = 0; i < npriors; i++) ibuf[i] = pack->priors[i].total_training;
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_PRIOR_TRAINING, ibuf, npriors * sizeof(int32_t));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_PRIOR_LABELS, pack->prior_labels, nplabels * sizeof(unsigned short));
+  if (!err) err = gcapWriteSection(fp, &hdr, GCAP_PRIOR_PRIORS, pack->prior_priors, nplabels * sizeof(float));
+  free(ibuf);
+  free(sbuf);
+  free(cbuf);
+
+  hdr.file_size = ftell(fp);
+  if (!err && fseek(fp, 0, SEEK_SET) == 0) {
+    err = fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ? ERROR_BADFILE : NO_ERROR;
+  }
+  if (fclose(fp) != 0) {
+    err = ERROR_BADFILE;
+  }
+
+  // the colortable has its own serialization, append it after the arrays
+  if (!err && gca->ct) {
+    znzFile file = znzopen(fname, "ab", 0);
+    if (znz_isnull(file)) {
+      err = ERROR_BADFILE;
+    }
+    else {
+      znzCTABwriteIntoBinary(gca->ct, file);
+      znzclose(file);
+      hdr.ct_offset = hdr.file_size;
+      fp = fopen(fname, "r+b");
+      if (fp == NULL || fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        err = ERROR_BADFILE;
+      }
+      if (fp) fclose(fp);
+    }
+  }
+
+  if (!was_packed) {
+    GCAunpack(gca);
+  }
+  if (err) {
+    ErrorReturn(err, (err, "GCAwritePacked(%s): write failed (%s)", fname, strerror(errno)));
+  }
+  return (NO_ERROR);
+}
+
+/*!
+  \fn GCA *GCAreadPacked(const char *fname)
+  \brief Read a .gcp atlas by mapping it. Only the node/prior structs
+  (counts and pointers) are built in memory; labels, means, covariances
+  and priors are paged in from the file as they are touched and are
+  shared between all processes mapping the same atlas until one of them
+  modifies a value (copy on write).
+*/
+GCA *GCAreadPacked(const char *fname)
+{
+  GCAP_HEADER hdr;
+  GCA_PACK *pack;
+  GCA *gca;
+  struct stat st;
+  char *base;
+  const int32_t *node_nlabels, *node_training, *gc_ntraining, *prior_nlabels, *prior_training;
+  const int16_t *gc_njust;
+  const int8_t *gc_reg;
+  size_t i, g, b, p;
+  int fd, x, y, z, n, j, ncovars, bad = 0;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    ErrorReturn(NULL, (ERROR_NOFILE, "GCAreadPacked(%s): could not open file", fname));
+  }
+  if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) || memcmp(hdr.magic, GCAP_MAGIC, sizeof(GCAP_MAGIC))) {
+    close(fd);
+    ErrorReturn(NULL, (ERROR_BADFILE, "GCAreadPacked(%s): not a packed gca file", fname));
+  }
+  if (hdr.byteorder != GCAP_BYTEORDER || hdr.version != GCAP_VERSION) {
+    close(fd);
+    ErrorReturn(NULL,
+                (ERROR_BADFILE,
+                 "GCAreadPacked(%s): version %d/byte order %x not supported, "
+                 "regenerate it from the .gca with mri_gca_pack",
+                 fname,
+                 hdr.version,
+                 hdr.byteorder));
+  }
+  if (fstat(fd, &st) || (uint64_t)st.st_size < hdr.file_size || !gcapSectionsFit(&hdr)) {
+    close(fd);
+    ErrorReturn(NULL, (ERROR_BADFILE, "GCAreadPacked(%s): file truncated or corrupt", fname));
+  }
+  base = (char *)mmap(NULL, hdr.file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    ErrorReturn(NULL, (ERROR_NOMEMORY, "GCAreadPacked(%s): mmap failed (%s)", fname, strerror(errno)));
+  }
+
+  gca = gcaAllocMax(hdr.ninputs,
+                    hdr.prior_spacing,
+                    hdr.node_spacing,
+                    hdr.node_spacing * hdr.node_width,
+                    hdr.node_spacing * hdr.node_height,
+                    hdr.node_spacing * hdr.node_depth,
+                    -1,  // nodes and priors are set up below
+                    hdr.flags);
+  gca->node_width = hdr.node_width;
+  gca->node_height = hdr.node_height;
+  gca->node_depth = hdr.node_depth;
+  gca->prior_width = hdr.prior_width;
+  gca->prior_height = hdr.prior_height;
+  gca->prior_depth = hdr.prior_depth;
+  gca->type = hdr.type;
+  gca->max_label = hdr.max_label;
+  gca->total_training = hdr.total_training;
+  memcpy(gca->TRs, hdr.TRs, sizeof(hdr.TRs));
+  memcpy(gca->FAs, hdr.FAs, sizeof(hdr.FAs));
+  memcpy(gca->TEs, hdr.TEs, sizeof(hdr.TEs));
+
+  ncovars = (gca->ninputs * (gca->ninputs + 1)) / 2;
+  pack = (GCA_PACK *)calloc(1, sizeof(GCA_PACK));
+  if (pack == NULL) ErrorExit(ERROR_NOMEMORY, "GCAreadPacked: could not allocate pack");
+  pack->mapping = base;
+  pack->mapping_len = hdr.file_size;
+  pack->nbytes = hdr.file_size;
+  pack->nallocs = 1;
+
+  node_nlabels = (const int32_t *)(base + hdr.offset[GCAP_NODE_NLABELS]);
+  node_training = (const int32_t *)(base + hdr.offset[GCAP_NODE_TRAINING]);
+  gc_ntraining = (const int32_t *)(base + hdr.offset[GCAP_GC_NTRAINING]);
+  gc_njust = (const int16_t *)(base + hdr.offset[GCAP_GC_NJUSTPRIORS]);
+  gc_reg = (const int8_t *)(base + hdr.offset[GCAP_GC_REGULARIZED]);
+  prior_nlabels = (const int32_t *)(base + hdr.offset[GCAP_PRIOR_NLABELS]);
+  prior_training = (const int32_t *)(base + hdr.offset[GCAP_PRIOR_TRAINING]);
+  pack->node_labels = (unsigned short *)(base + hdr.offset[GCAP_NODE_LABELS]);
+  pack->means = (float *)(base + hdr.offset[GCAP_GC_MEANS]);
+  pack->covars = (float *)(base + hdr.offset[GCAP_GC_COVARS]);
+  if (hdr.have_gibbs) {
+    pack->gibbs_nlabels = (short *)(base + hdr.offset[GCAP_GIBBS_NLABELS]);
+    pack->gibbs_labels = (unsigned short *)(base + hdr.offset[GCAP_GIBBS_LABELS]);
+    pack->gibbs_priors = (float *)(base + hdr.offset[GCAP_GIBBS_PRIORS]);
+  }
+  pack->prior_labels = (unsigned short *)(base + hdr.offset[GCAP_PRIOR_LABELS]);
+  pack->prior_priors = (float *)(base + hdr.offset[GCAP_PRIOR_PRIORS]);
+
+  pack->node_cols = (GCA_NODE ***)gcaPackAlloc(pack, gca->node_width, sizeof(GCA_NODE **));
+  pack->node_rows = (GCA_NODE **)gcaPackAlloc(pack, (size_t)gca->node_width * gca->node_height, sizeof(GCA_NODE *));
+  pack->nodes = (GCA_NODE *)gcaPackAlloc(pack, hdr.nnodes, sizeof(GCA_NODE));
+  pack->gcs = (GC1D *)gcaPackAlloc(pack, hdr.ngcs, sizeof(GC1D));
+  if (hdr.have_gibbs) {
+    pack->gibbs_label_ptrs =
+        (unsigned short **)gcaPackAlloc(pack, hdr.ngcs * GIBBS_NEIGHBORHOOD, sizeof(unsigned short *));
+    pack->gibbs_prior_ptrs = (float **)gcaPackAlloc(pack, hdr.ngcs * GIBBS_NEIGHBORHOOD, sizeof(float *));
+  }
+  pack->prior_cols = (GCA_PRIOR ***)gcaPackAlloc(pack, gca->prior_width, sizeof(GCA_PRIOR **));
+  pack->prior_rows =
+      (GCA_PRIOR **)gcaPackAlloc(pack, (size_t)gca->prior_width * gca->prior_height, sizeof(GCA_PRIOR *));
+  pack->priors = (GCA_PRIOR *)gcaPackAlloc(pack, hdr.npriors, sizeof(GCA_PRIOR));
+  gca->nodes = pack->node_cols;
+  gca->priors = pack->prior_cols;
+  gca->pack = pack;
+
+  // point the node and gc structs into the mapping; this only reads the
+  // count arrays, the data itself is paged in on first use
+  for (i = g = b = 0, x = 0; x < gca->node_width; x++) {
+    pack->node_cols[x] = &pack->node_rows[(size_t)x * gca->node_height];
+    for (y = 0; y < gca->node_height; y++) {
+      pack->node_cols[x][y] = &pack->nodes[i];
+      for (z = 0; z < gca->node_depth; z++, i++) {
+        GCA_NODE *gcan = &pack->nodes[i];
+
+        gcan->nlabels = gcan->max_labels = node_nlabels[i];
+        gcan->total_training = node_training[i];
+        if (gcan->nlabels < 0 || g + gcan->nlabels > hdr.ngcs) {
+          gcan->nlabels = gcan->max_labels = 0;
+          bad = 1;
+        }
+        if (gcan->nlabels == 0) {
+          continue;
+        }
+        gcan->labels = &pack->node_labels[g];
+        gcan->gcs = &pack->gcs[g];
+        for (n = 0; n < gcan->nlabels; n++, g++) {
+          GC1D *gc = &pack->gcs[g];
+
+          gc->means = &pack->means[g * gca->ninputs];
+          gc->covars = &pack->covars[g * ncovars];
+          gc->ntraining = gc_ntraining[g];
+          gc->n_just_priors = gc_njust[g];
+          gc->regularized = gc_reg[g];
+          if (!hdr.have_gibbs) {
+            continue;
+          }
+          gc->nlabels = &pack->gibbs_nlabels[g * GIBBS_NEIGHBORHOOD];
+          gc->labels = &pack->gibbs_label_ptrs[g * GIBBS_NEIGHBORHOOD];
+          gc->label_priors = &pack->gibbs_prior_ptrs[g * GIBBS_NEIGHBORHOOD];
+          for (j = 0; j < GIBBS_NEIGHBORHOOD; j++) {
+            gc->labels[j] = &pack->gibbs_labels[b];
+            gc->label_priors[j] = &pack->gibbs_priors[b];
+            b += gc->nlabels[j];
+          }
+        }
+      }
+    }
+  }
+  for (i = p = 0, x = 0; x < gca->prior_width; x++) {
+    pack->prior_cols[x] = &pack->prior_rows[(size_t)x * gca->prior_height];
+    for (y = 0; y < gca->prior_height; y++) {
+      pack->prior_cols[x][y] = &pack->priors[i];
+      for (z = 0; z < gca->prior_depth; z++, i++) {
+        GCA_PRIOR *gcap = &pack->priors[i];
+
+        gcap->nlabels = gcap->max_labels = prior_nlabels[i];
+        gcap->total_training = prior_training[i];
+        if (gcap->nlabels < 0 || p + gcap->nlabels > hdr.nplabels) {
+          gcap->nlabels = gcap->max_labels = 0;
+          bad = 1;
+        }
+        gcap->labels = &pack->prior_labels[p];
+        gcap->priors = &pack->prior_priors[p];
+        p += gcap->nlabels;
+      }
+    }
+  }
+  if (bad || g != hdr.ngcs || b != hdr.ngibbs || p != hdr.nplabels) {
+    GCAfree(&gca);
+    ErrorReturn(NULL, (ERROR_BADFILE, "GCAreadPacked(%s): inconsistent label counts", fname));
+  }
+
+  if (hdr.ct_offset) {
+    znzFile file = znzopen(fname, "rb", 0);
+    if (!znz_isnull(file)) {
+      if (znzseek(file, hdr.ct_offset, SEEK_SET) == 0) {
+        gca->ct = znzCTABreadFromBinary(file);
+      }
+      znzclose(file);
+    }
+    if (gca->ct == NULL) ErrorPrintf(ERROR_BADFILE, "GCAreadPacked(%s): could not read colortable", fname);
+  }
+
+  gca->x_r = hdr.x_r;
+  gca->x_a = hdr.x_a;
+  gca->x_s = hdr.x_s;
+  gca->y_r = hdr.y_r;
+  gca->y_a = hdr.y_a;
+  gca->y_s = hdr.y_s;
+  gca->z_r = hdr.z_r;
+  gca->z_a = hdr.z_a;
+  gca->z_s = hdr.z_s;
+  gca->c_r = hdr.c_r;
+  gca->c_a = hdr.c_a;
+  gca->c_s = hdr.c_s;
+  gca->width = hdr.width;
+  gca->height = hdr.height;
+  gca->depth = hdr.depth;
+  gca->xsize = hdr.xsize;
+  gca->ysize = hdr.ysize;
+  gca->zsize = hdr.zsize;
+  GCAsetup(gca);
+
+  return (gca);
+}
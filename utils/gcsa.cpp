@@ -24,6 +24,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #include "mrisurf.h"
 #include "mrisurf_project.h"
@@ -38,6 +39,7 @@
 #include "macros.h"
 #include "mrishash.h"
 #include "proto.h"
+#include "romp_support.h"
 #include "tags.h"
 #include "transform.h"
 #include "utils.h"
@@ -54,9 +56,19 @@ static int MRIScomputeVertexPermutation(MRI_SURFACE *mris, int *indices);
 static int GCSAupdateNodeMeans(GCSA_NODE *gcsan, int label, double *v_inputs, int ninputs);
 static int GCSAupdateNodeGibbsPriors(CP_NODE *cpn, int label, MRI_SURFACE *mris, int vno);
 static int GCSAupdateNodeCovariance(GCSA_NODE *gcsan, int label, double *v_inputs, int ninputs);
+
+// prior and classifier node of every vertex of the surface being labeled,
+// looked up once instead of for every likelihood evaluation
+typedef struct
+{
+  std::vector<int> vno_prior, vno_classifier;
+} GCSA_NODE_MAP;
+static void gcsaMapNodes(GCSA *gcsa, MRI_SURFACE *mris, GCSA_NODE_MAP *nodes);
+
 static double gcsaNbhdGibbsLogLikelihood(
-    GCSA *gcsa, MRI_SURFACE *mris, double *v_inputs, int vno, double gibbs_coef, int label);
-static double gcsaVertexGibbsLogLikelihood(GCSA *gcsa, MRI_SURFACE *mris, double const *v_inputs, int vno, double gibbs_coef);
+    GCSA *gcsa, MRI_SURFACE *mris, GCSA_NODE_MAP const *nodes, double *v_inputs, int vno, double gibbs_coef, int label);
+static double gcsaVertexGibbsLogLikelihood(
+    GCSA *gcsa, MRI_SURFACE *mris, GCSA_NODE_MAP const *nodes, double const *v_inputs, int vno, double gibbs_coef);
 static int add_gc_to_gcsan(GCSA_NODE *gcsan_src, int nsrc, GCSA_NODE *gcsan_dst);
 
 GCSA *GCSAalloc(int ninputs, int icno_priors, int icno_classifiers)
@@ -950,30 +962,32 @@ int GCSAbuildMostLikelyLabels(GCSA *gcsa, MRI_SURFACE *mris)
 static int Gvno = -1;
 MRI *GCSAlabel(GCSA *gcsa, MRI_SURFACE *mris)
 {
-  int vno, vno_classifier, label, vno_prior;
-  VERTEX *v, *v_classifier, *v_prior;
-  GCSA_NODE *gcsan;
-  CP_NODE *cpn;
-  double v_inputs[100], p[3];
-
   MRI *probabilities = MRIallocSequence(mris->nvertices,1,1,MRI_FLOAT,3);
 
+  // the vertices are classified independently
+  int vno;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(guided)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
-    v = &mris->vertices[vno];
-    if (v->ripflag) continue;
+    ROMP_PFLB_begin
+    VERTEX *v = &mris->vertices[vno];
+    if (v->ripflag) ROMP_PFLB_continue;
     if (vno == Gdiag_no) DiagBreak();
+    double v_inputs[100], p[3];
     GCSAload_inputs(v_inputs, gcsa->inputvals, vno);
 
-    v_prior = GCSAsourceToPriorVertex(gcsa, v);
-    vno_prior = v_prior - gcsa->mris_priors->vertices;
+    VERTEX *v_prior = GCSAsourceToPriorVertex(gcsa, v);
+    int vno_prior = v_prior - gcsa->mris_priors->vertices;
     if (vno_prior == Gdiag_no) DiagBreak();
-    v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
-    vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
+    VERTEX *v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
+    int vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
     if (vno_classifier == Gdiag_no) DiagBreak();
-    gcsan = &gcsa->gc_nodes[vno_classifier];
+    GCSA_NODE *gcsan = &gcsa->gc_nodes[vno_classifier];
 
-    cpn = &gcsa->cp_nodes[vno_prior];
-    label = GCSANclassify(gcsan, cpn, v_inputs, gcsa->ninputs, p, NULL, 0, vno);
+    CP_NODE *cpn = &gcsa->cp_nodes[vno_prior];
+    int label = GCSANclassify(gcsan, cpn, v_inputs, gcsa->ninputs, p, NULL, 0, vno);
     v->annotation = label;
     //v->val2 = p ; // posterior prob in val2
     for(int k=0; k < 3; k++) MRIsetVoxVal(probabilities,vno,0,0,k,p[k]);
@@ -991,7 +1005,9 @@ MRI *GCSAlabel(GCSA *gcsa, MRI_SURFACE *mris)
         MatrixPrint(stdout, gcs->v_means);
       }
     } // diag
+    ROMP_PFLB_end
   } //vertex
+  ROMP_PF_end
 
   //MRIwrite(probabilities,"probabilities.mgz");
 
@@ -1007,8 +1023,8 @@ int GCSANclassify(GCSA_NODE *gcsan, CP_NODE *cpn, double *v_inputs, int ninputs,
 
   CP *cp;
   GCS *gcs;
-  static MATRIX *m_cov_inv = NULL;
-  static VECTOR *v_tmp = NULL, *v_x = NULL;
+  static thread_local MATRIX *m_cov_inv = NULL;
+  static thread_local VECTOR *v_tmp = NULL, *v_x = NULL;
 
   if (v_x && ninputs != v_x->rows) {
     MatrixFree(&m_cov_inv);
@@ -1295,17 +1311,143 @@ static int edge_to_index(VERTEX const * const v, VERTEX const * const vn)
 
 int gcsa_write_iterations = 0;
 char *gcsa_write_fname = NULL;
+int gcsa_parallel_icm = 0;
+
+static void gcsaMapNodes(GCSA *gcsa, MRI_SURFACE *mris, GCSA_NODE_MAP *nodes)
+{
+  nodes->vno_prior.resize(mris->nvertices);
+  nodes->vno_classifier.resize(mris->nvertices);
+
+  int vno;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
+    VERTEX const * const v_prior = GCSAsourceToPriorVertex(gcsa, &mris->vertices[vno]);
+    nodes->vno_prior[vno] = v_prior - gcsa->mris_priors->vertices;
+    VERTEX const * const v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
+    nodes->vno_classifier[vno] = v_classifier - gcsa->mris_classifiers->vertices;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/*
+  Greedy colouring of the vertices such that no two vertices of a colour are
+  within two edges of each other. Relabeling a vertex reads the labels of its
+  neighbours and of their neighbours, so all the vertices of one colour can be
+  relabeled at the same time. Returns the vertices grouped by colour, colour c
+  being vertices[colstart[c] .. colstart[c+1]-1].
+*/
+static void gcsaColorSecondNbhd(MRI_SURFACE *mris, std::vector<int> &colstart, std::vector<int> &vertices)
+{
+  std::vector<int> color(mris->nvertices, -1), used;
+  int ncolors = 0;
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX_TOPOLOGY const * const vt = &mris->vertices_topology[vno];
+    used.assign(ncolors + 1, 0);
+    for (int n = 0; n < vt->vnum; n++) {
+      VERTEX_TOPOLOGY const * const vnt = &mris->vertices_topology[vt->v[n]];
+      if (color[vt->v[n]] >= 0) used[color[vt->v[n]]] = 1;
+      for (int n2 = 0; n2 < vnt->vnum; n2++)
+        if (color[vnt->v[n2]] >= 0) used[color[vnt->v[n2]]] = 1;
+    }
+    int c = 0;
+    while (used[c]) c++;
+    color[vno] = c;
+    if (c == ncolors) ncolors++;
+  }
+
+  colstart.assign(ncolors + 1, 0);
+  for (int vno = 0; vno < mris->nvertices; vno++) colstart[color[vno] + 1]++;
+  for (int c = 0; c < ncolors; c++) colstart[c + 1] += colstart[c];
+  vertices.resize(mris->nvertices);
+  std::vector<int> next(colstart.begin(), colstart.end() - 1);
+  for (int vno = 0; vno < mris->nvertices; vno++) vertices[next[color[vno]]++] = vno;
+}
+
+/*
+  One ICM step at a marked vertex: gives it the label that maximizes the
+  Gibbs likelihood of its neighbourhood. Returns 1 if the label changed and
+  counts the vertex in *examined if it was marked.
+*/
+static int gcsaReclassifyVertexUsingGibbsPriors(
+    GCSA *gcsa, MRI_SURFACE *mris, GCSA_NODE_MAP const *nodes, int vno, int *examined)
+{
+  VERTEX* const v = &mris->vertices[vno];
+  if (v->marked == 0) return (0);
+  v->marked = 0;
+  (*examined)++;
+
+  if (vno == Gdiag_no) DiagBreak();
 
+  double v_inputs[100];
+  GCSAload_inputs(v_inputs, gcsa->inputvals, vno);
+
+  int const vno_prior = nodes->vno_prior[vno];
+  if (vno_prior == Gdiag_no) DiagBreak();
+  CP_NODE const * const cpn = &gcsa->cp_nodes[vno_prior];
+  if (cpn->nlabels <= 1) return (0);
+
+  if (nodes->vno_classifier[vno] == Gdiag_no) DiagBreak();
+
+  int best_label, old_label;
+  best_label = old_label = v->annotation;
+  if (vno == Gdiag_no) printf("reclassifying vertex %d...\n", vno);
+  double max_ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, nodes, v_inputs, vno, 1.0, old_label);
+  for (int n = 0; n < cpn->nlabels; n++) {
+    int const label = cpn->labels[n];
+    double const ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, nodes, v_inputs, vno, 1.0, label);
+    if (vno == Gdiag_no)
+      printf("\tlabel %s (%d, %d): ll=%2.3f\n",
+             annotation_to_name(label, NULL),
+             label,
+             annotation_to_index(label),
+             ll);
+    if (ll > max_ll) {
+      max_ll = ll;
+      best_label = label;
+      if (vno == Gdiag_no) printf("\tlabel %s NEW MAX\n", annotation_to_name(label, NULL));
+    }
+  }
+  if (best_label == old_label) return (0);
+
+  if (vno == Gdiag_no)
+    printf("v %d: label changed from %s (%d) to %s (%d)\n",
+           vno,
+           annotation_to_name(old_label, NULL),
+           old_label,
+           annotation_to_name(best_label, NULL),
+           best_label);
+  v->marked = 1;
+  v->annotation = best_label;
+  return (1);
+}
+
+/*
+  Iterated conditional modes relabeling with the Gibbs priors. By default the
+  vertices are visited serially in a new random order every iteration, which
+  is what the results have always been computed with. If gcsa_parallel_icm is
+  set, each iteration instead sweeps over the colours of gcsaColorSecondNbhd()
+  and relabels the vertices of a colour in parallel. That does not use the
+  random number generator and gives the same labels for any number of
+  threads, but not the labels of the serial order.
+*/
 int GCSAreclassifyUsingGibbsPriors(GCSA *gcsa, MRI_SURFACE *mris)
 {
   int *indices;
-  int n, vno, i, nchanged, label, best_label, old_label, vno_prior, vno_classifier, niter, examined;
-  double ll, max_ll;
-  // GCSA_NODE *gcsan;
-  CP_NODE *cpn;
-  double v_inputs[100];
+  int n, vno, i, nchanged, niter, examined;
+  GCSA_NODE_MAP nodes;
+  std::vector<int> colstart, colvertices;
 
   indices = (int *)calloc(mris->nvertices, sizeof(int));
+  gcsaMapNodes(gcsa, mris, &nodes);
+  if (gcsa_parallel_icm) {
+    gcsaColorSecondNbhd(mris, colstart, colvertices);
+    printf("relabeling %d colors of vertices in parallel\n", (int)colstart.size() - 1);
+  }
 
   niter = 0;
   if (gcsa_write_iterations != 0) {
@@ -1320,58 +1462,23 @@ int GCSAreclassifyUsingGibbsPriors(GCSA *gcsa, MRI_SURFACE *mris)
   do {
     nchanged = 0;
     examined = 0;
-    MRIScomputeVertexPermutation(mris, indices);
-    for (i = 0; i < mris->nvertices; i++) {
-      vno = indices[i];
-      VERTEX* const v = &mris->vertices[vno];
-      if (v->marked == 0) continue;
-      v->marked = 0;
-      examined++;
-
-      if (vno == Gdiag_no) DiagBreak();
-
-      GCSAload_inputs(v_inputs, gcsa->inputvals, vno);
-
-      VERTEX const * const v_prior = GCSAsourceToPriorVertex(gcsa, v);
-      vno_prior = v_prior - gcsa->mris_priors->vertices;
-      if (vno_prior == Gdiag_no) DiagBreak();
-      cpn = &gcsa->cp_nodes[vno_prior];
-      if (cpn->nlabels <= 1) continue;
-
-      VERTEX const * const v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
-      vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
-      // gcsan = &gcsa->gc_nodes[vno_classifier];
-      if (vno_classifier == Gdiag_no) DiagBreak();
-
-      best_label = old_label = v->annotation;
-      if (vno == Gdiag_no) printf("reclassifying vertex %d...\n", vno);
-      max_ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, old_label);
-      for (n = 0; n < cpn->nlabels; n++) {
-        label = cpn->labels[n];
-        ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, label);
-        if (vno == Gdiag_no)
-          printf("\tlabel %s (%d, %d): ll=%2.3f\n",
-                 annotation_to_name(label, NULL),
-                 label,
-                 annotation_to_index(label),
-                 ll);
-        if (ll > max_ll) {
-          max_ll = ll;
-          best_label = label;
-          if (vno == Gdiag_no) printf("\tlabel %s NEW MAX\n", annotation_to_name(label, NULL));
+    if (!gcsa_parallel_icm) {
+      MRIScomputeVertexPermutation(mris, indices);
+      for (i = 0; i < mris->nvertices; i++)
+        nchanged += gcsaReclassifyVertexUsingGibbsPriors(gcsa, mris, &nodes, indices[i], &examined);
+    }
+    else {
+      for (int c = 0; c + 1 < (int)colstart.size(); c++) {
+        ROMP_PF_begin
+#ifdef HAVE_OPENMP
+        #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : nchanged, examined) schedule(dynamic, 64)
+#endif
+        for (i = colstart[c]; i < colstart[c + 1]; i++) {
+          ROMP_PFLB_begin
+          nchanged += gcsaReclassifyVertexUsingGibbsPriors(gcsa, mris, &nodes, colvertices[i], &examined);
+          ROMP_PFLB_end
         }
-      }
-      if (best_label != old_label) {
-        if (vno == Gdiag_no)
-          printf("v %d: label changed from %s (%d) to %s (%d)\n",
-                 vno,
-                 annotation_to_name(old_label, NULL),
-                 old_label,
-                 annotation_to_name(best_label, NULL),
-                 best_label);
-        v->marked = 1;
-        nchanged++;
-        v->annotation = best_label;
+        ROMP_PF_end
       }
     }
     printf("%03d: %6d changed, %d examined...\n", niter, nchanged, examined);
@@ -1415,8 +1522,11 @@ int MRIScomputeVertexPermutation(MRI_SURFACE *mris, int *indices)
   return (NO_ERROR);
 }
 
+/*
+  nodes may be NULL, then the prior and classifier nodes are looked up
+*/
 static double gcsaNbhdGibbsLogLikelihood(
-    GCSA *gcsa, MRI_SURFACE *mris, double *v_inputs, int const vno, double gibbs_coef, int label)
+    GCSA *gcsa, MRI_SURFACE *mris, GCSA_NODE_MAP const *nodes, double *v_inputs, int const vno, double gibbs_coef, int label)
 {
   VERTEX_TOPOLOGY const * const vt = &mris->vertices_topology[vno];
   VERTEX                * const v  = &mris->vertices[vno];
@@ -1424,12 +1534,12 @@ static double gcsaNbhdGibbsLogLikelihood(
   int old_annotation = v->annotation;
   v->annotation = label;
 
-  double total_ll = gcsaVertexGibbsLogLikelihood(gcsa, mris, v_inputs, vno, gibbs_coef);
+  double total_ll = gcsaVertexGibbsLogLikelihood(gcsa, mris, nodes, v_inputs, vno, gibbs_coef);
 
   int n;
   for (n = 0; n < vt->vnum; n++) {
     double ll = 
-    	gcsaVertexGibbsLogLikelihood(gcsa, mris, v_inputs, vt->v[n], gibbs_coef);
+    	gcsaVertexGibbsLogLikelihood(gcsa, mris, nodes, v_inputs, vt->v[n], gibbs_coef);
     total_ll += ll;
   }
 
@@ -1441,12 +1551,13 @@ static double gcsaNbhdGibbsLogLikelihood(
 static double gcsaVertexGibbsLogLikelihood(
     GCSA         * const gcsa, 
     MRI_SURFACE  * const mris, 
+    GCSA_NODE_MAP const * const nodes,
     double const * const v_inputs, 
     int            const vno, 
     double  	   const gibbs_coef)
 {
-  static MATRIX *m_cov_inv = NULL;
-  static VECTOR *v_tmp = NULL, *v_x = NULL;
+  static thread_local MATRIX *m_cov_inv = NULL;
+  static thread_local VECTOR *v_tmp = NULL, *v_x = NULL;
 
   if (v_x && gcsa->ninputs != v_x->cols) {
     MatrixFree(&m_cov_inv);
@@ -1457,16 +1568,21 @@ static double gcsaVertexGibbsLogLikelihood(
   VERTEX_TOPOLOGY const * const vt = &mris->vertices_topology[vno];
   VERTEX          const * const v  = &mris->vertices         [vno];
 
-  VERTEX const * const v_prior = GCSAsourceToPriorVertex(gcsa, v);
-  int const vno_prior = v_prior - gcsa->mris_priors->vertices;
+  int vno_prior, vno_classifier;
+  if (nodes) {
+    vno_prior = nodes->vno_prior[vno];
+    vno_classifier = nodes->vno_classifier[vno];
+  }
+  else {
+    VERTEX const * const v_prior = GCSAsourceToPriorVertex(gcsa, v);
+    vno_prior = v_prior - gcsa->mris_priors->vertices;
+    VERTEX const * const v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
+    vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
+  }
   if (vno_prior == Gdiag_no) DiagBreak();
 
   CP_NODE * const cpn = &gcsa->cp_nodes[vno_prior];
 
-  VERTEX const * const v_classifier = 
-    GCSAsourceToClassifierVertex(gcsa, v_prior);
-    
-  int const vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
   if (vno_classifier == Gdiag_no) DiagBreak();
 
   GCSA_NODE * const gcsan = &gcsa->gc_nodes[vno_classifier];
@@ -1577,7 +1693,7 @@ int GCSAreclassifyLabel(GCSA *gcsa, MRI_SURFACE *mris, LABEL *area)
         VERTEX const * const vn = &mris->vertices[vt->v[n]];
         if (vn->annotation == annotation) continue;
         ;
-        ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, vn->annotation);
+        ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, NULL, v_inputs, vno, 1.0, vn->annotation);
 
         // if likelihood increased, or annotation is still at its
         // initial (v->annotation) value
@@ -0,0 +1,480 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "mgzblock.h"
+#include "bfileio.h"
+#include "const.h"
+#include "error.h"
+#include "log.h"
+#include "mghendian.h"
+#include "romp_support.h"
+
+// gzip member header: magic, CM=deflate, FLG=FEXTRA, MTIME=0, XFL=0, OS=unknown,
+// XLEN=8, then the 'FS' subfield (SLEN=4) holding the total member size
+#define MGZBLOCK_HEADER_SIZE  20
+#define MGZBLOCK_TRAILER_SIZE 8
+
+// last record of the sidecar: 'FSGZ', mgz size, gzip trailer of its last member
+#define MGZBLOCK_CHECK_SIZE   (4 + 8 + MGZBLOCK_TRAILER_SIZE)
+
+static void mgzblockPutLE32(unsigned char *p, unsigned int v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+static unsigned int mgzblockGetLE32(const unsigned char *p)
+{
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void mgzblockPutLE64(unsigned char *p, unsigned long long v)
+{
+  for (int n = 0; n < 8; n++) p[n] = (v >> (8 * n)) & 0xff;
+}
+
+static unsigned long long mgzblockGetLE64(const unsigned char *p)
+{
+  unsigned long long v = 0;
+  for (int n = 7; n >= 0; n--) v = (v << 8) | p[n];
+  return v;
+}
+
+// size and gzip trailer (CRC32, ISIZE) of the last member of fname
+static int mgzblockFileCheck(const char *fname, unsigned char *check)
+{
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) return (ERROR_NOFILE);
+  int err = ERROR_BADFILE;
+  if (fseeko(fp, 0, SEEK_END) == 0) {
+    off_t size = ftello(fp);
+    if (size >= MGZBLOCK_TRAILER_SIZE && fseeko(fp, size - MGZBLOCK_TRAILER_SIZE, SEEK_SET) == 0 &&
+        fread(&check[12], 1, MGZBLOCK_TRAILER_SIZE, fp) == MGZBLOCK_TRAILER_SIZE) {
+      memcpy(check, "FSGZ", 4);
+      mgzblockPutLE64(&check[4], size);
+      err = NO_ERROR;
+    }
+  }
+  fclose(fp);
+  return (err);
+}
+
+// mgz voxel data is big-endian
+static void mgzblockSwap(void *buf, size_t nbytes, int swapsize)
+{
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  if (swapsize == 2) byteswapbufshort(buf, nbytes);
+  if (swapsize == 4 || swapsize == 8) byteswapbuffloat(buf, nbytes);
+#endif
+}
+
+
+/*!
+  \fn int MGZBLOCKenabled(void)
+  \brief Returns 1 if mgz files should be written in block-gzip format
+  (FS_MGZIO_BLOCKGZIP set to anything but 0).
+*/
+int MGZBLOCKenabled(void)
+{
+  const char *s = getenv("FS_MGZIO_BLOCKGZIP");
+  if (s == NULL) return (0);
+  return (strcmp(s, "0") != 0);
+}
+
+
+/*!
+  \fn size_t MGZBLOCKblockSize(void)
+  \brief Uncompressed block size, from FS_MGZIO_BLOCKSIZE if set. Always a
+  multiple of 8 so that no voxel straddles two blocks.
+*/
+size_t MGZBLOCKblockSize(void)
+{
+  size_t blocksize = MGZBLOCK_DEFAULT_BLOCKSIZE;
+  const char *s = getenv("FS_MGZIO_BLOCKSIZE");
+  if (s != NULL) {
+    long long b = atoll(s);
+    if (b > 0) blocksize = (size_t)b;
+  }
+  blocksize = std::min(blocksize, (size_t)MGZBLOCK_MAX_BLOCKSIZE);
+  blocksize = std::max(blocksize - blocksize % 8, (size_t)8);
+  return (blocksize);
+}
+
+
+char *MGZBLOCKindexName(const char *fname, char *indexname)
+{
+  sprintf(indexname, "%s.gzi", fname);
+  return (indexname);
+}
+
+
+/*!
+  \fn void MGZBLOCKremoveIndex(const char *fname)
+  \brief Removes a sidecar index left over from a previous block-gzip write
+  of fname so that it can not be applied to the new file.
+*/
+void MGZBLOCKremoveIndex(const char *fname)
+{
+  char indexname[STRLEN + 8];
+  if (strlen(fname) >= STRLEN) return;
+  MGZBLOCKindexName(fname, indexname);
+  unlink(indexname);
+}
+
+
+// deflate one block into a complete gzip member
+static int mgzblockDeflate(const unsigned char *src, size_t nbytes, std::vector<unsigned char> &member)
+{
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return (ERROR_NOMEMORY);
+
+  member.resize(MGZBLOCK_HEADER_SIZE + deflateBound(&strm, nbytes) + MGZBLOCK_TRAILER_SIZE);
+  strm.next_in = (Bytef *)src;
+  strm.avail_in = nbytes;
+  strm.next_out = &member[MGZBLOCK_HEADER_SIZE];
+  strm.avail_out = member.size() - MGZBLOCK_HEADER_SIZE - MGZBLOCK_TRAILER_SIZE;
+  int ret = deflate(&strm, Z_FINISH);
+  size_t csize = strm.total_out;
+  deflateEnd(&strm);
+  if (ret != Z_STREAM_END) return (ERROR_BADFILE);
+
+  size_t msize = MGZBLOCK_HEADER_SIZE + csize + MGZBLOCK_TRAILER_SIZE;
+  member.resize(msize);
+
+  unsigned char *h = &member[0];
+  memset(h, 0, MGZBLOCK_HEADER_SIZE);
+  h[0] = 0x1f;
+  h[1] = 0x8b;
+  h[2] = Z_DEFLATED;
+  h[3] = 0x04;  // FEXTRA
+  h[9] = 0xff;  // OS unknown
+  h[10] = 8;    // XLEN
+  h[12] = 'F';
+  h[13] = 'S';
+  h[14] = 4;    // SLEN
+  mgzblockPutLE32(&h[16], msize);
+
+  unsigned char *t = &member[msize - MGZBLOCK_TRAILER_SIZE];
+  mgzblockPutLE32(t, crc32(crc32(0L, Z_NULL, 0), src, nbytes));
+  mgzblockPutLE32(t + 4, nbytes);
+
+  return (NO_ERROR);
+}
+
+
+// inflate one gzip member written by mgzblockDeflate into dst (exactly nbytes)
+static int mgzblockInflate(const unsigned char *member, size_t msize, unsigned char *dst, size_t nbytes)
+{
+  if (msize < MGZBLOCK_HEADER_SIZE + MGZBLOCK_TRAILER_SIZE) return (ERROR_BADFILE);
+  if (member[0] != 0x1f || member[1] != 0x8b || member[3] != 0x04 || member[12] != 'F' || member[13] != 'S')
+    return (ERROR_BADFILE);
+  if (mgzblockGetLE32(&member[16]) != msize) return (ERROR_BADFILE);
+
+  const unsigned char *t = &member[msize - MGZBLOCK_TRAILER_SIZE];
+  if (mgzblockGetLE32(t + 4) != nbytes) return (ERROR_BADFILE);
+
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) return (ERROR_NOMEMORY);
+  strm.next_in = (Bytef *)&member[MGZBLOCK_HEADER_SIZE];
+  strm.avail_in = msize - MGZBLOCK_HEADER_SIZE - MGZBLOCK_TRAILER_SIZE;
+  strm.next_out = dst;
+  strm.avail_out = nbytes;
+  int ret = inflate(&strm, Z_FINISH);
+  size_t usize = strm.total_out;
+  inflateEnd(&strm);
+  if (ret != Z_STREAM_END || usize != nbytes) return (ERROR_BADFILE);
+
+  if (mgzblockGetLE32(t) != crc32(crc32(0L, Z_NULL, 0), dst, nbytes)) return (ERROR_BADFILE);
+
+  return (NO_ERROR);
+}
+
+
+/*!
+  \fn int MGZBLOCKwriteData(const char *fname, const void *data, size_t nbytes, int swapsize,
+                            unsigned long long uoffset, MGZBLOCK_INDEX *index)
+  \brief Appends data to fname as a series of independently compressed gzip
+  members. Blocks are compressed in parallel, a batch at a time, and written
+  in order. The input is not modified; byte swapping to big-endian (swapsize
+  2, 4 or 8) is done on a per-thread copy of each block.
+  \param uoffset - uncompressed offset of data within the whole gzip stream
+  \param index - receives an entry for every member written, plus one for
+  the member that will follow (the mgz trailer)
+*/
+int MGZBLOCKwriteData(const char *fname, const void *data, size_t nbytes, int swapsize,
+                      unsigned long long uoffset, MGZBLOCK_INDEX *index)
+{
+  FILE *fp = fopen(fname, "ab");
+  if (fp == NULL) ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MGZBLOCKwriteData(): could not open %s", fname));
+  fseeko(fp, 0, SEEK_END);
+  unsigned long long coffset = ftello(fp);
+
+  size_t blocksize = MGZBLOCKblockSize();
+  size_t nblocks = (nbytes + blocksize - 1) / blocksize;
+  int nthreads = omp_get_max_threads();
+  size_t batch = std::max((size_t)1, (size_t)(4 * nthreads));
+
+  std::vector<std::vector<unsigned char> > members(std::min(batch, std::max(nblocks, (size_t)1)));
+  std::vector<std::vector<unsigned char> > swapbuf(nthreads);
+  const unsigned char *src = (const unsigned char *)data;
+
+  for (size_t b0 = 0; b0 < nblocks; b0 += batch) {
+    size_t b1 = std::min(nblocks, b0 + batch);
+    int err = NO_ERROR;
+
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) reduction(max: err)
+#endif
+    for (long b = (long)b0; b < (long)b1; b++) {
+      size_t start = (size_t)b * blocksize;
+      size_t len = std::min(blocksize, nbytes - start);
+      const unsigned char *block = src + start;
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+      if (swapsize > 1) {
+        std::vector<unsigned char> &tmp = swapbuf[omp_get_thread_num()];
+        tmp.assign(block, block + len);
+        mgzblockSwap(&tmp[0], len, swapsize);
+        block = &tmp[0];
+      }
+#endif
+      int e = mgzblockDeflate(block, len, members[b - b0]);
+      if (e != NO_ERROR) err = std::max(err, e);
+    }
+    if (err != NO_ERROR) {
+      fclose(fp);
+      ErrorReturn(err, (err, "MGZBLOCKwriteData(): could not compress %s", fname));
+    }
+
+    for (size_t b = b0; b < b1; b++) {
+      std::vector<unsigned char> &member = members[b - b0];
+      index->coffset.push_back(coffset);
+      index->uoffset.push_back(uoffset + b * blocksize);
+      if (fwrite(&member[0], 1, member.size(), fp) != member.size()) {
+        fclose(fp);
+        ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MGZBLOCKwriteData(): could not write to %s", fname));
+      }
+      coffset += member.size();
+    }
+  }
+
+  if (fclose(fp) != 0) ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MGZBLOCKwriteData(): could not close %s", fname));
+
+  // start of the member that follows the voxel data
+  index->coffset.push_back(coffset);
+  index->uoffset.push_back(uoffset + nbytes);
+
+  return (NO_ERROR);
+}
+
+
+/*!
+  \fn int MGZBLOCKwriteIndex(const char *fname, const MGZBLOCK_INDEX *index)
+  \brief Writes the bgzip-style sidecar index <fname>.gzi. fname must be
+  complete, its size and final gzip trailer are recorded in the index.
+*/
+int MGZBLOCKwriteIndex(const char *fname, const MGZBLOCK_INDEX *index)
+{
+  char indexname[STRLEN + 8];
+  if (strlen(fname) >= STRLEN) ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "MGZBLOCKwriteIndex(): name too long"));
+  MGZBLOCKindexName(fname, indexname);
+
+  size_t n = index->coffset.size();
+  std::vector<unsigned char> buf(8 + 16 * n + MGZBLOCK_CHECK_SIZE);
+  mgzblockPutLE64(&buf[0], n);
+  for (size_t i = 0; i < n; i++) {
+    mgzblockPutLE64(&buf[8 + 16 * i], index->coffset[i]);
+    mgzblockPutLE64(&buf[8 + 16 * i + 8], index->uoffset[i]);
+  }
+  if (mgzblockFileCheck(fname, &buf[8 + 16 * n]) != NO_ERROR)
+    ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MGZBLOCKwriteIndex(): could not read the end of %s", fname));
+
+  FILE *fp = fopen(indexname, "wb");
+  if (fp == NULL) ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MGZBLOCKwriteIndex(): could not open %s", indexname));
+  size_t nwritten = fwrite(&buf[0], 1, buf.size(), fp);
+  if (fclose(fp) != 0 || nwritten != buf.size()) {
+    unlink(indexname);
+    ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MGZBLOCKwriteIndex(): could not write %s", indexname));
+  }
+
+  return (NO_ERROR);
+}
+
+
+/*!
+  \fn int MGZBLOCKreadIndex(const char *fname, unsigned long long uoffset, unsigned long long nbytes,
+                            MGZBLOCK_INDEX *index)
+  \brief Reads and validates the sidecar index of fname. Returns NO_ERROR only
+  if the index exists, is not older than fname, matches the size and final
+  gzip trailer of fname and describes a voxel region starting at uoffset with
+  nbytes bytes; otherwise the caller should fall back to streaming the file.
+  The mtime alone is not enough, as it only has a resolution of a second.
+  Failures are silent since the index is optional.
+*/
+int MGZBLOCKreadIndex(const char *fname, unsigned long long uoffset, unsigned long long nbytes,
+                      MGZBLOCK_INDEX *index)
+{
+  char indexname[STRLEN + 8];
+  struct stat fstat_buf, istat_buf;
+
+  index->coffset.clear();
+  index->uoffset.clear();
+
+  if (strlen(fname) >= STRLEN) return (ERROR_BADPARM);
+  MGZBLOCKindexName(fname, indexname);
+  if (stat(fname, &fstat_buf) != 0 || stat(indexname, &istat_buf) != 0) return (ERROR_NOFILE);
+  if (istat_buf.st_mtime < fstat_buf.st_mtime) return (ERROR_BADFILE);
+
+  FILE *fp = fopen(indexname, "rb");
+  if (fp == NULL) return (ERROR_NOFILE);
+  unsigned char buf[16];
+  if (fread(buf, 1, 8, fp) != 8) {
+    fclose(fp);
+    return (ERROR_BADFILE);
+  }
+  unsigned long long n = mgzblockGetLE64(buf);
+  if (n < 2 || 8 + 16 * n + MGZBLOCK_CHECK_SIZE != (unsigned long long)istat_buf.st_size) {
+    fclose(fp);
+    return (ERROR_BADFILE);
+  }
+  index->coffset.resize(n);
+  index->uoffset.resize(n);
+  for (unsigned long long i = 0; i < n; i++) {
+    if (fread(buf, 1, 16, fp) != 16) {
+      fclose(fp);
+      return (ERROR_BADFILE);
+    }
+    index->coffset[i] = mgzblockGetLE64(buf);
+    index->uoffset[i] = mgzblockGetLE64(buf + 8);
+    if (i > 0 && (index->coffset[i] <= index->coffset[i - 1] || index->uoffset[i] <= index->uoffset[i - 1])) {
+      fclose(fp);
+      index->coffset.clear();
+      index->uoffset.clear();
+      return (ERROR_BADFILE);
+    }
+  }
+  unsigned char icheck[MGZBLOCK_CHECK_SIZE], fcheck[MGZBLOCK_CHECK_SIZE];
+  size_t ncheck = fread(icheck, 1, MGZBLOCK_CHECK_SIZE, fp);
+  fclose(fp);
+  if (ncheck != MGZBLOCK_CHECK_SIZE || mgzblockFileCheck(fname, fcheck) != NO_ERROR ||
+      memcmp(icheck, fcheck, MGZBLOCK_CHECK_SIZE) != 0) {
+    index->coffset.clear();
+    index->uoffset.clear();
+    return (ERROR_BADFILE);
+  }
+
+  if (index->uoffset.front() != uoffset || index->uoffset.back() != uoffset + nbytes ||
+      index->coffset.back() >= (unsigned long long)fstat_buf.st_size) {
+    index->coffset.clear();
+    index->uoffset.clear();
+    return (ERROR_BADFILE);
+  }
+
+  return (NO_ERROR);
+}
+
+
+/*!
+  \fn int MGZBLOCKreadData(const char *fname, const MGZBLOCK_INDEX *index, unsigned long long uoffset,
+                           size_t nbytes, void *data, int swapsize)
+  \brief Reads nbytes of uncompressed voxel data starting at uoffset into
+  data, inflating only the blocks that overlap the range, in parallel.
+  Blocks entirely inside the range are inflated in place; the (at most two)
+  partial blocks go through a per-thread buffer. The result is swapped from
+  big-endian using swapsize.
+*/
+int MGZBLOCKreadData(const char *fname, const MGZBLOCK_INDEX *index, unsigned long long uoffset,
+                     size_t nbytes, void *data, int swapsize)
+{
+  if (nbytes == 0) return (NO_ERROR);
+
+  // the last entry marks the end of the voxel data
+  const std::vector<unsigned long long> &uoff = index->uoffset;
+  const std::vector<unsigned long long> &coff = index->coffset;
+  long nblocks = (long)uoff.size() - 1;
+  if (uoffset < uoff.front() || uoffset + nbytes > uoff.back())
+    ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "MGZBLOCKreadData(%s): range outside of indexed data", fname));
+
+  long b0 = (long)(std::upper_bound(uoff.begin(), uoff.end(), uoffset) - uoff.begin()) - 1;
+  long b1 = (long)(std::lower_bound(uoff.begin(), uoff.end(), uoffset + nbytes) - uoff.begin());
+  b1 = std::min(b1, nblocks);
+
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) ErrorReturn(ERROR_NOFILE, (ERROR_NOFILE, "MGZBLOCKreadData(): could not open %s", fname));
+
+  int nthreads = omp_get_max_threads();
+  std::vector<std::vector<unsigned char> > cbuf(nthreads), ubuf(nthreads);
+  unsigned char *dst = (unsigned char *)data;
+  int err = NO_ERROR;
+
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for schedule(dynamic, 1) reduction(max: err)
+#endif
+  for (long b = b0; b < b1; b++) {
+    int tid = omp_get_thread_num();
+    size_t msize = coff[b + 1] - coff[b];
+    size_t usize = uoff[b + 1] - uoff[b];
+    std::vector<unsigned char> &member = cbuf[tid];
+    member.resize(msize);
+
+    size_t nread = 0;
+    while (nread < msize) {
+      ssize_t r = pread(fd, &member[nread], msize - nread, coff[b] + nread);
+      if (r <= 0) break;
+      nread += r;
+    }
+    if (nread != msize) {
+      err = std::max(err, (int)ERROR_BADFILE);
+      continue;
+    }
+
+    // overlap of this block with the requested range
+    unsigned long long lo = std::max(uoff[b], uoffset);
+    unsigned long long hi = std::min(uoff[b + 1], uoffset + nbytes);
+    int e;
+    if (lo == uoff[b] && hi == uoff[b + 1])
+      e = mgzblockInflate(&member[0], msize, dst + (lo - uoffset), usize);
+    else {
+      std::vector<unsigned char> &tmp = ubuf[tid];
+      tmp.resize(usize);
+      e = mgzblockInflate(&member[0], msize, &tmp[0], usize);
+      if (e == NO_ERROR) memcpy(dst + (lo - uoffset), &tmp[lo - uoff[b]], hi - lo);
+    }
+    if (e != NO_ERROR) {
+      err = std::max(err, e);
+      continue;
+    }
+    mgzblockSwap(dst + (lo - uoffset), hi - lo, swapsize);
+  }
+  close(fd);
+
+  if (err != NO_ERROR) ErrorReturn(err, (err, "MGZBLOCKreadData(): could not read block data from %s", fname));
+
+  return (NO_ERROR);
+}
@@ -27,6 +27,10 @@ extern const char *Progname;
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "faster_variants.h"
 #include "romp_support.h"
@@ -354,6 +358,52 @@ void MRI::initIndices()
 }
 
 
+/**
+  Points the image buffer at a private, copy-on-write mapping of the voxel data stored
+  at `offset` in an uncompressed file instead of allocating and reading it. Pages are read
+  on first access and shared through the page cache with every other process mapping the
+  same file; a page only gets a private copy once the volume modifies it. This must be
+  called on a header-only volume, and the file data must already be in the native voxel
+  layout (the caller is responsible for any byte swapping). Returns NO_ERROR on success.
+*/
+int MRI::mapChunk(const char *filename, size_t offset)
+{
+  if (chunk || slices) return ERROR_BADPARM;
+
+  // voxels must be aligned for their (component) type
+  size_t align = (type == MRI_FLOAT_COMPLEX) ? sizeof(float) : bytes_per_vox;
+  if (offset % align) return ERROR_BADPARM;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return ERROR_NOFILE;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < offset + bytes_total) {
+    close(fd);
+    return ERROR_BADFILE;
+  }
+
+  size_t pagesize = sysconf(_SC_PAGESIZE);
+  size_t start = offset - offset % pagesize;
+  size_t len = bytes_total + (offset - start);
+  void *addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, start);
+  close(fd);
+  if (addr == MAP_FAILED) return ERROR_NOMEMORY;
+
+  mapping = addr;
+  mapping_len = len;
+  chunk = (BUFTYPE *)addr + (offset - start);
+  ischunked = 1;
+  owndata = false;
+  ras_good_flag = 1;
+
+  initSlices();
+  initIndices();
+
+  return NO_ERROR;
+}
+
+
 /**
   \todo A lot of this can be cleaned up by simply using smart pointers and
   vectors for many of the MRI parameters.
@@ -372,6 +422,7 @@ MRI::~MRI()
     }
   } else {
     if (owndata) free(chunk);
+    if (mapping) munmap(mapping, mapping_len);
     if (slices) {
       for (int slice = 0; slice < depth * nframes; slice++)
         if (slices[slice]) free(slices[slice]);
@@ -11489,6 +11540,52 @@ MRI *MRIlinearTransformInterp(MRI *mri_src, MRI *mri_dst, MATRIX *mA, int Interp
   width = mri_dst->width;
   height = mri_dst->height;
   depth = mri_dst->depth;
+
+  if (bspline == NULL) {
+    // sample a row of the destination at a time with the batched sampler;
+    // the source coordinates are computed exactly as MatrixMultiply() would
+    // (float accumulation) so the output does not change
+    float A[3][4];
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 4; c++) A[r][c] = mAinv->rptr[r + 1][c + 1];
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+    for (int z = 0; z < depth; z++) {
+      ROMP_PFLB_begin
+      std::vector<double> xs(width), ys(width), zs(width), vals(width);
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          float v[3];
+          for (int r = 0; r < 3; r++) {
+            float acc = 0.0;
+            acc += A[r][0] * (float)x;
+            acc += A[r][1] * (float)y;
+            acc += A[r][2] * (float)z;
+            acc += A[r][3] * 1.0f;
+            v[r] = acc;
+          }
+          xs[x] = v[0];
+          ys[x] = v[1];
+          zs[x] = v[2];
+        }
+        for (int f = 0; f < mri_src->nframes; f++) {
+          MRIsampleVolumeFrameTypeBatch(mri_src, width, xs.data(), ys.data(), zs.data(), f, InterpMethod, vals.data());
+          // will clip the val according to mri_dst type:
+          for (int x = 0; x < width; x++) MRIsetVoxVal(mri_dst, x, y, z, f, vals[x]);
+        }
+      }
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    MatrixFree(&mAinv);
+    mri_dst->ras_good_flag = 1;
+    return (mri_dst);
+  }
+
   v_X = VectorAlloc(4, MATRIX_REAL); /* input (src) coordinates */
   v_Y = VectorAlloc(4, MATRIX_REAL); /* transformed (dst) coordinates */
 
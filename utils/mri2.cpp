@@ -3970,6 +3970,354 @@ int MRIsegFrameAvg(MRI *seg, int segid, MRI *mri, double *favg)
   return (nvoxels);
 }
 
+/*---------------------------------------------------------
+  MRIsegReadRow() - copies row r of slice s, frame f, into buf
+  as MRIgetVoxVal() would return the values. Chunked volumes
+  of the common types are read straight out of the buffer.
+  ---------------------------------------------------------*/
+static void MRIsegReadRow(MRI *mri, int r, int s, int f, float *buf)
+{
+  int c, w = mri->width;
+
+  if (mri->ischunked) {
+    size_t off = (size_t)f * mri->vox_per_vol + (size_t)s * mri->vox_per_slice + (size_t)r * mri->vox_per_row;
+    switch (mri->type) {
+      case MRI_UCHAR: {
+        const unsigned char *p = (const unsigned char *)mri->chunk + off;
+        for (c = 0; c < w; c++) buf[c] = p[c];
+        return;
+      }
+      case MRI_SHORT: {
+        const short *p = (const short *)mri->chunk + off;
+        for (c = 0; c < w; c++) buf[c] = p[c];
+        return;
+      }
+      case MRI_USHRT: {
+        const unsigned short *p = (const unsigned short *)mri->chunk + off;
+        for (c = 0; c < w; c++) buf[c] = p[c];
+        return;
+      }
+      case MRI_INT: {
+        const int *p = (const int *)mri->chunk + off;
+        for (c = 0; c < w; c++) buf[c] = p[c];
+        return;
+      }
+      case MRI_FLOAT: {
+        const float *p = (const float *)mri->chunk + off;
+        for (c = 0; c < w; c++) buf[c] = p[c];
+        return;
+      }
+    }
+  }
+  for (c = 0; c < w; c++) buf[c] = MRIgetVoxVal(mri, c, r, s, f);
+}
+
+/*---------------------------------------------------------
+  MRIsegVoxelIndex() - one pass over seg that maps each voxel
+  (in memory order, c fastest) to the index of its id in
+  segids[], or -1 if its id is not in the list. An id that is
+  in the list more than once maps to its first entry. If first is
+  non-NULL, first[n] gets the index of the first entry with the
+  id of entry n. If nhits is non-NULL, it gets the number of
+  voxels of each id, duplicates included (as MRIsegCount()).
+  ---------------------------------------------------------*/
+static int *MRIsegVoxelIndex(MRI *seg, int nsegs, const int *segids, int *nhits, int *first)
+{
+  int n, minid, maxid, *lut, *index;
+  const long wh = (long)seg->width * seg->height;
+
+  minid = maxid = (nsegs > 0) ? segids[0] : 0;
+  for (n = 1; n < nsegs; n++) {
+    if (minid > segids[n]) minid = segids[n];
+    if (maxid < segids[n]) maxid = segids[n];
+  }
+  lut = (int *)malloc(sizeof(int) * (maxid - minid + 1));
+  for (n = 0; n <= maxid - minid; n++) lut[n] = -1;
+  for (n = nsegs - 1; n >= 0; n--) lut[segids[n] - minid] = n;  // first one wins
+  if (first)
+    for (n = 0; n < nsegs; n++) first[n] = lut[segids[n] - minid];
+
+  index = (int *)malloc(sizeof(int) * wh * seg->depth);
+  if (nhits) memset(nhits, 0, sizeof(int) * nsegs);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (int s = 0; s < seg->depth; s++) {
+    ROMP_PFLB_begin
+    float *row = (float *)malloc(sizeof(float) * seg->width);
+    for (int r = 0; r < seg->height; r++) {
+      int *idx = &index[s * wh + (long)r * seg->width];
+      MRIsegReadRow(seg, r, s, 0, row);
+      for (int c = 0; c < seg->width; c++) {
+        int id = (int)row[c];
+        idx[c] = (id < minid || id > maxid) ? -1 : lut[id - minid];
+      }
+    }
+    free(row);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  if (nhits) {
+    long v, nvox = wh * seg->depth;
+    for (v = 0; v < nvox; v++)
+      if (index[v] >= 0) nhits[index[v]]++;
+    for (n = 0; n < nsegs; n++) nhits[n] = nhits[lut[segids[n] - minid]];
+  }
+  free(lut);
+  return (index);
+}
+
+/*---------------------------------------------------------
+  MRIsegCountAll() - the number of voxels of each of the nsegs
+  ids in segids[] (as MRIsegCount() on each) in one pass.
+  ---------------------------------------------------------*/
+int MRIsegCountAll(MRI *seg, int nsegs, const int *segids, int *nhits)
+{
+  int *index = MRIsegVoxelIndex(seg, nsegs, segids, nhits, NULL);
+  free(index);
+  return (0);
+}
+
+// Number of slices accumulated together by MRIsegStatsAll()
+#define SEGSTATS_SLAB 4
+
+/*---------------------------------------------------------
+  MRIsegStatsAll() - MRIsegStats() for each of the nsegs ids in
+  segids[] in a single pass over seg and the given frame of mri,
+  instead of one pass per id. Slabs of SEGSTATS_SLAB slices are
+  accumulated in parallel and merged in slab order, so the result
+  does not depend on the number of threads. nvox (if non-NULL)
+  gets the number of voxels of each id.
+  ---------------------------------------------------------*/
+int MRIsegStatsAll(MRI *seg, int nsegs, const int *segids, MRI *mri, int frame,
+                   int *nvox, float *min, float *max, float *range, float *mean, float *std)
+{
+  int n, b, nslabs, *index, *first;
+  const long wh = (long)seg->width * seg->height;
+  long *cnt;
+  double *sum, *sum2, *vmin, *vmax;
+
+  first = (int *)calloc(nsegs, sizeof(int));
+  index = MRIsegVoxelIndex(seg, nsegs, segids, NULL, first);
+  nslabs = (seg->depth + SEGSTATS_SLAB - 1) / SEGSTATS_SLAB;
+  cnt = (long *)calloc((size_t)nslabs * nsegs, sizeof(long));
+  sum = (double *)calloc((size_t)nslabs * nsegs, sizeof(double));
+  sum2 = (double *)calloc((size_t)nslabs * nsegs, sizeof(double));
+  vmin = (double *)calloc((size_t)nslabs * nsegs, sizeof(double));
+  vmax = (double *)calloc((size_t)nslabs * nsegs, sizeof(double));
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (b = 0; b < nslabs; b++) {
+    ROMP_PFLB_begin
+    long *bcnt = &cnt[(size_t)b * nsegs];
+    double *bsum = &sum[(size_t)b * nsegs], *bsum2 = &sum2[(size_t)b * nsegs];
+    double *bmin = &vmin[(size_t)b * nsegs], *bmax = &vmax[(size_t)b * nsegs];
+    float *row = (float *)malloc(sizeof(float) * seg->width);
+    int s, r, c, s1 = MIN((b + 1) * SEGSTATS_SLAB, seg->depth);
+    for (s = b * SEGSTATS_SLAB; s < s1; s++) {
+      for (r = 0; r < seg->height; r++) {
+        const int *idx = &index[s * wh + (long)r * seg->width];
+        MRIsegReadRow(mri, r, s, frame, row);
+        for (c = 0; c < seg->width; c++) {
+          int k = idx[c];
+          if (k < 0) continue;
+          double val = row[c];
+          if (bcnt[k] == 0 || bmin[k] > val) bmin[k] = val;
+          if (bcnt[k] == 0 || bmax[k] < val) bmax[k] = val;
+          bcnt[k]++;
+          bsum[k] += val;
+          bsum2[k] += val * val;
+        }
+      }
+    }
+    free(row);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (n = 0; n < nsegs; n++) {
+    long nv = 0;
+    double s = 0, s2 = 0, mn = 0, mx = 0;
+    for (b = 0; b < nslabs; b++) {
+      size_t k = (size_t)b * nsegs + first[n];
+      if (cnt[k] == 0) continue;
+      if (nv == 0 || mn > vmin[k]) mn = vmin[k];
+      if (nv == 0 || mx < vmax[k]) mx = vmax[k];
+      nv += cnt[k];
+      s += sum[k];
+      s2 += sum2[k];
+    }
+    min[n] = mn;
+    max[n] = mx;
+    range[n] = max[n] - min[n];
+    mean[n] = (nv != 0) ? s / nv : 0.0;
+    if (nv > 1)
+      std[n] = sqrt(((nv) * (mean[n]) * (mean[n]) - 2 * (mean[n]) * s + s2) / (nv - 1));
+    else
+      std[n] = 0.0;
+    if (nvox) nvox[n] = nv;
+  }
+
+  free(index);
+  free(first);
+  free(cnt);
+  free(sum);
+  free(sum2);
+  free(vmin);
+  free(vmax);
+  return (0);
+}
+
+/*---------------------------------------------------------
+  MRIsegStatsRobustAll() - MRIsegStatsRobust() for each of the
+  nsegs ids in segids[]. The values of all the ids are gathered
+  in one pass over the volume, then each id's list is sorted and
+  trimmed in parallel. Gives the same values as
+  MRIsegStatsRobust() on each id. nvox (if non-NULL) gets the
+  number of voxels used for each id.
+  ---------------------------------------------------------*/
+int MRIsegStatsRobustAll(MRI *seg, int nsegs, const int *segids, MRI *mri, int frame,
+                         int *nvox, float *min, float *max, float *range, float *mean, float *std, float Pct)
+{
+  int n, r, s, c, *index, *nhits, *first;
+  const long wh = (long)seg->width * seg->height;
+  long *offset, *fill;
+  float *vals, *row;
+
+  nhits = (int *)calloc(nsegs, sizeof(int));
+  first = (int *)calloc(nsegs, sizeof(int));
+  index = MRIsegVoxelIndex(seg, nsegs, segids, nhits, first);
+  // duplicate ids get no values of their own, they are copied below
+  offset = (long *)calloc(nsegs + 1, sizeof(long));
+  for (n = 0; n < nsegs; n++) offset[n + 1] = offset[n] + ((first[n] == n) ? nhits[n] : 0);
+  fill = (long *)calloc(nsegs, sizeof(long));
+  vals = (float *)malloc(sizeof(float) * MAX(offset[nsegs], 1));
+
+  row = (float *)malloc(sizeof(float) * seg->width);
+  for (s = 0; s < seg->depth; s++) {
+    for (r = 0; r < seg->height; r++) {
+      const int *idx = &index[s * wh + (long)r * seg->width];
+      MRIsegReadRow(mri, r, s, frame, row);
+      for (c = 0; c < seg->width; c++)
+        if (idx[c] >= 0) vals[offset[idx[c]] + fill[idx[c]]++] = row[c];
+    }
+  }
+  free(row);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (n = 0; n < nsegs; n++) {
+    ROMP_PFLB_begin
+    if (first[n] != n) ROMP_PFLB_continue;
+    // same as MRIsegStatsRobust()
+    float *vlist = &vals[offset[n]];
+    int nvoxels = nhits[n], k, m = 0;
+    double val, sum = 0, sum2 = 0;
+    min[n] = max[n] = range[n] = mean[n] = std[n] = 0;
+    if (nvoxels > 0) {
+      qsort((void *)vlist, nvoxels, sizeof(float), compare_floats);
+      for (k = 0; k < nvoxels; k++) {
+        if (k < Pct * nvoxels / 100.0) continue;
+        if (k > (100 - Pct) * nvoxels / 100.0) continue;
+        val = vlist[k];
+        if (m == 0) {
+          min[n] = val;
+          max[n] = val;
+        }
+        if (min[n] > val) min[n] = val;
+        if (max[n] < val) max[n] = val;
+        sum += val;
+        sum2 += (val * val);
+        m = m + 1;
+      }
+      range[n] = max[n] - min[n];
+      mean[n] = sum / m;
+      if (m > 1)
+        std[n] = sqrt(((m) * (mean[n]) * (mean[n]) - 2 * (mean[n]) * sum + sum2) / (m - 1));
+      else
+        std[n] = 0.0;
+    }
+    if (nvox) nvox[n] = m;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (n = 0; n < nsegs; n++) {
+    int k = first[n];
+    if (k == n) continue;
+    min[n] = min[k];
+    max[n] = max[k];
+    range[n] = range[k];
+    mean[n] = mean[k];
+    std[n] = std[k];
+    if (nvox) nvox[n] = nvox[k];
+  }
+
+  free(index);
+  free(first);
+  free(nhits);
+  free(offset);
+  free(fill);
+  free(vals);
+  return (0);
+}
+
+/*---------------------------------------------------------
+  MRIsegFrameAvgAll() - MRIsegFrameAvg() for each of the nsegs ids
+  in segids[]: favg[n] (preallocated to mri->nframes) gets the
+  average waveform of id n and nvox[n] (if non-NULL) its number of
+  voxels. The seg is read once and the frames are averaged in
+  parallel, each in one pass over its voxels.
+  ---------------------------------------------------------*/
+int MRIsegFrameAvgAll(MRI *seg, int nsegs, const int *segids, MRI *mri, double **favg, int *nvox)
+{
+  int *index, *nhits, *first, f, n;
+  const long wh = (long)seg->width * seg->height;
+
+  nhits = (int *)calloc(nsegs, sizeof(int));
+  first = (int *)calloc(nsegs, sizeof(int));
+  index = MRIsegVoxelIndex(seg, nsegs, segids, nhits, first);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (f = 0; f < mri->nframes; f++) {
+    ROMP_PFLB_begin
+    double *fsum = (double *)calloc(nsegs, sizeof(double));
+    float *row = (float *)malloc(sizeof(float) * seg->width);
+    int s, r, c, n;
+    for (s = 0; s < seg->depth; s++) {
+      for (r = 0; r < seg->height; r++) {
+        const int *idx = &index[s * wh + (long)r * seg->width];
+        MRIsegReadRow(mri, r, s, f, row);
+        for (c = 0; c < seg->width; c++)
+          if (idx[c] >= 0) fsum[idx[c]] += row[c];
+      }
+    }
+    for (n = 0; n < nsegs; n++) favg[n][f] = (nhits[n] != 0) ? fsum[first[n]] / nhits[n] : 0;
+    free(row);
+    free(fsum);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  if (nvox)
+    for (n = 0; n < nsegs; n++) nvox[n] = nhits[n];
+  free(index);
+  free(first);
+  free(nhits);
+  return (0);
+}
+
 MRI *MRImask_with_T2_and_aparc_aseg(
     MRI *mri_src, MRI *mri_dst, MRI *mri_T2, MRI *mri_aparc_aseg, float T2_thresh, int mm_from_exterior)
 {
@@ -64,6 +64,7 @@
 #include "math.h"
 #include "matrix.h"
 #include "mghendian.h"
+#include "mgzblock.h"
 #include "mri2.h"
 #include "mri_circulars.h"
 #include "mri_identify.h"
@@ -140,6 +141,7 @@ static int analyzeWrite4D(MRI *mri, const char *fname);
 static void swap_analyze_header(dsr *hdr);
 
 static int nan_inf_check(MRI *mri);
+static int mriioUseMmap(void);
 #ifdef VC_TO_CV
 static int voxel_center_to_center_voxel(MRI *mri, float *x, float *y, float *z);
 #endif
@@ -651,7 +653,13 @@ MRI *mri_read(const char *fname, int type, int volume_flag, int start_frame, int
     mri = sdtRead(fname_copy, volume_flag);
   }
   else if (type == MRI_MGH_FILE) {
-    mri = mghRead(fname_copy, volume_flag, -1);
+    if (volume_flag && start_frame >= 0 && start_frame == end_frame) {
+      // only read the requested frame (block-gzip mgz files seek straight to it)
+      mri = mghRead(fname_copy, volume_flag, start_frame);
+      start_frame = end_frame = 0;
+    }
+    else
+      mri = mghRead(fname_copy, volume_flag, -1);
   }
   else if (type == MGH_MORPH) {
     int which = start_frame ;
@@ -7642,8 +7650,7 @@ static MRI *ximgRead(const char *fname, int read_volume)
   -----------------------------------------------------------*/
 MRI *MRISreadCurvAsMRI(const char *curvfile, int read_volume)
 {
-  int magno, k, vnum, fnum, vals_per_vertex;
-  float curv;
+  int magno, vnum, fnum, vals_per_vertex;
   FILE *fp;
   MRI *curvmri;
 
@@ -7670,10 +7677,8 @@ MRI *MRISreadCurvAsMRI(const char *curvfile, int read_volume)
 
   curvmri = MRIalloc(vnum, 1, 1, MRI_FLOAT);
   curvmri->version = ((MGZ_INTENT_SHAPE & 0xff ) << 8) | MGH_VERSION;
-  for (k = 0; k < vnum; k++) {
-    curv = freadFloat(fp);
-    MRIsetVoxVal(curvmri, k, 0, 0, 0, curv);
-  }
+  // the values of a 1 x 1 volume are one contiguous row
+  freadFloatArray(&MRIFvox(curvmri, 0, 0, 0), vnum, fp);
   fclose(fp);
 
   return (curvmri);
@@ -8549,8 +8554,21 @@ static MRI *niiRead(const char *fname, int read_volume)
 
   if (ncols * hdr.dim[2] * hdr.dim[3] == 163842) IsIco7 = 1;
 
-  if (read_volume)
-    mri = MRIallocSequence(ncols, hdr.dim[2], hdr.dim[3], fs_type, nslices);
+  // unscaled voxel data of an uncompressed file in native byte order can be
+  // mapped directly; swapping it would copy every page of the mapping
+  int mapped = 0;
+  if (read_volume) {
+    mri = NULL;
+    if (!use_compression && !scaledata && hdr.datatype != DT_DOUBLE && !IsIco7 &&
+        !(swapped_flag && bytes_per_voxel > 1) && mriioUseMmap()) {
+      mri = MRIallocHeader(ncols, hdr.dim[2], hdr.dim[3], fs_type, nslices);
+      if (mri->mapChunk(fname, (size_t)hdr.vox_offset) == NO_ERROR)
+        mapped = 1;
+      else
+        MRIfree(&mri);
+    }
+    if (mri == NULL) mri = MRIallocSequence(ncols, hdr.dim[2], hdr.dim[3], fs_type, nslices);
+  }
   else {
     if (!IsIco7)
       mri = MRIallocHeader(ncols, hdr.dim[2], hdr.dim[3], fs_type, nslices);
@@ -8660,7 +8678,10 @@ static MRI *niiRead(const char *fname, int read_volume)
     printf("[DEBUG] niiRead(): zeek to image data, after znzseek(%ld), file position = %ld\n", (long)hdr.vox_offset, here);
   }
   
-  if (!scaledata) {
+  if (mapped) {
+    // voxel data is mapped from the file and used as is
+  }
+  else if (!scaledata) {
     // no voxel value scaling needed
     void *buf;
     float *fbuf;
@@ -10760,6 +10781,56 @@ static void local_buffer_to_image(BUFTYPE *buf, MRI *mri, int slice, int frame)
 // declare function pointer
 // static int (*myclose)(FILE *stream);
 
+/*!
+  \fn static int mriioUseMmap(void)
+  \brief Whether uncompressed mgh/nii voxel data should be mapped rather
+  than read (MRIIO_UseMmap or FS_MRIIO_MMAP), see MRI::mapChunk(). Only
+  data that needs no byte swapping is mapped: swapping in place would copy
+  every page of the private mapping, so big-endian mgh data of more than
+  one byte per voxel gains nothing and is read as usual on little-endian
+  hosts.
+*/
+static int mriioUseMmap(void)
+{
+  return (MRIIO_UseMmap || getenv("FS_MRIIO_MMAP") != NULL);
+}
+
+/*!
+  \fn static void mghSkipBytes(znzFile fp, long long nbytes, int gzipped)
+  \brief Skips nbytes of voxel data. A gzip stream cannot seek, so it is
+  read through in 64k pieces.
+*/
+static void mghSkipBytes(znzFile fp, long long nbytes, int gzipped)
+{
+  if (!gzipped) {
+    znzseek(fp, nbytes, SEEK_CUR);
+    return;
+  }
+
+  std::vector<uchar> buf(65536);
+  while (nbytes > 0) {
+    long long n = std::min(nbytes, (long long)buf.size());
+    if ((long long)znzread(&buf[0], 1, n, fp) != n) break;
+    nbytes -= n;
+  }
+}
+
+/*!
+  \fn static znzFile mghOpenBlockTrailer(const char *fname, const MGZBLOCK_INDEX *index)
+  \brief Opens a block-gzip mgz positioned at the gzip member following the
+  voxel data (scan parameters and TAGs), see mgzblock.h
+*/
+static znzFile mghOpenBlockTrailer(const char *fname, const MGZBLOCK_INDEX *index)
+{
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) return (NULL);
+  if (lseek(fd, (off_t)index->coffset.back(), SEEK_SET) < 0) {
+    close(fd);
+    return (NULL);
+  }
+  return (znzdopen(fd, "rb", 1));
+}
+
 MRI *mghRead(const char *fname, int read_volume, int frame)
 {
   MRI *mri;
@@ -10852,33 +10923,45 @@ MRI *mghRead(const char *fname, int read_volume, int frame)
   if (type == MRI_TENSOR)
     nframes = 9;
 
+  if (frame >= nframes) {
+    znzclose(fp);
+    errno = 0;
+    ErrorReturn(NULL, (ERROR_BADPARM, "mghRead(%s, %d): frame out of range (%d frames in volume)", fname, frame, nframes));
+  }
+
   bytes = width * height * bpv; /* bytes per slice */
+  long long frame_bytes = (long long)bytes * depth;
+
+  // a block-gzip mgz with a valid sidecar index can be read in parallel and
+  // seeked in; otherwise fall back to streaming the (still valid) gzip file
+  MGZBLOCK_INDEX blockindex;
+  long long data_offset = znztell(fp);
+  int blockgz = 0;
+  if (gzipped && MRIsizeof(type) > 0)
+    blockgz = (MGZBLOCKreadIndex(fname, data_offset, (unsigned long long)nframes * frame_bytes, &blockindex) == NO_ERROR);
+
   if (!read_volume) {
     mri = MRIallocHeader(width, height, depth, type, nframes);
     mri->dof = dof;
     mri->nframes = nframes;
     mri->version = version;                // version saved in mgz
     mri->intent  = (version >> 8) & 0xff;  // content of the mgz file, annot, curv, warp, ...
-    if (gzipped) {  // pipe cannot seek
-      long count, total_bytes;
-      uchar buf[STRLEN];
-
-      total_bytes = (long)mri->nframes * width * height * depth * bpv;
-      for (count = 0; count < total_bytes - STRLEN; count += STRLEN) znzread(buf, STRLEN, 1, fp);
-      znzread(buf, total_bytes - count, 1, fp);
+    if (blockgz) {
+      znzclose(fp);
+      fp = mghOpenBlockTrailer(fname, &blockindex);
+      if (znz_isnull(fp)) {
+        MRIfree(&mri);
+        ErrorReturn(NULL, (ERROR_BADFILE, "mghRead(%s): could not reopen file", fname));
+      }
     }
     else
-      znzseek(fp, (long)mri->nframes * width * height * depth * bpv, SEEK_CUR);
+      mghSkipBytes(fp, (long long)mri->nframes * frame_bytes, gzipped);
   }
   else {
+    int total_frames = nframes;
     if (frame >= 0) {
       start_frame = end_frame = frame;
-      if (gzipped) {  // pipe cannot seek
-        long count;
-        for (count = 0; count < (long)frame * width * height * depth * bpv; count++) znzgetc(fp);
-      }
-      else
-        znzseek(fp, (long)frame * width * height * depth * bpv, SEEK_CUR);
+      if (!blockgz) mghSkipBytes(fp, (long long)frame * frame_bytes, gzipped);
       nframes = 1;
     }
     else { /* hack - # of frames < -1 means to only read in that
@@ -10892,7 +10975,23 @@ MRI *mghRead(const char *fname, int read_volume, int frame)
       if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) fprintf(stderr, "read %d frames\n", nframes);
     }
     buf = (BUFTYPE *)calloc(bytes, sizeof(BUFTYPE));
-    mri = MRIallocSequence(width, height, depth, type, nframes);
+    mri = NULL;
+    int mapped = 0;
+    // mgh data is big-endian, so it can only be used in place if it needs
+    // no swapping (bytes, or a big-endian host)
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+    int native = (bpv == 1);
+#else
+    int native = 1;
+#endif
+    if (!gzipped && native && mriioUseMmap()) {
+      mri = MRIallocHeader(width, height, depth, type, nframes);
+      if (mri->mapChunk(fname, data_offset + start_frame * frame_bytes) == NO_ERROR)
+        mapped = 1;
+      else
+        MRIfree(&mri);
+    }
+    if (mri == NULL) mri = MRIallocSequence(width, height, depth, type, nframes);
     mri->dof = dof;
 
     mri->version = version;                // version saved in mgz
@@ -10905,8 +11004,37 @@ MRI *mghRead(const char *fname, int read_volume, int frame)
       clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &begin);
     }
 
+    // a block-gzip file that does not inflate is read again from the
+    // stream, which has not been advanced past the header yet
+    int blockread = 0;
+    if (!mapped && blockgz && mri->ischunked)
+    {
+      size_t bytes_to_read = (size_t)frame_bytes * (end_frame - start_frame + 1);
+      if (MGZBLOCKreadData(fname, &blockindex, data_offset + start_frame * frame_bytes, bytes_to_read, mri->chunk, bpv) == NO_ERROR)
+        blockread = 1;
+      else
+      {
+        printf("WARNING: mghRead(%s): could not read the block-gzip voxel data, reading it as a stream\n", fname);
+        blockgz = 0;
+        mghSkipBytes(fp, (long long)start_frame * frame_bytes, gzipped);
+      }
+    }
+
     int USEVOXELBUF = 0;
-    if (mri->ischunked && getenv("FS_MGZIO_USEVOXELBUFREAD"))
+    if (mapped)
+    {
+      // voxel data is mapped from the file and used as is
+      USEVOXELBUF = 1;
+      free(buf);
+      znzseek(fp, data_offset + total_frames * frame_bytes, SEEK_SET);
+    }
+    else if (blockread)
+    {
+      // selected frames are contiguous in the chunk, blocks were inflated in parallel
+      USEVOXELBUF = 1;
+      free(buf);
+    }
+    else if (mri->ischunked && getenv("FS_MGZIO_USEVOXELBUFREAD"))
     {
       USEVOXELBUF = 1;
       printf("INFO: Environment variable FS_MGZIO_USEVOXELBUFREAD set\n");
@@ -10970,10 +11098,30 @@ MRI *mghRead(const char *fname, int read_volume, int frame)
     }
     else  // copy voxel point by point
     {
+      // a block-gzip frame is inflated in one go (in parallel) and then
+      // split into slices, so that no block is inflated more than twice
+      std::vector<BUFTYPE> framebuf;
       for (frame = start_frame; frame <= end_frame; frame++) {
+        if (blockgz) {
+          framebuf.resize(frame_bytes);
+          if (MGZBLOCKreadData(fname, &blockindex, data_offset + frame * frame_bytes, frame_bytes, &framebuf[0], 0) !=
+              NO_ERROR) {
+            // continue from the stream, still at the start of the voxel data
+            printf("WARNING: mghRead(%s): could not read the block-gzip voxel data, reading it as a stream\n", fname);
+            blockgz = 0;
+            std::vector<BUFTYPE>().swap(framebuf);
+            mghSkipBytes(fp, frame * frame_bytes, gzipped);
+          }
+        }
         for (z = 0; z < depth; z++) {
 	  // read one slice data: bytes=width x height x byte_per_voxel
-          if ((int)znzread(buf, sizeof(char), bytes, fp) != bytes) {
+          if (blockgz) {
+            memcpy(buf, &framebuf[(size_t)z * bytes], bytes);
+            nread = bytes;
+          }
+          else
+            nread = (int)znzread(buf, sizeof(char), bytes, fp);
+          if (nread != bytes) {
             // fclose(fp) ;
             znzclose(fp);
             free(buf);
@@ -11045,6 +11193,18 @@ MRI *mghRead(const char *fname, int read_volume, int frame)
       if (buf) free(buf);
     } // end of copying voxel point by point
 
+    // position the stream at the scan parameters that follow the voxel data
+    if (blockgz) {
+      znzclose(fp);
+      fp = mghOpenBlockTrailer(fname, &blockindex);
+      if (znz_isnull(fp)) {
+        MRIfree(&mri);
+        ErrorReturn(NULL, (ERROR_BADFILE, "mghRead(%s): could not reopen file", fname));
+      }
+    }
+    else if (!mapped && end_frame < total_frames - 1)
+      mghSkipBytes(fp, (long long)(total_frames - 1 - end_frame) * frame_bytes, gzipped);
+
     if (getenv("FS_MGZIO_TIMING"))
     {
       clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
@@ -11230,8 +11390,34 @@ int mghWrite(MRI *mri, const char *fname, int frame)
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &begin);
   }
 
+  // block-gzip output (see mgzblock.h): the header stays in its own gzip member,
+  // the voxel data is compressed in parallel into indexed members, and the scan
+  // parameters and TAGs are appended as a final member
+  MGZBLOCK_INDEX blockindex;
+  int blockgz = gzipped && mri->ischunked && MGZBLOCKenabled();
+  if (mri->type != MRI_UCHAR && mri->type != MRI_SHORT && mri->type != MRI_USHRT &&
+      mri->type != MRI_INT && mri->type != MRI_FLOAT && mri->type != MRI_FLOAT_COMPLEX)
+    blockgz = 0;
+
   int USEVOXELBUF = 0;
-  if (mri->ischunked && getenv("FS_MGZIO_USEVOXELBUFWRITE"))
+  if (blockgz)
+  {
+    USEVOXELBUF = 1;
+    long long data_offset = znztell(fp);
+    znzclose(fp);
+
+    size_t bytes_to_write = mri->bytes_per_vox * mri->vox_per_vol * (end_frame - start_frame + 1);
+    if (MGZBLOCKwriteData(fname, &MRIseq_vox(mri, 0, 0, 0, start_frame), bytes_to_write, mri->bytes_per_vox,
+                          data_offset, &blockindex) != NO_ERROR)
+      ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "mghWrite: could not write block-gzip data to %s", fname));
+
+    fp = znzopen(fname, "ab", gzipped);
+    if (znz_isnull(fp)) {
+      errno = 0;
+      ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "mghWrite(%s, %d): could not reopen file", fname, frame));
+    }
+  }
+  else if (mri->ischunked && getenv("FS_MGZIO_USEVOXELBUFWRITE"))
   {
     USEVOXELBUF = 1;
     printf("INFO: Environment variable FS_MGZIO_USEVOXELBUFWRITE set\n");
@@ -11391,6 +11577,15 @@ int mghWrite(MRI *mri, const char *fname, int frame)
   // fclose(fp) ;
   znzclose(fp);
 
+  // the sidecar index is written last so it is never older than the file;
+  // a plain write drops any stale index from an earlier block-gzip write
+  if (blockgz) {
+    if (MGZBLOCKwriteIndex(fname, &blockindex) != NO_ERROR)
+      ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "mghWrite: could not write block index for %s", fname));
+  }
+  else if (gzipped)
+    MGZBLOCKremoveIndex(fname);
+
   return (NO_ERROR);
 } // end mghWrite()
 
@@ -0,0 +1,186 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+// mrisample.cpp - batched nearest/trilinear sampling of MRI volumes
+
+#include <math.h>
+#include <stddef.h>
+
+#include "error.h"
+#include "macros.h"
+#include "mri.h"
+#include "utils.h"
+
+// number of points classified before the gather pass runs over them
+#define SAMPLE_BLOCK 256
+
+#define SAMPLE_MODE_OUTSIDE 0
+#define SAMPLE_MODE_NEAREST 1
+#define SAMPLE_MODE_TRILINEAR 2
+
+/*
+  Samples one block of points out of the contiguous frame buffer vol.
+
+  The first pass does the per-point bookkeeping of MRIsampleVolumeFrameType()
+  (integer test, bounds test, clamping) and reduces every point to a base
+  offset, the three neighbour strides and the three fractional weights.
+  The second pass is branch free apart from the final select, reads the
+  eight corners straight out of the chunk and is the part the compiler can
+  turn into vector gathers. The arithmetic and its order are the same as in
+  MRIsampleVolumeFrame(), so the results are identical to the scalar API.
+*/
+template <typename T>
+static void sampleBlock(const MRI *mri,
+                        const T *vol,
+                        const int npoints,
+                        const double *xs,
+                        const double *ys,
+                        const double *zs,
+                        const int type,
+                        double *vals)
+{
+  const int width = mri->width, height = mri->height, depth = mri->depth;
+  const ptrdiff_t row = mri->vox_per_row, slice = mri->vox_per_slice;
+  ptrdiff_t off[SAMPLE_BLOCK], dxo[SAMPLE_BLOCK], dyo[SAMPLE_BLOCK], dzo[SAMPLE_BLOCK];
+  double xmds[SAMPLE_BLOCK], ymds[SAMPLE_BLOCK], zmds[SAMPLE_BLOCK];
+  int mode[SAMPLE_BLOCK];
+
+  for (int i = 0; i < npoints; i++) {
+    double x = xs[i], y = ys[i], z = zs[i];
+
+    off[i] = dxo[i] = dyo[i] = dzo[i] = 0;
+    xmds[i] = ymds[i] = zmds[i] = 0;
+    if (MRIindexNotInVolume(mri, x, y, z) == 1) {
+      mode[i] = SAMPLE_MODE_OUTSIDE;
+      continue;
+    }
+
+    if (type == SAMPLE_NEAREST || (FEQUAL((int)x, x) && FEQUAL((int)y, y) && FEQUAL((int)z, z))) {
+      int xv = nint(x), yv = nint(y), zv = nint(z);
+      if (xv < 0) xv = 0;
+      if (xv >= width) xv = width - 1;
+      if (yv < 0) yv = 0;
+      if (yv >= height) yv = height - 1;
+      if (zv < 0) zv = 0;
+      if (zv >= depth) zv = depth - 1;
+      off[i] = xv + yv * row + zv * slice;
+      mode[i] = SAMPLE_MODE_NEAREST;
+      continue;
+    }
+
+    if (x >= width) x = width - 1.0;
+    if (y >= height) y = height - 1.0;
+    if (z >= depth) z = depth - 1.0;
+    if (x < 0.0) x = 0.0;
+    if (y < 0.0) y = 0.0;
+    if (z < 0.0) z = 0.0;
+
+    int xm = MAX((int)x, 0);
+    int ym = MAX((int)y, 0);
+    int zm = MAX((int)z, 0);
+    off[i] = xm + ym * row + zm * slice;
+    dxo[i] = MIN(width - 1, xm + 1) - xm;
+    dyo[i] = (MIN(height - 1, ym + 1) - ym) * row;
+    dzo[i] = (MIN(depth - 1, zm + 1) - zm) * slice;
+    xmds[i] = x - (float)xm;
+    ymds[i] = y - (float)ym;
+    zmds[i] = z - (float)zm;
+    mode[i] = SAMPLE_MODE_TRILINEAR;
+  }
+
+  const double outside_val = mri->outside_val;
+#ifdef HAVE_OPENMP
+  #pragma omp simd
+#endif
+  for (int i = 0; i < npoints; i++) {
+    const T *p = vol + off[i];
+    const ptrdiff_t dx = dxo[i], dy = dyo[i], dz = dzo[i];
+    double xmd = xmds[i], ymd = ymds[i], zmd = zmds[i];
+    double xpd = (1.0f - xmd), ypd = (1.0f - ymd), zpd = (1.0f - zmd);
+
+    double val = xpd * ypd * zpd * (double)p[0] + xpd * ypd * zmd * (double)p[dz] +
+                 xpd * ymd * zpd * (double)p[dy] + xpd * ymd * zmd * (double)p[dy + dz] +
+                 xmd * ypd * zpd * (double)p[dx] + xmd * ypd * zmd * (double)p[dx + dz] +
+                 xmd * ymd * zpd * (double)p[dx + dy] + xmd * ymd * zmd * (double)p[dx + dy + dz];
+    double nearest = (float)p[0];
+
+    vals[i] = mode[i] == SAMPLE_MODE_TRILINEAR ? val : (mode[i] == SAMPLE_MODE_NEAREST ? nearest : outside_val);
+  }
+}
+
+template <typename T>
+static void sampleFrame(const MRI *mri,
+                        const int npoints,
+                        const double *xs,
+                        const double *ys,
+                        const double *zs,
+                        const int frame,
+                        const int type,
+                        double *vals)
+{
+  const T *vol = (const T *)mri->chunk + frame * mri->vox_per_vol;
+
+  for (int i = 0; i < npoints; i += SAMPLE_BLOCK)
+    sampleBlock<T>(mri, vol, MIN(SAMPLE_BLOCK, npoints - i), xs + i, ys + i, zs + i, type, vals + i);
+}
+
+/*!
+  \fn int MRIsampleVolumeFrameTypeBatch(const MRI *mri, int npoints, const double *xs, const double *ys,
+                                        const double *zs, int frame, int type, double *vals)
+  \brief Samples frame at npoints voxel coordinates (xs[i],ys[i],zs[i]) into vals[i].
+  Gives the same values as calling MRIsampleVolumeFrameType() on each point. Nearest and
+  trilinear sampling of chunked uchar/short/ushort/int/float volumes go through a
+  type-specialized kernel that reads the contiguous buffer directly; anything else falls
+  back to the scalar function.
+*/
+int MRIsampleVolumeFrameTypeBatch(const MRI *mri,
+                                  const int npoints,
+                                  const double *xs,
+                                  const double *ys,
+                                  const double *zs,
+                                  const int frame,
+                                  const int type,
+                                  double *vals)
+{
+  if (frame < 0 || frame >= mri->nframes)
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM, "MRIsampleVolumeFrameTypeBatch: frame %d out of range (%d)", frame, mri->nframes));
+
+  if (!mri->ischunked || (type != SAMPLE_NEAREST && type != SAMPLE_TRILINEAR)) {
+    for (int i = 0; i < npoints; i++) MRIsampleVolumeFrameType(mri, xs[i], ys[i], zs[i], frame, type, &vals[i]);
+    return (NO_ERROR);
+  }
+
+  switch (mri->type) {
+  case MRI_UCHAR:
+    sampleFrame<unsigned char>(mri, npoints, xs, ys, zs, frame, type, vals);
+    break;
+  case MRI_SHORT:
+    sampleFrame<short>(mri, npoints, xs, ys, zs, frame, type, vals);
+    break;
+  case MRI_USHRT:
+    sampleFrame<unsigned short>(mri, npoints, xs, ys, zs, frame, type, vals);
+    break;
+  case MRI_INT:
+    sampleFrame<int>(mri, npoints, xs, ys, zs, frame, type, vals);
+    break;
+  case MRI_FLOAT:
+    sampleFrame<float>(mri, npoints, xs, ys, zs, frame, type, vals);
+    break;
+  default:
+    for (int i = 0; i < npoints; i++) MRIsampleVolumeFrameType(mri, xs[i], ys[i], zs[i], frame, type, &vals[i]);
+    break;
+  }
+  return (NO_ERROR);
+}
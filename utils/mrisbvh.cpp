@@ -0,0 +1,587 @@
+/**
+ * @brief Bounding volume hierarchy over the faces of a surface
+ *
+ */
+/*
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "error.h"
+#include "macros.h"
+#include "mrisbvh.h"
+#include "romp_support.h"
+
+// number of bins the surface area heuristic evaluates per split
+#define BVH_BINS 16
+
+// deepest traversal stack a query needs; the tree is far shallower
+#define BVH_STACK 128
+
+// node boxes are grown by this much so that a crossing computed at the very
+// edge of a triangle is never rejected by the rounding of the box test
+#define BVH_PAD 1e-7
+
+// same as Math::ComputeNormal(): the unit normal (v1-v0) x (v2-v0), or 0 for a degenerate face
+static void computeNormal(const double v1[3], const double v2[3], const double v3[3], double n[3])
+{
+  double ax = v3[0] - v2[0], ay = v3[1] - v2[1], az = v3[2] - v2[2];
+  double bx = v1[0] - v2[0], by = v1[1] - v2[1], bz = v1[2] - v2[2];
+
+  n[0] = (ay * bz - az * by);
+  n[1] = (az * bx - ax * bz);
+  n[2] = (ax * by - ay * bx);
+  double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  if (length != 0.0) {
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+  }
+}
+
+static void faceCoords(MRIS const *mris, int fno, double pt[3][3])
+{
+  FACE const *face = &mris->faces[fno];
+  for (int i = 0; i < 3; i++) {
+    VERTEX const *v = &mris->vertices[face->v[i]];
+    pt[i][0] = v->x;
+    pt[i][1] = v->y;
+    pt[i][2] = v->z;
+  }
+}
+
+static double boxArea(const double *bmin, const double *bmax)
+{
+  double dx = bmax[0] - bmin[0], dy = bmax[1] - bmin[1], dz = bmax[2] - bmin[2];
+  if (dx < 0) return 0;
+  return dx * dy + dy * dz + dz * dx;
+}
+
+static void boxEmpty(double *bmin, double *bmax)
+{
+  for (int k = 0; k < 3; k++) {
+    bmin[k] = std::numeric_limits<double>::max();
+    bmax[k] = -std::numeric_limits<double>::max();
+  }
+}
+
+static void boxGrow(double *bmin, double *bmax, const double *omin, const double *omax)
+{
+  for (int k = 0; k < 3; k++) {
+    if (omin[k] < bmin[k]) bmin[k] = omin[k];
+    if (omax[k] > bmax[k]) bmax[k] = omax[k];
+  }
+}
+
+MRISBVH::MRISBVH(MRIS const *mris) : deepest(0)
+{
+  // the trivial-reject box of Math::AABB(mris, 0.0)
+  for (int k = 0; k < 3; k++) {
+    aabb_min[k] = std::numeric_limits<float>::max();
+    aabb_max[k] = -std::numeric_limits<float>::max();
+  }
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    double const xyz[3] = {v->x, v->y, v->z};
+    for (int k = 0; k < 3; k++) {
+      if (xyz[k] < aabb_min[k]) aabb_min[k] = xyz[k];
+      if (xyz[k] > aabb_max[k]) aabb_max[k] = xyz[k];
+    }
+  }
+
+  int const nfaces = mris->nfaces;
+  std::vector<double> bounds(6 * (size_t)nfaces);
+  centroid.resize(3 * (size_t)nfaces);
+  fnormal.resize(3 * (size_t)nfaces);
+
+  for (int fno = 0; fno < nfaces; fno++) {
+    double pt[3][3];
+    faceCoords(mris, fno, pt);
+    for (int k = 0; k < 3; k++) {
+      centroid[3 * fno + k] = (pt[0][k] + pt[1][k] + pt[2][k]) / 3;
+      bounds[6 * fno + k] = std::min(pt[0][k], std::min(pt[1][k], pt[2][k]));
+      bounds[6 * fno + 3 + k] = std::max(pt[0][k], std::max(pt[1][k], pt[2][k]));
+    }
+    computeNormal(pt[0], pt[1], pt[2], &fnormal[3 * fno]);
+  }
+
+  std::vector<int> order(nfaces);
+  for (int fno = 0; fno < nfaces; fno++) order[fno] = fno;
+  if (nfaces > 0) {
+    nodes.reserve(nfaces / 2 + 1);
+    build(order, bounds, centroid, 0, nfaces, 0);
+  }
+
+  for (int i = 0; i < nfaces; i++) storeTriangle(mris, order[i]);
+}
+
+/*
+  Builds the subtree over order[first..first+count) and returns its node index.
+  The split is the best of BVH_BINS planes along the longest axis of the face
+  centroids under the surface area heuristic; small sets become leaves when no
+  split is cheaper than testing all their triangles.
+*/
+int MRISBVH::build(std::vector<int> &order,
+                   std::vector<double> const &bounds,
+                   std::vector<double> const &centers,
+                   int first,
+                   int count,
+                   int level)
+{
+  int const idx = nodes.size();
+  nodes.push_back(Node());
+  if (level > deepest) deepest = level;
+
+  double bmin[3], bmax[3], cmin[3], cmax[3];
+  boxEmpty(bmin, bmax);
+  boxEmpty(cmin, cmax);
+  for (int i = first; i < first + count; i++) {
+    int const fno = order[i];
+    boxGrow(bmin, bmax, &bounds[6 * fno], &bounds[6 * fno + 3]);
+    boxGrow(cmin, cmax, &centers[3 * fno], &centers[3 * fno]);
+  }
+  for (int k = 0; k < 3; k++) {
+    nodes[idx].bmin[k] = bmin[k] - BVH_PAD;
+    nodes[idx].bmax[k] = bmax[k] + BVH_PAD;
+  }
+
+  int axis = 0;
+  for (int k = 1; k < 3; k++)
+    if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) axis = k;
+  double const extent = cmax[axis] - cmin[axis];
+
+  int mid = -1;
+  if (extent > 0 && count > 1) {
+    int bin_count[BVH_BINS] = {0};
+    double bin_min[BVH_BINS][3], bin_max[BVH_BINS][3];
+    for (int b = 0; b < BVH_BINS; b++) boxEmpty(bin_min[b], bin_max[b]);
+
+    double const scale = BVH_BINS / extent;
+    auto binOf = [&](int fno) { return MIN(BVH_BINS - 1, (int)((centers[3 * fno + axis] - cmin[axis]) * scale)); };
+    for (int i = first; i < first + count; i++) {
+      int const fno = order[i], b = binOf(fno);
+      bin_count[b]++;
+      boxGrow(bin_min[b], bin_max[b], &bounds[6 * fno], &bounds[6 * fno + 3]);
+    }
+
+    // cost of every split plane from a sweep in each direction
+    double right_cost[BVH_BINS];
+    double amin[3], amax[3];
+    boxEmpty(amin, amax);
+    int n = 0;
+    for (int b = BVH_BINS - 1; b > 0; b--) {
+      boxGrow(amin, amax, bin_min[b], bin_max[b]);
+      n += bin_count[b];
+      right_cost[b] = n * boxArea(amin, amax);
+    }
+    boxEmpty(amin, amax);
+    n = 0;
+    double best_cost = std::numeric_limits<double>::max();
+    int best_bin = -1;
+    for (int b = 0; b < BVH_BINS - 1; b++) {
+      boxGrow(amin, amax, bin_min[b], bin_max[b]);
+      n += bin_count[b];
+      if (n == 0 || n == count) continue;
+      double const cost = n * boxArea(amin, amax) + right_cost[b + 1];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_bin = b;
+      }
+    }
+
+    // a split costs one more box test per triangle-sized unit of work
+    double const area = boxArea(bmin, bmax);
+    bool const split_pays = best_bin >= 0 && (area <= 0 || 1 + best_cost / area < count);
+    if (best_bin >= 0 && (split_pays || count > MAX_LEAF)) {
+      mid = std::partition(order.begin() + first, order.begin() + first + count, [&](int fno) {
+              return binOf(fno) <= best_bin;
+            }) - order.begin();
+    }
+  }
+
+  // too many faces with (nearly) the same centroid: split them by position in the list
+  if (mid < 0 && count > MAX_LEAF) mid = first + count / 2;
+
+  if (mid < 0) {
+    nodes[idx].start = first;
+    nodes[idx].count = count;
+    return idx;
+  }
+
+  build(order, bounds, centers, first, mid - first, level + 1);
+  int const right = build(order, bounds, centers, mid, first + count - mid, level + 1);
+  nodes[idx].start = right;
+  nodes[idx].count = 0;
+  return idx;
+}
+
+void MRISBVH::storeTriangle(MRIS const *mris, int fno)
+{
+  double pt[3][3], n[3];
+  faceCoords(mris, fno, pt);
+  n[0] = fnormal[3 * fno + 0];
+  n[1] = fnormal[3 * fno + 1];
+  n[2] = fnormal[3 * fno + 2];
+
+  fnos.push_back(fno);
+  p0x.push_back(pt[0][0]);
+  p0y.push_back(pt[0][1]);
+  p0z.push_back(pt[0][2]);
+  e1x.push_back(pt[1][0] - pt[0][0]);
+  e1y.push_back(pt[1][1] - pt[0][1]);
+  e1z.push_back(pt[1][2] - pt[0][2]);
+  e2x.push_back(pt[2][0] - pt[0][0]);
+  e2y.push_back(pt[2][1] - pt[0][1]);
+  e2z.push_back(pt[2][2] - pt[0][2]);
+  nx.push_back(n[0]);
+  ny.push_back(n[1]);
+  nz.push_back(n[2]);
+
+  // the 2D projection MRISOBBTree::LineIntersectsTriangle() uses
+  int xi = 0, yi = 1, zi = 2;
+  if (n[0] * n[0] < n[1] * n[1]) {
+    xi = 1;
+    yi = 2;
+    zi = 0;
+  }
+  if (n[xi] * n[xi] < n[2] * n[2]) {
+    xi = 2;
+    yi = 0;
+    zi = 1;
+  }
+  double const u1 = pt[1][yi] - pt[0][yi];
+  double const v1 = pt[1][zi] - pt[0][zi];
+  double const u2 = pt[2][yi] - pt[0][yi];
+  double const v2 = pt[2][zi] - pt[0][zi];
+  pa.push_back(pt[0][yi]);
+  pb.push_back(pt[0][zi]);
+  pu1.push_back(u1);
+  pv1.push_back(v1);
+  pu2.push_back(u2);
+  pv2.push_back(v2);
+  parea.push_back(v2 * u1 - u2 * v1);
+  pyi.push_back(yi);
+  pzi.push_back(zi);
+}
+
+/*
+  Tests the segment p0 + t*v01, t in [0,1], against all triangles of a leaf at
+  once. The arithmetic is that of MRISOBBTree::LineIntersectsTriangle(), lane
+  by lane, so both find exactly the same crossings.
+  Returns the index of the nearest crossing within the leaf or -1.
+*/
+int MRISBVH::leafSegment(Node const &node, const double p0[3], const double v01[3], double *t, int *sense) const
+{
+  int const s = node.start;
+  int const count = node.count;
+  int hit[MAX_LEAF], sns[MAX_LEAF];
+  double tt[MAX_LEAF];
+
+  const double *const ax = &p0x[s], *const ay = &p0y[s], *const az = &p0z[s];
+  const double *const nxs = &nx[s], *const nys = &ny[s], *const nzs = &nz[s];
+  const double *const as = &pa[s], *const bs = &pb[s];
+  const double *const u1s = &pu1[s], *const v1s = &pv1[s], *const u2s = &pu2[s], *const v2s = &pv2[s];
+  const double *const areas = &parea[s];
+  const int *const yis = &pyi[s], *const zis = &pzi[s];
+
+#ifdef HAVE_OPENMP
+  #pragma omp simd
+#endif
+  for (int k = 0; k < count; k++) {
+    double const num = nxs[k] * (ax[k] - p0[0]) + nys[k] * (ay[k] - p0[1]) + nzs[k] * (az[k] - p0[2]);
+    double const den = nxs[k] * v01[0] + nys[k] * v01[1] + nzs[k] * v01[2];
+    double const fabsden = den < 0.0 ? -den : den;
+    bool const steep = fabsden > 1e-6;
+    double const tk = num / (steep ? den : 1.0);
+
+    double const px = p0[0] + tk * v01[0];
+    double const py = p0[1] + tk * v01[1];
+    double const pz = p0[2] + tk * v01[2];
+    double const u0 = (yis[k] == 0 ? px : (yis[k] == 1 ? py : pz)) - as[k];
+    double const v0 = (zis[k] == 0 ? px : (zis[k] == 1 ? py : pz)) - bs[k];
+
+    double area = areas[k];
+    double alpha = (v2s[k] * u0 - u2s[k] * v0);
+    double beta = (v0 * u1s[k] - u0 * v1s[k]);
+    double gamma = area - alpha - beta;
+    double const sgn = area < 0 ? -1.0 : 1.0;
+    alpha *= sgn;
+    beta *= sgn;
+    gamma *= sgn;
+
+    hit[k] = steep && tk >= 0.0 && tk <= 1.0 && alpha > 0 && beta > 0 && gamma > 0;
+    tt[k] = tk;
+    sns[k] = den < 0.0 ? 1 : -1;
+  }
+
+  int best = -1;
+  for (int k = 0; k < count; k++)
+    if (hit[k] && (best < 0 || tt[k] < tt[best])) best = k;
+  if (best >= 0) {
+    *t = tt[best];
+    *sense = sns[best];
+    return s + best;
+  }
+  return -1;
+}
+
+int MRISBVH::IntersectSegment(const double p0[3], const double p1[3], double *pt, int *psense) const
+{
+  if (nodes.empty()) return -1;
+
+  double const v01[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  double inv[3];
+  for (int k = 0; k < 3; k++) inv[k] = v01[k] != 0 ? 1.0 / v01[k] : 0;
+
+  double best_t = std::numeric_limits<double>::max();
+  int best = -1, best_sense = 0;
+
+  int stack[BVH_STACK], depth = 0;
+  stack[depth++] = 0;
+  while (depth > 0) {
+    Node const &node = nodes[stack[--depth]];
+
+    // slab test of the part of the segment not yet beaten by a crossing
+    double tmin = 0, tmax = MIN(1.0, best_t);
+    bool overlaps = true;
+    for (int k = 0; k < 3 && overlaps; k++) {
+      if (v01[k] == 0) {
+        overlaps = p0[k] >= node.bmin[k] && p0[k] <= node.bmax[k];
+        continue;
+      }
+      double t1 = (node.bmin[k] - p0[k]) * inv[k];
+      double t2 = (node.bmax[k] - p0[k]) * inv[k];
+      if (t1 > t2) std::swap(t1, t2);
+      tmin = MAX(tmin, t1);
+      tmax = MIN(tmax, t2);
+      overlaps = tmin <= tmax;
+    }
+    if (!overlaps) continue;
+
+    if (node.count > 0) {
+      double t;
+      int sense;
+      int const i = leafSegment(node, p0, v01, &t, &sense);
+      if (i >= 0 && t < best_t) {
+        best_t = t;
+        best = i;
+        best_sense = sense;
+      }
+      continue;
+    }
+
+    // visit the child nearer to p0 first so that it can prune the other
+    int const left = &node - &nodes[0] + 1, right = node.start;
+    bool const right_first = v01[0] * (nodes[right].bmin[0] + nodes[right].bmax[0] - nodes[left].bmin[0] - nodes[left].bmax[0]) +
+                                 v01[1] * (nodes[right].bmin[1] + nodes[right].bmax[1] - nodes[left].bmin[1] - nodes[left].bmax[1]) +
+                                 v01[2] * (nodes[right].bmin[2] + nodes[right].bmax[2] - nodes[left].bmin[2] - nodes[left].bmax[2]) <
+                             0;
+    if (depth + 2 > BVH_STACK) ErrorExit(ERROR_BADPARM, "MRISBVH::IntersectSegment: tree too deep");
+    stack[depth++] = right_first ? left : right;
+    stack[depth++] = right_first ? right : left;
+  }
+
+  if (best < 0) return -1;
+  if (pt) *pt = best_t;
+  if (psense) *psense = best_sense;
+  return fnos[best];
+}
+
+void MRISBVH::IntersectSegments(
+    int nsegments, const double *p0, const double *p1, int *fno, double *t, int *sense) const
+{
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 64)
+#endif
+  for (int i = 0; i < nsegments; i++) {
+    ROMP_PFLB_begin
+    double ti = 0;
+    int si = 0;
+    fno[i] = IntersectSegment(&p0[3 * i], &p1[3 * i], &ti, &si);
+    if (t) t[i] = ti;
+    if (sense) sense[i] = si;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+int MRISBVH::PointInclusionTest(double x, double y, double z) const
+{
+  if (x < aabb_min[0] || y < aabb_min[1] || z < aabb_min[2] || x > aabb_max[0] || y > aabb_max[1] || z > aabb_max[2])
+    return -1;
+
+  // aim at a point beyond the centroid of the first face the segment is not parallel to
+  int const nfaces = fnos.size();
+  for (int fno = 0; fno < nfaces; fno++) {
+    double pt[3];
+    pt[0] = centroid[3 * fno + 0];
+    pt[1] = centroid[3 * fno + 1];
+    pt[2] = centroid[3 * fno + 2];
+    pt[0] += pt[0] - x;
+    pt[1] += pt[1] - y;
+    pt[2] += pt[2] - z;
+
+    double const x_pt[3] = {pt[0] - x, pt[1] - y, pt[2] - z};
+    double const *n = &fnormal[3 * fno];
+    double dotprod = n[0] * x_pt[0] + n[1] * x_pt[1] + n[2] * x_pt[2];
+    if (dotprod < 0) dotprod = -dotprod;
+    if (dotprod >= 1e-6) {
+      double const p0[3] = {x, y, z};
+      double t;
+      int sense;
+      return IntersectSegment(p0, pt, &t, &sense) >= 0 ? sense : 0;
+    }
+  }
+  return 0;
+}
+
+void MRISBVH::PointInclusionTests(int npoints, const double *xyz, int *res) const
+{
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 64)
+#endif
+  for (int i = 0; i < npoints; i++) {
+    ROMP_PFLB_begin
+    res[i] = PointInclusionTest(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/*
+  Squared distance from p to the nearest triangle of a leaf that is closer than
+  best_d2 (Ericson, Real-Time Collision Detection, 5.1.5).
+*/
+double MRISBVH::leafClosest(Node const &node, const double p[3], double best_d2, int *best) const
+{
+  for (int i = node.start; i < node.start + node.count; i++) {
+    double const ab[3] = {e1x[i], e1y[i], e1z[i]};
+    double const ac[3] = {e2x[i], e2y[i], e2z[i]};
+    double const ap[3] = {p[0] - p0x[i], p[1] - p0y[i], p[2] - p0z[i]};
+    double q[3];
+
+    double const d1 = ab[0] * ap[0] + ab[1] * ap[1] + ab[2] * ap[2];
+    double const d2 = ac[0] * ap[0] + ac[1] * ap[1] + ac[2] * ap[2];
+    double const bp[3] = {ap[0] - ab[0], ap[1] - ab[1], ap[2] - ab[2]};
+    double const d3 = ab[0] * bp[0] + ab[1] * bp[1] + ab[2] * bp[2];
+    double const d4 = ac[0] * bp[0] + ac[1] * bp[1] + ac[2] * bp[2];
+    double const cp[3] = {ap[0] - ac[0], ap[1] - ac[1], ap[2] - ac[2]};
+    double const d5 = ab[0] * cp[0] + ab[1] * cp[1] + ab[2] * cp[2];
+    double const d6 = ac[0] * cp[0] + ac[1] * cp[1] + ac[2] * cp[2];
+    double const vc = d1 * d4 - d3 * d2;
+    double const vb = d5 * d2 - d1 * d6;
+    double const va = d3 * d6 - d5 * d4;
+
+    double v = 0, w = 0;
+    if (d1 <= 0 && d2 <= 0) {
+      // vertex 0
+    }
+    else if (d3 >= 0 && d4 <= d3) {
+      v = 1;  // vertex 1
+    }
+    else if (d6 >= 0 && d5 <= d6) {
+      w = 1;  // vertex 2
+    }
+    else if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+      v = d1 / (d1 - d3);  // edge 0-1
+    }
+    else if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+      w = d2 / (d2 - d6);  // edge 0-2
+    }
+    else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+      w = (d4 - d3) / ((d4 - d3) + (d5 - d6));  // edge 1-2
+      v = 1 - w;
+    }
+    else {
+      double const denom = va + vb + vc;
+      if (denom != 0) {
+        v = vb / denom;
+        w = vc / denom;
+      }
+    }
+    for (int k = 0; k < 3; k++) q[k] = ap[k] - v * ab[k] - w * ac[k];
+    double const d2q = q[0] * q[0] + q[1] * q[1] + q[2] * q[2];
+    if (d2q < best_d2) {
+      best_d2 = d2q;
+      *best = i;
+    }
+  }
+  return best_d2;
+}
+
+static double boxDist2(const double *bmin, const double *bmax, const double p[3])
+{
+  double d2 = 0;
+  for (int k = 0; k < 3; k++) {
+    double d = 0;
+    if (p[k] < bmin[k])
+      d = bmin[k] - p[k];
+    else if (p[k] > bmax[k])
+      d = p[k] - bmax[k];
+    d2 += d * d;
+  }
+  return d2;
+}
+
+int MRISBVH::ClosestFace(const double p[3], double max_dist, double *dist) const
+{
+  if (nodes.empty()) return -1;
+
+  double best_d2 = max_dist * max_dist;
+  int best = -1;
+
+  int stack[BVH_STACK], depth = 0;
+  stack[depth++] = 0;
+  while (depth > 0) {
+    Node const &node = nodes[stack[--depth]];
+    if (boxDist2(node.bmin, node.bmax, p) > best_d2) continue;
+
+    if (node.count > 0) {
+      best_d2 = leafClosest(node, p, best_d2, &best);
+      continue;
+    }
+
+    int const left = &node - &nodes[0] + 1, right = node.start;
+    double const dl = boxDist2(nodes[left].bmin, nodes[left].bmax, p);
+    double const dr = boxDist2(nodes[right].bmin, nodes[right].bmax, p);
+    if (depth + 2 > BVH_STACK) ErrorExit(ERROR_BADPARM, "MRISBVH::ClosestFace: tree too deep");
+    stack[depth++] = dl < dr ? right : left;
+    stack[depth++] = dl < dr ? left : right;
+  }
+
+  if (best < 0) return -1;
+  if (dist) *dist = sqrt(best_d2);
+  return fnos[best];
+}
+
+void MRISBVH::ClosestFaces(int npoints, const double *xyz, double max_dist, double *dist, int *fno) const
+{
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 64)
+#endif
+  for (int i = 0; i < npoints; i++) {
+    ROMP_PFLB_begin
+    double d = max_dist;
+    int const f = ClosestFace(&xyz[3 * i], max_dist, &d);
+    dist[i] = f >= 0 ? d : max_dist;
+    if (fno) fno[i] = f;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
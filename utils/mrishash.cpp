@@ -23,6 +23,9 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include <memory>
+#include <vector>
+
 //----------------------------------------------------
 // Includes that differ for linux vs GW BC compile
 //----------------------------------------------------
@@ -416,16 +419,29 @@ static void mhtVoxelList_SampleTriangle(
 //
 #define MHT_MAX_TOUCHING_FACES 10000
 
+// number of faces rasterized per task when a face table is built in parallel
+#define MHT_CAPTURE_BLOCK 1024
+
+// Bucket and bucket-array locks are only taken when the caller has declared
+// concurrent modification with MHT_maybeParallel_begin().  Read-only queries
+// of a table that nobody is modifying need no locks and may run on any thread;
+// only the paths that modify the table insist on thread 0 otherwise.
+//
 static void lockBucket(const MHBT *bucketc) {
 #ifdef HAVE_OPENMP
     MHBT *bucket = (MHBT *)bucketc;
-    if (parallelLevel) omp_set_lock(&bucket->bucket_lock); else checkThread0();
+    if (parallelLevel) omp_set_lock(&bucket->bucket_lock);
 #endif
 }
 static void unlockBucket(const MHBT *bucketc) {
 #ifdef HAVE_OPENMP
     MHBT *bucket = (MHBT *)bucketc;
-    if (parallelLevel) omp_unset_lock(&bucket->bucket_lock); else checkThread0();
+    if (parallelLevel) omp_unset_lock(&bucket->bucket_lock);
+#endif
+}
+static void checkWriter() {
+#ifdef HAVE_OPENMP
+    if (!parallelLevel) checkThread0();
 #endif
 }
 
@@ -461,10 +477,11 @@ static void freeBins(MHBT* bucket) {
 }
 
 
-int FindBucketsChecked_Count;
-int FindBucketsPresent_Count;
-int VertexNumFoundByMHT; /* 2007-07-30 GW: Added to allow diagnostics even
-                            with fallback-to-brute-force */
+// per thread, so that concurrent queries do not race on them
+static thread_local int FindBucketsChecked_Count;
+static thread_local int FindBucketsPresent_Count;
+static thread_local int VertexNumFoundByMHT; /* 2007-07-30 GW: Added to allow diagnostics even
+                                                with fallback-to-brute-force */
 
 void MHTfindReportCounts(int *BucketsChecked, int *BucketsPresent, int *VtxNumByMHT)
 {
@@ -538,6 +555,11 @@ struct MRIS_HASH_TABLE_NoSurface : public MRIS_HASH_TABLE {
 
     int mhtAddFaceOrVertexAtCoords   (float x, float y, float z, int forvnum);
     int mhtAddFaceOrVertexAtVoxIx    (int xv, int yv, int zv, int forvnum);
+
+    // (voxel, face or vertex number) pairs gathered by the parallel constructors
+    struct Entry { int xv, yv, zv, forvnum; };
+    static void clampEntry(Entry & e);
+    void mhtAddEntries               (std::vector<Entry> const & entries);
     int mhtRemoveFaceOrVertexAtVoxIx (int xv, int yv, int zv, int forvnum);
 
     void mhtFaceCentroid2xyz_float   (int fno, float *x, float *y, float *z);
@@ -600,12 +622,12 @@ void MHTfree(MRIS_HASH_TABLE **pmht)
 
 void MRIS_HASH_TABLE_NoSurface::lockBuckets() const {
 #ifdef HAVE_OPENMP
-    if (parallelLevel) omp_set_lock(&buckets_lock); else checkThread0();
+    if (parallelLevel) omp_set_lock(&buckets_lock);
 #endif
 }
 void MRIS_HASH_TABLE_NoSurface::unlockBuckets() const {
 #ifdef HAVE_OPENMP
-    if (parallelLevel) omp_unset_lock(&buckets_lock); else checkThread0();
+    if (parallelLevel) omp_unset_lock(&buckets_lock);
 #endif
 }
 
@@ -616,6 +638,7 @@ MHBT* MRIS_HASH_TABLE_NoSurface::makeAndAcqBucket(int xv, int yv, int zv)
   //-----------------------------------------------
   // 1. Allocate a 1-D array at buckets_mustUseAcqRel[xv][yv]
   
+  checkWriter();
   lockBuckets();
   
   if (!buckets_mustUseAcqRel[xv][yv]) {
@@ -725,6 +748,74 @@ Done:
     return result;
 }
 
+void MRIS_HASH_TABLE_NoSurface::clampEntry(Entry & e)
+{
+  if (e.xv < 0) e.xv = 0;
+  if (e.xv >= TABLE_SIZE) e.xv = TABLE_SIZE - 1;
+  if (e.yv < 0) e.yv = 0;
+  if (e.yv >= TABLE_SIZE) e.yv = TABLE_SIZE - 1;
+  if (e.zv < 0) e.zv = 0;
+  if (e.zv >= TABLE_SIZE) e.zv = TABLE_SIZE - 1;
+}
+
+
+/*------------------------------------------------------------
+  mhtAddEntries
+  Lock-free bulk version of mhtAddFaceOrVertexAtVoxIx for a table that is
+  not yet shared.  The entries are bucket-sorted on xv (stably, so every
+  bucket receives its face or vertex numbers in the same order as the serial
+  insertion) and each xv slab is then filled by a single thread, so no two
+  threads ever touch the same column of buckets.
+  -------------------------------------------------------------*/
+void MRIS_HASH_TABLE_NoSurface::mhtAddEntries(std::vector<Entry> const & entries)
+{
+  std::vector<size_t> first(TABLE_SIZE + 1, 0);
+  for (auto const & e : entries) first[e.xv + 1]++;
+  for (int xv = 0; xv < TABLE_SIZE; xv++) first[xv + 1] += first[xv];
+
+  std::vector<Entry> sorted(entries.size());
+  {
+    std::vector<size_t> next(first.begin(), first.end() - 1);
+    for (auto const & e : entries) sorted[next[e.xv]++] = e;
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 8)
+#endif
+  for (int xv = 0; xv < TABLE_SIZE; xv++) {
+    ROMP_PFLB_begin
+    for (size_t i = first[xv]; i < first[xv + 1]; i++) {
+      Entry const & e = sorted[i];
+
+      MHBT ** & column = buckets_mustUseAcqRel[e.xv][e.yv];
+      if (!column) {
+        column = (MHBT **)calloc(TABLE_SIZE, sizeof(MHBT *));
+        if (!column) ErrorExit(ERROR_NO_MEMORY, "%s: could not allocate slice.", __MYFUNCTION__);
+      }
+      MHBT *bucket = column[e.zv];
+      if (!bucket) {
+        column[e.zv] = bucket = (MHBT *)calloc(1, sizeof(MHBT));
+        if (!bucket) ErrorExit(ERROR_NOMEMORY, "%s couldn't allocate bucket.\n", __MYFUNCTION__);
+#ifdef HAVE_OPENMP
+        omp_init_lock(&bucket->bucket_lock);
+#endif
+        reallocBins(bucket, 4);
+      }
+
+      int j;
+      for (j = 0; j < bucket->nused; j++)
+        if (bucket->bins[j].fno == e.forvnum) break;
+      if (j < bucket->nused) continue;
+
+      reallocBins(bucket, bucket->nused + 1);
+      bucket->bins[bucket->nused++].fno = e.forvnum;
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
 #define buckets_mustUseAcqRel SHOULD_NOT_ACCESS_BUCKETS_DIRECTLY
 
 
@@ -761,19 +852,24 @@ int MRIS_HASH_TABLE_NoSurface::mhtAddFaceOrVertexAtVoxIx(int xv, int yv, int zv,
     //-------------------------------------------------------------
     MHB *bin = bucket->bins;
 
-    int i;
+    int i, at = bucket->nused;
     for (i = 0; i < bucket->nused; i++, bin++) {
       if (bin->fno == forvnum) goto done;
+      if (bin->fno > forvnum && at == bucket->nused) at = i;
     }
 
     //-------------------------------------------------------------
-    // Add forvnum to this bucket
+    // Add forvnum to this bucket, keeping the bucket in ascending
+    // order as a fresh build leaves it, so a table that is updated
+    // in place answers every query exactly as a rebuilt one would.
     //-------------------------------------------------------------
     if (i == bucket->nused) /* forvnum not already listed at this bucket */
     {
       reallocBins(bucket, bucket->nused + 1);
       //----- add this face-position to this bucket ------
-      bucket->bins[bucket->nused++].fno = forvnum;
+      memmove(&bucket->bins[at + 1], &bucket->bins[at], (bucket->nused - at) * sizeof(MHB));
+      bucket->bins[at].fno = forvnum;
+      bucket->nused++;
     }
 
   done:
@@ -809,6 +905,7 @@ int MRIS_HASH_TABLE_NoSurface::mhtRemoveFaceOrVertexAtVoxIx(int xv, int yv, int
 
   if (!existsBuckets2(xv,yv)) return (NO_ERROR);  // no bucket at such coordinates
   
+  checkWriter();
   MHBT *bucket = acqBucket(xv,yv,zv);
   if (!bucket) return (NO_ERROR);  // no bucket at such coordinates
 
@@ -926,8 +1023,19 @@ struct MRIS_HASH_TABLE_IMPL : public MRIS_HASH_TABLE_NoSurface {
 
     void captureFaceData();
     void captureVertexData();
+
+    // Face tables only: the vertex coordinates each face was last hashed with,
+    // 9 per face, and whether it is in the table at all.  updateAllFaces uses
+    // them to find the faces that moved and the buckets they used to be in.
+    std::vector<float> faceHashedXYZ;
+    std::vector<char>  faceHashed;
+    void recordFaceHashed            (int fno, Ptdbl_t const pts[3]);
+    void hashedFacePoints            (int fno, Ptdbl_t pts[3]) const;
     
     int mhtFaceToMHT                 (Face f, bool on);
+    void mhtFaceToPoints             (Face f, Ptdbl_t pts[3]) const;
+    void mhtPointsToVoxelList        (Ptdbl_t const pts[3], VOXEL_LISTgw *voxlist) const;
+    void mhtFaceToVoxelList          (Face f, VOXEL_LISTgw *voxlist) const;
     int mhtDoesTriangleVoxelListIntersect(
                                       MHT_TRIANGLE const    * const triangle, 
                                       VOXEL_LISTgw const    * const voxlistForTriangle,
@@ -1031,13 +1139,51 @@ void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::captureFaceData()
     static int ncalls = 0, ncalls_limit = 1;
     ncalls++;
 
-    // Capture data from caller and surface
-    //    
-    for (int fno = 0; fno < surface.nfaces(); fno++) {
-        auto f = surface.faces(fno);
-        if (f.ripflag()) continue;
-        mhtFaceToMHT(f, true);
+    // Capture data from caller and surface.
+    // The faces are rasterized in parallel, in fixed blocks whose results are
+    // concatenated in face order, and then inserted without locks.
+    //
+    int const nfaces  = surface.nfaces();
+    int const nblocks = (nfaces + MHT_CAPTURE_BLOCK - 1) / MHT_CAPTURE_BLOCK;
+    std::vector< std::vector<Entry> > blockEntries(nblocks);
+    faceHashedXYZ.assign(9 * size_t(nfaces), 0.0f);
+    faceHashed   .assign(nfaces, 0);
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic)
+#endif
+    for (int block = 0; block < nblocks; block++) {
+        ROMP_PFLB_begin
+        std::unique_ptr<VOXEL_LISTgw> voxlist(new VOXEL_LISTgw);
+        std::vector<Entry> & entries = blockEntries[block];
+        int const fnoEnd = MIN(nfaces, (block + 1) * MHT_CAPTURE_BLOCK);
+        for (int fno = block * MHT_CAPTURE_BLOCK; fno < fnoEnd; fno++) {
+            auto f = surface.faces(fno);
+            if (f.ripflag()) continue;
+            Ptdbl_t pts[3];
+            mhtFaceToPoints(f, pts);
+            mhtPointsToVoxelList(pts, voxlist.get());
+            recordFaceHashed(fno, pts);
+            for (int vlix = 0; vlix < voxlist->nused; vlix++) {
+                Entry e = { voxlist->voxels[vlix][0], voxlist->voxels[vlix][1], voxlist->voxels[vlix][2], fno };
+                clampEntry(e);
+                entries.push_back(e);
+            }
+        }
+        ROMP_PFLB_end
     }
+    ROMP_PF_end
+
+    size_t nentries = 0;
+    for (auto const & entries : blockEntries) nentries += entries.size();
+    std::vector<Entry> all;
+    all.reserve(nentries);
+    for (auto & entries : blockEntries) {
+        all.insert(all.end(), entries.begin(), entries.end());
+        std::vector<Entry>().swap(entries);
+    }
+    mhtAddEntries(all);
 
     // Diagnostics
     //
@@ -1093,13 +1239,33 @@ void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::captureVertexData()
     static int ncalls = 0;
     ncalls++;
     
-    for (int vno = 0; vno < surface.nvertices(); vno++) {
+    int const nvertices = surface.nvertices();
+    std::vector<Entry> entries(nvertices);
+    std::vector<char>  used(nvertices, 0);
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+    for (int vno = 0; vno < nvertices; vno++) {
+        ROMP_PFLB_begin
         auto v = surface.vertices(vno);
-        if (v.ripflag()) continue;
+        if (v.ripflag()) ROMP_PFLB_continue;
         float x, y, z;
         mhtVertex2xyz(v, which(), &x, &y, &z);
-        mhtAddFaceOrVertexAtCoords(x, y, z, vno);
+        Entry e = { WORLD_TO_VOXEL(x), WORLD_TO_VOXEL(y), WORLD_TO_VOXEL(z), vno };
+        clampEntry(e);
+        entries[vno] = e;
+        used[vno] = 1;
+        ROMP_PFLB_end
     }
+    ROMP_PF_end
+
+    size_t n = 0;
+    for (int vno = 0; vno < nvertices; vno++)
+        if (used[vno]) entries[n++] = entries[vno];
+    entries.resize(n);
+    mhtAddEntries(entries);
 }
 
 
@@ -1141,23 +1307,123 @@ int MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::removeAllFaces(int vno)
 }
 
 
+//  Brings a face table up to date with the current vertex positions and ripflags
+//  without rebuilding it.  Only faces whose vertices moved since they were last
+//  hashed are resampled, and only the buckets they leave or enter are touched, so
+//  the cost follows the amount of movement rather than the size of the surface.
+//  Bucket contents, their order and the face centroids end up the same as in a
+//  table freshly created at the same resolution, so every query answers the same.
+//  Returns: the number of faces that were resampled
+//
+template <class Surface, class Face, class Vertex>
+int MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::updateAllFaces()
+{
+    checkWriter();
+
+    int const nfaces  = surface.nfaces();
+    if (nfaces != int(faceHashed.size()))
+        ErrorExit(ERROR_BADPARM, "%s: surface has %d faces, the table was built for %d\n",
+            __MYFUNCTION__, nfaces, int(faceHashed.size()));
+    int const nblocks = (nfaces + MHT_CAPTURE_BLOCK - 1) / MHT_CAPTURE_BLOCK;
+    std::vector< std::vector<Entry> > blockRemoved(nblocks), blockAdded(nblocks);
+    std::vector<int> blockMoved(nblocks, 0);
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic)
+#endif
+    for (int block = 0; block < nblocks; block++) {
+        ROMP_PFLB_begin
+        std::unique_ptr<VOXEL_LISTgw> oldVoxlist(new VOXEL_LISTgw);
+        std::unique_ptr<VOXEL_LISTgw> newVoxlist(new VOXEL_LISTgw);
+        int const fnoEnd = MIN(nfaces, (block + 1) * MHT_CAPTURE_BLOCK);
+        for (int fno = block * MHT_CAPTURE_BLOCK; fno < fnoEnd; fno++) {
+            auto face = surface.faces(fno);
+            bool const wasHashed = faceHashed[fno];
+            bool const isHashed  = !face.ripflag();
+            if (!wasHashed && !isHashed) continue;
+
+            Ptdbl_t pts[3];
+            mhtFaceToPoints(face, pts);
+
+            float const *xyz = &faceHashedXYZ[9 * fno];
+            if (wasHashed && isHashed) {
+                int n;
+                for (n = 0; n < 3; n++)
+                    if (xyz[3 * n + 0] != float(pts[n].x) || xyz[3 * n + 1] != float(pts[n].y) || xyz[3 * n + 2] != float(pts[n].z)) break;
+                if (n == 3) continue;
+            }
+            blockMoved[block]++;
+
+            mhtVoxelList_Init(oldVoxlist.get());
+            mhtVoxelList_Init(newVoxlist.get());
+            if (wasHashed) {
+                Ptdbl_t old[3];
+                hashedFacePoints(fno, old);
+                mhtPointsToVoxelList(old, oldVoxlist.get());
+            }
+            if (isHashed) {
+                mhtPointsToVoxelList(pts, newVoxlist.get());
+                recordFaceHashed(fno, pts);
+
+                float xt, yt, zt;
+                computeFaceCentroid(which(), fno, &xt, &yt, &zt);
+                f[fno].cx = xt;
+                f[fno].cy = yt;
+                f[fno].cz = zt;
+            } else {
+                faceHashed[fno] = 0;
+            }
+
+            // the buckets the face leaves and the ones it enters
+            for (int pass = 0; pass < 2; pass++) {
+                VOXEL_LISTgw const * from = pass ? newVoxlist.get() : oldVoxlist.get();
+                VOXEL_LISTgw const * to   = pass ? oldVoxlist.get() : newVoxlist.get();
+                for (int i = 0; i < from->nused; i++) {
+                    Entry e = { from->voxels[i][0], from->voxels[i][1], from->voxels[i][2], fno };
+                    clampEntry(e);
+                    int j;
+                    for (j = 0; j < to->nused; j++) {
+                        Entry o = { to->voxels[j][0], to->voxels[j][1], to->voxels[j][2], fno };
+                        clampEntry(o);
+                        if (o.xv == e.xv && o.yv == e.yv && o.zv == e.zv) break;
+                    }
+                    if (j < to->nused) continue;
+                    (pass ? blockAdded : blockRemoved)[block].push_back(e);
+                }
+            }
+        }
+        ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    int nmoved = 0;
+    for (int block = 0; block < nblocks; block++) {
+        nmoved += blockMoved[block];
+        for (auto const & e : blockRemoved[block]) mhtRemoveFaceOrVertexAtVoxIx(e.xv, e.yv, e.zv, e.forvnum);
+    }
+    for (int block = 0; block < nblocks; block++)
+        for (auto const & e : blockAdded[block]) mhtAddFaceOrVertexAtVoxIx(e.xv, e.yv, e.zv, e.forvnum);
+
+    return nmoved;
+}
+
+
 //  Adds face fno to mht. 
 //  Calls mhtVoxelList_SampleTriangle to get a list of MHT Voxels (buckets) in which to list fno.
 //
 template <class Surface, class Face, class Vertex>
-int MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::mhtFaceToMHT(Face const face, bool const on)
+void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::mhtFaceToPoints(Face const face, Ptdbl_t pts[3]) const
 {
-    if (face.ripflag()) return (NO_ERROR);
-    auto const fno = face.fno();
-
-    Vertex const v0 = face.v(0);
-    Vertex const v1 = face.v(1);
-    Vertex const v2 = face.v(2);
+    for (int n = 0; n < 3; n++) mhtVertex2xyz(face.v(n), which(), &pts[n]);
+}
 
-    Ptdbl_t vpt0, vpt1, vpt2;
-    mhtVertex2xyz(v0, which(), &vpt0);
-    mhtVertex2xyz(v1, which(), &vpt1);
-    mhtVertex2xyz(v2, which(), &vpt2);
+template <class Surface, class Face, class Vertex>
+void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::mhtPointsToVoxelList(Ptdbl_t const pts[3], VOXEL_LISTgw *voxlist) const
+{
+    Ptdbl_t const & vpt0 = pts[0];
+    Ptdbl_t const & vpt1 = pts[1];
+    Ptdbl_t const & vpt2 = pts[2];
 
     if (Gx >= 0) {
         double dist0 = sqrt(SQR(vpt0.x - Gx) + SQR(vpt0.y - Gy) + SQR(vpt0.z - Gz));
@@ -1166,9 +1432,61 @@ int MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::mhtFaceToMHT(Face const face, boo
         if (dist0 < vres() || dist1 < vres() || dist2 < vres()) DiagBreak();
     }
 
+    mhtVoxelList_Init(voxlist);
+    mhtVoxelList_SampleTriangle(vres(), &vpt0, &vpt1, &vpt2, voxlist);
+}
+
+template <class Surface, class Face, class Vertex>
+void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::mhtFaceToVoxelList(Face const face, VOXEL_LISTgw *voxlist) const
+{
+    Ptdbl_t pts[3];
+    mhtFaceToPoints(face, pts);
+    mhtPointsToVoxelList(pts, voxlist);
+}
+
+template <class Surface, class Face, class Vertex>
+void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::recordFaceHashed(int fno, Ptdbl_t const pts[3])
+{
+    float *xyz = &faceHashedXYZ[9 * fno];
+    for (int n = 0; n < 3; n++) {
+        xyz[3 * n + 0] = pts[n].x;
+        xyz[3 * n + 1] = pts[n].y;
+        xyz[3 * n + 2] = pts[n].z;
+    }
+    faceHashed[fno] = 1;
+}
+
+template <class Surface, class Face, class Vertex>
+void MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::hashedFacePoints(int fno, Ptdbl_t pts[3]) const
+{
+    float const *xyz = &faceHashedXYZ[9 * fno];
+    for (int n = 0; n < 3; n++) {
+        pts[n].x = xyz[3 * n + 0];
+        pts[n].y = xyz[3 * n + 1];
+        pts[n].z = xyz[3 * n + 2];
+    }
+}
+
+template <class Surface, class Face, class Vertex>
+int MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::mhtFaceToMHT(Face const face, bool const on)
+{
+    if (face.ripflag()) return (NO_ERROR);
+    auto const fno = face.fno();
+
+    // A face is removed from the buckets it was added to, even if its
+    // vertices have been moved since without telling the table.
+    Ptdbl_t pts[3];
+    if (on) {
+        mhtFaceToPoints(face, pts);
+        recordFaceHashed(fno, pts);
+    } else {
+        if (!faceHashed[fno]) return (NO_ERROR);
+        hashedFacePoints(fno, pts);
+        faceHashed[fno] = 0;
+    }
+
     VOXEL_LISTgw voxlist;
-    mhtVoxelList_Init(&voxlist);
-    mhtVoxelList_SampleTriangle(vres(), &vpt0, &vpt1, &vpt2, &voxlist);
+    mhtPointsToVoxelList(pts, &voxlist);
 
     for (int vlix = 0; vlix < voxlist.nused; vlix++) {
 
@@ -1218,7 +1536,7 @@ int MRIS_HASH_TABLE_IMPL<Surface,Face,Vertex>::isVectorFilled(
 
     checkConstructedWithFaces();
 
-    static int count; count++;
+    static thread_local int count; count++;
   
     int const trace = 0;
   
@@ -2404,6 +2722,10 @@ int  MHTremoveAllFaces(MRIS_HASH_TABLE* mht, MRIS* mris, int vno)
 { mht->toMRIS_HASH_TABLE_NoSurface()->checkConstructedWithFaces();
   return mht->removeAllFaces(vno); }
 
+int  MHTupdateAllFaces(MRIS_HASH_TABLE* mht, MRIS* mris) 
+{ mht->toMRIS_HASH_TABLE_NoSurface()->checkConstructedWithFaces();
+  return mht->updateAllFaces(); }
+
 
 // Surface self-intersection (Uses MHT initialized with FACES)
 //
@@ -8434,6 +8434,19 @@ MRI_SURFACE *MRIScorrectTopology(
     mrisComputeSurfaceStatistics(mris, mri, h_k1, h_k2, mri_k1_k2, mri_gray_white, h_dot);
 
   mrisMarkAllDefects(mris, dl, 0);
+
+  /* with seed_per_defect, defect i is searched with the random sequence
+     seed+i+1, so its correction depends neither on how many random numbers
+     the defects before it used nor on whether they were corrected at all */
+  long defect_seed = 0;
+  if (parms->seed_per_defect) {
+    defect_seed = getRandomSeed();
+    if (defect_seed == 0) {
+      defect_seed = 1234;
+    }
+    fprintf(WHICH_OUTPUT, "seeding each defect from %ld\n", defect_seed);
+  }
+
   for (i = 0; i < dl->ndefects; i++) {
     if (parms->correct_defect >= 0 && i != parms->correct_defect) {
       continue;
@@ -8443,6 +8456,10 @@ MRI_SURFACE *MRIScorrectTopology(
     if (i == Gdiag_no) {
       DiagBreak();
     }
+    if (parms->seed_per_defect) {
+      long const seed = defect_seed + i + 1;
+      setRandomSeed(seed ? seed : -1);
+    }
     mrisMarkAllDefects(mris, dl, 1);
     mrisComputeGrayWhiteBorderDistributions(mris, mri, defect, h_white, h_gray, h_border, h_grad);
     mrisMarkAllDefects(mris, dl, 0);
@@ -11209,12 +11226,9 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
                                 TOPOLOGY_PARMS *parms)
 {
   int i, j, vlist[MAX_DEFECT_VERTICES], n, nvertices, nedges, ndiscarded;
-  VERTEX *v, *v2;
   EDGE *et;
   /*  double  cx, cy, cz, max_len ;*/
   static int dno = 0;
-  double x, y, z, xv, yv, zv, val0, val, total, dx, dy, dz, d, wval, gval, Ix, Iy, Iz;
-  float norm1[3], norm2[3], nx, ny, nz;
   int nes; /* number of edges present in original tessellation */
   ES *es;  /* list of edges present in original tessellation */
   /*generate an initial ordering*/
@@ -11266,14 +11280,27 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
 
   ROMP_SCOPE_end
   
-  n = 0;
+  /* the orig normal of every vertex, instead of recomputing both for each of the nedges pairs */
+  float *orig_normals = (float *)calloc(3 * nvertices, sizeof(float));
+  for (i = 0; i < nvertices; i++) {
+    mrisComputeOrigNormal(mris, vlist[i], &orig_normals[3 * i]);
+  }
+
+  /* edge n joins vlist[i] and vlist[j] (i < j) in the order of the double loop,
+     so row i starts at a known n and the rows can be filled independently */
+  n = nedges;
   ROMP_PF_begin
 #ifdef HAVE_OPENMP
-  #pragma omp parallel for if_ROMP(serial)
+  #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : nes) schedule(dynamic, 4)
 #endif
   for (i = 0; i < nvertices; i++) {
     ROMP_PFLB_begin
-    
+
+    VERTEX *v, *v2;
+    double x, y, z, xv, yv, zv, val0, val, total, dx, dy, dz, d, wval, gval, Ix, Iy, Iz;
+    float *norm1, *norm2, nx, ny, nz;
+    int n = i * nvertices - (i * (i + 1)) / 2;
+
     v = &mris->vertices[vlist[i]];
     if (vlist[i] == Gdiag_no) {
       DiagBreak();
@@ -11281,7 +11308,7 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
     if (vertex_trans[vlist[i]] == Gdiag_no) {
       DiagBreak();
     }
-    for (j = i + 1; j < nvertices; j++, n++) {
+    for (int j = i + 1; j < nvertices; j++, n++) {
       if (vlist[j] == Gdiag_no) {
         DiagBreak();
       }
@@ -11291,8 +11318,8 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
       if (vertex_trans[vlist[j]] == Gdiag_no || vertex_trans[vlist[i]] == Gdiag_no) {
         DiagBreak();
       }
-      mrisComputeOrigNormal(mris, vlist[i], norm1);
-      mrisComputeOrigNormal(mris, vlist[j], norm2);
+      norm1 = &orig_normals[3 * i];
+      norm2 = &orig_normals[3 * j];
       nx = (norm1[0] + norm2[0]) / 2;
       ny = (norm1[1] + norm2[1]) / 2;
       nz = (norm1[2] + norm2[2]) / 2;
@@ -11482,6 +11509,7 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
     ROMP_PFLB_end
   }
   ROMP_PF_end
+  free(orig_normals);
 
   ROMP_SCOPE_begin
   /* find and discard all edges that intersect one that is already in the
@@ -12151,8 +12179,8 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
 {
   DEFECT_VERTEX_STATE *dvs;
   DEFECT_PATCH dps1[MAX_PATCHES], dps2[MAX_PATCHES], *dps, *dp, *dps_next_generation;
-  int i, best_i, j, g, nselected, nreplacements, rank, nunchanged = 0, nelite, ncrossovers, k, l, noverlap;
-  int *overlap, ngenerations, nbests, last_euthanasia, nremovedvertices, nfinalvertices;
+  int i, best_i, j, g, nselected, nreplacements, rank, nunchanged = 0, nelite, ncrossovers, k, l;
+  int ngenerations, nbests, last_euthanasia, nremovedvertices, nfinalvertices;
   double fitness, best_fitness, last_best, fitness_mean, fitness_sigma, fitness_norm, pfitness, two_sigma_sq,
       last_fitness;
   static int dno = 0;     /* for debugging */
@@ -12265,20 +12293,27 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
     etable.overlapping_edges = (int **)calloc(nedges, sizeof(int *));
     etable.noverlap = (int *)calloc(nedges, sizeof(int));
     etable.flags = (unsigned char *)calloc(nedges, sizeof(unsigned char));
-    overlap = (int *)calloc(nedges, sizeof(int));
-    if (!etable.edges || !etable.overlapping_edges || !etable.noverlap || !overlap)
+    if (!etable.edges || !etable.overlapping_edges || !etable.noverlap)
       ErrorExit(ERROR_NOMEMORY,
                 "mrisComputeOptimalRetessellation: Excessive "
                 "topologic defect encountered: could not allocate %d "
                 "edge table",
                 nedges);
 
-    for (nzero = i = 0; i < nedges; i++) /* compute overlapping
-                                                        for each edge */
-    {
-      if (nedges > 50000 && !(i % 25000)) {
-        fprintf(WHICH_OUTPUT, "%d of %d edges processed\n", i, nedges);
-      }
+    /* compute overlapping for each edge: nedges^2 intersection tests on
+       the sphere, independent for every edge and a large part of the
+       time spent on big defects */
+    nzero = 0;
+    int nprocessed = 0;
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : nzero) schedule(dynamic, 64)
+#endif
+    for (i = 0; i < nedges; i++) {
+      ROMP_PFLB_begin
+
+      int overlap[MAX_EDGES + 1], noverlap, j;
+
       etable.noverlap[i] = 0;
       for (noverlap = j = 0; j < nedges; j++) {
         if (j == i) {
@@ -12315,9 +12350,24 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
       else {
         nzero++;
       }
-    }
 
-    free(overlap);
+      /* count the edges as they complete, so that the progress is printed
+         in order whichever thread finishes them */
+      if (nedges > 50000) {
+#ifdef HAVE_OPENMP
+        #pragma omp critical
+#endif
+        {
+          nprocessed++;
+          if (!(nprocessed % 25000)) {
+            fprintf(WHICH_OUTPUT, "%d of %d edges processed\n", nprocessed, nedges);
+          }
+        }
+      }
+
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
   }
 
   ROMP_SCOPE_end
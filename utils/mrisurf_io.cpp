@@ -325,10 +325,9 @@ int MRISwriteCurvature(MRI_SURFACE *mris, const char *sname, const char *curv_na
     fwriteInt(mris->nvertices, fp);
     fwriteInt(mris->nfaces, fp);
     fwriteInt(1, fp); /* 1 value per vertex */
-    for (int k = 0; k < mris->nvertices; k++) {
-      float curv = mris->vertices[k].curv;
-      fwriteFloat(curv, fp);
-    }
+    std::vector<float> curv(mris->nvertices);
+    for (int k = 0; k < mris->nvertices; k++) curv[k] = mris->vertices[k].curv;
+    fwriteFloatArray(curv.data(), mris->nvertices, fp);
     fclose(fp);
   }
   return error;
@@ -1437,10 +1436,12 @@ static int __mrisreadannot(const char *fannot, MRIS *mris, const COLOR_TABLE *ct
     ErrorReturn(ERROR_NOFILE, (ERROR_NOFILE, "# elements (%d) in %s and # vertices (%d) don't match", nElem, fannot, nVertices));
 
   /* For each one, read in a vno and an int for the annotation value. Check the vno. */
+  std::vector<int> pairs(2 * nElem);
+  freadIntArray(pairs.data(), 2 * nElem, fp);
   for (int j = 0; j < nElem; j++)
   {
-    int vno = freadInt(fp);
-    int annot = freadInt(fp);
+    int vno = pairs[2 * j];
+    int annot = pairs[2 * j + 1];
     if (vno == Gdiag_no)
       DiagBreak();
 
@@ -1585,11 +1586,33 @@ int MRISreadAnnotationIntoArray(const char *fname, int in_array_size, int **out_
   /* First int is the number of elements. */
   num = freadInt(fp);
 
+  /* Make sure the file holds that many pairs before allocating them. */
+  long start = ftell(fp);
+  fseek(fp, 0, SEEK_END);
+  long remaining = ftell(fp) - start;
+  fseek(fp, start, SEEK_SET);
+  if (num < 0 || (long)num * 2 * (long)sizeof(int) > remaining) {
+    fclose(fp);
+    free(array);
+    ErrorReturn(ERROR_BADFILE,
+                (ERROR_BADFILE,
+                 "MRISreadAnnotationIntoArray: %s holds %ld bytes, too few for %d (vno, annotation) pairs",
+                 fname,
+                 remaining,
+                 num));
+  }
+
   /* For each one, read in a vno and an int for the annotation
      value. Check the vno. */
+  std::vector<int> pairs(2 * (long)num);
+  if (freadIntArray(pairs.data(), pairs.size(), fp) != (long)pairs.size()) {
+    fclose(fp);
+    free(array);
+    ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "MRISreadAnnotationIntoArray: could not read the pairs of %s", fname));
+  }
   for (j = 0; j < num; j++) {
-    vno = freadInt(fp);
-    i = freadInt(fp);
+    vno = pairs[2 * j];
+    i = pairs[2 * j + 1];
     if (vno == Gdiag_no) {
       DiagBreak();
     }
@@ -1809,15 +1832,16 @@ static int __mriswriteannot(MRIS *mris, const char *outfannot)
     ErrorReturn(ERROR_NOFILE, (ERROR_NOFILE, "could not write annot file %s", outfannot));
 
   fwriteInt(mris->nvertices, fp);
+  std::vector<int> pairs(2 * mris->nvertices);
   for (int vno = 0; vno < mris->nvertices; vno++)
   {
     if (vno == Gdiag_no)
       DiagBreak();
 
-    int i = mris->vertices[vno].annotation;
-    fwriteInt(vno, fp);
-    i = fwriteInt(i, fp);
+    pairs[2 * vno] = vno;
+    pairs[2 * vno + 1] = mris->vertices[vno].annotation;
   }
+  fwriteIntArray(pairs.data(), pairs.size(), fp);
 
   if (mris->ct) /* also write annotation in */
   {
@@ -5333,15 +5357,23 @@ int MRISwriteTriangularSurface(MRI_SURFACE *mris, const char *fname)
   fwriteInt(mris->nvertices, fp);
   fwriteInt(mris->nfaces, fp); /* # of triangles */
 
-  for (int k = 0; k < mris->nvertices; k++) {
-    fwriteFloat(mris->vertices[k].x, fp);
-    fwriteFloat(mris->vertices[k].y, fp);
-    fwriteFloat(mris->vertices[k].z, fp);
+  {
+    std::vector<float> xyz(3 * (size_t)mris->nvertices);
+    for (int k = 0; k < mris->nvertices; k++) {
+      xyz[3 * k] = mris->vertices[k].x;
+      xyz[3 * k + 1] = mris->vertices[k].y;
+      xyz[3 * k + 2] = mris->vertices[k].z;
+    }
+    fwriteFloatArray(xyz.data(), xyz.size(), fp);
   }
-  for (int k = 0; k < mris->nfaces; k++) {
-    for (int n = 0; n < VERTICES_PER_FACE; n++) {
-      fwriteInt(mris->faces[k].v[n], fp);
+  {
+    std::vector<int> fv(VERTICES_PER_FACE * (size_t)mris->nfaces);
+    for (int k = 0; k < mris->nfaces; k++) {
+      for (int n = 0; n < VERTICES_PER_FACE; n++) {
+        fv[VERTICES_PER_FACE * k + n] = mris->faces[k].v[n];
+      }
     }
+    fwriteIntArray(fv.data(), fv.size(), fp);
   }
   /* write whether vertex data was using
      the real RAS rather than conformed RAS */
@@ -5408,14 +5440,16 @@ static SMALL_SURFACE *mrisReadTriangleFileVertexPositionsOnly(const char *fname)
     free(mriss);
     ErrorReturn(NULL, (ERROR_NOMEMORY, "MRISreadVerticesOnly: could not allocate surface"));
   }
+  std::vector<float> xyz(3 * (size_t)nvertices);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
   for (vno = 0; vno < nvertices; vno++) {
     v = &mriss->vertices[vno];
     if (vno == Gdiag_no) {
       DiagBreak();
     }
-    v->x = freadFloat(fp);
-    v->y = freadFloat(fp);
-    v->z = freadFloat(fp);
+    v->x = xyz[3 * vno];
+    v->y = xyz[3 * vno + 1];
+    v->z = xyz[3 * vno + 2];
     if (fabs(v->x) > 10000 || !std::isfinite(v->x))
       ErrorExit(ERROR_BADFILE, "%s: vertex %d x coordinate %f!", Progname, vno, v->x);
     if (fabs(v->y) > 10000 || !std::isfinite(v->y))
@@ -5468,11 +5502,10 @@ static int mrisReadTriangleFilePositions(MRI_SURFACE *mris, const char *fname)
     // MRISsetXYZ will invalidate all of these,
     // so make sure they are recomputed before being used again!
 
+  std::vector<float> xyz(3 * (size_t)nvertices);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
   for (vno = 0; vno < nvertices; vno++) {
-    float x = freadFloat(fp);
-    float y = freadFloat(fp);
-    float z = freadFloat(fp);
-    MRISsetXYZ(mris, vno, x,y,z);
+    MRISsetXYZ(mris, vno, xyz[3 * vno], xyz[3 * vno + 1], xyz[3 * vno + 2]);
   }
 
   fclose(fp);
@@ -5522,6 +5555,10 @@ static MRI_SURFACE *mrisReadTriangleFile(const char *fname, double nVFMultiplier
   MRIS * mris = MRISoverAlloc(nVFMultiplier * nvertices, nVFMultiplier * nfaces, nvertices, nfaces);
   mris->type = MRIS_TRIANGULAR_SURFACE;
 
+  // the vertex and face sections are each read in one go
+  std::vector<float> xyz(3 * (size_t)nvertices);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
+
   for (vno = 0; vno < nvertices; vno++) {
     if (vno % 100 == 0) exec_progress_callback(vno, nvertices, 0, 1);
     VERTEX_TOPOLOGY * const vt = &mris->vertices_topology[vno];
@@ -5530,11 +5567,7 @@ static MRI_SURFACE *mrisReadTriangleFile(const char *fname, double nVFMultiplier
       DiagBreak();
     }
 
-    float x = freadFloat(fp);
-    float y = freadFloat(fp);
-    float z = freadFloat(fp);
-    
-    MRISsetXYZ(mris,vno, x, y, z);
+    MRISsetXYZ(mris,vno, xyz[3 * vno], xyz[3 * vno + 1], xyz[3 * vno + 2]);
 
     vt->num = 0; /* will figure it out */
     if (fabs(v->x) > 10000 || !std::isfinite(v->x))
@@ -5545,10 +5578,12 @@ static MRI_SURFACE *mrisReadTriangleFile(const char *fname, double nVFMultiplier
       ErrorExit(ERROR_BADFILE, "%s: vertex %d z coordinate %f!", Progname, vno, v->z);
   }
 
+  std::vector<int> fv(VERTICES_PER_FACE * (size_t)mris->nfaces);
+  freadIntArray(fv.data(), fv.size(), fp);
   for (fno = 0; fno < mris->nfaces; fno++) {
     f = &mris->faces[fno];
     for (n = 0; n < VERTICES_PER_FACE; n++) {
-      f->v[n] = freadInt(fp);
+      f->v[n] = fv[VERTICES_PER_FACE * fno + n];
       if (f->v[n] >= mris->nvertices || f->v[n] < 0)
         ErrorExit(ERROR_BADFILE, "f[%d]->v[%d] = %d - out of range!\n", fno, n, f->v[n]);
     }
@@ -5835,10 +5870,12 @@ int MRISreadNewCurvatureFile(MRI_SURFACE *mris, const char *sname)
         (ERROR_NOFILE, "MRISreadNewCurvature(%s): vals/vertex %d unsupported (must be 1) ", fname, vals_per_vertex));
   }
 
+  std::vector<float> curvs(vnum);
+  freadFloatArray(curvs.data(), vnum, fp);
   curvmin = 10000.0f;
   curvmax = -10000.0f; /* for compiler warnings */
   for (k = 0; k < vnum; k++) {
-    curv = freadFloat(fp);
+    curv = curvs[k];
     if (k == 0) {
       curvmin = curvmax = curv;
     }
@@ -5901,7 +5938,7 @@ float *MRISreadNewCurvatureVector(MRI_SURFACE *mris, const char *sname)
 
 int MRISreadNewCurvatureIntoArray(const char *sname, int in_array_size, float **out_array)
 {
-  int k, vnum, fnum;
+  int vnum, fnum;
   float *cvec;
   FILE *fp;
   int vals_per_vertex;
@@ -5947,9 +5984,7 @@ int MRISreadNewCurvatureIntoArray(const char *sname, int in_array_size, float **
   if (!cvec) ErrorExit(ERROR_NOMEMORY, "MRISreadNewCurvatureVector(%s): calloc failed", sname);
 
   /* Read in values. */
-  for (k = 0; k < vnum; k++) {
-    cvec[k] = freadFloat(fp);
-  }
+  freadFloatArray(cvec, vnum, fp);
   fclose(fp);
 
   /* Return what we read. */
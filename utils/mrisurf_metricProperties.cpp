@@ -6885,6 +6885,88 @@ int MRIShistoThresholdCurvature(MRIS *mris, float thresh_pct)
 }
 
 
+/*
+  Breadth first walk over the rings 1..nbhd_size around a vertex, shared by
+  the closest vertex searches below. It visits the unripped vertices in the
+  order the walks that kept the visited set in v->marked did, calling
+  visit(vno2, ring) once for each, but keeps the visited set and the ring
+  numbers in its own arrays. These are stamped with a counter that is bumped
+  for every walk rather than cleared, so each thread can keep one walk and
+  search around its vertices without touching v->marked.
+*/
+class MRISnbhdWalk
+{
+ public:
+  template <class Visit>
+  void walk(MRIS const *mris, int vno, int nbhd_size, Visit visit)
+  {
+    if ((int)stamp.size() != mris->nvertices) {
+      stamp.assign(mris->nvertices, 0);
+      ring.assign(mris->nvertices, 0);
+      epoch = 0;
+    }
+    if (++epoch == 0) {
+      std::fill(stamp.begin(), stamp.end(), 0);
+      epoch = 1;
+    }
+    vlist.clear();
+    vlist.push_back(vno);
+    stamp[vno] = epoch;
+    ring[vno] = 1;
+    for (int ns = 1; ns <= nbhd_size; ns++) {
+      int const vtotal = vlist.size();
+      for (int i = 0; i < vtotal; i++) {
+        int const vn = vlist[i];
+        if (mris->vertices[vn].ripflag) continue;
+        if (ring[vn] < ns - 1) continue;
+        VERTEX_TOPOLOGY const * const vnt = &mris->vertices_topology[vn];
+        for (int n = 0; n < vnt->vnum; n++) {
+          int const vn2 = vnt->v[n];
+          if (mris->vertices[vn2].ripflag || stamp[vn2] == epoch) /* already processed */
+          {
+            continue;
+          }
+          vlist.push_back(vn2);
+          stamp[vn2] = epoch;
+          ring[vn2] = ns;
+          visit(vn2, ns);
+        }
+      }
+    }
+  }
+
+ private:
+  std::vector<int> vlist, ring;
+  std::vector<unsigned int> stamp;
+  unsigned int epoch = 0;
+};
+
+static std::vector<MRISnbhdWalk> mrisNbhdWalksPerThread()
+{
+#ifdef HAVE_OPENMP
+  return std::vector<MRISnbhdWalk>(omp_get_max_threads());
+#else
+  return std::vector<MRISnbhdWalk>(1);
+#endif
+}
+
+static MRISnbhdWalk &mrisThisThreadsNbhdWalk(std::vector<MRISnbhdWalk> &walks)
+{
+#ifdef HAVE_OPENMP
+  return walks[omp_get_thread_num()];
+#else
+  return walks[0];
+#endif
+}
+
+// counts the searched vertices by the ring their closest vertex was found in
+static void mrisAddNbrCounts(std::vector<int> &nbr_count, std::vector<int> const &min_ns)
+{
+  for (int const min_n : min_ns)
+    if (min_n >= 0) nbr_count[min_n]++;
+}
+
+
 /*-----------------------------------------------------
   Parameters:
 
@@ -6897,92 +6979,72 @@ int MRIShistoThresholdCurvature(MRIS *mris, float thresh_pct)
   This routine assumes that the white matter surface is stored in
   ORIGINAL_VERTICES, and that the current vertex positions reflect
   the pial surface.
+
+  The vertices are searched in parallel and v->marked is not used.
   ------------------------------------------------------*/
 
 int MRISfindClosestOrigVertices(MRIS *mris, int nbhd_size)
 {
-  int vno, n, vlist[100000], vtotal, ns, i, vnum, nbr_count[100], min_n, min_vno;
-  float dx, dy, dz, dist, min_dist, nx, ny, nz, dot;
-
-  memset(nbr_count, 0, 100 * sizeof(int));
+  std::vector<MRISnbhdWalk> walks = mrisNbhdWalksPerThread();
+  std::vector<int> min_ns(mris->nvertices, -1);
 
   /* current vertex positions are gray matter, orig are white matter */
+  int vno;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(guided)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
     VERTEX * const v = &mris->vertices[vno];
     if (v->ripflag) {
-      continue;
+      ROMP_PFLB_continue;
     }
-    nx = v->nx;
-    ny = v->ny;
-    nz = v->nz;
+    float const nx = v->nx;
+    float const ny = v->ny;
+    float const nz = v->nz;
     if (vno == Gdiag_no) {
       DiagBreak();
     }
-    dx = v->x - v->origx;
-    dy = v->y - v->origy;
-    dz = v->z - v->origz;
-    min_dist = sqrt(dx * dx + dy * dy + dz * dz);
-    v->marked = 1;
-    vtotal = 1;
-    vlist[0] = vno;
-    min_n = 0;
-    min_vno = vno;
-    for (ns = 1; ns <= nbhd_size; ns++) {
-      vnum = 0; /* will be # of new neighbors added to list */
-      for (i = 0; i < vtotal; i++) {
-        VERTEX_TOPOLOGY const * const vnt = &mris->vertices_topology[vlist[i]];
-        VERTEX          const * const vn  = &mris->vertices         [vlist[i]];
-        if (vn->ripflag) {
-          continue;
-        }
-        if (vn->marked && vn->marked < ns - 1) {
-          continue;
-        }
-        for (n = 0; n < vnt->vnum; n++) {
-          VERTEX * const vn2 = &mris->vertices[vnt->v[n]];
-          if (vn2->ripflag || vn2->marked) /* already processed */
-          {
-            continue;
-          }
-          vlist[vtotal + vnum++] = vnt->v[n];
-          vn2->marked = ns;
-          dx = vn2->x - v->origx;
-          dy = vn2->y - v->origy;
-          dz = vn2->z - v->origz;
-          dot = dx * nx + dy * ny + dz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dot = vn2->nx * nx + vn2->ny * ny + vn2->nz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dist = sqrt(dx * dx + dy * dy + dz * dz);
-          if (dist < min_dist) {
-            min_n = ns;
-            min_dist = dist;
-            if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vnt->v[n], dist);
-            min_vno = vnt->v[n];
-          }
-        }
+    float dx = v->x - v->origx;
+    float dy = v->y - v->origy;
+    float dz = v->z - v->origz;
+    float min_dist = sqrt(dx * dx + dy * dy + dz * dz);
+    int min_n = 0;
+    int min_vno = vno;
+    mrisThisThreadsNbhdWalk(walks).walk(mris, vno, nbhd_size, [&](int vno2, int ns) {
+      VERTEX const * const vn2 = &mris->vertices[vno2];
+      float dx = vn2->x - v->origx;
+      float dy = vn2->y - v->origy;
+      float dz = vn2->z - v->origz;
+      float dot = dx * nx + dy * ny + dz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vtotal += vnum;
-    }
-
-    nbr_count[min_n]++;
-    for (n = 0; n < vtotal; n++) {
-      VERTEX * const vn = &mris->vertices[vlist[n]];
-      if (vn->ripflag) {
-        continue;
+      dot = vn2->nx * nx + vn2->ny * ny + vn2->nz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vn->marked = 0;
-    }
+      float const dist = sqrt(dx * dx + dy * dy + dz * dz);
+      if (dist < min_dist) {
+        min_n = ns;
+        min_dist = dist;
+        if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vno2, dist);
+        min_vno = vno2;
+      }
+    });
+
+    min_ns[vno] = min_n;
     v->curv = min_vno;  // BLETCH
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
-  for (n = 0; n <= nbhd_size; n++) {
+  std::vector<int> nbr_count(nbhd_size + 1, 0);
+  mrisAddNbrCounts(nbr_count, min_ns);
+  for (int n = 0; n <= nbhd_size; n++) {
     fprintf(stdout, "%d vertices at %d distance\n", nbr_count[n], n);
   }
   return (NO_ERROR);
@@ -6993,90 +7055,69 @@ int MRISfindClosestOrigVertices(MRIS *mris, int nbhd_size)
 */
 int MRISfindClosestPialVerticesCanonicalCoords(MRIS *mris, int nbhd_size)
 {
-  int vno, n, vlist[100000], vtotal, ns, i, vnum, nbr_count[100], min_n, min_vno;
-  float dx, dy, dz, dist, min_dist, nx, ny, nz, dot;
-
-  memset(nbr_count, 0, 100 * sizeof(int));
+  std::vector<MRISnbhdWalk> walks = mrisNbhdWalksPerThread();
+  std::vector<int> min_ns(mris->nvertices, -1);
 
+  int vno;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(guided)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
     VERTEX * const v  = &mris->vertices         [vno];
     if (v->ripflag) {
-      continue;
+      ROMP_PFLB_continue;
     }
-    nx = v->wnx;
-    ny = v->wny;
-    nz = v->wnz;
+    float const nx = v->wnx;
+    float const ny = v->wny;
+    float const nz = v->wnz;
     if (vno == Gdiag_no) {
       DiagBreak();
     }
-    dx = v->pialx - v->whitex;
-    dy = v->pialy - v->whitey;
-    dz = v->pialz - v->whitez;
-    min_dist = sqrt(dx * dx + dy * dy + dz * dz);
-    v->marked = 1;
-    vtotal = 1;
-    vlist[0] = vno;
-    min_n = 0;
-    min_vno = vno;
-    for (ns = 1; ns <= nbhd_size; ns++) {
-      vnum = 0; /* will be # of new neighbors added to list */
-      for (i = 0; i < vtotal; i++) {
-        VERTEX_TOPOLOGY const * const vnt = &mris->vertices_topology[vlist[i]];
-        VERTEX          const * const vn  = &mris->vertices         [vlist[i]];
-        if (vn->ripflag) {
-          continue;
-        }
-        if (vn->marked && vn->marked < ns - 1) {
-          continue;
-        }
-        for (n = 0; n < vnt->vnum; n++) {
-          VERTEX * const vn2 = &mris->vertices[vnt->v[n]];
-          if (vn2->ripflag || vn2->marked) /* already processed */
-          {
-            continue;
-          }
-          vlist[vtotal + vnum++] = vnt->v[n];
-          vn2->marked = ns;
-          dx = vn2->pialx - v->whitex;
-          dy = vn2->pialy - v->whitey;
-          dz = vn2->pialz - v->whitez;
-          dot = dx * nx + dy * ny + dz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dot = vn2->wnx * nx + vn2->wny * ny + vn2->wnz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dist = sqrt(dx * dx + dy * dy + dz * dz);
-          if (dist < min_dist) {
-            min_n = ns;
-            min_dist = dist;
-            if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vnt->v[n], dist);
-            min_vno = vnt->v[n];
-          }
-        }
+    float dx = v->pialx - v->whitex;
+    float dy = v->pialy - v->whitey;
+    float dz = v->pialz - v->whitez;
+    float min_dist = sqrt(dx * dx + dy * dy + dz * dz);
+    int min_n = 0;
+    int min_vno = vno;
+    mrisThisThreadsNbhdWalk(walks).walk(mris, vno, nbhd_size, [&](int vno2, int ns) {
+      VERTEX const * const vn2 = &mris->vertices[vno2];
+      float dx = vn2->pialx - v->whitex;
+      float dy = vn2->pialy - v->whitey;
+      float dz = vn2->pialz - v->whitez;
+      float dot = dx * nx + dy * ny + dz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vtotal += vnum;
-    }
-
-    nbr_count[min_n]++;
-    for (n = 0; n < vtotal; n++) {
-      VERTEX * const vn = &mris->vertices[vlist[n]];
-      if (vn->ripflag) {
-        continue;
+      dot = vn2->wnx * nx + vn2->wny * ny + vn2->wnz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vn->marked = 0;
-    }
+      float const dist = sqrt(dx * dx + dy * dy + dz * dz);
+      if (dist < min_dist) {
+        min_n = ns;
+        min_dist = dist;
+        if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vno2, dist);
+        min_vno = vno2;
+      }
+    });
+
+    // only v's own x,y,z are written, the search reads the pial and white coords
+    min_ns[vno] = min_n;
     v->curv = min_vno;                  // BLETCH
     v->x = mris->vertices[min_vno].cx;
     v->y = mris->vertices[min_vno].cy;
     v->z = mris->vertices[min_vno].cz;
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
-  for (n = 0; n <= nbhd_size; n++) {
+  std::vector<int> nbr_count(nbhd_size + 1, 0);
+  mrisAddNbrCounts(nbr_count, min_ns);
+  for (int n = 0; n <= nbhd_size; n++) {
     fprintf(stdout, "%d vertices at %d distance\n", nbr_count[n], n);
   }
   return (NO_ERROR);
@@ -7085,93 +7126,64 @@ int MRISfindClosestPialVerticesCanonicalCoords(MRIS *mris, int nbhd_size)
 
 int MRISmeasureCorticalThickness(MRIS *mris, int nbhd_size, float max_thick)
 {
-  int vno, n, vlist[100000], vtotal, ns, i, vnum, nbr_count[100], min_n, nwg_bad, ngw_bad;
-  float dx, dy, dz, dist, min_dist, nx, ny, nz, dot;
-
-  memset(nbr_count, 0, 100 * sizeof(int));
-  nwg_bad = ngw_bad = 0;
+  std::vector<MRISnbhdWalk> walks = mrisNbhdWalksPerThread();
+  std::vector<int> min_ns(mris->nvertices, -1), min_ns2(mris->nvertices, -1);
+  int nwg_bad = 0, ngw_bad = 0;
 
   /* current vertex positions are gray matter, orig are white matter */
+  int vno;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : nwg_bad) schedule(guided)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
     if (!(vno % 25000)) {
       fprintf(stdout, "%d of %d vertices processed\n", vno, mris->nvertices);
     }
     VERTEX * const v = &mris->vertices[vno];
     if (v->ripflag) {
       v->curv = 0;
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
+      ROMP_PFLB_continue;
     }
-    nx = v->nx;
-    ny = v->ny;
-    nz = v->nz;
+    float const nx = v->nx;
+    float const ny = v->ny;
+    float const nz = v->nz;
     if (vno == Gdiag_no) {
       DiagBreak();
     }
-    dx = v->x - v->origx;
-    dy = v->y - v->origy;
-    dz = v->z - v->origz;
-    min_dist = sqrt(dx * dx + dy * dy + dz * dz);
-    v->marked = 1;
-    vtotal = 1;
-    vlist[0] = vno;
-    min_n = 0;
-    for (ns = 1; ns <= nbhd_size; ns++) {
-      vnum = 0; /* will be # of new neighbors added to list */
-      for (i = 0; i < vtotal; i++) {
-        VERTEX_TOPOLOGY const * const vnt = &mris->vertices_topology[vlist[i]];
-        VERTEX          const * const vn  = &mris->vertices         [vlist[i]];
-        if (vn->ripflag) {
-          continue;
-        }
-        if (vn->marked && vn->marked < ns - 1) {
-          continue;
-        }
-        for (n = 0; n < vnt->vnum; n++) {
-          VERTEX * const vn2 = &mris->vertices[vnt->v[n]];
-          if (vn2->ripflag || vn2->marked) /* already processed */
-          {
-            continue;
-          }
-          vlist[vtotal + vnum++] = vnt->v[n];
-          vn2->marked = ns;
-          dx = vn2->x - v->origx;
-          dy = vn2->y - v->origy;
-          dz = vn2->z - v->origz;
-          dot = dx * nx + dy * ny + dz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dot = vn2->nx * nx + vn2->ny * ny + vn2->nz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dist = sqrt(dx * dx + dy * dy + dz * dz);
-	  if(Gdiag_no == vno) {
-	    printf("vno=%d A %3d %6d (%g,%g,%g) (%g,%g,%g) %g %g\n",vno,n,vnt->v[n],v->origx,v->origy,v->origz,v->x,v->y,v->z,dist,min_dist);
-	  }
-          if (dist < min_dist) {
-            min_n = ns;
-            min_dist = dist;
-            if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vnt->v[n], dist);
-          }
-        }
+    float dx = v->x - v->origx;
+    float dy = v->y - v->origy;
+    float dz = v->z - v->origz;
+    float min_dist = sqrt(dx * dx + dy * dy + dz * dz);
+    int min_n = 0;
+    mrisThisThreadsNbhdWalk(walks).walk(mris, vno, nbhd_size, [&](int vno2, int ns) {
+      VERTEX const * const vn2 = &mris->vertices[vno2];
+      float dx = vn2->x - v->origx;
+      float dy = vn2->y - v->origy;
+      float dz = vn2->z - v->origz;
+      float dot = dx * nx + dy * ny + dz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vtotal += vnum;
-    }
-
-    nbr_count[min_n]++;
-    for (n = 0; n < vtotal; n++) {
-      VERTEX * const vn = &mris->vertices[vlist[n]];
-      if (vn->ripflag) {
-        continue;
+      dot = vn2->nx * nx + vn2->ny * ny + vn2->nz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vn->marked = 0;
-    }
+      float const dist = sqrt(dx * dx + dy * dy + dz * dz);
+      if(Gdiag_no == vno) {
+        printf("vno=%d A %6d (%g,%g,%g) (%g,%g,%g) %g %g\n",vno,vno2,v->origx,v->origy,v->origz,v->x,v->y,v->z,dist,min_dist);
+      }
+      if (dist < min_dist) {
+        min_n = ns;
+        min_dist = dist;
+        if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vno2, dist);
+      }
+    });
+
+    min_ns[vno] = min_n;
     if (min_dist > max_thick) {
       nwg_bad++;
       min_dist = max_thick;
@@ -7180,9 +7192,17 @@ int MRISmeasureCorticalThickness(MRIS *mris, int nbhd_size, float max_thick)
       DiagBreak();
     }
     v->curv = min_dist;
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
+  // the second pass only reads the x,y,z and orig coords, and the curv of its own vertex
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : ngw_bad) schedule(guided)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
     if (!(vno % 25000)) {
       fprintf(stdout, "%d of %d vertices processed\n", vno, mris->nvertices);
     }
@@ -7191,76 +7211,43 @@ int MRISmeasureCorticalThickness(MRIS *mris, int nbhd_size, float max_thick)
       DiagBreak();
     }
     if (v->ripflag) {
-      continue;
-    }
-    nx = v->nx;
-    ny = v->ny;
-    nz = v->nz;
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-    dx = v->x - v->origx;
-    dy = v->y - v->origy;
-    dz = v->z - v->origz;
-    min_dist = sqrt(dx * dx + dy * dy + dz * dz);
-    v->marked = 1;
-    vtotal = 1;
-    vlist[0] = vno;
-    min_n = 0;
-    for (ns = 1; ns <= nbhd_size; ns++) {
-      vnum = 0; /* will be # of new neighbors added to list */
-      for (i = 0; i < vtotal; i++) {
-        VERTEX_TOPOLOGY const * const vnt = &mris->vertices_topology[vlist[i]];
-        VERTEX          const * const vn  = &mris->vertices         [vlist[i]];
-        if (vn->ripflag) {
-          continue;
-        }
-        if (vn->marked && vn->marked < ns - 1) {
-          continue;
-        }
-        for (n = 0; n < vnt->vnum; n++) {
-          VERTEX * const vn2 = &mris->vertices[vnt->v[n]];
-          if (vn2->ripflag || vn2->marked) /* already processed */
-          {
-            continue;
-          }
-          vlist[vtotal + vnum++] = vnt->v[n];
-          vn2->marked = ns;
-          dx = v->x - vn2->origx;
-          dy = v->y - vn2->origy;
-          dz = v->z - vn2->origz;
-          dot = dx * nx + dy * ny + dz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dot = vn2->nx * nx + vn2->ny * ny + vn2->nz * nz;
-          if (dot < 0) /* must be outwards from surface */
-          {
-            continue;
-          }
-          dist = sqrt(dx * dx + dy * dy + dz * dz);
-	  if(Gdiag_no == vno) {
-	    printf("vno=%d B %3d %6d (%g,%g,%g) (%g,%g,%g) %g %g\n",vno,n,vnt->v[n],vn2->origx,vn2->origy,vn2->origz,v->x,v->y,v->z,dist,min_dist);
-	  }
-          if (dist < min_dist) {
-            min_n = ns;
-            min_dist = dist;
-            if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vnt->v[n], dist);
-          }
-        }
+      ROMP_PFLB_continue;
+    }
+    float const nx = v->nx;
+    float const ny = v->ny;
+    float const nz = v->nz;
+    float dx = v->x - v->origx;
+    float dy = v->y - v->origy;
+    float dz = v->z - v->origz;
+    float min_dist = sqrt(dx * dx + dy * dy + dz * dz);
+    int min_n = 0;
+    mrisThisThreadsNbhdWalk(walks).walk(mris, vno, nbhd_size, [&](int vno2, int ns) {
+      VERTEX const * const vn2 = &mris->vertices[vno2];
+      float dx = v->x - vn2->origx;
+      float dy = v->y - vn2->origy;
+      float dz = v->z - vn2->origz;
+      float dot = dx * nx + dy * ny + dz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vtotal += vnum;
-    }
-
-    nbr_count[min_n]++;
-    for (n = 0; n < vtotal; n++) {
-      VERTEX * const vn = &mris->vertices[vlist[n]];
-      if (vn->ripflag) {
-        continue;
+      dot = vn2->nx * nx + vn2->ny * ny + vn2->nz * nz;
+      if (dot < 0) /* must be outwards from surface */
+      {
+        return;
       }
-      vn->marked = 0;
-    }
+      float const dist = sqrt(dx * dx + dy * dy + dz * dz);
+      if(Gdiag_no == vno) {
+        printf("vno=%d B %6d (%g,%g,%g) (%g,%g,%g) %g %g\n",vno,vno2,vn2->origx,vn2->origy,vn2->origz,v->x,v->y,v->z,dist,min_dist);
+      }
+      if (dist < min_dist) {
+        min_n = ns;
+        min_dist = dist;
+        if (min_n == nbhd_size && DIAG_VERBOSE_ON) fprintf(stdout, "%d --> %d = %2.3f\n", vno, vno2, dist);
+      }
+    });
+
+    min_ns2[vno] = min_n;
     if (DIAG_VERBOSE_ON && fabs(v->curv - min_dist) > 4.0)
       fprintf(stdout, "v %d, white->gray=%2.2f, gray->white=%2.2f\n", vno, v->curv, min_dist);
     if (min_dist > max_thick) {
@@ -7276,10 +7263,15 @@ int MRISmeasureCorticalThickness(MRIS *mris, int nbhd_size, float max_thick)
     }
     if(Gdiag_no == vno) 
       printf("vno = %d, final measurment %g\n",vno,v->curv);
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
   fprintf(stdout, "thickness calculation complete, %d:%d truncations.\n", nwg_bad, ngw_bad);
-  for (n = 0; n <= nbhd_size; n++) {
+  std::vector<int> nbr_count(nbhd_size + 1, 0);
+  mrisAddNbrCounts(nbr_count, min_ns);
+  mrisAddNbrCounts(nbr_count, min_ns2);
+  for (int n = 0; n <= nbhd_size; n++) {
     fprintf(stdout, "%d vertices at %d distance\n", nbr_count[n], n);
   }
   return (NO_ERROR);
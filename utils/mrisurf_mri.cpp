@@ -451,6 +451,8 @@ int MRISpositionSurface(MRI_SURFACE *mris, MRI *mri_brain, MRI *mri_smooth, INTE
   double sse, delta_t = 0.0, rms, dt, l_intensity, base_dt, last_sse, last_rms, max_mm;
   MHT *mht = NULL, *mht_v_orig = NULL, *mht_v_current = NULL, *mht_f_current = NULL, *mht_pial = NULL;
   int msec;
+  long hash_nsec = 0;
+  int const start_t = parms->start_t;
   VERTEX *vgdiag;
 
   printf("Entering MRISpositionSurface()\n");
@@ -587,17 +589,24 @@ int MRISpositionSurface(MRI_SURFACE *mris, MRI *mri_brain, MRI *mri_smooth, INTE
   // important than it first appears.
   dt = parms->dt;
   l_intensity = parms->l_intensity;
+  Timer loop_timer;
   for (n = parms->start_t; n < parms->start_t + niterations; n++) {
 
     parms->t = n;
+    Timer iter_timer;
+    // The face tables follow the surface: only the faces that moved since the
+    // last iteration (or were moved back by a rejected step) are re-bucketed.
     if (!FZERO(parms->l_repulse)) {
       MHTfree(&mht_v_current);
       mht_v_current = MHTcreateVertexTable(mris, CURRENT_VERTICES);
-      MHTfree(&mht_f_current); mht_f_current = MHTcreateFaceTable(mris);
+      if (mht_f_current) MHTupdateAllFaces(mht_f_current, mris);
+      else mht_f_current = MHTcreateFaceTable(mris);
     }
     if (!(parms->flags & IPFLAG_NO_SELF_INT_TEST)) {
-      MHTfree(&mht); mht = MHTcreateFaceTable(mris);
+      if (mht) MHTupdateAllFaces(mht, mris);
+      else mht = MHTcreateFaceTable(mris);
     }
+    hash_nsec += iter_timer.nanoseconds();
     MRISclearGradient(mris);
 
     // Compute the gradient direction
@@ -856,6 +865,10 @@ int MRISpositionSurface(MRI_SURFACE *mris, MRI *mri_brain, MRI *mri_smooth, INTE
 
   parms->start_t = n;
   parms->dt = base_dt;
+  if ((Gdiag & DIAG_SHOW) && n > start_t) {
+    printf("  %d iterations, %2.1f msec/iteration, %2.1f msec/iteration hash table upkeep\n",
+           n - start_t, (float)loop_timer.milliseconds() / (n - start_t), hash_nsec / 1e6 / (n - start_t));
+  }
   if (Gdiag & DIAG_SHOW) {
     msec = then.milliseconds();
     fprintf(stdout, "positioning took %2.1f minutes\n", (float)msec / (60 * 1000.0f));
@@ -5403,6 +5416,165 @@ MRI *MRISsmoothMRI(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *BinMask, MRI *Ta
   MRIScrsLUTFree(crslut);
   return (Targ);
 }
+/*-------------------------------------------------------------------
+  MRIS_SMOOTH_OPERATOR - one step of the nearest neighbour averaging
+  done by MRISsmoothMRIFast() as a sparse matrix in CSR form. The row
+  of vertex vno lists vno itself followed by its unripped, in-mask
+  neighbors, in the order their values are summed, and the new value
+  is the sum divided by the length of the row. Vertices out of the
+  mask have empty rows and are held at 0. Building it once replaces
+  walking the neighbor lists again for every frame.
+  -------------------------------------------------------------------*/
+struct MRIS_SMOOTH_OPERATOR {
+  int nvertices;
+  std::vector<int> rowstart, col;
+};
+
+// frames smoothed together, stored interleaved so that the values of a
+// vertex for all frames of a block are contiguous (one cache line)
+#define MRIS_SMOOTH_FRAME_BLOCK 16
+
+/*-------------------------------------------------------------------
+  MRISsmoothOperator() - builds the smoothing step for Surf and the
+  inclusive mask IncMask (nvertices x 1 x 1, NULL for no mask). The
+  ripflags of Surf are read now, so rip before building it.
+  -------------------------------------------------------------------*/
+MRIS_SMOOTH_OPERATOR *MRISsmoothOperator(MRIS *Surf, MRI *IncMask)
+{
+  if (IncMask && IncMask->width != Surf->nvertices) {
+    printf("ERROR: MRISsmoothOperator(): Surf/Mask dimension mismatch\n");
+    return (NULL);
+  }
+
+  MRIS_SMOOTH_OPERATOR *op = new MRIS_SMOOTH_OPERATOR;
+  op->nvertices = Surf->nvertices;
+  op->rowstart.resize(Surf->nvertices + 1);
+  op->col.reserve(7 * Surf->nvertices);
+  for (int vno = 0; vno < Surf->nvertices; vno++) {
+    op->rowstart[vno] = op->col.size();
+    // Mask is inclusive, so look for out of mask
+    // should exclude rips here too? Original does not.
+    if (IncMask && MRIgetVoxVal(IncMask, vno, 0, 0, 0) < 0.5) continue;
+    op->col.push_back(vno);
+    VERTEX_TOPOLOGY const * const vt = &Surf->vertices_topology[vno];
+    for (int nthnbr = 0; nthnbr < vt->vnum; nthnbr++) {
+      int const nbrvno = vt->v[nthnbr];
+      if (Surf->vertices[nbrvno].ripflag) continue;
+      if (IncMask && MRIgetVoxVal(IncMask, nbrvno, 0, 0, 0) < 0.5) continue;
+      op->col.push_back(nbrvno);
+    }
+  }
+  op->rowstart[Surf->nvertices] = op->col.size();
+  return (op);
+}
+
+void MRISsmoothOperatorFree(MRIS_SMOOTH_OPERATOR **pop)
+{
+  delete *pop;
+  *pop = NULL;
+}
+
+/*-------------------------------------------------------------------
+  Applies nSmoothSteps steps of op to frames frame0..frame1-1 of Src
+  in place. The frames are done MRIS_SMOOTH_FRAME_BLOCK at a time: the
+  sum over a row runs over all frames of the block at once and the
+  vertices of each step are spread over the threads. Each frame sees
+  exactly the additions and division it did when smoothed on its own.
+  -------------------------------------------------------------------*/
+static void mrisSmoothOperatorApplyFrames(MRIS_SMOOTH_OPERATOR *op, MRI *Src, int frame0, int frame1, int nSmoothSteps)
+{
+  int const nvertices = op->nvertices;
+  int const *const rowstart = op->rowstart.data();
+  int const *const col = op->col.data();
+  int const nblock = MIN(frame1 - frame0, MRIS_SMOOTH_FRAME_BLOCK);
+  std::vector<float> xbuf((size_t)nvertices * nblock), ybuf((size_t)nvertices * nblock);
+
+  for (int f0 = frame0; f0 < frame1; f0 += nblock) {
+    int const nf = MIN(nblock, frame1 - f0);
+    float *x = xbuf.data(), *y = ybuf.data();
+
+    // out-of-mask vertices start (and stay) at 0
+    int vno;
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+    for (vno = 0; vno < nvertices; vno++) {
+      ROMP_PFLB_begin
+      float *const xv = x + (size_t)vno * nf;
+      int const in = rowstart[vno] < rowstart[vno + 1];
+      for (int f = 0; f < nf; f++) xv[f] = in ? MRIFseq_vox(Src, vno, 0, 0, f0 + f) : 0;
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    for (int nthstep = 0; nthstep < nSmoothSteps; nthstep++) {
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+      #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+      for (vno = 0; vno < nvertices; vno++) {
+        ROMP_PFLB_begin
+        float *const yv = y + (size_t)vno * nf;
+        int const k0 = rowstart[vno], k1 = rowstart[vno + 1];
+        if (k0 == k1) {
+          for (int f = 0; f < nf; f++) yv[f] = 0;
+          ROMP_PFLB_continue;
+        }
+        float const *xv = x + (size_t)col[k0] * nf;
+        for (int f = 0; f < nf; f++) yv[f] = xv[f];
+        for (int k = k0 + 1; k < k1; k++) {
+          xv = x + (size_t)col[k] * nf;
+#ifdef HAVE_OPENMP
+          #pragma omp simd
+#endif
+          for (int f = 0; f < nf; f++) yv[f] += xv[f];
+        }
+        float const num = k1 - k0;
+#ifdef HAVE_OPENMP
+        #pragma omp simd
+#endif
+        for (int f = 0; f < nf; f++) yv[f] /= num;
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+      std::swap(x, y);
+    }
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+    for (vno = 0; vno < nvertices; vno++) {
+      ROMP_PFLB_begin
+      float const *const xv = x + (size_t)vno * nf;
+      for (int f = 0; f < nf; f++) MRIFseq_vox(Src, vno, 0, 0, f0 + f) = xv[f];
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+  }
+}
+
+/*-------------------------------------------------------------------
+  MRISsmoothOperatorApply() - smooths all frames of Src (MRI_FLOAT,
+  nvertices x 1 x 1) in place with nSmoothSteps steps of op. The
+  result is the same as that of MRISsmoothMRIFast() with the surface
+  and mask op was built from.
+  -------------------------------------------------------------------*/
+int MRISsmoothOperatorApply(MRIS_SMOOTH_OPERATOR *op, MRI *Src, int nSmoothSteps)
+{
+  if (Src->width != op->nvertices || Src->height != 1 || Src->depth != 1) {
+    printf("ERROR: MRISsmoothOperatorApply(): Surf/Src dimension mismatch\n");
+    return (1);
+  }
+  if (Src->type != MRI_FLOAT) {
+    printf("ERROR: MRISsmoothOperatorApply(): structure passed is not MRI_FLOAT\n");
+    return (1);
+  }
+  mrisSmoothOperatorApplyFrames(op, Src, 0, Src->nframes, nSmoothSteps);
+  return (0);
+}
+
 /*-------------------------------------------------------------------
   MRISsmoothMRIFast() - faster version of MRISsmoothMRI(). Smooths
   values on the surface when the surface values are stored in an
@@ -5419,12 +5591,10 @@ MRI *MRISsmoothMRI(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *BinMask, MRI *Ta
   -------------------------------------------------------------------*/
 MRI *MRISsmoothMRIFast(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask, MRI *Targ)
 {
-  int nnbrs, nthstep, frame, vno, nthnbr, num, nvox, nbrvno, reshape;
+  int nvox, reshape;
   MRI *SrcTmp, *mritmp, *IncMaskTmp = NULL;
   int msecTime;
-  int *nNbrs, *nNbrs0, *rip, *rip0, nNbrsMax;
-  float **pF, **pF0, *tF, *tF0, sumF;
-  VERTEX *v, *vn;
+  MRIS_SMOOTH_OPERATOR *op;
 
   if (Gdiag_no > 0) printf("MRISsmoothMRIFast()\n");
 
@@ -5464,86 +5634,16 @@ MRI *MRISsmoothMRIFast(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask, MRI
     }
   }
 
-  // Alloc arrays. If there are ripped vertices, then only rip
-  // needs nvertices elements
-  nNbrsMax = 12;  // Should measure this, but overalloc does not hurt
-  pF = (float **)calloc(Surf->nvertices * nNbrsMax, sizeof(float *));
-  tF = (float *)calloc(Surf->nvertices, sizeof(float));
-  nNbrs = (int *)calloc(Surf->nvertices, sizeof(int));
-  rip = (int *)calloc(Surf->nvertices, sizeof(int));
-
-  pF0 = pF;
-  tF0 = tF;
-  rip0 = rip;
-  nNbrs0 = nNbrs;
-
+  // Build the smoothing step once for all frames
   Timer mytimer;
-
-  // Loop through frames
-  for (frame = 0; frame < Src->nframes; frame++) {
-    // Set up pointers for this frame
-    pF = pF0;
-    rip = rip0;
-    nNbrs = nNbrs0;
-    for (vno = 0; vno < Surf->nvertices; vno++) {
-      v = &Surf->vertices[vno];
-      if (IncMaskTmp && MRIgetVoxVal(IncMaskTmp, vno, 0, 0, 0) < 0.5) {
-        // Mask is inclusive, so look for out of mask
-        // should exclude rips here too? Original does not.
-        rip[vno] = 1;
-        MRIFseq_vox(SrcTmp, vno, 0, 0, frame) = 0;
-        continue;
-      }
-      rip[vno] = 0;
-      *pF++ = (float *)(&(MRIFseq_vox(SrcTmp, vno, 0, 0, frame)));
-      nnbrs = Surf->vertices_topology[vno].vnum;
-      num = 1;
-      for (nthnbr = 0; nthnbr < nnbrs; nthnbr++) {
-        nbrvno = Surf->vertices_topology[vno].v[nthnbr];
-        vn = &Surf->vertices[nbrvno];
-        if (vn->ripflag) {
-          continue;
-        }
-        if (IncMaskTmp && MRIgetVoxVal(IncMaskTmp, nbrvno, 0, 0, 0) < 0.5) {
-          continue;
-        }
-        *pF++ = (float *)(&(MRIFseq_vox(SrcTmp, nbrvno, 0, 0, frame)));
-        num++;
-      }
-      *nNbrs++ = num;  // num takes into account all rips/masks
-    }
-
-    // Step through the iterations
-    for (nthstep = 0; nthstep < nSmoothSteps; nthstep++) {
-      // Init pointers for this iteration
-      pF = pF0;
-      rip = rip0;
-      tF = tF0;
-      nNbrs = nNbrs0;
-      // Loop through vertices, average nearest neighbors
-      for (vno = 0; vno < Surf->nvertices; vno++) {
-        if (*rip++) {
-          continue;
-        }
-        sumF = *(*pF++);
-        for (nthnbr = 0; nthnbr < (*nNbrs) - 1; nthnbr++) {
-          sumF += *(*pF++);
-        }
-        *tF++ = sumF / (*nNbrs);
-        nNbrs++;
-      }
-      // Load up for the next step
-      rip = rip0;
-      tF = tF0;
-      for (vno = 0; vno < Surf->nvertices; vno++) {
-        if (*rip++) {
-          continue;
-        }
-        MRIsetVoxVal(SrcTmp, vno, 0, 0, frame, *tF++);
-      }
-    }
-
-  } /* end loop over frame */
+  op = MRISsmoothOperator(Surf, IncMaskTmp);
+  int err = (op == NULL) || MRISsmoothOperatorApply(op, SrcTmp, nSmoothSteps);
+  if (op) MRISsmoothOperatorFree(&op);
+  if (err) {
+    MRIfree(&SrcTmp);
+    if (IncMaskTmp) MRIfree(&IncMaskTmp);
+    return (NULL);
+  }
 
   // Copy to the output
   if (reshape) {
@@ -5563,10 +5663,6 @@ MRI *MRISsmoothMRIFast(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask, MRI
 
   MRIfree(&SrcTmp);
   if (IncMaskTmp) MRIfree(&IncMaskTmp);
-  free(pF0);
-  free(tF0);
-  free(rip0);
-  free(nNbrs0);
 
   return (Targ);
 }
@@ -5726,20 +5822,17 @@ MRI *MRISsmoothMRIFastD(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask, MR
 
 /*------------------------------------------------------------------
   MRISsmoothMRIFastFrame() same as MRISsmoothMRIFast() but operates
-  on a single frame. This allows the pointers to be cached in
-  a static data structure. Note: this will fail if Src is not
-  nvertices x 1 x 1 x nframes.
+  on a single frame, in place. Every call must pass the same Surf, Src
+  and frame. Note: this will fail if Src is not nvertices x 1 x 1 x
+  nframes.
   ------------------------------------------------------------------*/
 int MRISsmoothMRIFastFrame(MRIS *Surf, MRI *Src, int frame, int nSmoothSteps, MRI *IncMask)
 {
-  int nnbrs, nthstep, vno, nthnbr, num, nvox, nbrvno;
+  int nvox;
   int msecTime;
-  float sumF;
-  VERTEX *v, *vn;
   static MRIS *SurfInit = NULL;
   static MRI *SrcInit = NULL;
-  static int DoInit = 1, frameInit = 0, *nNbrs = NULL, *nNbrs0 = NULL, *rip = NULL, *rip0 = NULL, nNbrsMax = 0;
-  static float **pF = NULL, **pF0 = NULL, *tF = NULL, *tF0 = NULL;
+  static int DoInit = 1, frameInit = 0;
 
   if (Gdiag_no > 0) printf("MRISsmoothMRIFastFrame()\n");
 
@@ -5752,17 +5845,6 @@ int MRISsmoothMRIFastFrame(MRIS *Surf, MRI *Src, int frame, int nSmoothSteps, MR
       printf("ERROR: MRISsmoothMRIFastFrame(): Surf/Src dimension mismatch\n");
       return (1);
     }
-    // Alloc arrays. If there are ripped vertices, then only rip
-    // needs nvertices elements
-    nNbrsMax = 12;  // Should measure this, but overalloc does not hurt
-    pF = (float **)calloc(Surf->nvertices * nNbrsMax, sizeof(float *));
-    tF = (float *)calloc(Surf->nvertices, sizeof(float));
-    nNbrs = (int *)calloc(Surf->nvertices, sizeof(int));
-    rip = (int *)calloc(Surf->nvertices, sizeof(int));
-    pF0 = pF;
-    tF0 = tF;
-    rip0 = rip;
-    nNbrs0 = nNbrs;
     SrcInit = Src;
     SurfInit = Surf;
     frameInit = frame;
@@ -5783,67 +5865,11 @@ int MRISsmoothMRIFastFrame(MRIS *Surf, MRI *Src, int frame, int nSmoothSteps, MR
 
   Timer mytimer;
 
-  // Set up pointers for this call
-  pF = pF0;
-  rip = rip0;
-  nNbrs = nNbrs0;
-  for (vno = 0; vno < Surf->nvertices; vno++) {
-    v = &Surf->vertices[vno];
-    if (IncMask && MRIgetVoxVal(IncMask, vno, 0, 0, 0) < 0.5) {
-      // Mask is inclusive, so look for out of mask
-      // should exclude rips here too? Original does not.
-      rip[vno] = 1;
-      MRIFseq_vox(Src, vno, 0, 0, frame) = 0;
-      continue;
-    }
-    rip[vno] = 0;
-    *pF++ = (float *)(&(MRIFseq_vox(Src, vno, 0, 0, frame)));
-    nnbrs = Surf->vertices_topology[vno].vnum;
-    num = 1;
-    for (nthnbr = 0; nthnbr < nnbrs; nthnbr++) {
-      nbrvno = Surf->vertices_topology[vno].v[nthnbr];
-      vn = &Surf->vertices[nbrvno];
-      if (vn->ripflag) {
-        continue;
-      }
-      if (IncMask && MRIgetVoxVal(IncMask, nbrvno, 0, 0, 0) < 0.5) {
-        continue;
-      }
-      *pF++ = (float *)(&(MRIFseq_vox(Src, nbrvno, 0, 0, frame)));
-      num++;
-    }
-    *nNbrs++ = num;  // num takes into account all rips/masks
-  }
-
-  // Step through the iterations
-  for (nthstep = 0; nthstep < nSmoothSteps; nthstep++) {
-    // Init pointers for this iteration
-    pF = pF0;
-    rip = rip0;
-    tF = tF0;
-    nNbrs = nNbrs0;
-    // Loop through vertices, average nearest neighbors
-    for (vno = 0; vno < Surf->nvertices; vno++) {
-      if (*rip++) {
-        continue;
-      }
-      sumF = *(*pF++);
-      for (nthnbr = 0; nthnbr < (*nNbrs) - 1; nthnbr++) {
-        sumF += *(*pF++);
-      }
-      *tF++ = sumF / (*nNbrs);
-      nNbrs++;
-    }
-    // Load up for the next step
-    rip = rip0;
-    tF = tF0;
-    for (vno = 0; vno < Surf->nvertices; vno++) {
-      if (*rip++) {
-        continue;
-      }
-      MRIsetVoxVal(Src, vno, 0, 0, frame, *tF++);
-    }
-  }
+  // The mask may change between calls, so the step is built each time
+  MRIS_SMOOTH_OPERATOR *op = MRISsmoothOperator(Surf, IncMask);
+  if (op == NULL) return (1);
+  mrisSmoothOperatorApplyFrames(op, Src, frame, frame + 1, nSmoothSteps);
+  MRISsmoothOperatorFree(&op);
 
   msecTime = mytimer.milliseconds();
   if (Gdiag_no > 0) {
@@ -64,6 +64,7 @@
 #include "bfileio.h"
 #include "corio.h"
 #include "diag.h"
+#include "fio.h"
 #include "label.h"
 #include "matrix.h"
 #include "mri.h"
@@ -940,30 +941,54 @@ MRI *MRISapplyRegBCI(MRIS *reg1, MRIS *reg2, MRI *in)
 
 
 /*!
-\fn MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
+\fn unsigned long MRISapplyRegChecksum(MRI_SURFACE **SurfReg, int nsurfs,
                   int ReverseMapFlag, int DoJac, int UseHash)
-\brief Applies one or more surface registrations with or without jacobian correction.
-This should be used as a replacement for surf2surf_nnfr and surf2surf_nnfr_jac
-(it gives identical results).
-\param MRI *SrcSurfVals - Inputs
-\param MRIS **SurfReg - array of surface reg pairs, src1-trg1:src2-trg2:... where
-trg1 and src2 are from the same anatomy.
-\param int nsurfs - total number of surfs in SurfReg
-\param int ReverseMapFlag - perform reverse mapping
-\param int DoJac - perform jacobian correction (conserves sum(SrcVals))
-\param int UseHash - use hash table (no reason not to, much faster).
+\brief Hash of everything the MRISapplyReg() correspondence depends on: the
+number of vertices, the current xyz and the ripflag of each surface in
+SurfReg and the mapping options. Used to tell whether a map saved with
+MRISapplyRegMapWrite() still applies.
 */
-MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int ReverseMapFlag, int DoJac, int UseHash)
+unsigned long MRISapplyRegChecksum(MRI_SURFACE **SurfReg, int nsurfs, int ReverseMapFlag, int DoJac, int UseHash)
+{
+  FnvHash hash;
+  hash.add(&nsurfs);
+  hash.add(&ReverseMapFlag);
+  hash.add(&DoJac);
+  hash.add(&UseHash);
+  for (int n = 0; n < nsurfs; n++) {
+    MRIS const *surf = SurfReg[n];
+    hash.add(&surf->nvertices);
+    for (int vno = 0; vno < surf->nvertices; vno++) {
+      VERTEX const *v = &surf->vertices[vno];
+      hash.add(&v->x);
+      hash.add(&v->y);
+      hash.add(&v->z);
+      int const ripflag = v->ripflag;
+      hash.add(&ripflag);
+    }
+  }
+  return hash.value;
+}
+
+
+/*!
+\fn MRIS_APPLYREG_MAP *MRISapplyRegMap(MRI_SURFACE **SurfReg, int nsurfs,
+                  int ReverseMapFlag, int DoJac, int UseHash)
+\brief Computes the source-to-target vertex correspondence of MRISapplyReg()
+(see there for the arguments) without applying it to any values. The
+forward and reverse nearest vertex searches, the reverse map hit counts
+and the jacobian correction are all folded into the returned sparse map,
+which MRISapplyRegMapApply() then applies to any number of frames and
+inputs. Free with MRISapplyRegMapFree().
+*/
+MRIS_APPLYREG_MAP *MRISapplyRegMap(MRI_SURFACE **SurfReg, int nsurfs, int ReverseMapFlag, int DoJac, int UseHash)
 {
-  MRI *TrgSurfVals = NULL;
   MRI_SURFACE *SrcSurfReg, *TrgSurfReg;
-  int svtx = 0, tvtx, tvtxN, svtxN = 0, f, n, nrevhits, nSrcLost;
+  int svtx = 0, tvtx, tvtxN, svtxN = 0, n, nrevhits, nSrcLost;
   int npairs, kS, kT, nhits;
-  // int nunmapped;
   VERTEX *v;
   float dmin;
   MHT **Hash = NULL;
-  MRI *SrcHits, *TrgHits;
 
   npairs = nsurfs / 2;
   printf("MRISapplyReg(): nsurfs = %d, revmap=%d, jac=%d,  hash=%d\n", nsurfs, ReverseMapFlag, DoJac, UseHash);
@@ -973,11 +998,6 @@ MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int Rever
   TrgSurfReg = SurfReg[nsurfs - 1];
 
   /* check dimension consistency */
-  if (SrcSurfVals->width != SrcSurfReg->nvertices) {
-    printf("MRISapplyReg: Vals and Reg dimension mismatch\n");
-    printf("nVals = %d, nReg %d\n", SrcSurfVals->width, SrcSurfReg->nvertices);
-    return (NULL);
-  }
   for (n = 0; n < npairs - 1; n++) {
     kS = 2 * n + 1;
     kT = kS + 1;
@@ -988,20 +1008,18 @@ MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int Rever
     }
   }
 
-  /* allocate a "volume" to hold the output */
-  TrgSurfVals = MRIallocSequence(TrgSurfReg->nvertices, 1, 1, MRI_FLOAT, SrcSurfVals->nframes);
-  if (TrgSurfVals == NULL) return (NULL);
-  MRIcopyHeader(SrcSurfVals, TrgSurfVals);
-
   /* number of source vertices mapped to each target vertex */
-  TrgHits = MRIallocSequence(TrgSurfReg->nvertices, 1, 1, MRI_FLOAT, 1);
-  if (TrgHits == NULL) return (NULL);
-  MRIcopyHeader(SrcSurfVals, TrgHits);
-
+  std::vector<int> TrgHits(TrgSurfReg->nvertices, 0);
   /* number of target vertices mapped to by each source vertex */
-  SrcHits = MRIallocSequence(SrcSurfReg->nvertices, 1, 1, MRI_FLOAT, 1);
-  if (SrcHits == NULL) return (NULL);
-  MRIcopyHeader(SrcSurfVals, SrcHits);
+  std::vector<int> SrcHits(SrcSurfReg->nvertices, 0);
+
+  /* target, source and divisor of each mapped value, in the order the
+     values are accumulated into the target */
+  std::vector<int> etrg, esrc;
+  std::vector<float> ediv;
+  etrg.reserve(TrgSurfReg->nvertices);
+  esrc.reserve(TrgSurfReg->nvertices);
+  ediv.reserve(TrgSurfReg->nvertices);
 
   if (UseHash) {
     printf("MRISapplyReg: building hash tables (res=16).\n");
@@ -1030,8 +1048,8 @@ MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int Rever
         tvtxN = svtx;
       }
       /* update the number of hits and distance */
-      MRIFseq_vox((SrcHits), svtx, 0, 0, 0)++;
-      MRIFseq_vox((TrgHits), tvtx, 0, 0, 0)++;
+      SrcHits[svtx]++;
+      TrgHits[tvtx]++;
     }
   }
 
@@ -1122,16 +1140,17 @@ MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int Rever
 
     if (!DoJac) {
       /* update the number of hits */
-      MRIFseq_vox(SrcHits, svtx, 0, 0, 0)++;
-      MRIFseq_vox(TrgHits, tvtx, 0, 0, 0)++;
+      SrcHits[svtx]++;
+      TrgHits[tvtx]++;
       nhits = 1;
     }
     else
-      nhits = MRIgetVoxVal(SrcHits, svtx, 0, 0, 0);
+      nhits = SrcHits[svtx];
 
-    /* accumulate mapped values for each frame */
-    for (f = 0; f < SrcSurfVals->nframes; f++)
-      MRIFseq_vox(TrgSurfVals, tvtx, 0, 0, f) += (MRIFseq_vox(SrcSurfVals, svtx, 0, 0, f) / nhits);
+    /* the mapped value is the source value divided by nhits */
+    etrg.push_back(tvtx);
+    esrc.push_back(svtx);
+    ediv.push_back(nhits);
   }
   if(stvpairfp) fclose(stvpairfp);
 
@@ -1143,7 +1162,7 @@ MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int Rever
     printf("MRISapplyReg: Reverse Loop (%d)\n", SrcSurfReg->nvertices);
     nrevhits = 0;
     for (svtx = 0; svtx < SrcSurfReg->nvertices; svtx++) {
-      if (MRIFseq_vox((SrcHits), svtx, 0, 0, 0) != 0) continue;
+      if (SrcHits[svtx] != 0) continue;
       nrevhits++;
 
       // Compute the target vertex that corresponds to this source vertex
@@ -1163,40 +1182,267 @@ MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int Rever
       }
 
       /* update the number of hits */
-      MRIFseq_vox((SrcHits), svtx, 0, 0, 0)++;
-      MRIFseq_vox((TrgHits), tvtx, 0, 0, 0)++;
-      /* accumulate mapped values for each frame */
-      for (f = 0; f < SrcSurfVals->nframes; f++)
-        MRIFseq_vox(TrgSurfVals, tvtx, 0, 0, f) += MRIFseq_vox(SrcSurfVals, svtx, 0, 0, f);
+      SrcHits[svtx]++;
+      TrgHits[tvtx]++;
+      /* the source value is added as it is */
+      etrg.push_back(tvtx);
+      esrc.push_back(svtx);
+      ediv.push_back(1);
     }
     printf("  Reverse Loop had %d hits\n", nrevhits);
   }
 
-  /*---------------------------------------------------------------
-  Finally, divide the value at each target vertex by the number
-  of source vertices mapping into it */
-  if (!DoJac) {
-    printf("MRISapplyReg: Dividing by number of hits (%d)\n", TrgSurfReg->nvertices);
-    for (tvtx = 0; tvtx < TrgSurfReg->nvertices; tvtx++) {
-      n = MRIFseq_vox((TrgHits), tvtx, 0, 0, 0);
-      if (n > 1) {
-        for (f = 0; f < SrcSurfVals->nframes; f++) MRIFseq_vox(TrgSurfVals, tvtx, 0, 0, f) /= n;
-      }
-    }
-  }
-
   /* Count lost sources */
   nSrcLost = 0;
   for (svtx = 0; svtx < SrcSurfReg->nvertices; svtx++) {
-    n = MRIFseq_vox((SrcHits), svtx, 0, 0, 0);
-    if (n == 0) nSrcLost++;
+    if (SrcHits[svtx] == 0) nSrcLost++;
   }
   printf("MRISapplyReg: nSrcLost = %d\n", nSrcLost);
 
-  MRIfree(&SrcHits);
-  MRIfree(&TrgHits);
-  if (UseHash)
+  if (UseHash) {
     for (n = 0; n < nsurfs; n++) MHTfree(&Hash[n]);
+    free(Hash);
+  }
+
+  MRIS_APPLYREG_MAP *map = new MRIS_APPLYREG_MAP;
+  map->nsrc = SrcSurfReg->nvertices;
+  map->ntrg = TrgSurfReg->nvertices;
+  map->ReverseMapFlag = ReverseMapFlag;
+  map->DoJac = DoJac;
+  map->UseHash = UseHash;
+  map->checksum = MRISapplyRegChecksum(SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+  map->nSrcLost = nSrcLost;
+
+  /* Sort the entries by target, keeping the order within each target
+     (counting sort). Without jacobian correction each target is finally
+     divided by the number of source vertices mapping into it */
+  map->rowstart.assign(map->ntrg + 1, 0);
+  for (int const t : etrg) map->rowstart[t + 1]++;
+  for (tvtx = 0; tvtx < map->ntrg; tvtx++) map->rowstart[tvtx + 1] += map->rowstart[tvtx];
+  map->srcvtx.resize(etrg.size());
+  map->srcdiv.resize(etrg.size());
+  std::vector<int> next(map->rowstart.begin(), map->rowstart.end() - 1);
+  for (size_t k = 0; k < etrg.size(); k++) {
+    int const dst = next[etrg[k]]++;
+    map->srcvtx[dst] = esrc[k];
+    map->srcdiv[dst] = ediv[k];
+  }
+  map->trgdiv.resize(map->ntrg);
+  for (tvtx = 0; tvtx < map->ntrg; tvtx++) map->trgdiv[tvtx] = (!DoJac && TrgHits[tvtx] > 1) ? TrgHits[tvtx] : 1;
+
+  return (map);
+}
+
+
+/*!
+\fn MRI *MRISapplyRegMapApply(MRIS_APPLYREG_MAP *map, MRI *SrcSurfVals)
+\brief Applies a correspondence computed by MRISapplyRegMap() to all frames of
+SrcSurfVals (MRI_FLOAT, one column per source vertex). The result is
+identical to that of MRISapplyReg() with the same surfaces and options.
+*/
+MRI *MRISapplyRegMapApply(MRIS_APPLYREG_MAP *map, MRI *SrcSurfVals)
+{
+  /* check dimension consistency */
+  if (SrcSurfVals->width != map->nsrc) {
+    printf("MRISapplyReg: Vals and Reg dimension mismatch\n");
+    printf("nVals = %d, nReg %d\n", SrcSurfVals->width, map->nsrc);
+    return (NULL);
+  }
+
+  /* allocate a "volume" to hold the output */
+  MRI *TrgSurfVals = MRIallocSequence(map->ntrg, 1, 1, MRI_FLOAT, SrcSurfVals->nframes);
+  if (TrgSurfVals == NULL) return (NULL);
+  MRIcopyHeader(SrcSurfVals, TrgSurfVals);
+
+  /* each target only reads its own entries, and they are summed in the
+     order the values used to be accumulated */
+  int tvtx;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (tvtx = 0; tvtx < map->ntrg; tvtx++) {
+    ROMP_PFLB_begin
+    int const k0 = map->rowstart[tvtx];
+    int const k1 = map->rowstart[tvtx + 1];
+    if (k0 == k1) ROMP_PFLB_continue;
+    for (int f = 0; f < SrcSurfVals->nframes; f++) {
+      float val = 0;
+      for (int k = k0; k < k1; k++) val += MRIFseq_vox(SrcSurfVals, map->srcvtx[k], 0, 0, f) / map->srcdiv[k];
+      if (map->trgdiv[tvtx] > 1) val /= map->trgdiv[tvtx];
+      MRIFseq_vox(TrgSurfVals, tvtx, 0, 0, f) = val;
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  return (TrgSurfVals);
+}
+
+
+#define MRIS_APPLYREG_MAP_MAGIC 0x53324d50  // "S2MP"
+#define MRIS_APPLYREG_MAP_VERSION 1
+
+/*!
+\fn int MRISapplyRegMapWrite(MRIS_APPLYREG_MAP *map, const char *fname)
+\brief Saves the map (big endian binary) so that it can be applied again
+without the registration surfaces being searched.
+*/
+int MRISapplyRegMapWrite(MRIS_APPLYREG_MAP *map, const char *fname)
+{
+  FILE *fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    printf("ERROR: MRISapplyRegMapWrite(): could not open %s\n", fname);
+    return (1);
+  }
+  long const nentries = map->srcvtx.size();
+  fwriteInt(MRIS_APPLYREG_MAP_MAGIC, fp);
+  fwriteInt(MRIS_APPLYREG_MAP_VERSION, fp);
+  fwriteInt(map->nsrc, fp);
+  fwriteInt(map->ntrg, fp);
+  fwriteInt(map->ReverseMapFlag, fp);
+  fwriteInt(map->DoJac, fp);
+  fwriteInt(map->UseHash, fp);
+  fwriteLong((long long)map->checksum, fp);
+  fwriteInt(map->nSrcLost, fp);
+  fwriteInt(nentries, fp);
+  long n = fwriteIntArray(map->rowstart.data(), map->ntrg + 1, fp);
+  n += fwriteIntArray(map->srcvtx.data(), nentries, fp);
+  n += fwriteFloatArray(map->srcdiv.data(), nentries, fp);
+  n += fwriteFloatArray(map->trgdiv.data(), map->ntrg, fp);
+  int const err = (n != 2 * (map->ntrg + nentries) + 1) || ferror(fp);
+  if (fclose(fp) || err) {
+    printf("ERROR: MRISapplyRegMapWrite(): could not write %s\n", fname);
+    return (1);
+  }
+  return (0);
+}
+
+
+/*!
+\fn MRIS_APPLYREG_MAP *MRISapplyRegMapRead(const char *fname)
+\brief Reads a map saved by MRISapplyRegMapWrite(). Returns NULL if the file
+cannot be read or is not such a map.
+*/
+MRIS_APPLYREG_MAP *MRISapplyRegMapRead(const char *fname)
+{
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) {
+    printf("ERROR: MRISapplyRegMapRead(): could not open %s\n", fname);
+    return (NULL);
+  }
+  if (freadInt(fp) != MRIS_APPLYREG_MAP_MAGIC || freadInt(fp) != MRIS_APPLYREG_MAP_VERSION) {
+    printf("ERROR: MRISapplyRegMapRead(): %s is not a surface registration map\n", fname);
+    fclose(fp);
+    return (NULL);
+  }
+  MRIS_APPLYREG_MAP *map = new MRIS_APPLYREG_MAP;
+  map->nsrc = freadInt(fp);
+  map->ntrg = freadInt(fp);
+  map->ReverseMapFlag = freadInt(fp);
+  map->DoJac = freadInt(fp);
+  map->UseHash = freadInt(fp);
+  map->checksum = (unsigned long)freadLong(fp);
+  map->nSrcLost = freadInt(fp);
+  long const nentries = freadInt(fp);
+  if (map->nsrc < 0 || map->ntrg < 0 || nentries < 0 || feof(fp)) {
+    printf("ERROR: MRISapplyRegMapRead(): %s is corrupt\n", fname);
+    fclose(fp);
+    MRISapplyRegMapFree(&map);
+    return (NULL);
+  }
+  map->rowstart.resize(map->ntrg + 1);
+  map->srcvtx.resize(nentries);
+  map->srcdiv.resize(nentries);
+  map->trgdiv.resize(map->ntrg);
+  long n = freadIntArray(map->rowstart.data(), map->ntrg + 1, fp);
+  n += freadIntArray(map->srcvtx.data(), nentries, fp);
+  n += freadFloatArray(map->srcdiv.data(), nentries, fp);
+  n += freadFloatArray(map->trgdiv.data(), map->ntrg, fp);
+  fclose(fp);
+
+  int ok = (n == 2 * (map->ntrg + nentries) + 1) && map->rowstart[0] == 0 && map->rowstart[map->ntrg] == nentries;
+  for (int tvtx = 0; ok && tvtx < map->ntrg; tvtx++) ok = map->rowstart[tvtx] <= map->rowstart[tvtx + 1];
+  for (long k = 0; ok && k < nentries; k++) ok = map->srcvtx[k] >= 0 && map->srcvtx[k] < map->nsrc;
+  if (!ok) {
+    printf("ERROR: MRISapplyRegMapRead(): %s is corrupt\n", fname);
+    MRISapplyRegMapFree(&map);
+    return (NULL);
+  }
+  return (map);
+}
+
+
+/*!
+\fn MRIS_APPLYREG_MAP *MRISapplyRegMapCached(const char *fname, MRI_SURFACE **SurfReg,
+                  int nsurfs, int ReverseMapFlag, int DoJac, int UseHash)
+\brief Returns the map saved in fname if it was computed from the same
+surfaces with the same options (see MRISapplyRegChecksum()), otherwise
+computes it with MRISapplyRegMap() and saves it to fname. This way the
+correspondence between a subject and a target is only searched once, no
+matter how many measures are mapped with it.
+*/
+MRIS_APPLYREG_MAP *MRISapplyRegMapCached(
+    const char *fname, MRI_SURFACE **SurfReg, int nsurfs, int ReverseMapFlag, int DoJac, int UseHash)
+{
+  MRIS_APPLYREG_MAP *map;
+
+  // the vertex pair file is written while searching
+  if (fio_FileExistsReadable(fname) && !getenv("FS_MRISAPPLYREG_STVPAIR")) {
+    map = MRISapplyRegMapRead(fname);
+    if (map && map->nsrc == SurfReg[0]->nvertices && map->ntrg == SurfReg[nsurfs - 1]->nvertices &&
+        map->checksum == MRISapplyRegChecksum(SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash)) {
+      printf("MRISapplyReg: using map %s (nSrcLost = %d)\n", fname, map->nSrcLost);
+      return (map);
+    }
+    printf("MRISapplyReg: map %s was computed from other surfaces or options, recomputing it\n", fname);
+    if (map) MRISapplyRegMapFree(&map);
+  }
+
+  map = MRISapplyRegMap(SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+  if (map == NULL) return (NULL);
+  printf("MRISapplyReg: saving map to %s\n", fname);
+  if (MRISapplyRegMapWrite(map, fname)) printf("WARNING: MRISapplyRegMapCached(): map not saved\n");
+  return (map);
+}
+
+
+void MRISapplyRegMapFree(MRIS_APPLYREG_MAP **pmap)
+{
+  delete *pmap;
+  *pmap = NULL;
+}
+
+
+/*!
+\fn MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
+                  int ReverseMapFlag, int DoJac, int UseHash)
+\brief Applies one or more surface registrations with or without jacobian correction.
+This should be used as a replacement for surf2surf_nnfr and surf2surf_nnfr_jac
+(it gives identical results). To map several inputs with the same
+registration, compute the map once with MRISapplyRegMap() (or
+MRISapplyRegMapCached()) and apply it with MRISapplyRegMapApply().
+\param MRI *SrcSurfVals - Inputs
+\param MRIS **SurfReg - array of surface reg pairs, src1-trg1:src2-trg2:... where
+trg1 and src2 are from the same anatomy.
+\param int nsurfs - total number of surfs in SurfReg
+\param int ReverseMapFlag - perform reverse mapping
+\param int DoJac - perform jacobian correction (conserves sum(SrcVals))
+\param int UseHash - use hash table (no reason not to, much faster).
+*/
+MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs, int ReverseMapFlag, int DoJac, int UseHash)
+{
+  /* check dimension consistency before searching */
+  if (SrcSurfVals->width != SurfReg[0]->nvertices) {
+    printf("MRISapplyReg: Vals and Reg dimension mismatch\n");
+    printf("nVals = %d, nReg %d\n", SrcSurfVals->width, SurfReg[0]->nvertices);
+    return (NULL);
+  }
+
+  MRIS_APPLYREG_MAP *map = MRISapplyRegMap(SurfReg, nsurfs, ReverseMapFlag, DoJac, UseHash);
+  if (map == NULL) return (NULL);
+  MRI *TrgSurfVals = MRISapplyRegMapApply(map, SrcSurfVals);
+  MRISapplyRegMapFree(&map);
   return (TrgSurfVals);
 }
 
@@ -0,0 +1,134 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+//
+// gcapack_bench <gca> [<norm.mgz> <talairach.m3z|lta>]
+//
+// Compares the regular and the packed (GCApack) layout of an atlas:
+// memory footprint, a posterior sweep over every prior, and - if an input
+// volume and transform are given - GCAlabel() time. The labels from both
+// layouts must be identical.
+//
+
+#include <iostream>
+
+#include "error.h"
+#include "gca.h"
+#include "mri.h"
+#include "timer.h"
+#include "transform.h"
+
+const char *Progname = "gcapack_bench";
+
+using namespace std;
+
+static double posteriorSweep(GCA *gca)
+{
+  double total = 0;
+  float vals[MAX_GCA_INPUTS];
+
+  for (int xp = 0; xp < gca->prior_width; xp++)
+    for (int yp = 0; yp < gca->prior_height; yp++)
+      for (int zp = 0; zp < gca->prior_depth; zp++) {
+        int xn, yn, zn;
+        GCA_PRIOR *gcap = &gca->priors[xp][yp][zp];
+        if (gcap->nlabels == 0 || GCApriorToNode(gca, xp, yp, zp, &xn, &yn, &zn)) continue;
+        GCA_NODE *gcan = &gca->nodes[xn][yn][zn];
+        GC1D *gc = GCAfindGC(gca, xn, yn, zn, gcap->labels[0]);
+        if (gc == NULL) continue;
+        for (int r = 0; r < gca->ninputs; r++) vals[r] = gc->means[r];
+        for (int n = 0; n < gcap->nlabels; n++)
+          total += GCAcomputePosteriorDensity(gcap, gcan, -1, n, vals, gca->ninputs, xn, yn, zn, gca);
+      }
+  return total;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2 && argc != 4) {
+    cout << "Usage: gcapack_bench <gcafile> [<input volume> <transform>]" << endl;
+    return -1;
+  }
+
+  GCA *gca = GCAread(argv[1]);
+  GCA *gca_packed = GCAread(argv[1]);
+  if (gca == NULL || gca_packed == NULL) {
+    cout << "could not open file " << argv[1] << endl;
+    return -1;
+  }
+
+  size_t nallocs, nallocs_packed;
+  size_t nbytes = GCAmemoryUsage(gca, &nallocs);
+  Timer timer;
+  GCApack(gca_packed);
+  long pack_msec = timer.milliseconds();
+  size_t nbytes_packed = GCAmemoryUsage(gca_packed, &nallocs_packed);
+
+  // glibc needs at least 16 bytes of bookkeeping per heap block
+  cout << "heap layout:   " << nbytes / (1024.0 * 1024.0) << " MB in " << nallocs << " blocks (~"
+       << (nbytes + 16 * nallocs) / (1024.0 * 1024.0) << " MB resident)" << endl;
+  cout << "packed layout: " << nbytes_packed / (1024.0 * 1024.0) << " MB in " << nallocs_packed << " blocks, packed in "
+       << pack_msec << " msec" << endl;
+
+  timer.reset();
+  double p = posteriorSweep(gca);
+  long sweep_msec = timer.milliseconds();
+  timer.reset();
+  double p_packed = posteriorSweep(gca_packed);
+  long sweep_msec_packed = timer.milliseconds();
+  cout << "posterior sweep: " << sweep_msec << " msec heap, " << sweep_msec_packed << " msec packed" << endl;
+  if (p != p_packed) {
+    cout << "ERROR: posterior sums differ (" << p << " vs " << p_packed << ")" << endl;
+    return 1;
+  }
+
+  int ret = 0;
+  if (argc == 4) {
+    MRI *mri_inputs = MRIread(argv[2]);
+    TRANSFORM *transform = TransformRead(argv[3]);
+    if (mri_inputs == NULL || transform == NULL) {
+      cout << "could not read " << argv[2] << " or " << argv[3] << endl;
+      return -1;
+    }
+    TransformInvert(transform, mri_inputs);
+
+    timer.reset();
+    MRI *mri_labeled = GCAlabel(mri_inputs, gca, NULL, transform);
+    long label_msec = timer.milliseconds();
+    timer.reset();
+    MRI *mri_labeled_packed = GCAlabel(mri_inputs, gca_packed, NULL, transform);
+    long label_msec_packed = timer.milliseconds();
+    cout << "GCAlabel: " << label_msec << " msec heap, " << label_msec_packed << " msec packed" << endl;
+
+    int ndiff = 0;
+    for (int z = 0; z < mri_labeled->depth; z++)
+      for (int y = 0; y < mri_labeled->height; y++)
+        for (int x = 0; x < mri_labeled->width; x++)
+          if (MRIgetVoxVal(mri_labeled, x, y, z, 0) != MRIgetVoxVal(mri_labeled_packed, x, y, z, 0)) ndiff++;
+    if (ndiff) {
+      cout << "ERROR: " << ndiff << " voxels labeled differently" << endl;
+      ret = 1;
+    }
+
+    MRIfree(&mri_labeled);
+    MRIfree(&mri_labeled_packed);
+    MRIfree(&mri_inputs);
+    TransformFree(&transform);
+  }
+
+  GCAfree(&gca);
+  GCAfree(&gca_packed);
+  return ret;
+}
@@ -0,0 +1,110 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+//
+// mriio_mmap_test [<tmpdir>]
+//
+// Writes random uchar, short and float volumes as .mgh and .nii, reads each
+// back with the normal loader and with MRIIO_UseMmap, and fails unless every
+// voxel of the two agrees. Volumes whose data is in native byte order must
+// actually have been mapped; the others must have been read.
+//
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "error.h"
+#include "mri.h"
+#include "utils.h"
+
+const char *Progname = "mriio_mmap_test";
+
+using namespace std;
+
+static int compare(const string &fname, int type)
+{
+  MRIIO_UseMmap = 0;
+  MRI *mri_read = MRIread(fname.c_str());
+  MRIIO_UseMmap = 1;
+  MRI *mri_mapped = MRIread(fname.c_str());
+  MRIIO_UseMmap = 0;
+  if (mri_read == NULL || mri_mapped == NULL) {
+    cout << "ERROR: could not read " << fname << endl;
+    return 1;
+  }
+
+  int ret = 0;
+  long ndiff = 0;
+  for (int f = 0; f < mri_read->nframes; f++)
+    for (int z = 0; z < mri_read->depth; z++)
+      for (int y = 0; y < mri_read->height; y++)
+        for (int x = 0; x < mri_read->width; x++)
+          if (MRIgetVoxVal(mri_read, x, y, z, f) != MRIgetVoxVal(mri_mapped, x, y, z, f)) ndiff++;
+  if (ndiff) {
+    cout << "ERROR: " << fname << ": " << ndiff << " voxels differ" << endl;
+    ret = 1;
+  }
+
+  // big-endian mgh data would have to be swapped, which copies every page
+  bool native = true;
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  if (fname.find(".mgh") != string::npos && type != MRI_UCHAR) native = false;
+#endif
+  if ((mri_mapped->mapping != NULL) != native) {
+    cout << "ERROR: " << fname << (native ? " was not mapped" : " was mapped") << endl;
+    ret = 1;
+  }
+  cout << fname << ": " << (mri_mapped->mapping ? "mapped" : "read") << ", " << ndiff << " voxels differ" << endl;
+
+  MRIfree(&mri_read);
+  MRIfree(&mri_mapped);
+  unlink(fname.c_str());
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  string dir = (argc > 1) ? argv[1] : ".";
+  int types[] = {MRI_UCHAR, MRI_SHORT, MRI_FLOAT};
+  const char *names[] = {"uchar", "short", "float"};
+  const char *exts[] = {"mgh", "nii"};
+
+  setRandomSeed(1234);
+  int ret = 0;
+  for (int t = 0; t < 3; t++) {
+    MRI *mri = MRIallocSequence(37, 23, 11, types[t], 2);
+    for (int f = 0; f < mri->nframes; f++)
+      for (int z = 0; z < mri->depth; z++)
+        for (int y = 0; y < mri->height; y++)
+          for (int x = 0; x < mri->width; x++) {
+            double val = randomNumber(0, 250);
+            if (types[t] == MRI_SHORT) val = randomNumber(-30000, 30000);
+            if (types[t] == MRI_FLOAT) val = randomNumber(-1e4, 1e4);
+            MRIsetVoxVal(mri, x, y, z, f, val);
+          }
+    for (int e = 0; e < 2; e++) {
+      string fname = dir + "/mriio_mmap_test." + names[t] + "." + exts[e];
+      if (MRIwrite(mri, fname.c_str()) != NO_ERROR) {
+        cout << "ERROR: could not write " << fname << endl;
+        ret = 1;
+        continue;
+      }
+      ret |= compare(fname, types[t]);
+    }
+    MRIfree(&mri);
+  }
+  return ret;
+}
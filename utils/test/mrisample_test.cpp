@@ -0,0 +1,127 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+//
+// mrisample_test
+//
+// Fills uchar, short, ushort, int and float volumes with random values, maps
+// a target grid into them through a random rotation, scaling and shift (so
+// that part of it falls outside), adds integral and border coordinates, and
+// fails unless MRIsampleVolumeFrameTypeBatch() returns exactly what
+// MRIsampleVolumeFrameType() returns point by point, for nearest and
+// trilinear sampling of every frame.
+//
+
+#include <math.h>
+#include <iostream>
+#include <vector>
+
+#include "error.h"
+#include "mri.h"
+#include "utils.h"
+
+const char *Progname = "mrisample_test";
+
+using namespace std;
+
+// coordinates of a 48x40x32 grid under a random affine, plus special points
+static void makePoints(const MRI *mri, vector<double> &xs, vector<double> &ys, vector<double> &zs)
+{
+  double ax = randomNumber(-0.5, 0.5), ay = randomNumber(-0.5, 0.5), az = randomNumber(-0.5, 0.5);
+  double s = randomNumber(0.8, 1.2);
+  double cx = cos(ax), sx = sin(ax), cy = cos(ay), sy = sin(ay), cz = cos(az), sz = sin(az);
+  double R[3][3] = {{cy * cz, -cy * sz, sy},
+                    {sx * sy * cz + cx * sz, -sx * sy * sz + cx * cz, -sx * cy},
+                    {-cx * sy * cz + sx * sz, cx * sy * sz + sx * cz, cx * cy}};
+  double t[3] = {randomNumber(-6, 6), randomNumber(-6, 6), randomNumber(-6, 6)};
+
+  for (int z = 0; z < 32; z++)
+    for (int y = 0; y < 40; y++)
+      for (int x = 0; x < 48; x++) {
+        double p[3] = {x - 24.0, y - 20.0, z - 16.0};
+        double q[3];
+        for (int i = 0; i < 3; i++) q[i] = s * (R[i][0] * p[0] + R[i][1] * p[1] + R[i][2] * p[2]) + t[i];
+        xs.push_back(q[0] + mri->width / 2.0);
+        ys.push_back(q[1] + mri->height / 2.0);
+        zs.push_back(q[2] + mri->depth / 2.0);
+      }
+
+  // integral coordinates take the nearest path in the scalar code
+  for (int i = 0; i < 500; i++) {
+    xs.push_back((int)randomNumber(-2, mri->width + 2));
+    ys.push_back((int)randomNumber(-2, mri->height + 2));
+    zs.push_back((int)randomNumber(-2, mri->depth + 2));
+  }
+
+  // on and just inside/outside the last voxel
+  double d[] = {-0.5, -1e-9, 0, 1e-9, 0.25};
+  for (int i = 0; i < 5; i++)
+    for (int j = 0; j < 5; j++) {
+      xs.push_back(mri->width - 1 + d[i]);
+      ys.push_back(mri->height - 1 + d[j]);
+      zs.push_back(d[(i + j) % 5]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  int types[] = {MRI_UCHAR, MRI_SHORT, MRI_USHRT, MRI_INT, MRI_FLOAT};
+  const char *names[] = {"uchar", "short", "ushort", "int", "float"};
+  int interps[] = {SAMPLE_NEAREST, SAMPLE_TRILINEAR};
+  const char *inames[] = {"nearest", "trilinear"};
+
+  setRandomSeed(1234);
+  int ret = 0;
+  for (int t = 0; t < 5; t++) {
+    MRI *mri = MRIallocSequence(41, 33, 27, types[t], 2);
+    for (int f = 0; f < mri->nframes; f++)
+      for (int z = 0; z < mri->depth; z++)
+        for (int y = 0; y < mri->height; y++)
+          for (int x = 0; x < mri->width; x++) {
+            double val = randomNumber(0, 250);
+            if (types[t] == MRI_SHORT) val = randomNumber(-30000, 30000);
+            if (types[t] == MRI_USHRT) val = randomNumber(0, 60000);
+            if (types[t] == MRI_INT) val = randomNumber(-1e6, 1e6);
+            if (types[t] == MRI_FLOAT) val = randomNumber(-1e4, 1e4);
+            MRIsetVoxVal(mri, x, y, z, f, val);
+          }
+
+    vector<double> xs, ys, zs;
+    makePoints(mri, xs, ys, zs);
+    int npoints = xs.size();
+    vector<double> vals(npoints);
+
+    for (int m = 0; m < 2; m++)
+      for (int f = 0; f < mri->nframes; f++) {
+        MRIsampleVolumeFrameTypeBatch(mri, npoints, xs.data(), ys.data(), zs.data(), f, interps[m], vals.data());
+        long ndiff = 0;
+        for (int i = 0; i < npoints; i++) {
+          double val;
+          MRIsampleVolumeFrameType(mri, xs[i], ys[i], zs[i], f, interps[m], &val);
+          if (val != vals[i]) {
+            if (ndiff < 5)
+              cout << "  " << xs[i] << " " << ys[i] << " " << zs[i] << ": batch " << vals[i] << " scalar " << val
+                   << endl;
+            ndiff++;
+          }
+        }
+        cout << names[t] << " " << inames[m] << " frame " << f << (mri->ischunked ? " (chunked)" : "") << ": "
+             << ndiff << " of " << npoints << " points differ" << endl;
+        if (ndiff) ret = 1;
+      }
+    MRIfree(&mri);
+  }
+  return ret;
+}
@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+//
+// mrisbvh_bench <surface> [<spacing>]
+//
+// Runs the point inclusion test on a grid of points (default 2mm apart)
+// covering the bounding box of a surface, with MRISOBBTree and with MRISBVH
+// serially and batched. Prints the build and query times and fails if any
+// answer differs.
+//
+
+#include <iostream>
+#include <vector>
+
+#include "MRISOBBTree.h"
+#include "error.h"
+#include "mrisbvh.h"
+#include "mrisurf.h"
+#include "timer.h"
+
+const char *Progname = "mrisbvh_bench";
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2 && argc != 3) {
+    cout << "Usage: mrisbvh_bench <surface> [<spacing>]" << endl;
+    return -1;
+  }
+  double spacing = (argc == 3) ? atof(argv[2]) : 2.0;
+
+  // MRISOBBTree frees the surface it is given, so it gets its own copy
+  MRIS *mris = MRISread(argv[1]);
+  MRIS *mris_obb = MRISread(argv[1]);
+  if (!mris || !mris_obb) {
+    cout << "could not read " << argv[1] << endl;
+    return -1;
+  }
+  cout << mris->nvertices << " vertices, " << mris->nfaces << " faces" << endl;
+
+  Timer timer;
+  MRISOBBTree *obb = new MRISOBBTree(mris_obb);
+  obb->ConstructTree();
+  long obb_build = timer.milliseconds();
+  timer.reset();
+  MRISBVH bvh(mris);
+  long bvh_build = timer.milliseconds();
+  cout << "build:  " << obb_build << " msec OBB tree, " << bvh_build << " msec BVH (" << bvh.GetNodesCount()
+       << " nodes, depth " << bvh.GetDeepestLevel() << ")" << endl;
+
+  vector<double> xyz;
+  for (double x = mris->xlo - 2; x <= mris->xhi + 2; x += spacing)
+    for (double y = mris->ylo - 2; y <= mris->yhi + 2; y += spacing)
+      for (double z = mris->zlo - 2; z <= mris->zhi + 2; z += spacing) {
+        xyz.push_back(x);
+        xyz.push_back(y);
+        xyz.push_back(z);
+      }
+  int npoints = xyz.size() / 3;
+
+  vector<int> obb_res(npoints), bvh_res(npoints), batch_res(npoints);
+  timer.reset();
+  for (int i = 0; i < npoints; i++) obb_res[i] = obb->PointInclusionTest(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+  long obb_query = timer.milliseconds();
+  timer.reset();
+  for (int i = 0; i < npoints; i++) bvh_res[i] = bvh.PointInclusionTest(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+  long bvh_query = timer.milliseconds();
+  timer.reset();
+  bvh.PointInclusionTests(npoints, &xyz[0], &batch_res[0]);
+  long batch_query = timer.milliseconds();
+  cout << "query:  " << npoints << " points, " << obb_query << " msec OBB tree, " << bvh_query << " msec BVH, "
+       << batch_query << " msec BVH batched" << endl;
+
+  int ret = 0, ndiff = 0;
+  for (int i = 0; i < npoints; i++)
+    if (obb_res[i] != bvh_res[i] || bvh_res[i] != batch_res[i]) ndiff++;
+  if (ndiff) {
+    cout << "ERROR: " << ndiff << " point inclusion answers differ" << endl;
+    ret = 1;
+  }
+
+  delete obb;
+  MRISfree(&mris);
+  return ret;
+}
@@ -0,0 +1,160 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+//
+// mrishash_parallel_bench <surface> [<nthreads>]
+//
+// Builds the vertex and face hash tables of a surface (e.g. a ~150k vertex
+// lh.white) with one thread and with nthreads, and runs closest-vertex,
+// closest-face and self-intersection queries over every vertex/face, serially
+// and concurrently. It then moves every vertex a little and compares keeping
+// the face table current with MHTupdateAllFaces against rebuilding it.
+// Prints the timings and fails if any answer differs.
+//
+
+#include <iostream>
+#include <math.h>
+#include <vector>
+
+#include "error.h"
+#include "mrishash.h"
+#include "mrisurf.h"
+#include "romp_support.h"
+#include "timer.h"
+
+const char *Progname = "mrishash_parallel_bench";
+
+using namespace std;
+
+struct Answers
+{
+  vector<int> vno, fno, intersects;
+};
+
+static void query(MRIS *mris, MHT *vht, MHT *fht, int nthreads, Answers &a)
+{
+  a.vno.assign(mris->nvertices, -1);
+  a.fno.assign(mris->nvertices, -1);
+  a.intersects.assign(mris->nfaces, 0);
+
+#ifdef HAVE_OPENMP
+  omp_set_num_threads(nthreads);
+  #pragma omp parallel for
+#endif
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    // probe slightly off the vertex so the search has to look around
+    float x = v->x + 0.3, y = v->y - 0.2, z = v->z + 0.1, dist;
+    a.vno[vno] = MHTfindClosestVertexNoXYZ(vht, mris, x, y, z, &dist);
+    double fdist;
+    MHTfindClosestFaceGeneric(fht, mris, x, y, z, 4, -1, -1, NULL, &a.fno[vno], &fdist);
+  }
+
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for
+#endif
+  for (int fno = 0; fno < mris->nfaces; fno++) a.intersects[fno] = MHTdoesFaceIntersect(fht, mris, fno);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2 && argc != 3) {
+    cout << "Usage: mrishash_parallel_bench <surface> [<nthreads>]" << endl;
+    return -1;
+  }
+
+  MRIS *mris = MRISread(argv[1]);
+  if (!mris) {
+    cout << "could not read " << argv[1] << endl;
+    return -1;
+  }
+
+  int nthreads = 1;
+#ifdef HAVE_OPENMP
+  nthreads = (argc == 3) ? atoi(argv[2]) : omp_get_max_threads();
+  omp_set_num_threads(1);
+#endif
+  cout << mris->nvertices << " vertices, " << mris->nfaces << " faces, " << nthreads << " threads" << endl;
+
+  Timer timer;
+  MHT *fht1 = MHTcreateFaceTable(mris);
+  MHT *vht1 = MHTcreateVertexTable(mris, CURRENT_VERTICES);
+  long build1 = timer.milliseconds();
+
+#ifdef HAVE_OPENMP
+  omp_set_num_threads(nthreads);
+#endif
+  timer.reset();
+  MHT *fhtn = MHTcreateFaceTable(mris);
+  MHT *vhtn = MHTcreateVertexTable(mris, CURRENT_VERTICES);
+  long buildn = timer.milliseconds();
+  cout << "build:   " << build1 << " msec serial, " << buildn << " msec parallel" << endl;
+
+  Answers a1, an, ab;
+  timer.reset();
+  query(mris, vht1, fht1, 1, a1);
+  long query1 = timer.milliseconds();
+  timer.reset();
+  query(mris, vhtn, fhtn, nthreads, an);
+  long queryn = timer.milliseconds();
+  cout << "queries: " << query1 << " msec serial, " << queryn << " msec parallel" << endl;
+
+  // the serially built tables queried concurrently must agree as well
+  query(mris, vht1, fht1, nthreads, ab);
+
+  int ret = 0;
+  if (a1.vno != an.vno || a1.vno != ab.vno) {
+    cout << "ERROR: closest vertex differs" << endl;
+    ret = 1;
+  }
+  if (a1.fno != an.fno || a1.fno != ab.fno) {
+    cout << "ERROR: closest face differs" << endl;
+    ret = 1;
+  }
+  if (a1.intersects != an.intersects || a1.intersects != ab.intersects) {
+    cout << "ERROR: face intersections differ" << endl;
+    ret = 1;
+  }
+
+  // a deformation step: every vertex moves by up to ~0.1mm
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    MRISsetXYZ(mris, vno, v->x + 0.1 * sin(vno), v->y + 0.1 * cos(vno), v->z - 0.05 * sin(0.5 * vno));
+  }
+  timer.reset();
+  int nmoved = MHTupdateAllFaces(fhtn, mris);
+  long update = timer.milliseconds();
+  timer.reset();
+  MHTfree(&fht1);
+  fht1 = MHTcreateFaceTable(mris);
+  long rebuild = timer.milliseconds();
+  cout << "update:  " << update << " msec for " << nmoved << " moved faces, rebuild " << rebuild << " msec" << endl;
+
+  MHTfree(&vhtn);
+  vhtn = MHTcreateVertexTable(mris, CURRENT_VERTICES);
+  query(mris, vhtn, fht1, nthreads, a1);
+  query(mris, vhtn, fhtn, nthreads, an);
+  if (a1.fno != an.fno || a1.intersects != an.intersects) {
+    cout << "ERROR: updated face table differs from a rebuilt one" << endl;
+    ret = 1;
+  }
+
+  MHTfree(&fht1);
+  MHTfree(&vht1);
+  MHTfree(&fhtn);
+  MHTfree(&vhtn);
+  MRISfree(&mris);
+  return ret;
+}
@@ -0,0 +1,194 @@
+/*
+ *
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+
+//
+// mrisio_bench <surface> <tmpdir> [<repeats>]
+//
+// Writes the surface (e.g. a ~160k vertex lh.white), a curvature and an
+// annotation of it to tmpdir, then reads the vertex/face sections of the
+// surface and the values of the curvature value by value with
+// freadFloat/freadInt, as the readers used to, and in one go with
+// freadFloatArray/freadIntArray. Also times the complete MRISread,
+// MRISreadCurvatureFile and MRISreadAnnotation. Prints the timings and
+// fails if the two ways of reading give different values.
+//
+
+#include <iostream>
+#include <vector>
+
+#include "error.h"
+#include "fio.h"
+#include "mrisurf.h"
+#include "timer.h"
+
+const char *Progname = "mrisio_bench";
+
+using namespace std;
+
+// skips the magic number and the "created by" lines as mrisReadTriangleFile does
+static FILE *openTriangleFile(const char *fname, int *nvertices, int *nfaces)
+{
+  FILE *fp = fopen(fname, "rb");
+  if (!fp) return NULL;
+  int magic;
+  char line[STRLEN];
+  fread3(&magic, fp);
+  fgets(line, 200, fp);
+  fscanf(fp, "\n");
+  *nvertices = freadInt(fp);
+  *nfaces = freadInt(fp);
+  return fp;
+}
+
+static FILE *openCurvFile(const char *fname, int *nvertices)
+{
+  FILE *fp = fopen(fname, "rb");
+  if (!fp) return NULL;
+  int magic;
+  fread3(&magic, fp);
+  *nvertices = freadInt(fp);
+  freadInt(fp);  // faces
+  freadInt(fp);  // values per vertex
+  return fp;
+}
+
+static void readSurfaceScalar(const char *fname, vector<float> &xyz, vector<int> &fv)
+{
+  int nvertices, nfaces;
+  FILE *fp = openTriangleFile(fname, &nvertices, &nfaces);
+  xyz.resize(3 * nvertices);
+  fv.resize(3 * nfaces);
+  for (size_t i = 0; i < xyz.size(); i++) xyz[i] = freadFloat(fp);
+  for (size_t i = 0; i < fv.size(); i++) fv[i] = freadInt(fp);
+  fclose(fp);
+}
+
+static void readSurfaceBulk(const char *fname, vector<float> &xyz, vector<int> &fv)
+{
+  int nvertices, nfaces;
+  FILE *fp = openTriangleFile(fname, &nvertices, &nfaces);
+  xyz.resize(3 * nvertices);
+  fv.resize(3 * nfaces);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
+  freadIntArray(fv.data(), fv.size(), fp);
+  fclose(fp);
+}
+
+static void readCurvScalar(const char *fname, vector<float> &curv)
+{
+  int nvertices;
+  FILE *fp = openCurvFile(fname, &nvertices);
+  curv.resize(nvertices);
+  for (int i = 0; i < nvertices; i++) curv[i] = freadFloat(fp);
+  fclose(fp);
+}
+
+static void readCurvBulk(const char *fname, vector<float> &curv)
+{
+  int nvertices;
+  FILE *fp = openCurvFile(fname, &nvertices);
+  curv.resize(nvertices);
+  freadFloatArray(curv.data(), nvertices, fp);
+  fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 3 && argc != 4) {
+    cout << "Usage: mrisio_bench <surface> <tmpdir> [<repeats>]" << endl;
+    return -1;
+  }
+  int repeats = (argc == 4) ? atoi(argv[3]) : 10;
+
+  MRIS *mris = MRISread(argv[1]);
+  if (!mris) {
+    cout << "could not read " << argv[1] << endl;
+    return -1;
+  }
+  cout << mris->nvertices << " vertices, " << mris->nfaces << " faces, " << repeats << " repeats" << endl;
+
+  string surf = string(argv[2]) + "/lh.mrisio_bench";
+  string curv = string(argv[2]) + "/lh.mrisio_bench.curv";
+  string annot = string(argv[2]) + "/lh.mrisio_bench.annot";
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    mris->vertices[vno].curv = sin(0.001 * vno);
+    mris->vertices[vno].annotation = vno % 35;
+  }
+
+  Timer timer;
+  for (int i = 0; i < repeats; i++) {
+    MRISwrite(mris, surf.c_str());
+    MRISwriteCurvature(mris, curv.c_str());
+    MRISwriteAnnotation(mris, annot.c_str(), false);
+  }
+  cout << "write surface+curv+annot: " << timer.milliseconds() / repeats << " msec" << endl;
+
+  int ret = 0;
+  vector<float> xyz1, xyz2, curv1, curv2;
+  vector<int> fv1, fv2;
+
+  timer.reset();
+  for (int i = 0; i < repeats; i++) readSurfaceScalar(surf.c_str(), xyz1, fv1);
+  long scalar = timer.milliseconds();
+  timer.reset();
+  for (int i = 0; i < repeats; i++) readSurfaceBulk(surf.c_str(), xyz2, fv2);
+  long bulk = timer.milliseconds();
+  cout << "surface sections: " << scalar / repeats << " msec per value, " << bulk / repeats << " msec bulk" << endl;
+  if (xyz1 != xyz2 || fv1 != fv2) {
+    cout << "ERROR: surface sections differ" << endl;
+    ret = 1;
+  }
+  for (int vno = 0; vno < mris->nvertices; vno++)
+    if (xyz2[3 * vno] != mris->vertices[vno].x || fv2[3 * (vno % mris->nfaces)] != mris->faces[vno % mris->nfaces].v[0]) {
+      cout << "ERROR: surface file differs from the surface written" << endl;
+      ret = 1;
+      break;
+    }
+
+  timer.reset();
+  for (int i = 0; i < repeats; i++) readCurvScalar(curv.c_str(), curv1);
+  scalar = timer.milliseconds();
+  timer.reset();
+  for (int i = 0; i < repeats; i++) readCurvBulk(curv.c_str(), curv2);
+  bulk = timer.milliseconds();
+  cout << "curvature values: " << scalar / repeats << " msec per value, " << bulk / repeats << " msec bulk" << endl;
+  if (curv1 != curv2) {
+    cout << "ERROR: curvature values differ" << endl;
+    ret = 1;
+  }
+
+  timer.reset();
+  for (int i = 0; i < repeats; i++) {
+    MRIS *mris2 = MRISread(surf.c_str());
+    MRISreadCurvatureFile(mris2, curv.c_str());
+    MRISreadAnnotation(mris2, annot.c_str());
+    if (i == 0)
+      for (int vno = 0; vno < mris->nvertices; vno++)
+        if (mris2->vertices[vno].curv != mris->vertices[vno].curv ||
+            mris2->vertices[vno].annotation != mris->vertices[vno].annotation) {
+          cout << "ERROR: curvature or annotation read back differs" << endl;
+          ret = 1;
+          break;
+        }
+    MRISfree(&mris2);
+  }
+  cout << "MRISread+curv+annot: " << timer.milliseconds() / repeats << " msec" << endl;
+
+  unlink(surf.c_str());
+  unlink(curv.c_str());
+  unlink(annot.c_str());
+  MRISfree(&mris);
+  return ret;
+}